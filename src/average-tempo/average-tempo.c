@@ -61,9 +61,9 @@ int main(int argc, char **argv)
 	to_time = MidiFile_getTimeFromTick(midi_file, MidiFile_getTickFromTimeString(midi_file, to_string));
 	if (to_time <= from_time) to_time = MidiFile_getTimeFromTick(midi_file, MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file)));
 
-	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+	for (event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x51); event != NULL; event = MidiFileEvent_getNextEventOfType(event, -1, 0x51))
 	{
-		if (MidiFileEvent_isTempoEvent(event))
+		if (MidiFileEvent_getTrack(event) == MidiFile_getFirstTrack(midi_file))
 		{
 			float time = MidiFile_getTimeFromTick(midi_file, MidiFileEvent_getTick(event));
 			float tempo = MidiFileTempoEvent_getTempo(event);
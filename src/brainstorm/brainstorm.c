@@ -13,9 +13,11 @@ static char *prefix = "brainstorm-";
 static int timeout_msecs = 5000;
 static char *confirmation_command_pattern = NULL;
 static MidiUtilAlarm_t alarm;
+static MidiUtilLock_t lock;
 static RtMidiInPtr midi_in;
-static MidiFile_t midi_file = NULL;
-static MidiFileTrack_t track = NULL;
+static MidiFile_t midi_file = NULL; /* just the conductor track, for converting times to ticks */
+static MidiFileWriter_t midi_file_writer = NULL;
+static char filename[1024];
 static long start_time_msecs;
 
 static void usage(char *program_name)
@@ -26,28 +28,52 @@ static void usage(char *program_name)
 
 static void create_midi_file_for_first_event(void)
 {
-	if (midi_file != NULL) return;
+	MidiFileTrack_t track;
+	char current_time_string[16];
+
+	if (midi_file_writer != NULL) return;
 	midi_file = MidiFile_new(1, MIDI_FILE_DIVISION_TYPE_PPQ, 960);
 	track = MidiFile_createTrack(midi_file); /* conductor track */
 	MidiFileTrack_createTimeSignatureEvent(track, 0, 4, 4);
 	MidiFileTrack_createKeySignatureEvent(track, 0, 0, 0);
 	MidiFileTrack_createTempoEvent(track, 0, 100.0);
-	track = MidiFile_createTrack(midi_file); /* main track */
+
+	MidiUtil_getCurrentTimeString(current_time_string);
+	sprintf(filename, "%s%s.mid", prefix, current_time_string);
+
+	/* the take goes to disk as it is played, rather than all at once after the timeout */
+
+	if ((midi_file_writer = MidiFileWriter_open(filename, 1, MIDI_FILE_DIVISION_TYPE_PPQ, 960)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot save \"%s\".\n", filename);
+		exit(1);
+	}
+
+	MidiFileWriter_writeTrack(midi_file_writer, track);
+	MidiFileWriter_startTrack(midi_file_writer); /* main track */
 	start_time_msecs = MidiUtil_getCurrentTimeMsecs();
 }
 
 static void handle_alarm(int cancelled, void *user_data)
 {
-	char current_time_string[16];
-	char filename[1024];
+	char saved_filename[1024];
 
 	if (cancelled) return;
 
-	MidiUtil_getCurrentTimeString(current_time_string);
-	sprintf(filename, "%s%s.mid", prefix, current_time_string);
-	MidiFile_save(midi_file, filename);
+	MidiUtilLock_lock(lock);
+
+	if (midi_file_writer == NULL)
+	{
+		MidiUtilLock_unlock(lock);
+		return;
+	}
+
+	MidiFileWriter_close(midi_file_writer);
+	midi_file_writer = NULL;
 	MidiFile_free(midi_file);
 	midi_file = NULL;
+	strcpy(saved_filename, filename); /* the next take can start as soon as the lock is released */
+	MidiUtilLock_unlock(lock);
 
 	if (confirmation_command_pattern != NULL)
 	{
@@ -61,7 +87,7 @@ static void handle_alarm(int cancelled, void *user_data)
 
 				if (*p1 == 's')
 				{
-					for (p3 = filename; *p3 != '\0'; p3++)
+					for (p3 = saved_filename; *p3 != '\0'; p3++)
 					{
 						*(p2++) = *p3;
 					}
@@ -100,6 +126,7 @@ static void handle_midi_message(double timestamp, const unsigned char *message,
 		return;
 	}
 
+	MidiUtilLock_lock(lock);
 	create_midi_file_for_first_event();
 
 	long tick = MidiFile_getTickFromTime(midi_file, (float)(MidiUtil_getCurrentTimeMsecs() - start_time_msecs) / 1000.0);
@@ -108,37 +135,37 @@ static void handle_midi_message(double timestamp, const unsigned char *message,
 	{
 		case MIDI_UTIL_MESSAGE_TYPE_NOTE_OFF:
 		{
-			MidiFileTrack_createNoteOffEvent(track, tick, MidiUtilNoteOffMessage_getChannel(message), MidiUtilNoteOffMessage_getNote(message), MidiUtilNoteOffMessage_getVelocity(message));
+			MidiFileWriter_writeNoteOffEvent(midi_file_writer, tick, MidiUtilNoteOffMessage_getChannel(message), MidiUtilNoteOffMessage_getNote(message), MidiUtilNoteOffMessage_getVelocity(message));
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_NOTE_ON:
 		{
-			MidiFileTrack_createNoteOnEvent(track, tick, MidiUtilNoteOnMessage_getChannel(message), MidiUtilNoteOnMessage_getNote(message), MidiUtilNoteOnMessage_getVelocity(message));
+			MidiFileWriter_writeNoteOnEvent(midi_file_writer, tick, MidiUtilNoteOnMessage_getChannel(message), MidiUtilNoteOnMessage_getNote(message), MidiUtilNoteOnMessage_getVelocity(message));
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_KEY_PRESSURE:
 		{
-			MidiFileTrack_createKeyPressureEvent(track, tick, MidiUtilKeyPressureMessage_getChannel(message), MidiUtilKeyPressureMessage_getNote(message), MidiUtilKeyPressureMessage_getAmount(message));
+			MidiFileWriter_writeKeyPressureEvent(midi_file_writer, tick, MidiUtilKeyPressureMessage_getChannel(message), MidiUtilKeyPressureMessage_getNote(message), MidiUtilKeyPressureMessage_getAmount(message));
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_CONTROL_CHANGE:
 		{
-			MidiFileTrack_createControlChangeEvent(track, tick, MidiUtilControlChangeMessage_getChannel(message), MidiUtilControlChangeMessage_getNumber(message), MidiUtilControlChangeMessage_getValue(message));
+			MidiFileWriter_writeControlChangeEvent(midi_file_writer, tick, MidiUtilControlChangeMessage_getChannel(message), MidiUtilControlChangeMessage_getNumber(message), MidiUtilControlChangeMessage_getValue(message));
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_PROGRAM_CHANGE:
 		{
-			MidiFileTrack_createProgramChangeEvent(track, tick, MidiUtilProgramChangeMessage_getChannel(message), MidiUtilProgramChangeMessage_getNumber(message));
+			MidiFileWriter_writeProgramChangeEvent(midi_file_writer, tick, MidiUtilProgramChangeMessage_getChannel(message), MidiUtilProgramChangeMessage_getNumber(message));
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_CHANNEL_PRESSURE:
 		{
-			MidiFileTrack_createChannelPressureEvent(track, tick, MidiUtilChannelPressureMessage_getChannel(message), MidiUtilChannelPressureMessage_getAmount(message));
+			MidiFileWriter_writeChannelPressureEvent(midi_file_writer, tick, MidiUtilChannelPressureMessage_getChannel(message), MidiUtilChannelPressureMessage_getAmount(message));
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_PITCH_WHEEL:
 		{
-			MidiFileTrack_createPitchWheelEvent(track, tick, MidiUtilPitchWheelMessage_getChannel(message), MidiUtilPitchWheelMessage_getValue(message));
+			MidiFileWriter_writePitchWheelEvent(midi_file_writer, tick, MidiUtilPitchWheelMessage_getChannel(message), MidiUtilPitchWheelMessage_getValue(message));
 			break;
 		}
 		default:
@@ -148,12 +175,22 @@ static void handle_midi_message(double timestamp, const unsigned char *message,
 		}
 	}
 	MidiUtilAlarm_set(alarm, timeout_msecs, handle_alarm, NULL);
+	MidiUtilLock_unlock(lock);
 }
 
 static void handle_exit(void *user_data)
 {
 	MidiUtilAlarm_free(alarm);
 	rtmidi_close_port(midi_in);
+
+	/* keep a take that was still going, without running the confirmation command for it */
+	if (midi_file_writer != NULL)
+	{
+		MidiFileWriter_close(midi_file_writer);
+		MidiFile_free(midi_file);
+	}
+
+	MidiUtilLock_free(lock);
 }
 
 int main(int argc, char **argv)
@@ -189,6 +226,7 @@ int main(int argc, char **argv)
 	}
 
 	alarm = MidiUtilAlarm_new();
+	lock = MidiUtilLock_new();
 
 	if ((midi_in = rtmidi_open_in_port("brainstorm", midi_in_port, "brainstorm", handle_midi_message, NULL)) == NULL)
 	{
@@ -3,29 +3,71 @@
 #include <stdlib.h>
 #include <string.h>
 #include <midifile.h>
+#include <midiutil-batch.h>
+
+static int ratio_clicks = 0;
+static int ratio_beats = 0;
+static int channel = 0;
+static int note = 64;
+static int velocity = 64;
 
 static void usage(char *program_name)
 {
-	fprintf(stderr, "Usage:  %s --click-to-beat-ratio <clicks> <beats> [ --channel <default 0> [ --note <default 64> ] [ --velocity <default 64> ] [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "Usage:  %s --click-to-beat-ratio <clicks> <beats> [ --channel <default 0> [ --note <default 64> ] [ --velocity <default 64> ] [ --jobs <n> ] [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "(<filename.mid> can also be a directory, a wildcard pattern, or - for a list of filenames on stdin, with --out naming an output directory)\n");
 	exit(1);
 }
 
-int main(int argc, char **argv)
+static int process_file(char *input_filename, char *output_filename, char *error_message, size_t error_message_size, void *user_data)
 {
-	int i;
-	int ratio_clicks = 0;
-	int ratio_beats = 0;
-	int channel = 0;
-	int note = 64;
-	int velocity = 64;
-	char *output_filename = NULL;
-	char *input_filename = NULL;
 	MidiFile_t midi_file;
 	long last_tick;
 	MidiFileTrack_t click_track;
-	MidiFileEvent_t event;
 	long click = 0;
 
+	if ((midi_file = MidiFile_load(input_filename)) == NULL)
+	{
+		snprintf(error_message, error_message_size, "Cannot read MIDI file \"%s\".", input_filename);
+		return -1;
+	}
+
+	if (MidiFile_getFileFormat(midi_file) != 1)
+	{
+		snprintf(error_message, error_message_size, "Because this algorithm makes use of multiple, simultaneous tracks, it requires MIDI files in format 1.");
+		MidiFile_free(midi_file);
+		return -1;
+	}
+
+	last_tick = MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
+	click_track = MidiFile_createTrack(midi_file);
+
+	while (1)
+	{
+		long click_tick = MidiFile_getTickFromBeat(midi_file, (float)(click) * ratio_beats / ratio_clicks);
+		long click_end_tick = MidiFile_getTickFromBeat(midi_file, ((float)(click) + 0.5) * ratio_beats / ratio_clicks);
+		if (click_tick > last_tick) break;
+		MidiFileTrack_createNoteStartAndEndEvents(click_track, click_tick, click_end_tick, channel, note, velocity, 0);
+		click++;
+	}
+
+	if (MidiFile_save(midi_file, output_filename) < 0)
+	{
+		snprintf(error_message, error_message_size, "Cannot write MIDI file \"%s\".", output_filename);
+		MidiFile_free(midi_file);
+		return -1;
+	}
+
+	MidiFile_free(midi_file);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int number_of_jobs = 0;
+	int i;
+	char *output_filename = NULL;
+	char *input_filename = NULL;
+
 	for (i = 1; i < argc; i++)
 	{
 		if (strcmp(argv[i], "--help") == 0)
@@ -54,6 +96,11 @@ int main(int argc, char **argv)
 			if (++i == argc) usage(argv[0]);
 			velocity = atoi(argv[i]);
 		}
+		else if (strcmp(argv[i], "--jobs") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_jobs = atoi(argv[i]);
+		}
 		else if (strcmp(argv[i], "--out") == 0)
 		{
 			if (++i == argc) usage(argv[0]);
@@ -66,39 +113,6 @@ int main(int argc, char **argv)
 	}
 
 	if ((ratio_clicks == 0) || (ratio_beats == 0) || (input_filename == NULL)) usage(argv[0]);
-	if (output_filename == NULL) output_filename = input_filename;
-
-	if ((midi_file = MidiFile_load(input_filename)) == NULL)
-	{
-		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", input_filename);
-		exit(1);
-	}
-
-	if (MidiFile_getFileFormat(midi_file) != 1)
-	{
-		fprintf(stderr, "Error:  Because this algorithm makes use of multiple, simultaneous tracks, it requires MIDI files in format 1.\n");
-		exit(1);
-	}
-
-	last_tick = MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
-	click_track = MidiFile_createTrack(midi_file);
-
-	while (1)
-	{
-		long click_tick = MidiFile_getTickFromBeat(midi_file, (float)(click) * ratio_beats / ratio_clicks);
-		long click_end_tick = MidiFile_getTickFromBeat(midi_file, ((float)(click) + 0.5) * ratio_beats / ratio_clicks);
-		if (click_tick > last_tick) break;
-		MidiFileTrack_createNoteStartAndEndEvents(click_track, click_tick, click_end_tick, channel, note, velocity, 0);
-		click++;
-	}
-
-	if (MidiFile_save(midi_file, output_filename) < 0)
-	{
-		fprintf(stderr, "Error:  Cannot write MIDI file \"%s\".\n", output_filename);
-		exit(1);
-	}
-
-	MidiFile_free(midi_file);
-	return 0;
+	return (MidiUtil_processFiles(input_filename, output_filename, number_of_jobs, process_file, NULL) == 0) ? 0 : 1;
 }
 
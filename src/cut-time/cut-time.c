@@ -3,61 +3,31 @@
 #include <stdlib.h>
 #include <string.h>
 #include <midifile.h>
+#include <midiutil-batch.h>
+
+static char *from_string = NULL;
+static char *to_string = NULL;
 
 static void usage(char *program_name)
 {
-	fprintf(stderr, "Usage:  %s [ --from <time> ] [ --to <time> ] [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "Usage:  %s [ --from <time> ] [ --to <time> ] [ --jobs <n> ] [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "(<filename.mid> can also be a directory, a wildcard pattern, or - for a list of filenames on stdin, with --out naming an output directory)\n");
 	exit(1);
 }
 
-int main(int argc, char **argv)
+static int process_file(char *input_filename, char *output_filename, char *error_message, size_t error_message_size, void *user_data)
 {
-	char *from_string = NULL;
-	char *to_string = NULL;
-	char *output_filename = NULL;
-	char *input_filename = NULL;
-	int i;
 	MidiFile_t midi_file;
 	long from_tick;
 	long to_tick;
+	struct MidiFileIterator iterator;
 	MidiFileEvent_t event;
-	MidiFileEvent_t next_event;
 	MidiFileTrack_t track;
 
-	for (i = 1; i < argc; i++)
-	{
-		if (strcmp(argv[i], "--help") == 0)
-		{
-			usage(argv[0]);
-		}
-		else if (strcmp(argv[i], "--from") == 0)
-		{
-			if (++i == argc) usage(argv[0]);
-			from_string = argv[i];
-		}
-		else if (strcmp(argv[i], "--to") == 0)
-		{
-			if (++i == argc) usage(argv[0]);
-			to_string = argv[i];
-		}
-		else if (strcmp(argv[i], "--out") == 0)
-		{
-			if (++i == argc) usage(argv[0]);
-			output_filename = argv[i];
-		}
-		else
-		{
-			input_filename = argv[i];
-		}
-	}
-
-	if (input_filename == NULL) usage(argv[0]);
-	if (output_filename == NULL) output_filename = input_filename;
-
 	if ((midi_file = MidiFile_load(input_filename)) == NULL)
 	{
-		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", input_filename);
-		exit(1);
+		snprintf(error_message, error_message_size, "Cannot read MIDI file \"%s\".", input_filename);
+		return -1;
 	}
 
 	from_tick = MidiFile_getTickFromTimeString(midi_file, from_string);
@@ -65,21 +35,19 @@ int main(int argc, char **argv)
 	to_tick = MidiFile_getTickFromTimeString(midi_file, to_string);
 	if (to_tick < 0) to_tick = MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
 
-	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = next_event)
+	MidiFile_getEventsInRange(midi_file, from_tick, -1, &iterator);
+
+	for (event = MidiFileIterator_next(&iterator); event != NULL; event = MidiFileIterator_next(&iterator))
 	{
 		long tick = MidiFileEvent_getTick(event);
-		next_event = MidiFileEvent_getNextEventInFile(event);
 
-		if (tick >= from_tick)
+		if (tick < to_tick)
 		{
-			if (tick < to_tick)
-			{
-				MidiFileEvent_delete(event);
-			}
-			else
-			{
-				MidiFileEvent_setTick(event, tick - to_tick + from_tick);
-			}
+			MidiFileEvent_delete(event);
+		}
+		else
+		{
+			MidiFileEvent_setTick(event, tick - to_tick + from_tick);
 		}
 	}
 
@@ -102,11 +70,55 @@ int main(int argc, char **argv)
 
 	if (MidiFile_save(midi_file, output_filename) < 0)
 	{
-		fprintf(stderr, "Error:  Cannot write MIDI file \"%s\".\n", output_filename);
-		exit(1);
+		snprintf(error_message, error_message_size, "Cannot write MIDI file \"%s\".", output_filename);
+		MidiFile_free(midi_file);
+		return -1;
 	}
 
 	MidiFile_free(midi_file);
 	return 0;
 }
 
+int main(int argc, char **argv)
+{
+	int number_of_jobs = 0;
+	char *output_filename = NULL;
+	char *input_filename = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--help") == 0)
+		{
+			usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--from") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			from_string = argv[i];
+		}
+		else if (strcmp(argv[i], "--to") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			to_string = argv[i];
+		}
+		else if (strcmp(argv[i], "--jobs") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_jobs = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--out") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			output_filename = argv[i];
+		}
+		else
+		{
+			input_filename = argv[i];
+		}
+	}
+
+	if (input_filename == NULL) usage(argv[0]);
+	return (MidiUtil_processFiles(input_filename, output_filename, number_of_jobs, process_file, NULL) == 0) ? 0 : 1;
+}
+
@@ -10,13 +10,16 @@
 static char *prefix = "brainstorm-";
 static int timeout = 5;
 static char *confirmation_command_pattern = NULL;
-static MidiFile_t midi_file = NULL;
-static MidiFileTrack_t track = NULL;
+static MidiFile_t midi_file = NULL; /* just the conductor track, for converting times to ticks */
+static MidiFileWriter_t midi_file_writer = NULL;
+static char filename[1024];
 static struct timeval first_event_timestamp;
 
 static void create_midi_file_for_first_event(void)
 {
-	if (midi_file != NULL) return;
+	MidiFileTrack_t track;
+
+	if (midi_file_writer != NULL) return;
 
 	midi_file = MidiFile_new(1, MIDI_FILE_DIVISION_TYPE_PPQ, 960);
 	track = MidiFile_createTrack(midi_file); /* conductor track */
@@ -36,7 +39,28 @@ static void create_midi_file_for_first_event(void)
 		MidiFileTrack_createMetaEvent(track, 0, 0x51, 3, tempo);
 	}
 
-	track = MidiFile_createTrack(midi_file); /* main track */
+	{
+		time_t current_time;
+		struct tm *current_time_struct;
+		char current_time_string[1024];
+
+		current_time = time(NULL);
+		current_time_struct = localtime(&current_time);
+		strftime(current_time_string, 1024, "%Y%m%d%H%M%S", current_time_struct);
+
+		sprintf(filename, "%s%s.mid", prefix, current_time_string);
+	}
+
+	/* the recording goes to disk as it happens, rather than all at once at the end */
+
+	if ((midi_file_writer = MidiFileWriter_open(filename, 1, MIDI_FILE_DIVISION_TYPE_PPQ, 960)) == NULL)
+	{
+		fprintf(stderr, "Cannot write to %s.\n", filename);
+		exit(1);
+	}
+
+	MidiFileWriter_writeTrack(midi_file_writer, track);
+	MidiFileWriter_startTrack(midi_file_writer); /* main track */
 
 	gettimeofday(&first_event_timestamp, NULL);
 }
@@ -50,21 +74,8 @@ static long get_tick(void)
 
 static void alarm_handler(int signum)
 {
-	char filename[1024];
-
-	{
-		time_t current_time;
-		struct tm *current_time_struct;
-		char current_time_string[1024];
-
-		current_time = time(NULL);
-		current_time_struct = localtime(&current_time);
-		strftime(current_time_string, 1024, "%Y%m%d%H%M%S", current_time_struct);
-
-		sprintf(filename, "%s%s.mid", prefix, current_time_string);
-	}
-
-	MidiFile_save(midi_file, filename);
+	MidiFileWriter_close(midi_file_writer);
+	midi_file_writer = NULL;
 	MidiFile_free(midi_file);
 	midi_file = NULL;
 
@@ -194,49 +205,49 @@ int main(int argc, char **argv)
 					{
 						alarm(timeout);
 						create_midi_file_for_first_event();
-						MidiFileTrack_createNoteOffEvent(track, get_tick(), event->data.note.channel, event->data.note.note, event->data.note.velocity);
+						MidiFileWriter_writeNoteOffEvent(midi_file_writer, get_tick(), event->data.note.channel, event->data.note.note, event->data.note.velocity);
 						break;
 					}
 					case SND_SEQ_EVENT_NOTEON:
 					{
 						alarm(timeout);
 						create_midi_file_for_first_event();
-						MidiFileTrack_createNoteOnEvent(track, get_tick(), event->data.note.channel, event->data.note.note, event->data.note.velocity);
+						MidiFileWriter_writeNoteOnEvent(midi_file_writer, get_tick(), event->data.note.channel, event->data.note.note, event->data.note.velocity);
 						break;
 					}
 					case SND_SEQ_EVENT_KEYPRESS:
 					{
 						alarm(timeout);
 						create_midi_file_for_first_event();
-						MidiFileTrack_createKeyPressureEvent(track, get_tick(), event->data.note.channel, event->data.note.note, event->data.note.velocity);
+						MidiFileWriter_writeKeyPressureEvent(midi_file_writer, get_tick(), event->data.note.channel, event->data.note.note, event->data.note.velocity);
 						break;
 					}
 					case SND_SEQ_EVENT_CONTROLLER:
 					{
 						alarm(timeout);
 						create_midi_file_for_first_event();
-						MidiFileTrack_createControlChangeEvent(track, get_tick(), event->data.control.channel, event->data.control.param, event->data.control.value);
+						MidiFileWriter_writeControlChangeEvent(midi_file_writer, get_tick(), event->data.control.channel, event->data.control.param, event->data.control.value);
 						break;
 					}
 					case SND_SEQ_EVENT_PGMCHANGE:
 					{
 						alarm(timeout);
 						create_midi_file_for_first_event();
-						MidiFileTrack_createProgramChangeEvent(track, get_tick(), event->data.control.channel, event->data.control.value);
+						MidiFileWriter_writeProgramChangeEvent(midi_file_writer, get_tick(), event->data.control.channel, event->data.control.value);
 						break;
 					}
 					case SND_SEQ_EVENT_CHANPRESS:
 					{
 						alarm(timeout);
 						create_midi_file_for_first_event();
-						MidiFileTrack_createChannelPressureEvent(track, get_tick(), event->data.control.channel, event->data.control.value);
+						MidiFileWriter_writeChannelPressureEvent(midi_file_writer, get_tick(), event->data.control.channel, event->data.control.value);
 						break;
 					}
 					case SND_SEQ_EVENT_PITCHBEND:
 					{
 						alarm(timeout);
 						create_midi_file_for_first_event();
-						MidiFileTrack_createPitchWheelEvent(track, get_tick(), event->data.control.channel, event->data.control.value);
+						MidiFileWriter_writePitchWheelEvent(midi_file_writer, get_tick(), event->data.control.channel, event->data.control.value);
 						break;
 					}
 					default:
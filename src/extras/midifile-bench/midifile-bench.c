@@ -0,0 +1,886 @@
+
+/*
+ * Timings for the midifile library, to check that changes to its internals
+ * actually pay off.  Each test prints one line per run so that the results
+ * for different builds can be compared side by side.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <midifile.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+static unsigned long random_state = 1;
+static long number_of_mallocs = 0;
+static long number_of_frees = 0;
+
+/* The makefile builds midifile.c with malloc() and free() renamed to these, so that its allocations can be counted. */
+
+void *bench_malloc(size_t size)
+{
+	number_of_mallocs++;
+	return malloc(size);
+}
+
+void bench_free(void *pointer)
+{
+	if (pointer != NULL) number_of_frees++;
+	free(pointer);
+}
+
+static void usage(char *program_name)
+{
+	fprintf(stderr, "Usage:  %s --insert [ --tracks <n> ] [ --events <n> ]\n", program_name);
+	fprintf(stderr, "        %s --load [ --repeat <n> ] [ --mapped ] <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --read [ --repeat <n> ] [ --merged ] <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --parallel [ --repeat <n> ] [ --threads <n> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --alloc <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --iterate [ --repeat <n> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --convert <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --measure <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --pair <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --types [ --repeat <n> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --range [ --repeat <n> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --snapshot [ --repeat <n> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "        %s --diff [ --repeat <n> ] <filename.mid>\n", program_name);
+	exit(1);
+}
+
+static long get_random_number(long limit)
+{
+	random_state = (random_state * 1103515245UL) + 12345UL;
+	return (long)((random_state >> 8) % (unsigned long)(limit));
+}
+
+static double get_elapsed_seconds(clock_t start_time)
+{
+	return (double)(clock() - start_time) / CLOCKS_PER_SEC;
+}
+
+static double get_wall_clock_seconds(void)
+{
+	/* clock() adds up the time spent in every thread, so timing parallel work needs the wall clock instead. */
+
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)(counter.QuadPart) / (double)(frequency.QuadPart);
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec / 1e9);
+#endif
+}
+
+static long get_memory_usage(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS process_memory_counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &process_memory_counters, sizeof (process_memory_counters));
+	return (long)(process_memory_counters.WorkingSetSize);
+#else
+	long number_of_pages = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+
+	if (statm != NULL)
+	{
+		if (fscanf(statm, "%*ld %ld", &number_of_pages) != 1) number_of_pages = 0;
+		fclose(statm);
+	}
+
+	return number_of_pages * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static long get_private_memory_usage(void)
+{
+	/* Unlike get_memory_usage(), leaves out the pages of a mapped file, which the system can drop again at any time. */
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS_EX process_memory_counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS *)(&process_memory_counters), sizeof (process_memory_counters));
+	return (long)(process_memory_counters.PrivateUsage);
+#else
+	long number_of_pages = 0, number_of_shared_pages = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+
+	if (statm != NULL)
+	{
+		if (fscanf(statm, "%*ld %ld %ld", &number_of_pages, &number_of_shared_pages) != 2) number_of_pages = number_of_shared_pages = 0;
+		fclose(statm);
+	}
+
+	return (number_of_pages - number_of_shared_pages) * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static MidiFile_t create_test_file(int number_of_tracks, long number_of_events_per_track)
+{
+	/* Interleaves the tracks the way a loader or a recorder would, with every new event landing near the end of the file. */
+
+	MidiFile_t midi_file = MidiFile_new(1, MIDI_FILE_DIVISION_TYPE_PPQ, 960);
+	int track_number;
+	long event_number;
+
+	for (track_number = 0; track_number < number_of_tracks; track_number++) MidiFile_createTrack(midi_file);
+
+	for (track_number = 0; track_number < number_of_tracks; track_number++)
+	{
+		MidiFileTrack_t track = MidiFile_getTrackByNumber(midi_file, track_number, 0);
+		long tick = 0;
+
+		for (event_number = 0; event_number < number_of_events_per_track; event_number++)
+		{
+			tick += get_random_number(120);
+			MidiFileTrack_createNoteOnEvent(track, tick, track_number % 16, 60 + get_random_number(12), 100);
+		}
+	}
+
+	return midi_file;
+}
+
+static void test_insert(int number_of_tracks, long number_of_events_per_track)
+{
+	clock_t start_time = clock();
+	MidiFile_t midi_file = create_test_file(number_of_tracks, number_of_events_per_track);
+	double insert_seconds = get_elapsed_seconds(start_time);
+	long tick = MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
+	long number_of_moves = number_of_tracks * number_of_events_per_track / 10;
+	long move_number;
+
+	start_time = clock();
+
+	for (move_number = 0; move_number < number_of_moves; move_number++)
+	{
+		MidiFileTrack_t track = MidiFile_getTrackByNumber(midi_file, get_random_number(number_of_tracks), 0);
+		MidiFileEvent_setTick(MidiFileTrack_getLastEvent(track), get_random_number(tick + 1));
+	}
+
+	printf("insert tracks=%d events=%ld insert=%.3fs settick=%.3fs\n", number_of_tracks, number_of_tracks * number_of_events_per_track, insert_seconds, get_elapsed_seconds(start_time));
+	MidiFile_free(midi_file);
+}
+
+static long get_file_size(char *filename)
+{
+	FILE *in = fopen(filename, "rb");
+	long size;
+
+	if (in == NULL) return 0;
+	fseek(in, 0, SEEK_END);
+	size = ftell(in);
+	fclose(in);
+	return size;
+}
+
+static void test_load(char *filename, int number_of_repeats, int use_mapping)
+{
+	long base_memory_usage = get_private_memory_usage();
+	long peak_memory_usage = 0;
+	clock_t start_time = clock();
+	long number_of_events = 0;
+	int repeat_number;
+	double seconds;
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		MidiFile_t midi_file = use_mapping ? MidiFile_loadMapped(filename) : MidiFile_load(filename);
+		MidiFileEvent_t event;
+		long memory_usage;
+
+		if (midi_file == NULL)
+		{
+			fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+			exit(1);
+		}
+
+		for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event)) number_of_events++;
+		memory_usage = get_private_memory_usage() - base_memory_usage;
+		if (memory_usage > peak_memory_usage) peak_memory_usage = memory_usage;
+		MidiFile_free(midi_file);
+	}
+
+	seconds = get_elapsed_seconds(start_time) / number_of_repeats;
+	printf("load file=%s mapped=%d events=%ld time=%.3fs rate=%.1fMB/s private=%ldk\n", filename, use_mapping, number_of_events / number_of_repeats, seconds, get_file_size(filename) / seconds / 1e6, peak_memory_usage / 1024);
+}
+
+static void test_read(char *filename, int number_of_repeats, int use_merging)
+{
+	long base_memory_usage = get_private_memory_usage();
+	long peak_memory_usage = 0;
+	clock_t start_time = clock();
+	long number_of_events = 0;
+	long checksum = 0;
+	int repeat_number;
+	double seconds;
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		MidiFileReader_t reader = MidiFileReader_open(filename, use_merging ? MIDI_FILE_READER_MODE_MERGED : MIDI_FILE_READER_MODE_TRACK_BY_TRACK);
+		struct MidiFileReaderEvent event;
+		long memory_usage;
+
+		if (reader == NULL)
+		{
+			fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+			exit(1);
+		}
+
+		while (MidiFileReader_next(reader, &event) == 0)
+		{
+			checksum += event.tick + event.value;
+			number_of_events++;
+		}
+
+		memory_usage = get_private_memory_usage() - base_memory_usage;
+		if (memory_usage > peak_memory_usage) peak_memory_usage = memory_usage;
+		MidiFileReader_close(reader);
+	}
+
+	seconds = get_elapsed_seconds(start_time) / number_of_repeats;
+	printf("read file=%s merged=%d events=%ld time=%.3fs rate=%.1fMB/s private=%ldk checksum=%ld\n", filename, use_merging, number_of_events / number_of_repeats, seconds, get_file_size(filename) / seconds / 1e6, peak_memory_usage / 1024, checksum);
+}
+
+static long get_event_order_checksum(MidiFile_t midi_file, long *number_of_events)
+{
+	MidiFileEvent_t event;
+	long checksum = 0;
+
+	for (event = MidiFile_getFirstEvent(midi_file), *number_of_events = 0; event != NULL; event = MidiFileEvent_getNextEventInFile(event), (*number_of_events)++)
+	{
+		checksum = (checksum * 31) + MidiFileEvent_getTick(event) + (MidiFileTrack_getNumber(MidiFileEvent_getTrack(event)) * 7) + MidiFileEvent_getType(event);
+	}
+
+	return checksum;
+}
+
+static void test_parallel(char *filename, int number_of_repeats, int number_of_threads)
+{
+	/* Times an ordinary load of the same file alongside, and checks that both give the same events in the same order. */
+
+	double serial_seconds = 0, parallel_seconds = 0, start_time;
+	long number_of_events = 0, number_of_serial_events;
+	int is_same = 1;
+	int repeat_number;
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		MidiFile_t midi_file;
+		long serial_checksum, number_of_serial_events;
+
+		/* one file at a time, so that neither load pays for the memory the other still holds */
+
+		start_time = get_wall_clock_seconds();
+		midi_file = MidiFile_load(filename);
+		serial_seconds += get_wall_clock_seconds() - start_time;
+
+		if (midi_file == NULL)
+		{
+			fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+			exit(1);
+		}
+
+		serial_checksum = get_event_order_checksum(midi_file, &number_of_serial_events);
+		MidiFile_free(midi_file);
+
+		start_time = get_wall_clock_seconds();
+		midi_file = MidiFile_loadParallel(filename, number_of_threads);
+		parallel_seconds += get_wall_clock_seconds() - start_time;
+
+		if ((get_event_order_checksum(midi_file, &number_of_events) != serial_checksum) || (number_of_events != number_of_serial_events)) is_same = 0;
+		MidiFile_free(midi_file);
+	}
+
+	serial_seconds /= number_of_repeats;
+	parallel_seconds /= number_of_repeats;
+	printf("parallel file=%s threads=%d events=%ld serial=%.3fs parallel=%.3fs speedup=%.2f same=%d\n", filename, number_of_threads, number_of_events, serial_seconds, parallel_seconds, serial_seconds / parallel_seconds, is_same);
+}
+
+static void print_allocations(char *phase, clock_t start_time)
+{
+	printf("alloc phase=%s mallocs=%ld frees=%ld rss=%ldk time=%.3fs\n", phase, number_of_mallocs, number_of_frees, get_memory_usage() / 1024, get_elapsed_seconds(start_time));
+	number_of_mallocs = 0;
+	number_of_frees = 0;
+}
+
+static void test_alloc(char *filename)
+{
+	clock_t start_time = clock();
+	MidiFile_t midi_file;
+	MidiFileEvent_t *events;
+	long number_of_events = 0;
+	long event_number;
+	MidiFileEvent_t event;
+
+	print_allocations("start", start_time);
+	start_time = clock();
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	print_allocations("load", start_time);
+
+	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event)) number_of_events++;
+	if (number_of_events == 0) return;
+	events = (MidiFileEvent_t *)(malloc(sizeof(MidiFileEvent_t) * number_of_events));
+	for (event = MidiFile_getFirstEvent(midi_file), event_number = 0; event != NULL; event = MidiFileEvent_getNextEventInFile(event), event_number++) events[event_number] = event;
+	start_time = clock();
+
+	/* move, delete and create a tenth of the events each, and give some meta events new data */
+
+	for (event_number = 0; event_number < number_of_events; event_number += 10)
+	{
+		MidiFileEvent_setTick(events[event_number], MidiFileEvent_getTick(events[event_number]) + get_random_number(960));
+
+		if ((event_number + 1 < number_of_events) && (MidiFileEvent_getType(events[event_number + 1]) == MIDI_FILE_EVENT_TYPE_META))
+		{
+			MidiFileMetaEvent_setData(events[event_number + 1], 12, (unsigned char *)("edited text!"));
+		}
+
+		if (event_number + 2 < number_of_events)
+		{
+			MidiFileTrack_t track = MidiFileEvent_getTrack(events[event_number + 2]);
+			long tick = MidiFileEvent_getTick(events[event_number + 2]);
+			MidiFileEvent_delete(events[event_number + 2]);
+			MidiFileTrack_createNoteOnEvent(track, tick, 0, 60, 100);
+			MidiFileTrack_createNoteOffEvent(track, tick + 480, 0, 60, 0);
+		}
+	}
+
+	print_allocations("edit", start_time);
+	free(events);
+	start_time = clock();
+	MidiFile_free(midi_file);
+	print_allocations("free", start_time);
+}
+
+static void add_tick_to_checksum(MidiFileEvent_t event, void *user_data)
+{
+	*((long *)(user_data)) += MidiFileEvent_getTick(event);
+}
+
+static void test_iterate(char *filename, int number_of_repeats)
+{
+	long base_memory_usage = get_memory_usage();
+	MidiFile_t midi_file;
+	long memory_usage;
+	long number_of_events = 0;
+	long checksum = 0;
+	clock_t start_time;
+	double file_seconds, track_seconds, visit_seconds;
+	int repeat_number;
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	memory_usage = get_memory_usage() - base_memory_usage;
+	start_time = clock();
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		MidiFileEvent_t event;
+
+		for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+		{
+			checksum += MidiFileEvent_getTick(event) + MidiFileEvent_getType(event);
+			number_of_events++;
+		}
+	}
+
+	file_seconds = get_elapsed_seconds(start_time);
+	start_time = clock();
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		MidiFileTrack_t track;
+		MidiFileEvent_t event;
+
+		for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+		{
+			for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+			{
+				if (MidiFileEvent_isNoteStartEvent(event)) checksum += MidiFileNoteStartEvent_getVelocity(event);
+			}
+		}
+	}
+
+	track_seconds = get_elapsed_seconds(start_time);
+	start_time = clock();
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++) MidiFile_visitEvents(midi_file, add_tick_to_checksum, &checksum);
+	visit_seconds = get_elapsed_seconds(start_time);
+	number_of_events /= number_of_repeats;
+	if (number_of_events == 0) number_of_events = 1;
+	printf("iterate file=%s events=%ld bytes/event=%ld file=%.1fns/event track=%.1fns/event visit=%.1fns/event checksum=%ld\n", filename, number_of_events, memory_usage / number_of_events, file_seconds * 1e9 / number_of_events / number_of_repeats, track_seconds * 1e9 / number_of_events / number_of_repeats, visit_seconds * 1e9 / number_of_events / number_of_repeats, checksum);
+	MidiFile_free(midi_file);
+}
+
+static void test_convert(char *filename)
+{
+	MidiFile_t midi_file;
+	MidiFileEvent_t event;
+	long number_of_events = 0;
+	long number_of_mismatches = 0;
+	clock_t start_time;
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	/* the same round trips that playsmf and quantize make for every event */
+
+	start_time = clock();
+
+	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+	{
+		long tick = MidiFileEvent_getTick(event);
+		if (MidiFile_getTickFromTime(midi_file, MidiFile_getTimeFromTick(midi_file, tick)) < tick - 1) number_of_mismatches++;
+		if (MidiFile_getTickFromBeat(midi_file, MidiFile_getBeatFromTick(midi_file, tick)) < tick - 1) number_of_mismatches++;
+		number_of_events++;
+	}
+
+	printf("convert file=%s events=%ld time=%.3fs mismatches=%ld\n", filename, number_of_events, get_elapsed_seconds(start_time), number_of_mismatches);
+	MidiFile_free(midi_file);
+}
+
+static void test_measure(char *filename)
+{
+	MidiFile_t midi_file;
+	MidiFileEvent_t event;
+	long number_of_events = 0;
+	long number_of_mismatches = 0;
+	char measure_beat_tick_string[32];
+	clock_t start_time;
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	/* the round trips that an editor makes for every visible event when drawing bar lines and showing positions */
+
+	start_time = clock();
+
+	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+	{
+		long tick = MidiFileEvent_getTick(event);
+		if (MidiFile_getTickFromMeasure(midi_file, MidiFile_getMeasureFromTick(midi_file, tick)) < tick - 1) number_of_mismatches++;
+		strcpy(measure_beat_tick_string, MidiFile_getMeasureBeatTickStringFromTick(midi_file, tick));
+		if (MidiFile_getTickFromMeasureBeatTickString(midi_file, measure_beat_tick_string) < 0) number_of_mismatches++;
+		number_of_events++;
+	}
+
+	printf("measure file=%s events=%ld time=%.3fs mismatches=%ld\n", filename, number_of_events, get_elapsed_seconds(start_time), number_of_mismatches);
+	MidiFile_free(midi_file);
+}
+
+static void test_pair(char *filename)
+{
+	MidiFile_t midi_file;
+	MidiFileEvent_t event;
+	long number_of_notes = 0;
+	long number_of_unpaired_events = 0;
+	clock_t start_time;
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	/* look up the partner of every note start and end, as quantize and noteflurry do */
+
+	start_time = clock();
+
+	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+	{
+		if (MidiFileEvent_isNoteStartEvent(event))
+		{
+			if (MidiFileNoteStartEvent_getNoteEndEvent(event) == NULL) number_of_unpaired_events++;
+			number_of_notes++;
+		}
+		else if (MidiFileEvent_isNoteEndEvent(event))
+		{
+			if (MidiFileNoteEndEvent_getNoteStartEvent(event) == NULL) number_of_unpaired_events++;
+		}
+	}
+
+	printf("pair file=%s notes=%ld time=%.3fs unpaired=%ld\n", filename, number_of_notes, get_elapsed_seconds(start_time), number_of_unpaired_events);
+	MidiFile_free(midi_file);
+}
+
+static void test_types(char *filename, int number_of_repeats)
+{
+	MidiFile_t midi_file;
+	MidiFileEvent_t event;
+	long number_of_events = 0;
+	long number_of_tempo_events = 0;
+	long checksum = 0;
+	clock_t start_time;
+	double scan_seconds, build_seconds, list_seconds;
+	int repeat_number;
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	/* find the tempo events the way the tools used to, then through the per-type list, whose first use builds it */
+
+	start_time = clock();
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+		{
+			if (MidiFileEvent_isTempoEvent(event)) checksum += MidiFileEvent_getTick(event);
+			number_of_events++;
+		}
+	}
+
+	scan_seconds = get_elapsed_seconds(start_time);
+	start_time = clock();
+	event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x51);
+	build_seconds = get_elapsed_seconds(start_time);
+	start_time = clock();
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		for (event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x51); event != NULL; event = MidiFileEvent_getNextEventOfType(event, -1, 0x51))
+		{
+			checksum -= MidiFileEvent_getTick(event);
+			number_of_tempo_events++;
+		}
+	}
+
+	list_seconds = get_elapsed_seconds(start_time);
+	printf("types file=%s events=%ld tempo-events=%ld scan=%.1fus build=%.1fus list=%.1fus mismatch=%ld\n", filename, number_of_events / number_of_repeats, number_of_tempo_events / number_of_repeats, scan_seconds * 1e6 / number_of_repeats, build_seconds * 1e6, list_seconds * 1e6 / number_of_repeats, checksum);
+	MidiFile_free(midi_file);
+}
+
+static void test_range(char *filename, int number_of_repeats)
+{
+	MidiFile_t midi_file;
+	MidiFileEvent_t event;
+	long last_tick, window_ticks;
+	long number_of_events = 0;
+	long checksum = 0;
+	clock_t start_time;
+	double scan_seconds, range_seconds;
+	int repeat_number;
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	/* windows of a hundredth of the file at random places, as an editor's viewport or a seek would ask for */
+
+	last_tick = (MidiFile_getLastEvent(midi_file) == NULL) ? 0 : MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
+	window_ticks = (last_tick / 100) + 1;
+	random_state = 1;
+	start_time = clock();
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		long start_tick = get_random_number(last_tick + 1);
+
+		for (event = MidiFile_getFirstEvent(midi_file); (event != NULL) && (MidiFileEvent_getTick(event) < start_tick + window_ticks); event = MidiFileEvent_getNextEventInFile(event))
+		{
+			if (MidiFileEvent_getTick(event) >= start_tick) checksum += MidiFileEvent_getTick(event);
+		}
+	}
+
+	scan_seconds = get_elapsed_seconds(start_time);
+	random_state = 1;
+	start_time = clock();
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		long start_tick = get_random_number(last_tick + 1);
+		struct MidiFileIterator iterator;
+
+		MidiFile_getEventsInRange(midi_file, start_tick, start_tick + window_ticks, &iterator);
+
+		for (event = MidiFileIterator_next(&iterator); event != NULL; event = MidiFileIterator_next(&iterator))
+		{
+			checksum -= MidiFileEvent_getTick(event);
+			number_of_events++;
+		}
+	}
+
+	range_seconds = get_elapsed_seconds(start_time);
+	printf("range file=%s events/window=%ld scan=%.1fus/window range=%.1fus/window mismatch=%ld\n", filename, number_of_events / number_of_repeats, scan_seconds * 1e6 / number_of_repeats, range_seconds * 1e6 / number_of_repeats, checksum);
+	MidiFile_free(midi_file);
+}
+
+static long get_track_checksum(MidiFile_t midi_file, long *number_of_events)
+{
+	/* Unlike get_event_order_checksum(), does not depend on the order of events at the same tick in different tracks. */
+
+	MidiFileTrack_t track;
+	MidiFileEvent_t event;
+	long checksum = 0;
+
+	for (track = MidiFile_getFirstTrack(midi_file), *number_of_events = 0; track != NULL; track = MidiFileTrack_getNextTrack(track))
+	{
+		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event), (*number_of_events)++)
+		{
+			checksum = (checksum * 31) + MidiFileEvent_getTick(event) + (MidiFileTrack_getNumber(track) * 7) + MidiFileEvent_getType(event);
+		}
+	}
+
+	return checksum;
+}
+
+static void test_snapshot(char *filename, int number_of_repeats)
+{
+	MidiFile_t midi_file;
+	MidiFileSnapshot_t *snapshots;
+	unsigned char *buffer;
+	long last_tick, number_of_events, checksum;
+	clock_t start_time;
+	double full_seconds, snapshot_seconds = 0.0, restore_seconds, save_seconds;
+	int repeat_number;
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	/* a snapshot after each of a run of small edits, as an editor's undo does, then undo them all; saving the whole file is how undo used to work */
+
+	last_tick = (MidiFile_getLastEvent(midi_file) == NULL) ? 0 : MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
+	checksum = get_track_checksum(midi_file, &number_of_events);
+	snapshots = (MidiFileSnapshot_t *)(malloc(sizeof(MidiFileSnapshot_t) * (number_of_repeats + 1)));
+	random_state = 1;
+	start_time = clock();
+	snapshots[0] = MidiFile_snapshot(midi_file);
+	full_seconds = get_elapsed_seconds(start_time);
+
+	for (repeat_number = 1; repeat_number <= number_of_repeats; repeat_number++)
+	{
+		MidiFileTrack_createControlChangeEvent(MidiFile_getTrackByNumber(midi_file, (int)(get_random_number(MidiFile_getNumberOfTracks(midi_file))), 0), get_random_number(last_tick + 1), 0, 1, (int)(get_random_number(128)));
+		start_time = clock();
+		snapshots[repeat_number] = MidiFile_snapshot(midi_file);
+		snapshot_seconds += get_elapsed_seconds(start_time);
+	}
+
+	buffer = (unsigned char *)(malloc(MidiFile_getFileSize(midi_file)));
+	start_time = clock();
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		MidiFile_saveToBuffer(midi_file, buffer);
+	}
+
+	save_seconds = get_elapsed_seconds(start_time);
+	start_time = clock();
+
+	for (repeat_number = number_of_repeats - 1; repeat_number >= 0; repeat_number--)
+	{
+		MidiFile_restore(midi_file, snapshots[repeat_number]);
+	}
+
+	restore_seconds = get_elapsed_seconds(start_time);
+	checksum -= get_track_checksum(midi_file, &number_of_events);
+	printf("snapshot file=%s events=%ld full=%.1fms snapshot=%.1fus/edit restore=%.1fus/edit save=%.1fus/edit mismatch=%ld\n", filename, number_of_events, full_seconds * 1e3, snapshot_seconds * 1e6 / number_of_repeats, restore_seconds * 1e6 / number_of_repeats, save_seconds * 1e6 / number_of_repeats, checksum);
+	for (repeat_number = 0; repeat_number <= number_of_repeats; repeat_number++) MidiFileSnapshot_free(snapshots[repeat_number]);
+	free(snapshots);
+	free(buffer);
+	MidiFile_free(midi_file);
+}
+
+static void test_diff(char *filename, int number_of_repeats)
+{
+	MidiFile_t midi_file, new_midi_file;
+	MidiFileSnapshot_t snapshot;
+	MidiFilePatch_t patch;
+	long last_tick, number_of_events, checksum;
+	clock_t start_time;
+	double diff_seconds, apply_seconds, revert_seconds;
+	int repeat_number;
+
+	if ((midi_file = MidiFile_load(filename)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	/* a copy with a handful of edits scattered through it, as between two saves of an arrangement */
+
+	snapshot = MidiFile_snapshot(midi_file);
+	new_midi_file = MidiFile_newFromSnapshot(snapshot);
+	last_tick = (MidiFile_getLastEvent(midi_file) == NULL) ? 0 : MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
+	checksum = get_track_checksum(midi_file, &number_of_events);
+	random_state = 1;
+
+	for (repeat_number = 0; repeat_number < number_of_repeats; repeat_number++)
+	{
+		MidiFileTrack_createControlChangeEvent(MidiFile_getTrackByNumber(new_midi_file, (int)(get_random_number(MidiFile_getNumberOfTracks(new_midi_file))), 0), get_random_number(last_tick + 1), 0, 1, (int)(get_random_number(128)));
+	}
+
+	start_time = clock();
+	patch = MidiFile_diff(midi_file, new_midi_file);
+	diff_seconds = get_elapsed_seconds(start_time);
+	start_time = clock();
+	MidiFile_applyPatch(midi_file, patch);
+	apply_seconds = get_elapsed_seconds(start_time);
+	checksum -= get_track_checksum(new_midi_file, &number_of_events) - get_track_checksum(midi_file, &number_of_events);
+	start_time = clock();
+	MidiFile_revertPatch(midi_file, patch);
+	revert_seconds = get_elapsed_seconds(start_time);
+	checksum -= get_track_checksum(midi_file, &number_of_events);
+	printf("diff file=%s events=%ld edits=%d patch=%dbytes file=%dbytes diff=%.1fms apply=%.1fms revert=%.1fms mismatch=%ld\n", filename, number_of_events, number_of_repeats, MidiFilePatch_getSize(patch), MidiFile_getFileSize(midi_file), diff_seconds * 1e3, apply_seconds * 1e3, revert_seconds * 1e3, checksum);
+	MidiFilePatch_free(patch);
+	MidiFile_free(new_midi_file);
+	MidiFileSnapshot_free(snapshot);
+	MidiFile_free(midi_file);
+}
+
+int main(int argc, char **argv)
+{
+	char *test_name = NULL;
+	int number_of_tracks = 64;
+	long number_of_events_per_track = 2000;
+	int number_of_repeats = 1;
+	int use_mapping = 0;
+	int use_merging = 0;
+	int number_of_threads = 0;
+	char *filename = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--help") == 0)
+		{
+			usage(argv[0]);
+		}
+		else if ((strcmp(argv[i], "--insert") == 0) || (strcmp(argv[i], "--load") == 0) || (strcmp(argv[i], "--read") == 0) || (strcmp(argv[i], "--parallel") == 0) || (strcmp(argv[i], "--alloc") == 0) || (strcmp(argv[i], "--iterate") == 0) || (strcmp(argv[i], "--convert") == 0) || (strcmp(argv[i], "--measure") == 0) || (strcmp(argv[i], "--pair") == 0) || (strcmp(argv[i], "--types") == 0) || (strcmp(argv[i], "--range") == 0) || (strcmp(argv[i], "--snapshot") == 0) || (strcmp(argv[i], "--diff") == 0))
+		{
+			test_name = argv[i] + 2;
+		}
+		else if (strcmp(argv[i], "--tracks") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_tracks = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--events") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_events_per_track = atol(argv[i]);
+		}
+		else if (strcmp(argv[i], "--repeat") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_repeats = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_threads = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--mapped") == 0)
+		{
+			use_mapping = 1;
+		}
+		else if (strcmp(argv[i], "--merged") == 0)
+		{
+			use_merging = 1;
+		}
+		else
+		{
+			filename = argv[i];
+		}
+	}
+
+	if (test_name == NULL) usage(argv[0]);
+
+	if (strcmp(test_name, "insert") == 0)
+	{
+		if ((number_of_tracks < 1) || (number_of_events_per_track < 1)) usage(argv[0]);
+		test_insert(number_of_tracks, number_of_events_per_track);
+	}
+	else if (strcmp(test_name, "load") == 0)
+	{
+		if ((filename == NULL) || (number_of_repeats < 1)) usage(argv[0]);
+		test_load(filename, number_of_repeats, use_mapping);
+	}
+	else if (strcmp(test_name, "read") == 0)
+	{
+		if ((filename == NULL) || (number_of_repeats < 1)) usage(argv[0]);
+		test_read(filename, number_of_repeats, use_merging);
+	}
+	else if (strcmp(test_name, "parallel") == 0)
+	{
+		if ((filename == NULL) || (number_of_repeats < 1) || (number_of_threads < 0)) usage(argv[0]);
+		test_parallel(filename, number_of_repeats, number_of_threads);
+	}
+	else if (strcmp(test_name, "alloc") == 0)
+	{
+		if (filename == NULL) usage(argv[0]);
+		test_alloc(filename);
+	}
+	else if (strcmp(test_name, "iterate") == 0)
+	{
+		if ((filename == NULL) || (number_of_repeats < 1)) usage(argv[0]);
+		test_iterate(filename, number_of_repeats);
+	}
+	else if (strcmp(test_name, "convert") == 0)
+	{
+		if (filename == NULL) usage(argv[0]);
+		test_convert(filename);
+	}
+	else if (strcmp(test_name, "measure") == 0)
+	{
+		if (filename == NULL) usage(argv[0]);
+		test_measure(filename);
+	}
+	else if (strcmp(test_name, "pair") == 0)
+	{
+		if (filename == NULL) usage(argv[0]);
+		test_pair(filename);
+	}
+	else if (strcmp(test_name, "types") == 0)
+	{
+		if ((filename == NULL) || (number_of_repeats < 1)) usage(argv[0]);
+		test_types(filename, number_of_repeats);
+	}
+	else if (strcmp(test_name, "range") == 0)
+	{
+		if ((filename == NULL) || (number_of_repeats < 1)) usage(argv[0]);
+		test_range(filename, number_of_repeats);
+	}
+	else if (strcmp(test_name, "snapshot") == 0)
+	{
+		if ((filename == NULL) || (number_of_repeats < 1)) usage(argv[0]);
+		test_snapshot(filename, number_of_repeats);
+	}
+	else if (strcmp(test_name, "diff") == 0)
+	{
+		if ((filename == NULL) || (number_of_repeats < 1)) usage(argv[0]);
+		test_diff(filename, number_of_repeats);
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,774 @@
+/*
+ * Checks the library's bulk event type converters against the original
+ * one-event-at-a-time versions, which are kept here as the reference.  Each
+ * file is loaded twice and put through the same sequence of conversions with
+ * each implementation; after every step the tracks must hold the same events
+ * in the same order, and the files must save to the same bytes.  The order of
+ * events at the same tick in different tracks is allowed to differ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <midifile.h>
+
+static void usage(char *program_name)
+{
+	fprintf(stderr, "Usage:  %s <filename.mid> ...\n", program_name);
+	exit(1);
+}
+
+static int reference_convert_standard_events_to_note_events(MidiFile_t midi_file)
+{
+	MidiFileTrack_t track;
+	MidiFileEvent_t event;
+
+	if (midi_file == NULL) return -1;
+
+	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	{
+		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		{
+			MidiFileEvent_t end_event = MidiFileNoteStartEvent_getNoteEndEvent(event);
+
+			if (end_event != NULL)
+			{
+				MidiFileEvent_t new_event = MidiFileTrack_createNoteEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileEvent_getTick(end_event) - MidiFileEvent_getTick(event),
+					MidiFileNoteStartEvent_getChannel(event),
+					MidiFileNoteStartEvent_getNote(event),
+					MidiFileNoteStartEvent_getVelocity(event),
+					MidiFileNoteEndEvent_getVelocity(end_event));
+
+				MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setPreviousEvent(new_event, event);
+				MidiFileEvent_delete(event);
+				MidiFileEvent_delete(end_event);
+				event = new_event;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static MidiFileEvent_t get_newest_note_end_event(MidiFileEvent_t note_start_event, long end_tick)
+{
+	/*
+	 * The original looked the end event up with
+	 * MidiFileNoteStartEvent_getNoteEndEvent(), which finds an earlier
+	 * unpaired note end if there is one, and so selected the wrong event.  The
+	 * new end event is the last one for the note at its tick.
+	 */
+
+	MidiFileEvent_t event, note_end_event = NULL;
+
+	for (event = note_start_event; (event != NULL) && (MidiFileEvent_getTick(event) <= end_tick); event = MidiFileEvent_getNextEventInTrack(event))
+	{
+		if ((MidiFileEvent_getTick(event) == end_tick) && MidiFileEvent_isNoteEndEvent(event) && (MidiFileNoteEndEvent_getChannel(event) == MidiFileNoteStartEvent_getChannel(note_start_event)) && (MidiFileNoteEndEvent_getNote(event) == MidiFileNoteStartEvent_getNote(note_start_event)))
+		{
+			note_end_event = event;
+		}
+	}
+
+	return note_end_event;
+}
+
+static int reference_convert_note_events_to_standard_events(MidiFile_t midi_file)
+{
+	MidiFileTrack_t track;
+	MidiFileEvent_t event;
+
+	if (midi_file == NULL) return -1;
+
+	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	{
+		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		{
+			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_NOTE)
+			{
+				MidiFileEvent_t note_start_event = MidiFileTrack_createNoteStartAndEndEvents(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileEvent_getTick(event) + MidiFileNoteEvent_getDurationTicks(event),
+					MidiFileNoteEvent_getChannel(event),
+					MidiFileNoteEvent_getNote(event),
+					MidiFileNoteEvent_getVelocity(event),
+					MidiFileNoteEvent_getEndVelocity(event));
+
+				MidiFileEvent_setSelected(note_start_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setSelected(get_newest_note_end_event(note_start_event, MidiFileEvent_getTick(event) + MidiFileNoteEvent_getDurationTicks(event)), MidiFileEvent_isSelected(event));
+				MidiFileEvent_setPreviousEvent(note_start_event, event);
+				MidiFileEvent_delete(event);
+				event = note_start_event;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int reference_convert_standard_events_to_fine_control_change_events(MidiFile_t midi_file)
+{
+	MidiFileTrack_t track;
+	MidiFileEvent_t event, next_event;
+	int values[16][64];
+
+	if (midi_file == NULL) return -1;
+
+	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	{
+		memset(values, 0, sizeof (int) * 16 * 64);
+
+		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = next_event)
+		{
+			next_event = MidiFileEvent_getNextEventInTrack(event);
+
+			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
+			{
+				if (MidiFileControlChangeEvent_getNumber(event) < 32)
+				{
+					if ((MidiFileEvent_getType(next_event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
+						&& (MidiFileControlChangeEvent_getChannel(next_event) == MidiFileControlChangeEvent_getChannel(event))
+						&& (MidiFileControlChangeEvent_getNumber(next_event) == MidiFileControlChangeEvent_getNumber(event) + 32))
+					{
+						MidiFileEvent_t new_event = MidiFileTrack_createFineControlChangeEvent(
+							track,
+							MidiFileEvent_getTick(event),
+							MidiFileControlChangeEvent_getChannel(event),
+							MidiFileControlChangeEvent_getNumber(event),
+							0);
+
+						MidiFileFineControlChangeEvent_setCoarseValue(new_event, MidiFileControlChangeEvent_getValue(event));
+						MidiFileFineControlChangeEvent_setFineValue(new_event, MidiFileControlChangeEvent_getValue(next_event));
+						values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event)] = MidiFileControlChangeEvent_getValue(event);
+						values[MidiFileControlChangeEvent_getChannel(next_event)][MidiFileControlChangeEvent_getNumber(next_event)] = MidiFileControlChangeEvent_getValue(next_event);
+						MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+						MidiFileEvent_setPreviousEvent(new_event, next_event);
+						MidiFileEvent_delete(event);
+						MidiFileEvent_delete(next_event);
+						next_event = MidiFileEvent_getNextEventInTrack(new_event);
+					}
+					else
+					{
+						MidiFileEvent_t new_event = MidiFileTrack_createFineControlChangeEvent(
+							track,
+							MidiFileEvent_getTick(event),
+							MidiFileControlChangeEvent_getChannel(event),
+							MidiFileControlChangeEvent_getNumber(event),
+							0);
+
+						MidiFileFineControlChangeEvent_setCoarseValue(new_event, MidiFileControlChangeEvent_getValue(event));
+						MidiFileFineControlChangeEvent_setFineValue(new_event, values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event) + 32]);
+						values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event)] = MidiFileControlChangeEvent_getValue(event);
+						MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+						MidiFileEvent_setPreviousEvent(new_event, event);
+						MidiFileEvent_delete(event);
+						next_event = MidiFileEvent_getNextEventInTrack(new_event);
+					}
+				}
+				else if (MidiFileControlChangeEvent_getNumber(event) < 64)
+				{
+					MidiFileEvent_t new_event = MidiFileTrack_createFineControlChangeEvent(
+						track,
+						MidiFileEvent_getTick(event),
+						MidiFileControlChangeEvent_getChannel(event),
+						MidiFileControlChangeEvent_getNumber(event),
+						0);
+
+					MidiFileFineControlChangeEvent_setCoarseValue(new_event, values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event) - 32]);
+					MidiFileFineControlChangeEvent_setFineValue(new_event, MidiFileControlChangeEvent_getValue(event));
+					values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event)] = MidiFileControlChangeEvent_getValue(event);
+					MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+					MidiFileEvent_setPreviousEvent(new_event, event);
+					MidiFileEvent_delete(event);
+					next_event = MidiFileEvent_getNextEventInTrack(new_event);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int reference_convert_fine_control_change_events_to_standard_events(MidiFile_t midi_file)
+{
+	MidiFileTrack_t track;
+	MidiFileEvent_t event;
+
+	if (midi_file == NULL) return -1;
+
+	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	{
+		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		{
+			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)
+			{
+				MidiFileEvent_t coarse_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileFineControlChangeEvent_getChannel(event),
+					MidiFileFineControlChangeEvent_getCoarseNumber(event),
+					MidiFileFineControlChangeEvent_getCoarseValue(event));
+
+				MidiFileEvent_t fine_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileFineControlChangeEvent_getChannel(event),
+					MidiFileFineControlChangeEvent_getFineNumber(event),
+					MidiFileFineControlChangeEvent_getFineValue(event));
+
+				MidiFileEvent_setSelected(coarse_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setSelected(fine_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setPreviousEvent(coarse_event, event);
+				MidiFileEvent_setPreviousEvent(fine_event, coarse_event);
+				MidiFileEvent_delete(event);
+				event = fine_event;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int reference_convert_standard_events_to_rpn_and_nrpn_events(MidiFile_t midi_file)
+{
+	MidiFileTrack_t track;
+	MidiFileEvent_t event, next_event;
+	int is_nrpn[16];
+	int numbers[16];
+	int values[16];
+
+	if (midi_file == NULL) return -1;
+
+	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	{
+		memset(is_nrpn, 0, sizeof (int) * 16);
+		memset(numbers, 0, sizeof (int) * 16);
+		memset(values, 0, sizeof (int) * 16);
+
+		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = next_event)
+		{
+			next_event = MidiFileEvent_getNextEventInTrack(event);
+
+			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
+			{
+				if (MidiFileControlChangeEvent_getNumber(event) == 101)
+				{
+					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+					{
+						is_nrpn[MidiFileControlChangeEvent_getChannel(event)] = 0;
+						numbers[MidiFileControlChangeEvent_getChannel(event)] = MidiFileControlChangeEvent_getValue(event) << 7;
+					}
+					else
+					{
+						numbers[MidiFileControlChangeEvent_getChannel(event)] = (MidiFileControlChangeEvent_getValue(event) << 7) | (numbers[MidiFileControlChangeEvent_getChannel(event)] & 0x7F) ;
+					}
+
+					values[MidiFileControlChangeEvent_getChannel(event)] = 0;
+					MidiFileEvent_delete(event);
+				}
+				else if (MidiFileControlChangeEvent_getNumber(event) == 100)
+				{
+					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+					{
+						is_nrpn[MidiFileControlChangeEvent_getChannel(event)] = 0;
+						numbers[MidiFileControlChangeEvent_getChannel(event)] = MidiFileControlChangeEvent_getValue(event);
+					}
+					else
+					{
+						numbers[MidiFileControlChangeEvent_getChannel(event)] = (numbers[MidiFileControlChangeEvent_getChannel(event)] & ~0x7F) | MidiFileControlChangeEvent_getValue(event);
+					}
+
+					values[MidiFileControlChangeEvent_getChannel(event)] = 0;
+					MidiFileEvent_delete(event);
+				}
+				else if (MidiFileControlChangeEvent_getNumber(event) == 6)
+				{
+					if ((MidiFileEvent_getType(next_event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
+						&& (MidiFileControlChangeEvent_getChannel(next_event) == MidiFileControlChangeEvent_getChannel(event))
+						&& (MidiFileControlChangeEvent_getNumber(next_event) == 38))
+					{
+						MidiFileEvent_t new_event;
+
+						values[MidiFileControlChangeEvent_getChannel(event)] = (MidiFileControlChangeEvent_getValue(event) << 7) | MidiFileControlChangeEvent_getValue(next_event);
+
+						if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+						{
+							new_event = MidiFileTrack_createNrpnEvent(
+								track,
+								MidiFileEvent_getTick(event),
+								MidiFileControlChangeEvent_getChannel(event),
+								numbers[MidiFileControlChangeEvent_getChannel(event)],
+								values[MidiFileControlChangeEvent_getChannel(event)]);
+						}
+						else
+						{
+							new_event = MidiFileTrack_createRpnEvent(
+								track,
+								MidiFileEvent_getTick(event),
+								MidiFileControlChangeEvent_getChannel(event),
+								numbers[MidiFileControlChangeEvent_getChannel(event)],
+								values[MidiFileControlChangeEvent_getChannel(event)]);
+						}
+
+						MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+						MidiFileEvent_setPreviousEvent(new_event, next_event);
+						MidiFileEvent_delete(event);
+						MidiFileEvent_delete(next_event);
+						next_event = MidiFileEvent_getNextEventInTrack(new_event);
+					}
+					else
+					{
+						MidiFileEvent_t new_event;
+
+						values[MidiFileControlChangeEvent_getChannel(event)] = (MidiFileControlChangeEvent_getValue(event) << 7) | (values[MidiFileControlChangeEvent_getChannel(event)] & 0x7F);
+
+						if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+						{
+							new_event = MidiFileTrack_createNrpnEvent(
+								track,
+								MidiFileEvent_getTick(event),
+								MidiFileControlChangeEvent_getChannel(event),
+								numbers[MidiFileControlChangeEvent_getChannel(event)],
+								values[MidiFileControlChangeEvent_getChannel(event)]);
+						}
+						else
+						{
+							new_event = MidiFileTrack_createRpnEvent(
+								track,
+								MidiFileEvent_getTick(event),
+								MidiFileControlChangeEvent_getChannel(event),
+								numbers[MidiFileControlChangeEvent_getChannel(event)],
+								values[MidiFileControlChangeEvent_getChannel(event)]);
+						}
+
+						MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+						MidiFileEvent_setPreviousEvent(new_event, event);
+						MidiFileEvent_delete(event);
+						next_event = MidiFileEvent_getNextEventInTrack(new_event);
+					}
+				}
+				else if (MidiFileControlChangeEvent_getNumber(event) == 38)
+				{
+					MidiFileEvent_t new_event;
+
+					values[MidiFileControlChangeEvent_getChannel(event)] = (values[MidiFileControlChangeEvent_getChannel(event)] & ~0x7F) | MidiFileControlChangeEvent_getValue(event);
+
+					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+					{
+						new_event = MidiFileTrack_createNrpnEvent(
+							track,
+							MidiFileEvent_getTick(event),
+							MidiFileControlChangeEvent_getChannel(event),
+							numbers[MidiFileControlChangeEvent_getChannel(event)],
+							values[MidiFileControlChangeEvent_getChannel(event)]);
+					}
+					else
+					{
+						new_event = MidiFileTrack_createRpnEvent(
+							track,
+							MidiFileEvent_getTick(event),
+							MidiFileControlChangeEvent_getChannel(event),
+							numbers[MidiFileControlChangeEvent_getChannel(event)],
+							values[MidiFileControlChangeEvent_getChannel(event)]);
+					}
+
+					MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+					MidiFileEvent_setPreviousEvent(new_event, event);
+					MidiFileEvent_delete(event);
+					next_event = MidiFileEvent_getNextEventInTrack(new_event);
+				}
+				else if (MidiFileControlChangeEvent_getNumber(event) == 96)
+				{
+					MidiFileEvent_t new_event;
+
+					values[MidiFileControlChangeEvent_getChannel(event)]++;
+
+					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+					{
+						new_event = MidiFileTrack_createNrpnEvent(
+							track,
+							MidiFileEvent_getTick(event),
+							MidiFileControlChangeEvent_getChannel(event),
+							numbers[MidiFileControlChangeEvent_getChannel(event)],
+							values[MidiFileControlChangeEvent_getChannel(event)]);
+					}
+					else
+					{
+						new_event = MidiFileTrack_createRpnEvent(
+							track,
+							MidiFileEvent_getTick(event),
+							MidiFileControlChangeEvent_getChannel(event),
+							numbers[MidiFileControlChangeEvent_getChannel(event)],
+							values[MidiFileControlChangeEvent_getChannel(event)]);
+					}
+
+					MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+					MidiFileEvent_setPreviousEvent(new_event, event);
+					MidiFileEvent_delete(event);
+					next_event = MidiFileEvent_getNextEventInTrack(new_event);
+				}
+				else if (MidiFileControlChangeEvent_getNumber(event) == 97)
+				{
+					MidiFileEvent_t new_event;
+
+					values[MidiFileControlChangeEvent_getChannel(event)]--;
+
+					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+					{
+						new_event = MidiFileTrack_createNrpnEvent(
+							track,
+							MidiFileEvent_getTick(event),
+							MidiFileControlChangeEvent_getChannel(event),
+							numbers[MidiFileControlChangeEvent_getChannel(event)],
+							values[MidiFileControlChangeEvent_getChannel(event)]);
+					}
+					else
+					{
+						new_event = MidiFileTrack_createRpnEvent(
+							track,
+							MidiFileEvent_getTick(event),
+							MidiFileControlChangeEvent_getChannel(event),
+							numbers[MidiFileControlChangeEvent_getChannel(event)],
+							values[MidiFileControlChangeEvent_getChannel(event)]);
+					}
+
+					MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+					MidiFileEvent_setPreviousEvent(new_event, event);
+					MidiFileEvent_delete(event);
+					next_event = MidiFileEvent_getNextEventInTrack(new_event);
+				}
+			}
+			else if ((MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE) && (MidiFileFineControlChangeEvent_getCoarseNumber(event) == 6))
+			{
+				MidiFileEvent_t new_event;
+
+				values[MidiFileFineControlChangeEvent_getChannel(event)] = MidiFileFineControlChangeEvent_getValue(event);
+
+				if (is_nrpn[MidiFileFineControlChangeEvent_getChannel(event)])
+				{
+					new_event = MidiFileTrack_createNrpnEvent(
+						track,
+						MidiFileEvent_getTick(event),
+						MidiFileFineControlChangeEvent_getChannel(event),
+						numbers[MidiFileFineControlChangeEvent_getChannel(event)],
+						values[MidiFileFineControlChangeEvent_getChannel(event)]);
+				}
+				else
+				{
+					new_event = MidiFileTrack_createRpnEvent(
+						track,
+						MidiFileEvent_getTick(event),
+						MidiFileFineControlChangeEvent_getChannel(event),
+						numbers[MidiFileFineControlChangeEvent_getChannel(event)],
+						values[MidiFileFineControlChangeEvent_getChannel(event)]);
+				}
+
+				MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setPreviousEvent(new_event, event);
+				MidiFileEvent_delete(event);
+				next_event = MidiFileEvent_getNextEventInTrack(new_event);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int reference_convert_rpn_and_nrpn_events_to_standard_events(MidiFile_t midi_file)
+{
+	MidiFileTrack_t track;
+	MidiFileEvent_t event;
+
+	if (midi_file == NULL) return -1;
+
+	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	{
+		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		{
+			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_RPN)
+			{
+				MidiFileEvent_t coarse_number_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileRpnEvent_getChannel(event),
+					101,
+					MidiFileRpnEvent_getCoarseNumber(event));
+
+				MidiFileEvent_t fine_number_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileRpnEvent_getChannel(event),
+					100,
+					MidiFileRpnEvent_getFineNumber(event));
+
+				MidiFileEvent_t coarse_value_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileRpnEvent_getChannel(event),
+					6,
+					MidiFileRpnEvent_getCoarseValue(event));
+
+				MidiFileEvent_t fine_value_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileRpnEvent_getChannel(event),
+					38,
+					MidiFileRpnEvent_getFineValue(event));
+
+				MidiFileEvent_setSelected(coarse_number_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setSelected(fine_number_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setSelected(coarse_value_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setSelected(fine_value_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setPreviousEvent(coarse_number_event, event);
+				MidiFileEvent_setPreviousEvent(fine_number_event, coarse_number_event);
+				MidiFileEvent_setPreviousEvent(coarse_value_event, fine_number_event);
+				MidiFileEvent_setPreviousEvent(fine_value_event, coarse_value_event);
+				MidiFileEvent_delete(event);
+				event = fine_value_event;
+			}
+			else if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_NRPN)
+			{
+				MidiFileEvent_t coarse_number_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileNrpnEvent_getChannel(event),
+					99,
+					MidiFileNrpnEvent_getCoarseNumber(event));
+
+				MidiFileEvent_t fine_number_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileNrpnEvent_getChannel(event),
+					98,
+					MidiFileNrpnEvent_getFineNumber(event));
+
+				MidiFileEvent_t coarse_value_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileNrpnEvent_getChannel(event),
+					6,
+					MidiFileNrpnEvent_getCoarseValue(event));
+
+				MidiFileEvent_t fine_value_event = MidiFileTrack_createControlChangeEvent(
+					MidiFileEvent_getTrack(event),
+					MidiFileEvent_getTick(event),
+					MidiFileNrpnEvent_getChannel(event),
+					38,
+					MidiFileNrpnEvent_getFineValue(event));
+
+				MidiFileEvent_setSelected(coarse_number_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setSelected(fine_number_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setSelected(coarse_value_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setSelected(fine_value_event, MidiFileEvent_isSelected(event));
+				MidiFileEvent_setPreviousEvent(coarse_number_event, event);
+				MidiFileEvent_setPreviousEvent(fine_number_event, coarse_number_event);
+				MidiFileEvent_setPreviousEvent(coarse_value_event, fine_number_event);
+				MidiFileEvent_setPreviousEvent(fine_value_event, coarse_value_event);
+				MidiFileEvent_delete(event);
+				event = fine_value_event;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int events_match(MidiFileEvent_t event, MidiFileEvent_t other_event)
+{
+	if ((MidiFileEvent_getTick(event) != MidiFileEvent_getTick(other_event)) || (MidiFileEvent_getType(event) != MidiFileEvent_getType(other_event)) || (MidiFileEvent_isSelected(event) != MidiFileEvent_isSelected(other_event))) return 0;
+
+	switch (MidiFileEvent_getType(event))
+	{
+		case MIDI_FILE_EVENT_TYPE_SYSEX:
+		{
+			return ((MidiFileSysexEvent_getDataLength(event) == MidiFileSysexEvent_getDataLength(other_event)) && (memcmp(MidiFileSysexEvent_getData(event), MidiFileSysexEvent_getData(other_event), MidiFileSysexEvent_getDataLength(event)) == 0));
+		}
+		case MIDI_FILE_EVENT_TYPE_META:
+		{
+			return ((MidiFileMetaEvent_getNumber(event) == MidiFileMetaEvent_getNumber(other_event)) && (MidiFileMetaEvent_getDataLength(event) == MidiFileMetaEvent_getDataLength(other_event)) && (memcmp(MidiFileMetaEvent_getData(event), MidiFileMetaEvent_getData(other_event), MidiFileMetaEvent_getDataLength(event)) == 0));
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE:
+		{
+			return ((MidiFileNoteEvent_getDurationTicks(event) == MidiFileNoteEvent_getDurationTicks(other_event)) && (MidiFileNoteEvent_getChannel(event) == MidiFileNoteEvent_getChannel(other_event)) && (MidiFileNoteEvent_getNote(event) == MidiFileNoteEvent_getNote(other_event)) && (MidiFileNoteEvent_getVelocity(event) == MidiFileNoteEvent_getVelocity(other_event)) && (MidiFileNoteEvent_getEndVelocity(event) == MidiFileNoteEvent_getEndVelocity(other_event)));
+		}
+		case MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE:
+		{
+			return ((MidiFileFineControlChangeEvent_getChannel(event) == MidiFileFineControlChangeEvent_getChannel(other_event)) && (MidiFileFineControlChangeEvent_getCoarseNumber(event) == MidiFileFineControlChangeEvent_getCoarseNumber(other_event)) && (MidiFileFineControlChangeEvent_getValue(event) == MidiFileFineControlChangeEvent_getValue(other_event)));
+		}
+		case MIDI_FILE_EVENT_TYPE_RPN:
+		{
+			return ((MidiFileRpnEvent_getChannel(event) == MidiFileRpnEvent_getChannel(other_event)) && (MidiFileRpnEvent_getNumber(event) == MidiFileRpnEvent_getNumber(other_event)) && (MidiFileRpnEvent_getValue(event) == MidiFileRpnEvent_getValue(other_event)));
+		}
+		case MIDI_FILE_EVENT_TYPE_NRPN:
+		{
+			return ((MidiFileNrpnEvent_getChannel(event) == MidiFileNrpnEvent_getChannel(other_event)) && (MidiFileNrpnEvent_getNumber(event) == MidiFileNrpnEvent_getNumber(other_event)) && (MidiFileNrpnEvent_getValue(event) == MidiFileNrpnEvent_getValue(other_event)));
+		}
+		default:
+		{
+			return (MidiFileVoiceEvent_getData(event) == MidiFileVoiceEvent_getData(other_event));
+		}
+	}
+}
+
+static char *check_files_match(MidiFile_t midi_file, MidiFile_t reference_midi_file)
+{
+	/* Returns a description of the first difference, or NULL if there is none. */
+
+	MidiFileTrack_t track, reference_track;
+	MidiFileEvent_t event, reference_event;
+	long number_of_events_in_tracks = 0, number_of_events_in_file = 0;
+	int size;
+
+	for (track = MidiFile_getFirstTrack(midi_file), reference_track = MidiFile_getFirstTrack(reference_midi_file); (track != NULL) && (reference_track != NULL); track = MidiFileTrack_getNextTrack(track), reference_track = MidiFileTrack_getNextTrack(reference_track))
+	{
+		for (event = MidiFileTrack_getFirstEvent(track), reference_event = MidiFileTrack_getFirstEvent(reference_track); (event != NULL) && (reference_event != NULL); event = MidiFileEvent_getNextEventInTrack(event), reference_event = MidiFileEvent_getNextEventInTrack(reference_event))
+		{
+			if (! events_match(event, reference_event)) return "different events in track";
+			if (MidiFileEvent_getTrack(event) != track) return "event has the wrong track";
+			number_of_events_in_tracks++;
+		}
+
+		if ((event != NULL) || (reference_event != NULL)) return "different number of events in track";
+		if (MidiFileTrack_getEndTick(track) != MidiFileTrack_getEndTick(reference_track)) return "different track end tick";
+	}
+
+	if ((track != NULL) || (reference_track != NULL)) return "different number of tracks";
+
+	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+	{
+		if ((MidiFileEvent_getNextEventInFile(event) != NULL) && (MidiFileEvent_getTick(MidiFileEvent_getNextEventInFile(event)) < MidiFileEvent_getTick(event))) return "file list out of order";
+		if ((MidiFileEvent_getNextEventInFile(event) != NULL) && (MidiFileEvent_getPreviousEventInFile(MidiFileEvent_getNextEventInFile(event)) != event)) return "file list badly linked";
+		if (MidiFile_getFirstEventForTick(midi_file, MidiFileEvent_getTick(event)) == NULL) return "file tick index out of date";
+		number_of_events_in_file++;
+	}
+
+	if (number_of_events_in_file != number_of_events_in_tracks) return "file list and tracks hold different events";
+
+	size = MidiFile_getFileSize(midi_file);
+	if (size != MidiFile_getFileSize(reference_midi_file)) return "different file size";
+
+	{
+		unsigned char *buffer = (unsigned char *)(malloc(size));
+		unsigned char *reference_buffer = (unsigned char *)(malloc(size));
+		int buffers_match;
+		MidiFile_saveToBuffer(midi_file, buffer);
+		MidiFile_saveToBuffer(reference_midi_file, reference_buffer);
+		buffers_match = (memcmp(buffer, reference_buffer, size) == 0);
+		free(buffer);
+		free(reference_buffer);
+		if (! buffers_match) return "different saved data";
+	}
+
+	return NULL;
+}
+
+static char *step_names[] = { "to notes", "from notes", "to fine control changes", "to RPNs and NRPNs", "from RPNs and NRPNs", "from fine control changes" };
+
+static int check_file(char *filename)
+{
+	MidiFile_t midi_file, reference_midi_file;
+	MidiFileEvent_t event;
+	char *difference = NULL;
+	int step;
+
+	if (((midi_file = MidiFile_load(filename)) == NULL) || ((reference_midi_file = MidiFile_load(filename)) == NULL))
+	{
+		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", filename);
+		exit(1);
+	}
+
+	/* select some events so that the selection is checked as well */
+
+	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+	{
+		if ((MidiFileEvent_getTick(event) % 3) == 0) MidiFileEvent_setSelected(event, 1);
+	}
+
+	for (event = MidiFile_getFirstEvent(reference_midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+	{
+		if ((MidiFileEvent_getTick(event) % 3) == 0) MidiFileEvent_setSelected(event, 1);
+	}
+
+	for (step = 0; (step < 6) && (difference == NULL); step++)
+	{
+		switch (step)
+		{
+			case 0:
+			{
+				MidiFile_convertStandardEventsToNoteEvents(midi_file);
+				reference_convert_standard_events_to_note_events(reference_midi_file);
+				break;
+			}
+			case 1:
+			{
+				MidiFile_convertNoteEventsToStandardEvents(midi_file);
+				reference_convert_note_events_to_standard_events(reference_midi_file);
+				break;
+			}
+			case 2:
+			{
+				MidiFile_convertStandardEventsToFineControlChangeEvents(midi_file);
+				reference_convert_standard_events_to_fine_control_change_events(reference_midi_file);
+				break;
+			}
+			case 3:
+			{
+				MidiFile_convertStandardEventsToRpnAndNrpnEvents(midi_file);
+				reference_convert_standard_events_to_rpn_and_nrpn_events(reference_midi_file);
+				break;
+			}
+			case 4:
+			{
+				MidiFile_convertRpnAndNrpnEventsToStandardEvents(midi_file);
+				reference_convert_rpn_and_nrpn_events_to_standard_events(reference_midi_file);
+				break;
+			}
+			case 5:
+			{
+				MidiFile_convertFineControlChangeEventsToStandardEvents(midi_file);
+				reference_convert_fine_control_change_events_to_standard_events(reference_midi_file);
+				break;
+			}
+		}
+
+		difference = check_files_match(midi_file, reference_midi_file);
+	}
+
+	if (difference == NULL)
+	{
+		printf("ok    %s\n", filename);
+	}
+	else
+	{
+		printf("FAIL  %s (%s: %s)\n", filename, step_names[step - 1], difference);
+	}
+
+	MidiFile_free(reference_midi_file);
+	MidiFile_free(midi_file);
+	return (difference == NULL);
+}
+
+int main(int argc, char **argv)
+{
+	int number_of_failures = 0;
+	int i;
+
+	if (argc < 2) usage(argv[0]);
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--help") == 0) usage(argv[0]);
+	}
+
+	for (i = 1; i < argc; i++)
+	{
+		if (! check_file(argv[i])) number_of_failures++;
+	}
+
+	printf("%d of %d files passed\n", argc - 1 - number_of_failures, argc - 1);
+	return (number_of_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,567 @@
+
+/*
+ * Timings for the midiutil library, to check that changes to its internals
+ * actually pay off.  Each test prints one line per run so that the results
+ * for different builds can be compared side by side.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <midiutil-common.h>
+#include <midiutil-system.h>
+#include <simple-collections.h>
+
+struct AlarmRecord
+{
+	long long end_time_nsecs;
+	long long lateness_nsecs;
+	int has_fired;
+	int was_cancelled;
+};
+
+static unsigned long random_state = 1;
+static MidiUtilLock_t alarm_lock = NULL;
+static long number_of_unfinished_alarms = 0;
+
+static void usage(char *program_name)
+{
+	fprintf(stderr, "Usage:  %s --alarms [ --count <n> ] [ --threads <n> ] [ --spread <msecs> ]\n", program_name);
+	fprintf(stderr, "        %s --maps [ --count <n> ] [ --buckets <n> ]\n", program_name);
+	fprintf(stderr, "        %s --ring [ --count <n> ]\n", program_name);
+	fprintf(stderr, "        %s --arrays [ --count <n> ]\n", program_name);
+	exit(1);
+}
+
+static long get_random_number(long limit)
+{
+	random_state = (random_state * 1103515245UL) + 12345UL;
+	return (long)((random_state >> 8) % (unsigned long)(limit));
+}
+
+static int compare_lateness(const void *first, const void *second)
+{
+	long long first_lateness_nsecs = *((const long long *)(first));
+	long long second_lateness_nsecs = *((const long long *)(second));
+	return (first_lateness_nsecs < second_lateness_nsecs) ? -1 : (first_lateness_nsecs > second_lateness_nsecs) ? 1 : 0;
+}
+
+static void handle_alarm(int cancelled, void *user_data)
+{
+	struct AlarmRecord *record = (struct AlarmRecord *)(user_data);
+
+	if (cancelled)
+	{
+		record->was_cancelled++;
+	}
+	else
+	{
+		record->lateness_nsecs = MidiUtil_getCurrentTimeNsecs() - record->end_time_nsecs;
+		record->has_fired++;
+	}
+
+	MidiUtilLock_lock(alarm_lock);
+	if (--number_of_unfinished_alarms == 0) MidiUtilLock_notify(alarm_lock);
+	MidiUtilLock_unlock(alarm_lock);
+}
+
+static void test_alarms(long number_of_alarms, int number_of_threads, long spread_msecs)
+{
+	/* Schedules alarms at random times over the spread, cancels every tenth one through its handle, then waits for the rest to fire. */
+
+	MidiUtilAlarm_t alarm = MidiUtilAlarm_newWithThreads(number_of_threads);
+	struct AlarmRecord *records = (struct AlarmRecord *)(calloc(number_of_alarms, sizeof (struct AlarmRecord)));
+	long long *handles = (long long *)(malloc(number_of_alarms * sizeof (long long)));
+	long long *lateness_array = (long long *)(malloc(number_of_alarms * sizeof (long long)));
+	long long start_time_nsecs = MidiUtil_getCurrentTimeNsecs() + 200000000;
+	long long add_nsecs, cancel_nsecs, total_lateness_nsecs = 0;
+	long alarm_number, number_of_fired_alarms = 0, number_of_errors = 0;
+
+	alarm_lock = MidiUtilLock_new();
+	number_of_unfinished_alarms = number_of_alarms;
+
+	for (alarm_number = 0; alarm_number < number_of_alarms; alarm_number++)
+	{
+		records[alarm_number].end_time_nsecs = start_time_nsecs + ((long long)(get_random_number(spread_msecs * 1000)) * 1000);
+	}
+
+	add_nsecs = MidiUtil_getCurrentTimeNsecs();
+	for (alarm_number = 0; alarm_number < number_of_alarms; alarm_number++) handles[alarm_number] = MidiUtilAlarm_addAt(alarm, records[alarm_number].end_time_nsecs, handle_alarm, &(records[alarm_number]));
+	add_nsecs = MidiUtil_getCurrentTimeNsecs() - add_nsecs;
+
+	cancel_nsecs = MidiUtil_getCurrentTimeNsecs();
+	for (alarm_number = 0; alarm_number < number_of_alarms; alarm_number += 10) MidiUtilAlarm_cancelOne(alarm, handles[alarm_number]);
+	cancel_nsecs = MidiUtil_getCurrentTimeNsecs() - cancel_nsecs;
+
+	MidiUtilLock_lock(alarm_lock);
+	while (number_of_unfinished_alarms > 0) MidiUtilLock_wait(alarm_lock, -1);
+	MidiUtilLock_unlock(alarm_lock);
+
+	for (alarm_number = 0; alarm_number < number_of_alarms; alarm_number++)
+	{
+		if ((records[alarm_number].has_fired + records[alarm_number].was_cancelled != 1) || (records[alarm_number].was_cancelled != (alarm_number % 10 == 0))) number_of_errors++;
+		if (MidiUtilAlarm_cancelOne(alarm, handles[alarm_number]) == 0) number_of_errors++;
+
+		if (records[alarm_number].has_fired)
+		{
+			lateness_array[number_of_fired_alarms++] = records[alarm_number].lateness_nsecs;
+			total_lateness_nsecs += records[alarm_number].lateness_nsecs;
+		}
+	}
+
+	qsort(lateness_array, number_of_fired_alarms, sizeof (long long), compare_lateness);
+	printf("alarms count=%ld threads=%d add=%.0fns/alarm cancel=%.0fns/alarm lateness avg=%.0fus p99=%.0fus max=%.0fus errors=%ld\n", number_of_alarms, number_of_threads, (double)(add_nsecs) / number_of_alarms, (double)(cancel_nsecs) / ((number_of_alarms + 9) / 10), (number_of_fired_alarms > 0) ? (double)(total_lateness_nsecs) / number_of_fired_alarms / 1000 : 0.0, (number_of_fired_alarms > 0) ? lateness_array[number_of_fired_alarms * 99 / 100] / 1000.0 : 0.0, (number_of_fired_alarms > 0) ? lateness_array[number_of_fired_alarms - 1] / 1000.0 : 0.0, number_of_errors);
+
+	MidiUtilAlarm_free(alarm);
+	MidiUtilLock_free(alarm_lock);
+	free(lateness_array);
+	free(handles);
+	free(records);
+}
+
+static double get_nsecs_per_operation(long long start_time_nsecs, long number_of_operations)
+{
+	return (double)(MidiUtil_getCurrentTimeNsecs() - start_time_nsecs) / number_of_operations;
+}
+
+static void test_chained_maps(char *key_type, long number_of_keys, int number_of_buckets, int *int_keys, void **pointer_keys, unsigned char **string_keys)
+{
+	/* The chained maps that midiutil-common used to have, which still ship as extras/simple-collections. */
+
+	IntIntMap_t int_map = IntIntMap_new(number_of_buckets);
+	PointerIntMap_t pointer_map = PointerIntMap_new(number_of_buckets);
+	StringIntMap_t string_map = StringIntMap_new(number_of_buckets);
+	long long start_time_nsecs;
+	double set_nsecs, get_nsecs, miss_nsecs, remove_nsecs;
+	long key_number, checksum = 0;
+
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (key_number = 0; key_number < number_of_keys; key_number++)
+	{
+		if (key_type[0] == 'i') IntIntMap_set(int_map, int_keys[key_number], (int)(key_number));
+		else if (key_type[0] == 'p') PointerIntMap_set(pointer_map, pointer_keys[key_number], (int)(key_number));
+		else StringIntMap_set(string_map, string_keys[key_number], (int)(key_number));
+	}
+
+	set_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_keys);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (key_number = 0; key_number < number_of_keys; key_number++)
+	{
+		if (key_type[0] == 'i') checksum += IntIntMap_get(int_map, int_keys[key_number], -1);
+		else if (key_type[0] == 'p') checksum += PointerIntMap_get(pointer_map, pointer_keys[key_number], -1);
+		else checksum += StringIntMap_get(string_map, string_keys[key_number], -1);
+	}
+
+	get_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_keys);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (key_number = 0; key_number < number_of_keys; key_number++)
+	{
+		/* Keys from the second half of each array were never added. */
+		if (key_type[0] == 'i') checksum += IntIntMap_get(int_map, int_keys[number_of_keys + key_number], -1);
+		else if (key_type[0] == 'p') checksum += PointerIntMap_get(pointer_map, pointer_keys[number_of_keys + key_number], -1);
+		else checksum += StringIntMap_get(string_map, string_keys[number_of_keys + key_number], -1);
+	}
+
+	miss_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_keys);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (key_number = 0; key_number < number_of_keys; key_number++)
+	{
+		if (key_type[0] == 'i') IntIntMap_remove(int_map, int_keys[key_number]);
+		else if (key_type[0] == 'p') PointerIntMap_remove(pointer_map, pointer_keys[key_number]);
+		else StringIntMap_remove(string_map, string_keys[key_number]);
+	}
+
+	remove_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_keys);
+	printf("maps impl=chained keys=%s count=%ld set=%.0fns get=%.0fns miss=%.0fns remove=%.0fns checksum=%ld\n", key_type, number_of_keys, set_nsecs, get_nsecs, miss_nsecs, remove_nsecs, checksum);
+	IntIntMap_free(int_map);
+	PointerIntMap_free(pointer_map);
+	StringIntMap_free(string_map);
+}
+
+static void test_open_maps(char *key_type, long number_of_keys, int number_of_buckets, int *int_keys, void **pointer_keys, unsigned char **string_keys)
+{
+	MidiUtilIntIntMap_t int_map = MidiUtilIntIntMap_new(number_of_buckets);
+	MidiUtilPointerIntMap_t pointer_map = MidiUtilPointerIntMap_new(number_of_buckets);
+	MidiUtilStringIntMap_t string_map = MidiUtilStringIntMap_new(number_of_buckets);
+	long long start_time_nsecs;
+	double set_nsecs, get_nsecs, miss_nsecs, remove_nsecs;
+	long key_number, checksum = 0;
+
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (key_number = 0; key_number < number_of_keys; key_number++)
+	{
+		if (key_type[0] == 'i') MidiUtilIntIntMap_set(int_map, int_keys[key_number], (int)(key_number));
+		else if (key_type[0] == 'p') MidiUtilPointerIntMap_set(pointer_map, pointer_keys[key_number], (int)(key_number));
+		else MidiUtilStringIntMap_set(string_map, string_keys[key_number], (int)(key_number));
+	}
+
+	set_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_keys);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (key_number = 0; key_number < number_of_keys; key_number++)
+	{
+		if (key_type[0] == 'i') checksum += MidiUtilIntIntMap_get(int_map, int_keys[key_number], -1);
+		else if (key_type[0] == 'p') checksum += MidiUtilPointerIntMap_get(pointer_map, pointer_keys[key_number], -1);
+		else checksum += MidiUtilStringIntMap_get(string_map, string_keys[key_number], -1);
+	}
+
+	get_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_keys);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (key_number = 0; key_number < number_of_keys; key_number++)
+	{
+		if (key_type[0] == 'i') checksum += MidiUtilIntIntMap_get(int_map, int_keys[number_of_keys + key_number], -1);
+		else if (key_type[0] == 'p') checksum += MidiUtilPointerIntMap_get(pointer_map, pointer_keys[number_of_keys + key_number], -1);
+		else checksum += MidiUtilStringIntMap_get(string_map, string_keys[number_of_keys + key_number], -1);
+	}
+
+	miss_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_keys);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (key_number = 0; key_number < number_of_keys; key_number++)
+	{
+		if (key_type[0] == 'i') MidiUtilIntIntMap_remove(int_map, int_keys[key_number]);
+		else if (key_type[0] == 'p') MidiUtilPointerIntMap_remove(pointer_map, pointer_keys[key_number]);
+		else MidiUtilStringIntMap_remove(string_map, string_keys[key_number]);
+	}
+
+	remove_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_keys);
+	printf("maps impl=open keys=%s count=%ld set=%.0fns get=%.0fns miss=%.0fns remove=%.0fns checksum=%ld\n", key_type, number_of_keys, set_nsecs, get_nsecs, miss_nsecs, remove_nsecs, checksum);
+	MidiUtilIntIntMap_free(int_map);
+	MidiUtilPointerIntMap_free(pointer_map);
+	MidiUtilStringIntMap_free(string_map);
+}
+
+static void test_maps(long number_of_keys, int number_of_buckets)
+{
+	/*
+	 * Twice as many keys as get added, so the second half can be looked up as
+	 * misses.  Pointer keys are 16-byte aligned like malloc()'s.  The chained
+	 * maps multiply keys by 62342347 and can overflow into a negative bucket
+	 * number, so only keys that they can actually hold are used.
+	 */
+
+	int *int_keys = (int *)(malloc(number_of_keys * 2 * sizeof (int)));
+	char *pointer_key_buffer = (char *)(malloc(number_of_keys * 8 * 16));
+	void **pointer_keys = (void **)(malloc(number_of_keys * 2 * sizeof (void *)));
+	unsigned char **string_keys = (unsigned char **)(malloc(number_of_keys * 2 * sizeof (unsigned char *)));
+	unsigned long candidate_number = 0, pointer_candidate_number = 0;
+	long key_number;
+
+	for (key_number = 0; key_number < number_of_keys * 2; key_number++)
+	{
+		char string_key[32];
+
+		do
+		{
+			int_keys[key_number] = (int)((++candidate_number * 2654435761UL) & 0x7fffffff);
+		}
+		while ((int)((unsigned int)(int_keys[key_number]) * 62342347U) < 0);
+
+		do
+		{
+			pointer_keys[key_number] = pointer_key_buffer + ((pointer_candidate_number++ % (number_of_keys * 8)) * 16);
+		}
+		while ((long)((unsigned long)(pointer_keys[key_number]) * 62342347UL) < 0);
+
+		sprintf(string_key, "track-%ld-note", key_number);
+		string_keys[key_number] = (unsigned char *)(strdup(string_key));
+	}
+
+	test_chained_maps("int", number_of_keys, number_of_buckets, int_keys, pointer_keys, string_keys);
+	test_open_maps("int", number_of_keys, number_of_buckets, int_keys, pointer_keys, string_keys);
+	test_chained_maps("pointer", number_of_keys, number_of_buckets, int_keys, pointer_keys, string_keys);
+	test_open_maps("pointer", number_of_keys, number_of_buckets, int_keys, pointer_keys, string_keys);
+	test_chained_maps("string", number_of_keys, number_of_buckets, int_keys, pointer_keys, string_keys);
+	test_open_maps("string", number_of_keys, number_of_buckets, int_keys, pointer_keys, string_keys);
+
+	for (key_number = 0; key_number < number_of_keys * 2; key_number++) free(string_keys[key_number]);
+	free(string_keys);
+	free(pointer_keys);
+	free(pointer_key_buffer);
+	free(int_keys);
+}
+
+static void test_byte_backed_arrays(long number_of_values, int *values)
+{
+	IntArray_t int_array = IntArray_new(0);
+	PointerArray_t pointer_array = PointerArray_new(1024);
+	long long start_time_nsecs;
+	double add_nsecs, get_nsecs, add_values_nsecs, churn_nsecs;
+	long value_number;
+	unsigned long checksum = 0;
+
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	for (value_number = 0; value_number < number_of_values; value_number++) IntArray_add(int_array, values[value_number]);
+	add_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	for (value_number = 0; value_number < number_of_values; value_number++) checksum += IntArray_get(int_array, (int)(value_number));
+	get_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+
+	IntArray_clear(int_array);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	for (value_number = 0; value_number < number_of_values; value_number += 64) IntArray_addValues(int_array, values + value_number, (number_of_values - value_number < 64) ? (int)(number_of_values - value_number) : 64);
+	add_values_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+	checksum += IntArray_getSize(int_array);
+
+	for (value_number = 0; value_number < 1024; value_number++) PointerArray_add(pointer_array, values + value_number);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (value_number = 0; value_number < number_of_values; value_number++)
+	{
+		int element_number = values[value_number] & 1023;
+		void *value = PointerArray_get(pointer_array, element_number);
+		PointerArray_remove(pointer_array, element_number);
+		PointerArray_add(pointer_array, value);
+	}
+
+	churn_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+	printf("arrays impl=byte-backed count=%ld add=%.1fns get=%.1fns add-values=%.1fns churn=%.1fns checksum=%lu\n", number_of_values, add_nsecs, get_nsecs, add_values_nsecs, churn_nsecs, checksum);
+	IntArray_free(int_array);
+	PointerArray_free(pointer_array);
+}
+
+static void test_typed_arrays(long number_of_values, int *values)
+{
+	MidiUtilIntArray_t int_array = MidiUtilIntArray_new(0);
+	MidiUtilPointerArray_t pointer_array = MidiUtilPointerArray_new(1024);
+	long long start_time_nsecs;
+	double add_nsecs, add_unchecked_nsecs, get_nsecs, add_values_nsecs, churn_nsecs;
+	long value_number;
+	unsigned long checksum = 0;
+
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	for (value_number = 0; value_number < number_of_values; value_number++) MidiUtilIntArray_add(int_array, values[value_number]);
+	add_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+
+	MidiUtilIntArray_clear(int_array);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	MidiUtilIntArray_reserve(int_array, (int)(number_of_values));
+	for (value_number = 0; value_number < number_of_values; value_number++) MidiUtilIntArray_addUnchecked(int_array, values[value_number]);
+	add_unchecked_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	for (value_number = 0; value_number < number_of_values; value_number++) checksum += MidiUtilIntArray_get(int_array, (int)(value_number));
+	get_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+
+	MidiUtilIntArray_free(int_array);
+	int_array = MidiUtilIntArray_new(0);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	for (value_number = 0; value_number < number_of_values; value_number += 64) MidiUtilIntArray_addValues(int_array, values + value_number, (number_of_values - value_number < 64) ? (int)(number_of_values - value_number) : 64);
+	add_values_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+	checksum += MidiUtilIntArray_getSize(int_array);
+
+	for (value_number = 0; value_number < 1024; value_number++) MidiUtilPointerArray_add(pointer_array, values + value_number);
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+
+	for (value_number = 0; value_number < number_of_values; value_number++)
+	{
+		int element_number = values[value_number] & 1023;
+		void *value = MidiUtilPointerArray_get(pointer_array, element_number);
+		MidiUtilPointerArray_swapRemove(pointer_array, element_number);
+		MidiUtilPointerArray_add(pointer_array, value);
+	}
+
+	churn_nsecs = get_nsecs_per_operation(start_time_nsecs, number_of_values);
+	printf("arrays impl=typed count=%ld add=%.1fns add-unchecked=%.1fns get=%.1fns add-values=%.1fns churn=%.1fns checksum=%lu\n", number_of_values, add_nsecs, add_unchecked_nsecs, get_nsecs, add_values_nsecs, churn_nsecs, checksum);
+	MidiUtilIntArray_free(int_array);
+	MidiUtilPointerArray_free(pointer_array);
+}
+
+static void test_arrays(long number_of_values)
+{
+	/* Churn removes a player from the middle of a 1024-entry list and adds it back, the way noteflurry retires and starts players; the typed arrays do it with a swap-remove. */
+
+	int *values = (int *)(malloc((number_of_values + 1024) * sizeof (int)));
+	long value_number;
+
+	for (value_number = 0; value_number < number_of_values + 1024; value_number++) values[value_number] = (int)(((unsigned long)(value_number) * 2654435761UL) & 0x7fffffff);
+	test_byte_backed_arrays(number_of_values, values);
+	test_typed_arrays(number_of_values, values);
+	free(values);
+}
+
+struct RingTest
+{
+	MidiUtilMessageRing_t ring;
+	long number_of_messages;
+	long pace_nsecs;
+	MidiUtilLock_t lock;
+	int producer_is_finished;
+};
+
+static int get_ring_test_message(long message_number, unsigned char *message)
+{
+	/* Mostly note ons, with a sysex every 64 messages to exercise the arena. */
+	int message_size = (message_number % 64 == 63) ? 100 : 3;
+	int i;
+
+	message[0] = (message_size == 3) ? 0x90 : 0xF0;
+	for (i = 1; i < message_size; i++) message[i] = (unsigned char)((message_number + i) & 0x7F);
+	if (message_size > 3) message[message_size - 1] = 0xF7;
+	return message_size;
+}
+
+static void ring_producer_thread_main(void *user_data)
+{
+	struct RingTest *ring_test = (struct RingTest *)(user_data);
+	long long next_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	long message_number;
+
+	for (message_number = 0; message_number < ring_test->number_of_messages; message_number++)
+	{
+		unsigned char message[100];
+		int message_size = get_ring_test_message(message_number, message);
+
+		if (ring_test->pace_nsecs > 0)
+		{
+			next_time_nsecs += ring_test->pace_nsecs;
+			MidiUtil_sleepUntil(next_time_nsecs);
+		}
+
+		while (MidiUtilMessageRing_put(ring_test->ring, (double)(MidiUtil_getCurrentTimeNsecs()), message, message_size) < 0) {}
+	}
+
+	MidiUtilLock_lock(ring_test->lock);
+	ring_test->producer_is_finished = 1;
+	MidiUtilLock_notify(ring_test->lock);
+	MidiUtilLock_unlock(ring_test->lock);
+}
+
+static void test_ring_mode(char *mode, long number_of_messages, long pace_nsecs)
+{
+	/* The consumer is this thread, which blocks in MidiUtilMessageRing_wait() whenever the ring runs dry, the way a tool's worker thread would. */
+
+	struct RingTest ring_test;
+	long long *latency_array = (long long *)(malloc(number_of_messages * sizeof (long long)));
+	long long start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
+	double seconds;
+	long message_number = 0, number_of_errors = 0;
+
+	ring_test.ring = MidiUtilMessageRing_new(1024, 16384);
+	ring_test.number_of_messages = number_of_messages;
+	ring_test.pace_nsecs = pace_nsecs;
+	ring_test.lock = MidiUtilLock_new();
+	ring_test.producer_is_finished = 0;
+	MidiUtil_startThread(ring_producer_thread_main, &ring_test);
+
+	while (message_number < number_of_messages)
+	{
+		double timestamp;
+		const unsigned char *message;
+		int message_size;
+
+		if (MidiUtilMessageRing_get(ring_test.ring, &timestamp, &message, &message_size))
+		{
+			unsigned char expected_message[100];
+			latency_array[message_number] = MidiUtil_getCurrentTimeNsecs() - (long long)(timestamp);
+			if ((message_size != get_ring_test_message(message_number, expected_message)) || (memcmp(message, expected_message, message_size) != 0)) number_of_errors++;
+			message_number++;
+		}
+		else
+		{
+			MidiUtilMessageRing_wait(ring_test.ring, -1);
+		}
+	}
+
+	seconds = (MidiUtil_getCurrentTimeNsecs() - start_time_nsecs) / 1e9;
+
+	MidiUtilLock_lock(ring_test.lock);
+	while (!(ring_test.producer_is_finished)) MidiUtilLock_wait(ring_test.lock, -1);
+	MidiUtilLock_unlock(ring_test.lock);
+
+	qsort(latency_array, number_of_messages, sizeof (long long), compare_lateness);
+	printf("ring mode=%s count=%ld rate=%.0f/s latency p50=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus errors=%ld\n", mode, number_of_messages, number_of_messages / seconds, latency_array[number_of_messages / 2] / 1000.0, latency_array[number_of_messages * 99 / 100] / 1000.0, latency_array[number_of_messages * 999 / 1000] / 1000.0, latency_array[number_of_messages - 1] / 1000.0, number_of_errors);
+
+	MidiUtilMessageRing_free(ring_test.ring);
+	MidiUtilLock_free(ring_test.lock);
+	free(latency_array);
+}
+
+static void test_ring(long number_of_messages)
+{
+	/* Flat out to measure throughput, then paced like a busy MIDI input to measure how quickly a sleeping consumer wakes up. */
+	test_ring_mode("throughput", number_of_messages, 0);
+	test_ring_mode("paced", (number_of_messages < 20000) ? number_of_messages : 20000, 100000);
+}
+
+int main(int argc, char **argv)
+{
+	char *test_name = NULL;
+	long number_of_alarms = 100000;
+	long number_of_keys = 20000;
+	long number_of_messages = 1000000;
+	long number_of_values = 1000000;
+	int number_of_buckets = 1024;
+	int number_of_threads = 1;
+	long spread_msecs = 2000;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--help") == 0)
+		{
+			usage(argv[0]);
+		}
+		else if ((strcmp(argv[i], "--alarms") == 0) || (strcmp(argv[i], "--maps") == 0) || (strcmp(argv[i], "--ring") == 0) || (strcmp(argv[i], "--arrays") == 0))
+		{
+			test_name = argv[i] + 2;
+		}
+		else if (strcmp(argv[i], "--count") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_alarms = number_of_keys = number_of_messages = number_of_values = atol(argv[i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_threads = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--buckets") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_buckets = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--spread") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			spread_msecs = atol(argv[i]);
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	if (test_name == NULL) usage(argv[0]);
+
+	if (strcmp(test_name, "alarms") == 0)
+	{
+		if ((number_of_alarms < 1) || (number_of_threads < 1) || (spread_msecs < 1)) usage(argv[0]);
+		test_alarms(number_of_alarms, number_of_threads, spread_msecs);
+	}
+	else if (strcmp(test_name, "maps") == 0)
+	{
+		if ((number_of_keys < 1) || (number_of_buckets < 1)) usage(argv[0]);
+		test_maps(number_of_keys, number_of_buckets);
+	}
+	else if (strcmp(test_name, "ring") == 0)
+	{
+		if (number_of_messages < 1) usage(argv[0]);
+		test_ring(number_of_messages);
+	}
+	else if (strcmp(test_name, "arrays") == 0)
+	{
+		if (number_of_values < 1) usage(argv[0]);
+		test_arrays(number_of_values);
+	}
+
+	return 0;
+}
+
@@ -135,7 +135,10 @@ void AllEventsLane::moveEventsByXY(int x_offset, int y_offset)
 	Q_UNUSED(y_offset)
 	if (x_offset == 0) return;
 
-	for (MidiFileEvent_t midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file))
+	struct MidiFileIterator iterator;
+	MidiFileIterator_init(&iterator, this->window->sequence->midi_file);
+
+	for (MidiFileEvent_t midi_event = MidiFileIterator_next(&iterator); midi_event != NULL; midi_event = MidiFileIterator_next(&iterator))
 	{
 		if (MidiFileEvent_isSelected(midi_event)) MidiFileEvent_setTick(midi_event, this->window->getTickFromX(this->window->getXFromTick(MidiFileEvent_getTick(midi_event)) + x_offset));
 	}
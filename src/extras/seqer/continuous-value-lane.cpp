@@ -26,9 +26,9 @@ void ContinuousValueLane::paintEvents(QPainter* painter, int selected_events_x_o
 	painter->setPen(this->connecting_line_pen);
 	QPoint last_point;
 
-	for (MidiFileEvent_t midi_event = MidiFile_getFirstEvent(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFileEvent_getNextEventInFile(midi_event))
+	for (MidiFileEvent_t midi_event = this->getFirstEvent(); midi_event != NULL; midi_event = this->getNextEvent(midi_event))
 	{
-		if (this->shouldIncludeEvent(midi_event) && (MidiFileEvent_getTrack(midi_event) == current_track))
+		if (MidiFileEvent_getTrack(midi_event) == current_track)
 		{
 			QPoint point = this->getRectFromEvent(midi_event, selected_events_x_offset, selected_events_y_offset).center();
 
@@ -47,20 +47,17 @@ void ContinuousValueLane::paintEvents(QPainter* painter, int selected_events_x_o
 		painter->drawLine(last_point.x(), last_point.y(), this->width(), last_point.y());
 	}
 
-	for (MidiFileEvent_t midi_event = MidiFile_getFirstEvent(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFileEvent_getNextEventInFile(midi_event))
+	for (MidiFileEvent_t midi_event = this->getFirstEvent(); midi_event != NULL; midi_event = this->getNextEvent(midi_event))
 	{
-		if (this->shouldIncludeEvent(midi_event))
-		{
-			QRect rect = this->getRectFromEvent(midi_event, selected_events_x_offset, selected_events_y_offset);
+		QRect rect = this->getRectFromEvent(midi_event, selected_events_x_offset, selected_events_y_offset);
 
-			if (rect.intersects(bounds))
-			{
-				bool is_background = (MidiFileEvent_getTrack(midi_event) != current_track);
-				bool is_selected = MidiFileEvent_isSelected(midi_event);
-				painter->setPen(is_background ? (is_selected ? this->selected_background_event_pen : this->unselected_background_event_pen) : (is_selected ? this->selected_event_pen : this->unselected_event_pen));
-				painter->setBrush(is_background ? (is_selected ? this->selected_background_event_brush : this->unselected_background_event_brush) : (is_selected ? this->selected_event_brush : this->unselected_event_brush));
-				painter->drawRect(rect);
-			}
+		if (rect.intersects(bounds))
+		{
+			bool is_background = (MidiFileEvent_getTrack(midi_event) != current_track);
+			bool is_selected = MidiFileEvent_isSelected(midi_event);
+			painter->setPen(is_background ? (is_selected ? this->selected_background_event_pen : this->unselected_background_event_pen) : (is_selected ? this->selected_event_pen : this->unselected_event_pen));
+			painter->setBrush(is_background ? (is_selected ? this->selected_background_event_brush : this->unselected_background_event_brush) : (is_selected ? this->selected_event_brush : this->unselected_event_brush));
+			painter->drawRect(rect);
 		}
 	}
 }
@@ -93,7 +90,10 @@ MidiFileEvent_t ContinuousValueLane::addEventAtXY(int x, int y)
 
 void ContinuousValueLane::moveEventsByXY(int x_offset, int y_offset)
 {
-	for (MidiFileEvent_t midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file))
+	struct MidiFileIterator iterator;
+	MidiFileIterator_init(&iterator, this->window->sequence->midi_file);
+
+	for (MidiFileEvent_t midi_event = MidiFileIterator_next(&iterator); midi_event != NULL; midi_event = MidiFileIterator_next(&iterator))
 	{
 		if (this->shouldIncludeEvent(midi_event) && MidiFileEvent_isSelected(midi_event))
 		{
@@ -107,13 +107,10 @@ void ContinuousValueLane::selectEventsInRect(int x, int y, int width, int height
 {
 	QRect bounds(x, y, width, height);
 
-	for (MidiFileEvent_t midi_event = MidiFile_getFirstEvent(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFileEvent_getNextEventInFile(midi_event))
+	for (MidiFileEvent_t midi_event = this->getFirstEvent(); midi_event != NULL; midi_event = this->getNextEvent(midi_event))
 	{
-		if (this->shouldIncludeEvent(midi_event))
-		{
-			QRect rect = this->getRectFromEvent(midi_event, 0, 0);
-			if (rect.intersects(bounds)) MidiFileEvent_setSelected(midi_event, 1);
-		}
+		QRect rect = this->getRectFromEvent(midi_event, 0, 0);
+		if (rect.intersects(bounds)) MidiFileEvent_setSelected(midi_event, 1);
 	}
 }
 
@@ -33,6 +33,8 @@ public:
 	int getYFromValue(float value);
 	float getValueFromY(int y);
 	virtual bool shouldIncludeEvent(MidiFileEvent_t midi_event) = 0;
+	virtual MidiFileEvent_t getFirstEvent() = 0;
+	virtual MidiFileEvent_t getNextEvent(MidiFileEvent_t midi_event) = 0;
 	virtual MidiFileEvent_t addEvent(long tick, float value) = 0;
 	virtual float getEventValue(MidiFileEvent_t midi_event) = 0;
 	virtual void setEventValue(MidiFileEvent_t midi_event, float value) = 0;
@@ -15,6 +15,16 @@ bool ControllerLane::shouldIncludeEvent(MidiFileEvent_t midi_event)
 	return (MidiFileEvent_getType(midi_event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE) && (MidiFileControlChangeEvent_getNumber(midi_event) == this->controller_number);
 }
 
+MidiFileEvent_t ControllerLane::getFirstEvent()
+{
+	return MidiFile_getFirstEventOfType(this->window->sequence->midi_file, MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE, -1, this->controller_number);
+}
+
+MidiFileEvent_t ControllerLane::getNextEvent(MidiFileEvent_t midi_event)
+{
+	return MidiFileEvent_getNextEventOfType(midi_event, -1, this->controller_number);
+}
+
 MidiFileEvent_t ControllerLane::addEvent(long tick, float value)
 {
 	return MidiFileTrack_createControlChangeEvent(MidiFile_getTrackByNumber(this->window->sequence->midi_file, this->track_number, 1), tick, this->channel, this->controller_number, (int)(value));
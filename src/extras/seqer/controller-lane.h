@@ -17,6 +17,8 @@ public:
 
 	ControllerLane(Window* window);
 	bool shouldIncludeEvent(MidiFileEvent_t midi_event);
+	MidiFileEvent_t getFirstEvent();
+	MidiFileEvent_t getNextEvent(MidiFileEvent_t midi_event);
 	MidiFileEvent_t addEvent(long tick, float value);
 	float getEventValue(MidiFileEvent_t midi_event);
 	void setEventValue(MidiFileEvent_t midi_event, float value);
@@ -14,9 +14,9 @@ void MarkerLane::populateLabels()
 {
 	this->labels.clear();
 
-	for (MidiFileEvent_t midi_event = MidiFile_getFirstEvent(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFileEvent_getNextEventInFile(midi_event))
+	for (MidiFileEvent_t midi_event = MidiFile_getFirstEventOfType(this->window->sequence->midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x06); midi_event != NULL; midi_event = MidiFileEvent_getNextEventOfType(midi_event, -1, 0x06))
 	{
-		if (MidiFileEvent_isMarkerEvent(midi_event)) this->labels.append(Label(midi_event, MidiFileMarkerEvent_getText(midi_event)));
+		this->labels.append(Label(midi_event, MidiFileMarkerEvent_getText(midi_event)));
 	}
 }
 
@@ -31,7 +31,10 @@ void MarkerLane::moveEventsByXY(int x_offset, int y_offset)
 	Q_UNUSED(y_offset)
 	if (x_offset == 0) return;
 
-	for (MidiFileEvent_t midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file))
+	struct MidiFileIterator iterator;
+	MidiFileIterator_init(&iterator, this->window->sequence->midi_file);
+
+	for (MidiFileEvent_t midi_event = MidiFileIterator_next(&iterator); midi_event != NULL; midi_event = MidiFileIterator_next(&iterator))
 	{
 		if (MidiFileEvent_isMarkerEvent(midi_event) && MidiFileEvent_isSelected(midi_event)) MidiFileEvent_setTick(midi_event, this->window->getTickFromX(this->window->getXFromTick(MidiFileEvent_getTick(midi_event)) + x_offset));
 	}
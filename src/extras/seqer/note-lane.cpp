@@ -34,20 +34,20 @@ void NoteLane::paintEvents(QPainter* painter, int selected_events_x_offset, int
 	QRect bounds(0, 0, this->width(), this->height());
 	MidiFileTrack_t current_track = MidiFile_getTrackByNumber(this->window->sequence->midi_file, this->track_number, 0);
 
-	for (MidiFileEvent_t midi_event = MidiFile_getFirstEvent(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFileEvent_getNextEventInFile(midi_event))
+	// notes that start before the left edge can still reach into view, so only the right edge ends the search
+	long end_tick = this->window->getTickFromX(this->width() + qAbs(selected_events_x_offset)) + 1;
+
+	for (MidiFileEvent_t midi_event = MidiFile_getFirstEventOfType(this->window->sequence->midi_file, MIDI_FILE_EVENT_TYPE_NOTE, -1, -1); (midi_event != NULL) && (MidiFileEvent_getTick(midi_event) < end_tick); midi_event = MidiFileEvent_getNextEventOfType(midi_event, -1, -1))
 	{
-		if (MidiFileEvent_getType(midi_event) == MIDI_FILE_EVENT_TYPE_NOTE)
-		{
-			QRect rect = this->getRectFromEvent(midi_event, selected_events_x_offset, selected_events_y_offset);
+		QRect rect = this->getRectFromEvent(midi_event, selected_events_x_offset, selected_events_y_offset);
 
-			if (rect.intersects(bounds))
-			{
-				bool is_background = (MidiFileEvent_getTrack(midi_event) != current_track);
-				bool is_selected = MidiFileEvent_isSelected(midi_event);
-				painter->setPen(is_background ? (is_selected ? this->selected_background_event_pen : this->unselected_background_event_pen) : (is_selected ? this->selected_event_pen : this->unselected_event_pen));
-				painter->setBrush(is_background ? (is_selected ? this->selected_background_event_brush : this->unselected_background_event_brush) : (is_selected ? this->selected_event_brush : this->unselected_event_brush));
-				painter->drawRect(rect);
-			}
+		if (rect.intersects(bounds))
+		{
+			bool is_background = (MidiFileEvent_getTrack(midi_event) != current_track);
+			bool is_selected = MidiFileEvent_isSelected(midi_event);
+			painter->setPen(is_background ? (is_selected ? this->selected_background_event_pen : this->unselected_background_event_pen) : (is_selected ? this->selected_event_pen : this->unselected_event_pen));
+			painter->setBrush(is_background ? (is_selected ? this->selected_background_event_brush : this->unselected_background_event_brush) : (is_selected ? this->selected_event_brush : this->unselected_event_brush));
+			painter->drawRect(rect);
 		}
 	}
 }
@@ -82,7 +82,10 @@ MidiFileEvent_t NoteLane::addEventAtXY(int x, int y)
 
 void NoteLane::moveEventsByXY(int x_offset, int y_offset)
 {
-	for (MidiFileEvent_t midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file))
+	struct MidiFileIterator iterator;
+	MidiFileIterator_init(&iterator, this->window->sequence->midi_file);
+
+	for (MidiFileEvent_t midi_event = MidiFileIterator_next(&iterator); midi_event != NULL; midi_event = MidiFileIterator_next(&iterator))
 	{
 		if ((MidiFileEvent_getType(midi_event) == MIDI_FILE_EVENT_TYPE_NOTE) && MidiFileEvent_isSelected(midi_event))
 		{
@@ -112,13 +115,10 @@ void NoteLane::selectEventsInRect(int x, int y, int width, int height)
 {
 	QRect bounds(x, y, width, height);
 
-	for (MidiFileEvent_t midi_event = MidiFile_getFirstEvent(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFileEvent_getNextEventInFile(midi_event))
+	for (MidiFileEvent_t midi_event = MidiFile_getFirstEventOfType(this->window->sequence->midi_file, MIDI_FILE_EVENT_TYPE_NOTE, -1, -1); midi_event != NULL; midi_event = MidiFileEvent_getNextEventOfType(midi_event, -1, -1))
 	{
-		if (MidiFileEvent_getType(midi_event) == MIDI_FILE_EVENT_TYPE_NOTE)
-		{
-			QRect rect = this->getRectFromEvent(midi_event, 0, 0);
-			if (rect.intersects(bounds)) MidiFileEvent_setSelected(midi_event, 1);
-		}
+		QRect rect = this->getRectFromEvent(midi_event, 0, 0);
+		if (rect.intersects(bounds)) MidiFileEvent_setSelected(midi_event, 1);
 	}
 }
 
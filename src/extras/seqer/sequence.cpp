@@ -78,7 +78,7 @@ MidiFile_t Sequence::loadMidiFile(QString filename)
 
 MidiFile_t Sequence::loadMidiFileFromBuffer(QByteArray buffer)
 {
-	MidiFile_t midi_file = MidiFile_loadFromBuffer((unsigned char *)(buffer.data()));
+	MidiFile_t midi_file = MidiFile_loadFromBuffer((unsigned char *)(buffer.data()), buffer.size());
 	if (midi_file != NULL) Sequence::deserializeMidiFile(midi_file);
 	return midi_file;
 }
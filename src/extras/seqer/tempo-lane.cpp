@@ -16,6 +16,16 @@ bool TempoLane::shouldIncludeEvent(MidiFileEvent_t midi_event)
 	return MidiFileEvent_isTempoEvent(midi_event);
 }
 
+MidiFileEvent_t TempoLane::getFirstEvent()
+{
+	return MidiFile_getFirstEventOfType(this->window->sequence->midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x51);
+}
+
+MidiFileEvent_t TempoLane::getNextEvent(MidiFileEvent_t midi_event)
+{
+	return MidiFileEvent_getNextEventOfType(midi_event, -1, 0x51);
+}
+
 MidiFileEvent_t TempoLane::addEvent(long tick, float value)
 {
 	return MidiFileTrack_createTempoEvent(MidiFile_getTrackByNumber(this->window->sequence->midi_file, this->track_number, 1), tick, value);
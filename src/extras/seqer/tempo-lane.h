@@ -15,6 +15,8 @@ class TempoLane: public ContinuousValueLane
 public:
 	TempoLane(Window* window);
 	bool shouldIncludeEvent(MidiFileEvent_t midi_event);
+	MidiFileEvent_t getFirstEvent();
+	MidiFileEvent_t getNextEvent(MidiFileEvent_t midi_event);
 	MidiFileEvent_t addEvent(long tick, float value);
 	float getEventValue(MidiFileEvent_t midi_event);
 	void setEventValue(MidiFileEvent_t midi_event, float value);
@@ -1,16 +1,20 @@
-
 #include <QtWidgets>
+#include "midifile.h"
 #include "sequence.h"
 #include "undo-stack.h"
 
+// Each command owns the snapshot taken after it, and borrows the one before it from the command below, or from the stack for the first command.  Snapshots share whatever did not change in between, so this costs little more than the edits themselves.
+
 UndoStack::UndoStack(Sequence* sequence): QUndoStack()
 {
 	this->sequence = sequence;
-	this->current_snapshot = Sequence::saveMidiFileToBuffer(sequence->midi_file);
+	this->initial_snapshot = MidiFile_snapshot(sequence->midi_file);
+	this->current_snapshot = this->initial_snapshot;
 }
 
 UndoStack::~UndoStack()
 {
+	MidiFileSnapshot_free(this->initial_snapshot);
 }
 
 void UndoStack::createUndoCommand()
@@ -22,15 +26,20 @@ UndoCommand::UndoCommand(UndoStack* undo_stack)
 {
 	this->undo_stack = undo_stack;
 	this->undo_snapshot = this->undo_stack->current_snapshot;
-	this->redo_snapshot = Sequence::saveMidiFileToBuffer(this->undo_stack->sequence->midi_file);
+	this->redo_snapshot = MidiFile_snapshot(this->undo_stack->sequence->midi_file);
 	this->undo_stack->current_snapshot = this->redo_snapshot;
 }
 
+UndoCommand::~UndoCommand()
+{
+	MidiFileSnapshot_free(this->redo_snapshot);
+}
+
 void UndoCommand::undo()
 {
 	if (this->undo_stack->current_snapshot != this->undo_snapshot)
 	{
-		this->undo_stack->sequence->midi_file = Sequence::loadMidiFileFromBuffer(this->undo_snapshot);
+		MidiFile_restore(this->undo_stack->sequence->midi_file, this->undo_snapshot);
 		this->undo_stack->current_snapshot = this->undo_snapshot;
 		this->undo_stack->sequence->update(false);
 	}
@@ -42,9 +51,8 @@ void UndoCommand::redo()
 
 	if (this->undo_stack->current_snapshot != this->redo_snapshot)
 	{
-		this->undo_stack->sequence->midi_file = Sequence::loadMidiFileFromBuffer(this->redo_snapshot);
+		MidiFile_restore(this->undo_stack->sequence->midi_file, this->redo_snapshot);
 		this->undo_stack->current_snapshot = this->redo_snapshot;
 		this->undo_stack->sequence->update(false);
 	}
 }
-
@@ -5,6 +5,7 @@ class UndoStack;
 class UndoCommand;
 
 #include <QtWidgets>
+#include "midifile.h"
 #include "sequence.h"
 
 class UndoStack: public QUndoStack
@@ -13,7 +14,8 @@ class UndoStack: public QUndoStack
 
 public:
 	Sequence* sequence;
-	QByteArray current_snapshot;
+	MidiFileSnapshot_t initial_snapshot;
+	MidiFileSnapshot_t current_snapshot;
 
 	UndoStack(Sequence* sequence);
 	~UndoStack();
@@ -24,10 +26,11 @@ class UndoCommand: public QUndoCommand
 {
 public:
 	UndoStack* undo_stack;
-	QByteArray undo_snapshot;
-	QByteArray redo_snapshot;
+	MidiFileSnapshot_t undo_snapshot;
+	MidiFileSnapshot_t redo_snapshot;
 
 	UndoCommand(UndoStack* undo_stack);
+	~UndoCommand();
 	void undo();
 	void redo();
 };
@@ -21,7 +21,12 @@ void VelocityLane::paintEvents(QPainter* painter, int selected_events_x_offset,
 	QRect bounds(0, 0, this->width(), this->height());
 	MidiFileTrack_t current_track = MidiFile_getTrackByNumber(this->window->sequence->midi_file, this->track_number, 0);
 
-	for (MidiFileEvent_t midi_event = MidiFile_getFirstEvent(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFileEvent_getNextEventInFile(midi_event))
+	// only the visible part of the sequence, widened by how far the selection is being dragged
+	int margin = qAbs(selected_events_x_offset) + this->box_width;
+	struct MidiFileIterator iterator;
+	MidiFile_getEventsInRange(this->window->sequence->midi_file, qMax(this->window->getTickFromX(-margin), 0L), this->window->getTickFromX(this->width() + margin) + 1, &iterator);
+
+	for (MidiFileEvent_t midi_event = MidiFileIterator_next(&iterator); midi_event != NULL; midi_event = MidiFileIterator_next(&iterator))
 	{
 		if (MidiFileEvent_getType(midi_event) == MIDI_FILE_EVENT_TYPE_NOTE)
 		{
@@ -70,7 +75,10 @@ MidiFileEvent_t VelocityLane::addEventAtXY(int x, int y)
 
 void VelocityLane::moveEventsByXY(int x_offset, int y_offset)
 {
-	for (MidiFileEvent_t midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFile_iterateEvents(this->window->sequence->midi_file))
+	struct MidiFileIterator iterator;
+	MidiFileIterator_init(&iterator, this->window->sequence->midi_file);
+
+	for (MidiFileEvent_t midi_event = MidiFileIterator_next(&iterator); midi_event != NULL; midi_event = MidiFileIterator_next(&iterator))
 	{
 		if ((MidiFileEvent_getType(midi_event) == MIDI_FILE_EVENT_TYPE_NOTE) && MidiFileEvent_isSelected(midi_event))
 		{
@@ -84,13 +92,10 @@ void VelocityLane::selectEventsInRect(int x, int y, int width, int height)
 {
 	QRect bounds(x, y, width, height);
 
-	for (MidiFileEvent_t midi_event = MidiFile_getFirstEvent(this->window->sequence->midi_file); midi_event != NULL; midi_event = MidiFileEvent_getNextEventInFile(midi_event))
+	for (MidiFileEvent_t midi_event = MidiFile_getFirstEventOfType(this->window->sequence->midi_file, MIDI_FILE_EVENT_TYPE_NOTE, -1, -1); midi_event != NULL; midi_event = MidiFileEvent_getNextEventOfType(midi_event, -1, -1))
 	{
-		if (MidiFileEvent_getType(midi_event) == MIDI_FILE_EVENT_TYPE_NOTE)
-		{
-			QRect rect = this->getRectFromEvent(midi_event, 0, 0);
-			if (rect.intersects(bounds)) MidiFileEvent_setSelected(midi_event, 1);
-		}
+		QRect rect = this->getRectFromEvent(midi_event, 0, 0);
+		if (rect.intersects(bounds)) MidiFileEvent_setSelected(midi_event, 1);
 	}
 }
 
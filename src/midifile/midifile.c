@@ -1,13 +1,103 @@
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#endif
+
+#include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <midifile.h>
 
 /*
  * Data Types
  */
 
+#define MIDI_FILE_ARENA_NUMBER_OF_EVENTS_PER_SLAB 512
+#define MIDI_FILE_ARENA_CHUNK_SIZE 65536
+#define MIDI_FILE_ARENA_BLOCK_SIZE_STEP 8
+#define MIDI_FILE_ARENA_NUMBER_OF_BLOCK_SIZES 32
+
+typedef struct MidiFileArena *MidiFileArena_t;
+
+/*
+ * Each file allocates its events, tracks, event data and tick index nodes from
+ * an arena of its own, so that loading does not need a malloc() per event, and
+ * freeing the file releases a few slabs rather than every event in turn.
+ * Events are handed out from slabs and recycled through a free list.  Other
+ * blocks of up to MIDI_FILE_ARENA_NUMBER_OF_BLOCK_SIZES * MIDI_FILE_ARENA_BLOCK_SIZE_STEP
+ * bytes are carved out of larger chunks and recycled through one free list per
+ * size, while bigger ones are malloc'ed individually.  Since events can be
+ * detached or moved to another file and outlive the file they were created in,
+ * the arena counts the events still in use and is only released once its file
+ * and all of those events are gone.  For a file loaded with
+ * MidiFile_loadMapped(), the arena also owns the mapping that sysex and meta
+ * data point into, for the same reason.
+ */
+
+struct MidiFileArenaBlock
+{
+	struct MidiFileArenaBlock *previous_block;
+	struct MidiFileArenaBlock *next_block;
+};
+
+struct MidiFileArena
+{
+	int number_of_live_events;
+	int is_orphaned;
+	struct MidiFileArenaBlock *first_slab;
+	struct MidiFileEvent *next_event_in_slab;
+	int number_of_events_left_in_slab;
+	struct MidiFileEvent *first_free_event;
+	struct MidiFileArenaBlock *first_chunk;
+	unsigned char *next_byte_in_chunk;
+	long number_of_bytes_left_in_chunk;
+	void *first_free_blocks[MIDI_FILE_ARENA_NUMBER_OF_BLOCK_SIZES];
+	struct MidiFileArenaBlock *first_large_block;
+	unsigned char *mapping;
+	long mapping_length;
+};
+
+#define MIDI_FILE_TICK_INDEX_MAX_LEVELS 16
+
+typedef struct MidiFileTickIndexNode *MidiFileTickIndexNode_t;
+typedef struct MidiFileTickIndex *MidiFileTickIndex_t;
+
+/*
+ * A skip list with one node per distinct tick in an event list, pointing at
+ * the first and last event with that tick.  It lets sorted insertion find its
+ * place in logarithmic time instead of walking the list.
+ */
+
+struct MidiFileTickIndexNode
+{
+	long tick;
+	struct MidiFileEvent *first_event;
+	struct MidiFileEvent *last_event;
+	int number_of_levels;
+	struct MidiFileTickIndexNode *next_nodes[1]; /* actually number_of_levels long */
+};
+
+struct MidiFileTickIndex
+{
+	MidiFileArena_t arena;
+	int number_of_levels;
+	unsigned long random_state;
+	struct MidiFileTickIndexNode *head_nodes[MIDI_FILE_TICK_INDEX_MAX_LEVELS];
+	struct MidiFileTickIndexNode *tail_nodes[MIDI_FILE_TICK_INDEX_MAX_LEVELS];
+};
+
 struct MidiFile
 {
 	int file_format;
@@ -19,12 +109,25 @@ struct MidiFile
 	struct MidiFileTrack *last_track;
 	struct MidiFileEvent *first_event;
 	struct MidiFileEvent *last_event;
+	struct MidiFileTickIndex tick_index;
 	struct MidiFileMeasureBeat *measure_beat;
 	struct MidiFileMeasureBeatTick *measure_beat_tick;
 	struct MidiFileHourMinuteSecond *hour_minute_second;
 	struct MidiFileHourMinuteSecondFrame *hour_minute_second_frame;
-	struct MidiFileEvent *event_iterator_current;
-	struct MidiFileEvent *event_iterator_next;
+	struct MidiFileIterator event_iterator; /* for MidiFile_iterateEvents() */
+	int event_iterator_is_running;
+	unsigned int iteration_epoch;
+	int is_loading;
+	struct MidiFileArena *arena;
+	long number_of_events;
+	long number_of_foreign_events;
+	struct MidiFileTempoMapEntry *tempo_map;
+	int number_of_tempo_map_entries;
+	int tempo_map_is_valid;
+	struct MidiFileMeterMapEntry *meter_map;
+	int number_of_meter_map_entries;
+	int meter_map_is_valid;
+	struct MidiFileTypeIndex *type_index; /* NULL until first used */
 };
 
 struct MidiFileTrack
@@ -36,72 +139,186 @@ struct MidiFileTrack
 	struct MidiFileTrack *next_track;
 	struct MidiFileEvent *first_event;
 	struct MidiFileEvent *last_event;
-	struct MidiFileEvent *event_iterator_current;
-	struct MidiFileEvent *event_iterator_next;
+	struct MidiFileTickIndex tick_index;
+	struct MidiFileIterator event_iterator; /* for MidiFileTrack_iterateEvents() */
+	int event_iterator_is_running;
+	struct MidiFileEvent **last_events_with_same_note; /* the note pairing index, NULL until built */
+	struct MidiFileSnapshotTrack *snapshot_track; /* the last snapshot taken of or restored into this track, NULL if none */
+	long changed_start_tick; /* the range of ticks changed since then, empty when start > end */
+	long changed_end_tick;
+};
+
+/*
+ * The tempo map has one entry for the start of the file plus one for each
+ * tempo event in the conductor track, with the time and beat at which it
+ * takes effect.  It is built on first use and thrown away whenever a meta
+ * event in the conductor track changes, so that conversions between ticks,
+ * beats and seconds can binary search it instead of walking the track.
+ */
+
+struct MidiFileTempoMapEntry
+{
+	long tick;
+	double time;
+	double beat;
+	double tempo;
+	struct MidiFileEvent *event;
+};
+
+/*
+ * The meter map is the time signature counterpart of the tempo map.  It has
+ * one entry for the start of the file plus one for each time signature event
+ * in the conductor track, with the cumulative measure at which it takes
+ * effect and where that falls in visible measure/beat/tick terms.  It is
+ * invalidated along with the tempo map, since beats depend on tempo in SMPTE
+ * files.
+ */
+
+struct MidiFileMeterMapEntry
+{
+	long tick;
+	double beat;
+	double measure;
+	long visible_measure;
+	double visible_beat;
+	long visible_whole_beat;
+	long visible_tick;
+	int numerator;
+	int denominator;
+	struct MidiFileEvent *event;
+};
+
+/*
+ * The note pairing index threads the note on and note off events in a track
+ * into one list per channel and note, so that finding the end of a note (the
+ * next note end event with the same channel and note) or its start (the
+ * previous note start event) only looks at events for that note.  It is built
+ * for a track on the first such lookup, kept up to date as events are added
+ * and removed, and dropped when a note event changes channel or note or turns
+ * from a start into an end or vice versa.
+ */
+
+struct MidiFileNotePairingLinks
+{
+	struct MidiFileEvent *previous_event_with_same_note;
+	struct MidiFileEvent *next_event_with_same_note;
+};
+
+/*
+ * The type index threads events into lists of the same type, and of the same
+ * type and "subtype" (the channel for events which have one, or the number
+ * for meta events), in file order, so that filtered traversals like "every
+ * tempo event" or "every control change on channel 3" only look at matching
+ * events.  Each list is built on its first use and kept up to date from then
+ * on; an event gets an entry holding its links once it is in any built list.
+ */
+
+#define MIDI_FILE_TYPE_INDEX_NUMBER_OF_TYPES 13
+
+typedef struct MidiFileTypeIndex *MidiFileTypeIndex_t;
+
+struct MidiFileTypeIndexList
+{
+	struct MidiFileEvent *first_event;
+	struct MidiFileEvent *last_event;
+	int is_built;
+};
+
+struct MidiFileTypeIndex
+{
+	struct MidiFileTypeIndexList type_lists[MIDI_FILE_TYPE_INDEX_NUMBER_OF_TYPES];
+	struct MidiFileTypeIndexList channel_lists[MIDI_FILE_TYPE_INDEX_NUMBER_OF_TYPES][16];
+	struct MidiFileTypeIndexList meta_lists[256];
+};
+
+struct MidiFileTypeIndexLinks
+{
+	struct MidiFileEvent *previous_event;
+	struct MidiFileEvent *next_event;
+};
+
+struct MidiFileTypeIndexEntry
+{
+	struct MidiFileTypeIndexLinks same_type;
+	struct MidiFileTypeIndexLinks same_subtype;
 };
 
+/*
+ * Events are laid out to be small, with the fields that list traversal
+ * touches (the links, tick, type and flags) together at the front, and
+ * channels, notes and other MIDI values in the narrowest types that hold the
+ * values they can take.  RPN and NRPN values can go slightly out of range
+ * through data decrements, hence the signed shorts.
+ */
+
 struct MidiFileEvent
 {
-	struct MidiFileTrack *track;
-	struct MidiFileEvent *previous_event_in_track;
-	struct MidiFileEvent *next_event_in_track;
 	struct MidiFileEvent *previous_event_in_file;
 	struct MidiFileEvent *next_event_in_file;
+	struct MidiFileEvent *previous_event_in_track;
+	struct MidiFileEvent *next_event_in_track;
 	long tick;
-	MidiFileEventType_t type;
+	signed char type; /* a MidiFileEventType_t */
+	unsigned int is_selected : 1;
+	unsigned int visited_epoch; /* see MidiFileIterator_next() */
+	struct MidiFileTrack *track;
+	struct MidiFileArena *arena;
+	struct MidiFileTypeIndexEntry *type_index_entry; /* NULL unless the event is in a built type index list */
 
 	union
 	{
 		struct
 		{
-			int channel;
-			int note;
-			int velocity;
+			unsigned char channel;
+			unsigned char note;
+			unsigned char velocity;
+			struct MidiFileNotePairingLinks pairing_links;
 		}
 		note_off;
 
 		struct
 		{
-			int channel;
-			int note;
-			int velocity;
+			unsigned char channel;
+			unsigned char note;
+			unsigned char velocity;
+			struct MidiFileNotePairingLinks pairing_links;
 		}
 		note_on;
 
 		struct
 		{
-			int channel;
-			int note;
-			int amount;
+			unsigned char channel;
+			unsigned char note;
+			unsigned char amount;
 		}
 		key_pressure;
 
 		struct
 		{
-			int channel;
-			int number;
-			int value;
+			unsigned char channel;
+			unsigned char number;
+			unsigned char value;
 		}
 		control_change;
 
 		struct
 		{
-			int channel;
-			int number;
+			unsigned char channel;
+			unsigned char number;
 		}
 		program_change;
 
 		struct
 		{
-			int channel;
-			int amount;
+			unsigned char channel;
+			unsigned char amount;
 		}
 		channel_pressure;
 
 		struct
 		{
-			int channel;
-			int value;
+			unsigned char channel;
+			short value;
 		}
 		pitch_wheel;
 
@@ -114,7 +331,7 @@ struct MidiFileEvent
 
 		struct
 		{
-			int number;
+			unsigned char number;
 			int data_length;
 			unsigned char *data_buffer;
 		}
@@ -123,41 +340,38 @@ struct MidiFileEvent
 		struct
 		{
 			long duration_ticks;
-			int channel;
-			int note;
-			int velocity;
-			int end_velocity;
+			unsigned char channel;
+			unsigned char note;
+			unsigned char velocity;
+			unsigned char end_velocity;
 		}
 		note;
 
 		struct
 		{
-			int channel;
-			int coarse_number;
-			int value;
+			unsigned char channel;
+			unsigned char coarse_number;
+			short value;
 		}
 		fine_control_change;
 
 		struct
 		{
-			int channel;
-			int number;
-			int value;
+			unsigned char channel;
+			short number;
+			short value;
 		}
 		rpn;
 
 		struct
 		{
-			int channel;
-			int number;
-			int value;
+			unsigned char channel;
+			short number;
+			short value;
 		}
 		nrpn;
 	}
 	u;
-
-	int should_be_visited;
-	int is_selected;
 };
 
 struct MidiFileMeasureBeat
@@ -192,215 +406,253 @@ struct MidiFileHourMinuteSecondFrame
 	char string[32];
 };
 
-typedef struct MidiFileIO *MidiFileIO_t;
+#define MIDI_FILE_OUTPUT_BUFFER_SIZE 65536
+
+typedef struct MidiFileOutput *MidiFileOutput_t;
+
+/*
+ * Saving encodes straight into a buffer.  When writing to a file or a
+ * callback, it is a staging buffer which is handed over in one go whenever it
+ * fills up, and once more at the end; when writing to memory, it is the
+ * caller's buffer, which is already the right size.  Track lengths are worked
+ * out beforehand, so the output never needs to seek, and can be a pipe.
+ */
 
-typedef enum 
+struct MidiFileOutput
 {
-	MIDI_FILE_IO_TYPE_INVALID = -1,
-	MIDI_FILE_IO_TYPE_FILE,
-	MIDI_FILE_IO_TYPE_BUFFER
-}
-MidiFileIOType_t;
+	MidiFileWriteCallback_t callback;
+	void *user_data;
+	unsigned char *buffer;
+	long buffer_size;
+	long offset;
+	int failed;
+};
+
+typedef struct MidiFileReaderTrack *MidiFileReaderTrack_t;
 
-struct MidiFileIO
+/*
+ * The reader decodes events one at a time straight out of the file's bytes,
+ * keeping only a cursor per track.  In merged mode, each track also holds its
+ * next event, already decoded, in a binary heap ordered the same way as the
+ * event list of a loaded file.  The loader uses the same per-track cursor.
+ */
+
+struct MidiFileReaderTrack
 {
-	MidiFileIOType_t type;
+	int number;
+	unsigned char *position;
+	unsigned char *end;
+	long tick;
+	unsigned char running_status;
+	struct MidiFileReaderEvent next_event;
+};
 
-	union
-	{
-		struct
-		{
-			FILE *file;
-		}
-		file;
+struct MidiFileReader
+{
+	MidiFileReaderMode_t mode;
+	unsigned char *buffer;
+	long buffer_length;
+	int buffer_is_mapped;
+	int buffer_is_owned;
+	int file_format;
+	MidiFileDivisionType_t division_type;
+	int resolution;
+	int number_of_tracks;
+	struct MidiFileReaderTrack *tracks;
+	int current_track_number;
+	struct MidiFileReaderTrack **heap;
+	int heap_size;
+};
 
-		struct
-		{
-			long offset;
-			unsigned char *buffer;
-		}
-		buffer;
-	}
-	u;
+/*
+ * The writer appends each event to the last track chunk as it arrives,
+ * staging it in the same kind of buffer that saving uses.  A checkpoint
+ * flushes, writes an end of track event, and patches the chunk length and the
+ * header's track count, all without rewriting anything already written.  It
+ * then leaves the file position at the end of track event, so the next
+ * event overwrites it.  Until then, a crash leaves a truncated or stale tail
+ * for MidiFileWriter_recover() to make whole again.
+ */
+
+struct MidiFileWriter
+{
+	FILE *out;
+	struct MidiFileOutput output;
+	long number_of_bytes_flushed;
+	int file_format;
+	MidiFileDivisionType_t division_type;
+	int resolution;
+	int number_of_tracks;
+	long track_start; /* where the open track's data starts in the file, or -1 if no track is open */
+	long previous_tick;
 };
 
+typedef struct MidiFileParallelLoad *MidiFileParallelLoad_t;
+typedef struct MidiFileParallelLoadWorker *MidiFileParallelLoadWorker_t;
+
 /*
- * Helpers
+ * A parallel load first finds all the track chunks, which only takes their
+ * lengths, and creates the tracks up front.  Workers then take tracks one at a
+ * time until there are none left, and decode each into the worker's own
+ * arena, since arenas are not thread safe.  The calling thread is the first
+ * worker and uses the file's arena.  Once all are done, the other arenas are
+ * spliced into the file's, and the tracks are merged into the file list the
+ * same way as in an ordinary load.
  */
 
-static MidiFileIO_t MidiFileIO_newFromFile(FILE *file)
+struct MidiFileParallelLoadTrack
 {
-	MidiFileIO_t io = (MidiFileIO_t)(malloc(sizeof(struct MidiFileIO)));
-	io->type = MIDI_FILE_IO_TYPE_FILE;
-	io->u.file.file = file;
-	return io;
-}
+	struct MidiFileTrack *track;
+	unsigned char *start;
+	unsigned char *end;
+};
 
-static MidiFileIO_t MidiFileIO_newFromBuffer(unsigned char *buffer)
+struct MidiFileParallelLoad
 {
-	MidiFileIO_t io = (MidiFileIO_t)(malloc(sizeof(struct MidiFileIO)));
-	io->type = MIDI_FILE_IO_TYPE_BUFFER;
-	io->u.buffer.offset = 0;
-	io->u.buffer.buffer = buffer;
-	return io;
-}
+	struct MidiFileParallelLoadTrack *tracks;
+	int number_of_tracks;
+	int next_track_number;
+#ifdef _WIN32
+	CRITICAL_SECTION critical_section;
+#else
+	pthread_mutex_t mutex;
+#endif
+};
+
+struct MidiFileParallelLoadWorker
+{
+	MidiFileParallelLoad_t load;
+	MidiFileArena_t arena;
+	MidiFileArena_t file_arena;
+	int is_running;
+#ifdef _WIN32
+	HANDLE thread;
+#else
+	pthread_t thread;
+#endif
+};
+
+/*
+ * A snapshot holds each track as a list of immutable chunks of compactly
+ * encoded events, which never split the events at one tick, so the chunks of
+ * a track cover disjoint ranges of ticks.  Each track remembers the last
+ * snapshot taken of or restored into it and the range of ticks changed since,
+ * so taking the next snapshot shares every chunk outside that range instead
+ * of encoding it again, and restoring one only replaces the events between
+ * the chunks the two have in common.  Chunks and tracks are shared by
+ * reference count, kept atomically, so a snapshot can be read or freed on
+ * another thread while the file it came from keeps changing.
+ */
 
-static void MidiFileIO_free(MidiFileIO_t io)
+#define MIDI_FILE_SNAPSHOT_CHUNK_SIZE 256
+
+struct MidiFileSnapshotChunk
 {
-	free(io);
-}
+	long reference_count;
+	long first_tick;
+	long last_tick;
+	long number_of_events;
+	long data_length;
+	unsigned char data[1]; /* actually data_length long */
+};
 
-static int MidiFileIO_getc(MidiFileIO_t io)
+struct MidiFileSnapshotTrack
 {
-	switch (io->type)
-	{
-		case MIDI_FILE_IO_TYPE_FILE:
-		{
-			return fgetc(io->u.file.file);
-		}
-		case MIDI_FILE_IO_TYPE_BUFFER:
-		{
-			long offset = io->u.buffer.offset++;
+	long reference_count;
+	long end_tick;
+	int number_of_chunks;
+	struct MidiFileSnapshotChunk **chunks;
+};
 
-			if (io->u.buffer.buffer == NULL)
-			{
-				return 0;
-			}
-			else
-			{
-				return io->u.buffer.buffer[offset];
-			}
-		}
-		default:
-		{
-			return -1;
-		}
-	}
-}
+struct MidiFileSnapshot
+{
+	int file_format;
+	MidiFileDivisionType_t division_type;
+	int resolution;
+	float number_of_frames_per_second;
+	int number_of_tracks;
+	struct MidiFileSnapshotTrack **tracks;
+};
 
-static int MidiFileIO_putc(MidiFileIO_t io, int c)
+struct MidiFileSnapshotBuffer
 {
-	switch (io->type)
-	{
-		case MIDI_FILE_IO_TYPE_FILE:
-		{
-			return fputc(c, io->u.file.file);
-		}
-		case MIDI_FILE_IO_TYPE_BUFFER:
-		{
-			long offset = io->u.buffer.offset++;
-			if (io->u.buffer.buffer != NULL) io->u.buffer.buffer[offset] = (unsigned char)(c);
-			return 0;
-		}
-		default:
-		{
-			return -1;
-		}
-	}
+	unsigned char *bytes;
+	long length;
+	long size;
+};
+
+/*
+ * A patch is kept the way it is saved: a header with the old and new file
+ * settings, then for each track that differs its old and new end ticks and
+ * its hunks, each of which replaces a run of events at one tick with
+ * another, the events being encoded as in snapshots.
+ */
+
+struct MidiFilePatch
+{
+	unsigned char *data;
+	long data_length;
+};
+
+/*
+ * Helpers
+ */
+
+static void MidiFileOutput_initForCallback(MidiFileOutput_t output, unsigned char *buffer, MidiFileWriteCallback_t callback, void *user_data)
+{
+	output->callback = callback;
+	output->user_data = user_data;
+	output->buffer = buffer;
+	output->buffer_size = MIDI_FILE_OUTPUT_BUFFER_SIZE;
+	output->offset = 0;
+	output->failed = 0;
 }
 
-static size_t MidiFileIO_read(MidiFileIO_t io, size_t length, unsigned char *buffer)
+static void MidiFileOutput_initForBuffer(MidiFileOutput_t output, unsigned char *buffer, long buffer_size)
 {
-	switch (io->type)
-	{
-		case MIDI_FILE_IO_TYPE_FILE:
-		{
-			return fread(buffer, 1, length, io->u.file.file);
-		}
-		case MIDI_FILE_IO_TYPE_BUFFER:
-		{
-			if (io->u.buffer.buffer == NULL)
-			{
-				memset(buffer, 0, length);
-			}
-			else
-			{
-				memcpy(buffer, io->u.buffer.buffer + io->u.buffer.offset, length);
-			}
+	output->callback = NULL;
+	output->user_data = NULL;
+	output->buffer = buffer;
+	output->buffer_size = buffer_size;
+	output->offset = 0;
+	output->failed = 0;
+}
 
-			io->u.buffer.offset += length;
-			return length;
-		}
-		default:
-		{
-			return 0;
-		}
-	}
+static void MidiFileOutput_flush(MidiFileOutput_t output)
+{
+	if ((output->callback == NULL) || (output->offset == 0)) return;
+	if ((!output->failed) && ((*(output->callback))(output->buffer, (int)(output->offset), output->user_data) != 0)) output->failed = 1;
+	output->offset = 0;
 }
 
-static size_t MidiFileIO_write(MidiFileIO_t io, size_t length, unsigned char *buffer)
+static unsigned char *MidiFileOutput_reserve(MidiFileOutput_t output, long length)
 {
-	switch (io->type)
-	{
-		case MIDI_FILE_IO_TYPE_FILE:
-		{
-			return fwrite(buffer, 1, length, io->u.file.file);
-		}
-		case MIDI_FILE_IO_TYPE_BUFFER:
-		{
-			if (io->u.buffer.buffer != NULL) memcpy(io->u.buffer.buffer + io->u.buffer.offset, buffer, length);
-			io->u.buffer.offset += length;
-			return length;
-		}
-		default:
-		{
-			return 0;
-		}
-	}
+	/* Returns where to encode up to length bytes; hand the position after them back to MidiFileOutput_commit(). */
+	if (output->buffer_size - output->offset < length) MidiFileOutput_flush(output);
+	return output->buffer + output->offset;
 }
 
-static long MidiFileIO_tell(MidiFileIO_t io)
+static void MidiFileOutput_commit(MidiFileOutput_t output, unsigned char *position)
 {
-	switch (io->type)
-	{
-		case MIDI_FILE_IO_TYPE_FILE:
-		{
-			return ftell(io->u.file.file);
-		}
-		case MIDI_FILE_IO_TYPE_BUFFER:
-		{
-			return io->u.buffer.offset;
-		}
-		default:
-		{
-			return -1;
-		}
-	}
+	output->offset = (long)(position - output->buffer);
 }
 
-static int MidiFileIO_seek(MidiFileIO_t io, long offset, int whence)
+static void MidiFileOutput_write(MidiFileOutput_t output, unsigned char *data, long length)
 {
-	switch (io->type)
+	if (output->buffer_size - output->offset < length)
 	{
-		case MIDI_FILE_IO_TYPE_FILE:
-		{
-			return fseek(io->u.file.file, offset, whence);
-		}
-		case MIDI_FILE_IO_TYPE_BUFFER:
-		{
-			switch (whence)
-			{
-				case SEEK_SET:
-				{
-					io->u.buffer.offset = offset;
-					return 0;
-				}
-				case SEEK_CUR:
-				{
-					io->u.buffer.offset += offset;
-					return 0;
-				}
-				default:
-				{
-					return -1;
-				}
-			}
-		}
-		default:
+		MidiFileOutput_flush(output);
+
+		if (length > output->buffer_size)
 		{
-			return -1;
+			/* too big to be worth staging */
+			if ((!output->failed) && ((*(output->callback))(data, (int)(length), output->user_data) != 0)) output->failed = 1;
+			return;
 		}
 	}
+
+	memcpy(output->buffer + output->offset, data, length);
+	output->offset += length;
 }
 
 static unsigned short interpret_uint16(unsigned char *buffer)
@@ -408,680 +660,4041 @@ static unsigned short interpret_uint16(unsigned char *buffer)
 	return ((unsigned short)(buffer[0]) << 8) | (unsigned short)(buffer[1]);
 }
 
-static unsigned short read_uint16(MidiFileIO_t io)
+static unsigned char *encode_uint16(unsigned char *position, unsigned short value)
 {
-	unsigned char buffer[2];
-	MidiFileIO_read(io, 2, buffer);
-	return interpret_uint16(buffer);
+	position[0] = (unsigned char)((value >> 8) & 0xFF);
+	position[1] = (unsigned char)(value & 0xFF);
+	return position + 2;
 }
 
-static void write_uint16(MidiFileIO_t io, unsigned short value)
+static unsigned long interpret_uint32(unsigned char *buffer)
 {
-	unsigned char buffer[2];
-	buffer[0] = (unsigned char)((value >> 8) & 0xFF);
-	buffer[1] = (unsigned char)(value & 0xFF);
-	MidiFileIO_write(io, 2, buffer);
+	return ((unsigned long)(buffer[0]) << 24) | ((unsigned long)(buffer[1]) << 16) | ((unsigned long)(buffer[2]) << 8) | (unsigned long)(buffer[3]);
 }
 
-static unsigned long interpret_uint32(unsigned char *buffer)
+static unsigned char *encode_uint32(unsigned char *position, unsigned long value)
 {
-	return ((unsigned long)(buffer[0]) << 24) | ((unsigned long)(buffer[1]) << 16) | ((unsigned long)(buffer[2]) << 8) | (unsigned long)(buffer[3]);
+	position[0] = (unsigned char)((value >> 24) & 0xFF);
+	position[1] = (unsigned char)((value >> 16) & 0xFF);
+	position[2] = (unsigned char)((value >> 8) & 0xFF);
+	position[3] = (unsigned char)(value & 0xFF);
+	return position + 4;
 }
 
-static unsigned long read_uint32(MidiFileIO_t io)
+static int get_variable_length_quantity_size(unsigned long value)
 {
-	unsigned char buffer[4];
-	MidiFileIO_read(io, 4, buffer);
-	return interpret_uint32(buffer);
+	/* Quantities are limited to four bytes, as in the spec; any higher bits are dropped. */
+	if (value < 0x80UL) return 1;
+	if (value < 0x4000UL) return 2;
+	if (value < 0x200000UL) return 3;
+	return 4;
 }
 
-static void write_uint32(MidiFileIO_t io, unsigned long value)
+static unsigned char *encode_variable_length_quantity(unsigned char *position, unsigned long value)
 {
-	unsigned char buffer[4];
-	buffer[0] = (unsigned char)(value >> 24);
-	buffer[1] = (unsigned char)((value >> 16) & 0xFF);
-	buffer[2] = (unsigned char)((value >> 8) & 0xFF);
-	buffer[3] = (unsigned char)(value & 0xFF);
-	MidiFileIO_write(io, 4, buffer);
+	int shift;
+
+	for (shift = (get_variable_length_quantity_size(value) - 1) * 7; shift > 0; shift -= 7) *position++ = (unsigned char)(((value >> shift) & 0x7F) | 0x80);
+	*position++ = (unsigned char)(value & 0x7F);
+	return position;
 }
 
-static unsigned long read_variable_length_quantity(MidiFileIO_t io)
+static unsigned char *map_file(char *filename, long *length)
 {
-	unsigned char b;
-	unsigned long value = 0;
+	/* Maps the file privately, so that writing to the mapping copies the pages concerned instead of changing the file.  Returns NULL if it cannot be mapped. */
 
-	do
+#ifdef _WIN32
+	HANDLE file, mapping;
+	LARGE_INTEGER size;
+	unsigned char *buffer = NULL;
+
+	if ((file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE) return NULL;
+
+	if (GetFileSizeEx(file, &size) && (size.QuadPart > 0) && (size.QuadPart < 0x7FFFFFFF) && ((mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL)) != NULL))
 	{
-		b = MidiFileIO_getc(io);
-		value = (value << 7) | (b & 0x7F);
+		buffer = (unsigned char *)(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+		*length = (long)(size.QuadPart);
+		CloseHandle(mapping);
 	}
-	while ((b & 0x80) == 0x80);
 
-	return value;
-}
+	CloseHandle(file);
+	return buffer;
+#else
+	int fd;
+	struct stat file_status;
+	void *buffer = MAP_FAILED;
 
-static void write_variable_length_quantity(MidiFileIO_t io, unsigned long value)
-{
-	unsigned char buffer[4];
-	int offset = 3;
+	if ((fd = open(filename, O_RDONLY)) < 0) return NULL;
 
-	while (1)
+	if ((fstat(fd, &file_status) == 0) && S_ISREG(file_status.st_mode) && (file_status.st_size > 0) && (file_status.st_size < 0x7FFFFFFF))
 	{
-		buffer[offset] = (unsigned char)(value & 0x7F);
-		if (offset < 3) buffer[offset] |= 0x80;
-		value >>= 7;
-		if ((value == 0) || (offset == 0)) break;
-		offset--;
+		buffer = mmap(NULL, file_status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		*length = (long)(file_status.st_size);
 	}
 
-	MidiFileIO_write(io, 4 - offset, buffer + offset);
+	close(fd);
+	return (buffer == MAP_FAILED) ? NULL : (unsigned char *)(buffer);
+#endif
 }
 
-static void add_event_before(MidiFileEvent_t new_event, MidiFileEvent_t next_event)
+static void unmap_file(unsigned char *buffer, long length)
 {
-	/* Add in proper sorted order.  Search forwards to optimize for inserting. */
+#ifdef _WIN32
+	(void)(length);
+	UnmapViewOfFile(buffer);
+#else
+	munmap(buffer, length);
+#endif
+}
 
-	MidiFileEvent_t event;
-
-	for (event = new_event->track->first_event; (event != NULL) && (event->tick < new_event->tick); event = event->next_event_in_track) {}
+static MidiFileArena_t MidiFileArena_new(void)
+{
+	MidiFileArena_t arena = (MidiFileArena_t)(malloc(sizeof(struct MidiFileArena)));
+	int block_size_number;
 
-	if ((event != NULL) && (next_event != NULL) && (event->track == next_event->track) && (event->tick == next_event->tick))
-	{
-		while (event != next_event) event = event->next_event_in_track;
-	}
+	arena->number_of_live_events = 0;
+	arena->is_orphaned = 0;
+	arena->first_slab = NULL;
+	arena->next_event_in_slab = NULL;
+	arena->number_of_events_left_in_slab = 0;
+	arena->first_free_event = NULL;
+	arena->first_chunk = NULL;
+	arena->next_byte_in_chunk = NULL;
+	arena->number_of_bytes_left_in_chunk = 0;
+	for (block_size_number = 0; block_size_number < MIDI_FILE_ARENA_NUMBER_OF_BLOCK_SIZES; block_size_number++) arena->first_free_blocks[block_size_number] = NULL;
+	arena->first_large_block = NULL;
+	arena->mapping = NULL;
+	arena->mapping_length = 0;
+	return arena;
+}
 
-	new_event->next_event_in_track = event;
+static void MidiFileArena_free(MidiFileArena_t arena)
+{
+	struct MidiFileArenaBlock *block, *next_block;
 
-	if (event == NULL)
+	for (block = arena->first_slab; block != NULL; block = next_block)
 	{
-		new_event->previous_event_in_track = new_event->track->last_event;
-		new_event->track->last_event = new_event;
-	}
-	else
-	{
-		new_event->previous_event_in_track = event->previous_event_in_track;
-		event->previous_event_in_track = new_event;
+		next_block = block->next_block;
+		free(block);
 	}
 
-	if (new_event->previous_event_in_track == NULL)
+	for (block = arena->first_chunk; block != NULL; block = next_block)
 	{
-		new_event->track->first_event = new_event;
+		next_block = block->next_block;
+		free(block);
 	}
-	else
+
+	for (block = arena->first_large_block; block != NULL; block = next_block)
 	{
-		new_event->previous_event_in_track->next_event_in_track = new_event;
+		next_block = block->next_block;
+		free(block);
 	}
 
-	for (event = new_event->track->midi_file->first_event; (event != NULL) && (new_event->tick > event->tick); event = event->next_event_in_file) {}
+	if (arena->mapping != NULL) unmap_file(arena->mapping, arena->mapping_length);
+	free(arena);
+}
 
-	new_event->next_event_in_file = event;
+static void MidiFileArena_release(MidiFileArena_t arena)
+{
+	/* Called when the file that owns the arena goes away. */
+	arena->is_orphaned = 1;
+	if (arena->number_of_live_events == 0) MidiFileArena_free(arena);
+}
 
-	if (event == NULL)
-	{
-		new_event->previous_event_in_file = new_event->track->midi_file->last_event;
-		new_event->track->midi_file->last_event = new_event;
-	}
-	else
+static struct MidiFileArenaBlock *MidiFileArena_newBlock(struct MidiFileArenaBlock **first_block, long size)
+{
+	struct MidiFileArenaBlock *block = (struct MidiFileArenaBlock *)(malloc(sizeof(struct MidiFileArenaBlock) + size));
+	block->previous_block = NULL;
+	block->next_block = *first_block;
+	if (block->next_block != NULL) block->next_block->previous_block = block;
+	*first_block = block;
+	return block;
+}
+
+static void *MidiFileArena_allocate(MidiFileArena_t arena, long size)
+{
+	int block_size_number;
+	long block_size;
+	void *block;
+
+	if (size > MIDI_FILE_ARENA_NUMBER_OF_BLOCK_SIZES * MIDI_FILE_ARENA_BLOCK_SIZE_STEP)
 	{
-		new_event->previous_event_in_file = event->previous_event_in_file;
-		event->previous_event_in_file = new_event;
+		return MidiFileArena_newBlock(&(arena->first_large_block), size) + 1;
 	}
 
-	if (new_event->previous_event_in_file == NULL)
+	block_size_number = (size < 1) ? 0 : ((size - 1) / MIDI_FILE_ARENA_BLOCK_SIZE_STEP);
+
+	if (arena->first_free_blocks[block_size_number] != NULL)
 	{
-		new_event->track->midi_file->first_event = new_event;
+		block = arena->first_free_blocks[block_size_number];
+		arena->first_free_blocks[block_size_number] = *((void **)(block));
+		return block;
 	}
-	else
+
+	block_size = (block_size_number + 1) * MIDI_FILE_ARENA_BLOCK_SIZE_STEP;
+
+	if (arena->number_of_bytes_left_in_chunk < block_size)
 	{
-		new_event->previous_event_in_file->next_event_in_file = new_event;
+		arena->next_byte_in_chunk = (unsigned char *)(MidiFileArena_newBlock(&(arena->first_chunk), MIDI_FILE_ARENA_CHUNK_SIZE) + 1);
+		arena->number_of_bytes_left_in_chunk = MIDI_FILE_ARENA_CHUNK_SIZE;
 	}
 
-	if (new_event->tick > new_event->track->end_tick) new_event->track->end_tick = new_event->tick;
+	block = arena->next_byte_in_chunk;
+	arena->next_byte_in_chunk += block_size;
+	arena->number_of_bytes_left_in_chunk -= block_size;
+	return block;
 }
 
-static void add_event_after(MidiFileEvent_t new_event, MidiFileEvent_t previous_event)
+static void MidiFileArena_deallocate(MidiFileArena_t arena, void *block, long size)
 {
-	/* Add in proper sorted order.  Search backwards to optimize for appending. */
+	/* The size must be the same one that the block was allocated with. */
 
-	MidiFileEvent_t event;
+	int block_size_number;
 
-	for (event = new_event->track->last_event; (event != NULL) && (event->tick > new_event->tick); event = event->previous_event_in_track) {}
+	/* data still pointing into a file mapping simply stops being used */
+	if ((arena->mapping != NULL) && ((unsigned char *)(block) >= arena->mapping) && ((unsigned char *)(block) < arena->mapping + arena->mapping_length)) return;
 
-	if ((event != NULL) && (previous_event != NULL) && (event->track == previous_event->track) && (event->tick == previous_event->tick))
+	if (size > MIDI_FILE_ARENA_NUMBER_OF_BLOCK_SIZES * MIDI_FILE_ARENA_BLOCK_SIZE_STEP)
 	{
-		while (event != previous_event) event = event->previous_event_in_track;
-	}
+		struct MidiFileArenaBlock *large_block = (struct MidiFileArenaBlock *)(block) - 1;
 
-	new_event->previous_event_in_track = event;
+		if (large_block->previous_block == NULL)
+		{
+			arena->first_large_block = large_block->next_block;
+		}
+		else
+		{
+			large_block->previous_block->next_block = large_block->next_block;
+		}
 
-	if (event == NULL)
-	{
-		new_event->next_event_in_track = new_event->track->first_event;
-		new_event->track->first_event = new_event;
-	}
-	else
-	{
-		new_event->next_event_in_track = event->next_event_in_track;
-		event->next_event_in_track = new_event;
+		if (large_block->next_block != NULL) large_block->next_block->previous_block = large_block->previous_block;
+		free(large_block);
+		return;
 	}
 
-	if (new_event->next_event_in_track == NULL)
+	block_size_number = (size < 1) ? 0 : ((size - 1) / MIDI_FILE_ARENA_BLOCK_SIZE_STEP);
+	*((void **)(block)) = arena->first_free_blocks[block_size_number];
+	arena->first_free_blocks[block_size_number] = block;
+}
+
+static MidiFileEvent_t MidiFileArena_allocateEvent(MidiFileArena_t arena)
+{
+	MidiFileEvent_t event;
+
+	if (arena->first_free_event != NULL)
 	{
-		new_event->track->last_event = new_event;
+		event = arena->first_free_event;
+		arena->first_free_event = event->next_event_in_file;
 	}
 	else
 	{
-		new_event->next_event_in_track->previous_event_in_track = new_event;
+		if (arena->number_of_events_left_in_slab == 0)
+		{
+			arena->next_event_in_slab = (MidiFileEvent_t)(MidiFileArena_newBlock(&(arena->first_slab), sizeof(struct MidiFileEvent) * MIDI_FILE_ARENA_NUMBER_OF_EVENTS_PER_SLAB) + 1);
+			arena->number_of_events_left_in_slab = MIDI_FILE_ARENA_NUMBER_OF_EVENTS_PER_SLAB;
+		}
+
+		event = (arena->next_event_in_slab)++;
+		(arena->number_of_events_left_in_slab)--;
 	}
 
-	for (event = new_event->track->midi_file->last_event; (event != NULL) && (new_event->tick < event->tick); event = event->previous_event_in_file) {}
+	event->arena = arena;
+	event->type_index_entry = NULL;
+	(arena->number_of_live_events)++;
+	return event;
+}
 
-	new_event->previous_event_in_file = event;
+static void MidiFileArena_deallocateEvent(MidiFileEvent_t event)
+{
+	/* Events always go back to the arena they came from, which may no longer belong to any file. */
 
-	if (event == NULL)
+	MidiFileArena_t arena = event->arena;
+
+	event->next_event_in_file = arena->first_free_event;
+	arena->first_free_event = event;
+	(arena->number_of_live_events)--;
+	if (arena->is_orphaned && (arena->number_of_live_events == 0)) MidiFileArena_free(arena);
+}
+
+static void MidiFileArena_spliceBlocks(struct MidiFileArenaBlock **first_block, struct MidiFileArenaBlock *other_first_block)
+{
+	struct MidiFileArenaBlock *last_block;
+
+	if (other_first_block == NULL) return;
+	for (last_block = other_first_block; last_block->next_block != NULL; last_block = last_block->next_block) {}
+	last_block->next_block = *first_block;
+	if (*first_block != NULL) (*first_block)->previous_block = last_block;
+	*first_block = other_first_block;
+}
+
+static void MidiFileArena_splice(MidiFileArena_t arena, MidiFileArena_t other_arena)
+{
+	/* Hands all of the other arena's memory and events over to this one, and frees it.  Pointing the events themselves at this arena is up to the caller. */
+
+	MidiFileEvent_t last_free_event;
+	void *last_free_block;
+	int block_size_number;
+
+	MidiFileArena_spliceBlocks(&(arena->first_slab), other_arena->first_slab);
+	MidiFileArena_spliceBlocks(&(arena->first_chunk), other_arena->first_chunk);
+	MidiFileArena_spliceBlocks(&(arena->first_large_block), other_arena->first_large_block);
+
+	/* whatever is left of the other arena's current slab and chunk goes unused */
+
+	if (other_arena->first_free_event != NULL)
 	{
-		new_event->next_event_in_file = new_event->track->midi_file->first_event;
-		new_event->track->midi_file->first_event = new_event;
+		for (last_free_event = other_arena->first_free_event; last_free_event->next_event_in_file != NULL; last_free_event = last_free_event->next_event_in_file) {}
+		last_free_event->next_event_in_file = arena->first_free_event;
+		arena->first_free_event = other_arena->first_free_event;
 	}
-	else
+
+	for (block_size_number = 0; block_size_number < MIDI_FILE_ARENA_NUMBER_OF_BLOCK_SIZES; block_size_number++)
 	{
-		new_event->next_event_in_file = event->next_event_in_file;
-		event->next_event_in_file = new_event;
+		if (other_arena->first_free_blocks[block_size_number] == NULL) continue;
+		for (last_free_block = other_arena->first_free_blocks[block_size_number]; *((void **)(last_free_block)) != NULL; last_free_block = *((void **)(last_free_block))) {}
+		*((void **)(last_free_block)) = arena->first_free_blocks[block_size_number];
+		arena->first_free_blocks[block_size_number] = other_arena->first_free_blocks[block_size_number];
 	}
 
-	if (new_event->next_event_in_file == NULL)
+	arena->number_of_live_events += other_arena->number_of_live_events;
+	free(other_arena);
+}
+
+static void MidiFileTickIndex_init(MidiFileTickIndex_t index, MidiFileArena_t arena)
+{
+	int level;
+
+	index->arena = arena;
+	index->number_of_levels = 1;
+	index->random_state = 2463534242UL;
+
+	for (level = 0; level < MIDI_FILE_TICK_INDEX_MAX_LEVELS; level++)
 	{
-		new_event->track->midi_file->last_event = new_event;
+		index->head_nodes[level] = NULL;
+		index->tail_nodes[level] = NULL;
 	}
-	else
+}
+
+static long MidiFileTickIndexNode_getSize(int number_of_levels)
+{
+	return sizeof(struct MidiFileTickIndexNode) + (sizeof(MidiFileTickIndexNode_t) * (number_of_levels - 1));
+}
+
+static void MidiFileTickIndex_clear(MidiFileTickIndex_t index)
+{
+	MidiFileTickIndexNode_t node, next_node;
+
+	for (node = index->head_nodes[0]; node != NULL; node = next_node)
 	{
-		new_event->next_event_in_file->previous_event_in_file = new_event;
+		next_node = node->next_nodes[0];
+		MidiFileArena_deallocate(index->arena, node, MidiFileTickIndexNode_getSize(node->number_of_levels));
 	}
 
-	if (new_event->tick > new_event->track->end_tick) new_event->track->end_tick = new_event->tick;
+	MidiFileTickIndex_init(index, index->arena);
 }
 
-static void add_event(MidiFileEvent_t new_event)
+static int MidiFileTickIndex_getRandomNumberOfLevels(MidiFileTickIndex_t index)
 {
-	add_event_after(new_event, NULL);
+	/* xorshift; each additional level is a quarter as likely as the one below it */
+
+	unsigned long bits;
+	int number_of_levels = 1;
+
+	index->random_state ^= (index->random_state << 13) & 0xFFFFFFFFUL;
+	index->random_state ^= index->random_state >> 17;
+	index->random_state ^= (index->random_state << 5) & 0xFFFFFFFFUL;
+
+	for (bits = index->random_state; ((bits & 3) == 0) && (number_of_levels < MIDI_FILE_TICK_INDEX_MAX_LEVELS); bits >>= 2) number_of_levels++;
+	return number_of_levels;
 }
 
-static void remove_event(MidiFileEvent_t event)
+static MidiFileTickIndexNode_t MidiFileTickIndex_findPrecedingNodes(MidiFileTickIndex_t index, long tick, MidiFileTickIndexNode_t *preceding_nodes)
 {
-	if (event->previous_event_in_track == NULL)
-	{
-		event->track->first_event = event->next_event_in_track;
-	}
-	else
-	{
-		event->previous_event_in_track->next_event_in_track = event->next_event_in_track;
-	}
+	/* Fills in the last node before tick at each level (NULL meaning the head), and returns the first node at or after it. */
 
-	if (event->next_event_in_track == NULL)
-	{
-		event->track->last_event = event->previous_event_in_track;
-	}
-	else
-	{
-		event->next_event_in_track->previous_event_in_track = event->previous_event_in_track;
-	}
+	MidiFileTickIndexNode_t node = NULL;
+	int level;
 
-	if (event->previous_event_in_file == NULL)
+	for (level = index->number_of_levels - 1; level >= 0; level--)
 	{
-		event->track->midi_file->first_event = event->next_event_in_file;
+		MidiFileTickIndexNode_t next_node;
+
+		if ((index->tail_nodes[level] != NULL) && (index->tail_nodes[level]->tick < tick))
+		{
+			/* shortcut for appending, which is by far the most common case */
+			node = index->tail_nodes[level];
+		}
+		else
+		{
+			for (next_node = ((node == NULL) ? index->head_nodes[level] : node->next_nodes[level]); (next_node != NULL) && (next_node->tick < tick); next_node = next_node->next_nodes[level]) node = next_node;
+		}
+
+		if (preceding_nodes != NULL) preceding_nodes[level] = node;
 	}
-	else
+
+	return (node == NULL) ? index->head_nodes[0] : node->next_nodes[0];
+}
+
+static MidiFileTickIndexNode_t MidiFileTickIndex_getNode(MidiFileTickIndex_t index, long tick)
+{
+	MidiFileTickIndexNode_t node = MidiFileTickIndex_findPrecedingNodes(index, tick, NULL);
+	return ((node != NULL) && (node->tick == tick)) ? node : NULL;
+}
+
+static MidiFileEvent_t MidiFileTickIndex_getLastEventAtOrBefore(MidiFileTickIndex_t index, long tick)
+{
+	MidiFileTickIndexNode_t preceding_nodes[MIDI_FILE_TICK_INDEX_MAX_LEVELS];
+	MidiFileTickIndexNode_t node = MidiFileTickIndex_findPrecedingNodes(index, tick, preceding_nodes);
+	if ((node != NULL) && (node->tick == tick)) return node->last_event;
+	return (preceding_nodes[0] == NULL) ? NULL : preceding_nodes[0]->last_event;
+}
+
+static MidiFileEvent_t MidiFileTickIndex_getFirstEventAtOrAfter(MidiFileTickIndex_t index, long tick)
+{
+	MidiFileTickIndexNode_t node = MidiFileTickIndex_findPrecedingNodes(index, tick, NULL);
+	return (node == NULL) ? NULL : node->first_event;
+}
+
+static void MidiFileTickIndex_addEvent(MidiFileTickIndex_t index, MidiFileEvent_t event, MidiFileEvent_t previous_event, MidiFileEvent_t next_event)
+{
+	/* Call after the event has been linked into its list between previous_event and next_event. */
+
+	MidiFileTickIndexNode_t preceding_nodes[MIDI_FILE_TICK_INDEX_MAX_LEVELS];
+	MidiFileTickIndexNode_t node;
+	int number_of_levels, level;
+
+	if ((next_event == NULL) && (index->tail_nodes[0] != NULL) && (index->tail_nodes[0]->tick == event->tick))
 	{
-		event->previous_event_in_file->next_event_in_file = event->next_event_in_file;
+		/* appending another event at the last tick, as when loading, needs no search */
+		index->tail_nodes[0]->last_event = event;
+		return;
 	}
 
-	if (event->next_event_in_file == NULL)
+	node = MidiFileTickIndex_findPrecedingNodes(index, event->tick, preceding_nodes);
+
+	if ((node != NULL) && (node->tick == event->tick))
 	{
-		event->track->midi_file->last_event = event->previous_event_in_file;
+		if ((previous_event == NULL) || (previous_event->tick != event->tick)) node->first_event = event;
+		if ((next_event == NULL) || (next_event->tick != event->tick)) node->last_event = event;
+		return;
 	}
-	else
+
+	number_of_levels = MidiFileTickIndex_getRandomNumberOfLevels(index);
+	node = (MidiFileTickIndexNode_t)(MidiFileArena_allocate(index->arena, MidiFileTickIndexNode_getSize(number_of_levels)));
+	node->tick = event->tick;
+	node->first_event = event;
+	node->last_event = event;
+	node->number_of_levels = number_of_levels;
+
+	for (level = index->number_of_levels; level < node->number_of_levels; level++) preceding_nodes[level] = NULL;
+	if (node->number_of_levels > index->number_of_levels) index->number_of_levels = node->number_of_levels;
+
+	for (level = 0; level < node->number_of_levels; level++)
 	{
-		event->next_event_in_file->previous_event_in_file = event->previous_event_in_file;
+		if (preceding_nodes[level] == NULL)
+		{
+			node->next_nodes[level] = index->head_nodes[level];
+			index->head_nodes[level] = node;
+		}
+		else
+		{
+			node->next_nodes[level] = preceding_nodes[level]->next_nodes[level];
+			preceding_nodes[level]->next_nodes[level] = node;
+		}
+
+		if (node->next_nodes[level] == NULL) index->tail_nodes[level] = node;
 	}
 }
 
-static MidiFile_t load_midi_file(MidiFileIO_t io)
+static void MidiFileTickIndex_removeEvent(MidiFileTickIndex_t index, MidiFileEvent_t event, MidiFileEvent_t previous_event, MidiFileEvent_t next_event)
 {
-	MidiFile_t midi_file;
-	unsigned char chunk_id[4], division_type_and_resolution[4];
-	long chunk_size, chunk_start;
-	int file_format, number_of_tracks, number_of_tracks_read = 0;
+	/* Call while the event is still linked into its list between previous_event and next_event. */
 
-	MidiFileIO_read(io, 4, chunk_id);
-	chunk_size = read_uint32(io);
-	chunk_start = MidiFileIO_tell(io);
+	MidiFileTickIndexNode_t preceding_nodes[MIDI_FILE_TICK_INDEX_MAX_LEVELS];
+	MidiFileTickIndexNode_t node = MidiFileTickIndex_findPrecedingNodes(index, event->tick, preceding_nodes);
+	int level;
 
-	/* check for the RMID variation on SMF */
+	if ((node == NULL) || (node->tick != event->tick)) return;
 
-	if (memcmp(chunk_id, "RIFF", 4) == 0)
+	if (node->first_event != node->last_event)
 	{
-		MidiFileIO_read(io, 4, chunk_id); /* technically this one is a type id rather than a chunk id, but we'll reuse the buffer anyway */
+		if (node->first_event == event) node->first_event = next_event;
+		if (node->last_event == event) node->last_event = previous_event;
+		return;
+	}
 
-		if (memcmp(chunk_id, "RMID", 4) != 0)
+	for (level = 0; level < node->number_of_levels; level++)
+	{
+		if (preceding_nodes[level] == NULL)
 		{
-			return NULL;
+			index->head_nodes[level] = node->next_nodes[level];
 		}
-
-		MidiFileIO_read(io, 4, chunk_id);
-		chunk_size = read_uint32(io);
-
-		if (memcmp(chunk_id, "data", 4) != 0)
+		else
 		{
-			return NULL;
+			preceding_nodes[level]->next_nodes[level] = node->next_nodes[level];
 		}
 
-		MidiFileIO_read(io, 4, chunk_id);
-		chunk_size = read_uint32(io);
-		chunk_start = MidiFileIO_tell(io);
+		if (index->tail_nodes[level] == node) index->tail_nodes[level] = preceding_nodes[level];
 	}
 
-	if (memcmp(chunk_id, "MThd", 4) != 0)
+	while ((index->number_of_levels > 1) && (index->head_nodes[index->number_of_levels - 1] == NULL)) index->number_of_levels--;
+	MidiFileArena_deallocate(index->arena, node, MidiFileTickIndexNode_getSize(node->number_of_levels));
+}
+
+static void invalidate_conductor_track_maps(MidiFile_t midi_file)
+{
+	midi_file->tempo_map_is_valid = 0;
+	midi_file->meter_map_is_valid = 0;
+}
+
+static void invalidate_conductor_track_maps_for_event(MidiFileEvent_t event)
+{
+	/* Call whenever an event is added, removed or changed; only meta events in the conductor track affect the maps. */
+	if ((event->track != NULL) && (event->type == MIDI_FILE_EVENT_TYPE_META) && (event->track == event->track->midi_file->first_track)) invalidate_conductor_track_maps(event->track->midi_file);
+}
+
+static void count_event_in_file(MidiFileEvent_t event, int increment)
+{
+	/* Lets MidiFile_free() tell whether it can release the whole arena at once. */
+
+	MidiFile_t midi_file = event->track->midi_file;
+	midi_file->number_of_events += increment;
+	if (event->arena != midi_file->arena) midi_file->number_of_foreign_events += increment;
+}
+
+static void mark_track_changed(MidiFileTrack_t track, long start_tick, long end_tick)
+{
+	/* Widens the range of ticks which the next snapshot has to encode afresh. */
+	if (start_tick < track->changed_start_tick) track->changed_start_tick = start_tick;
+	if (end_tick > track->changed_end_tick) track->changed_end_tick = end_tick;
+}
+
+static void mark_event_changed(MidiFileEvent_t event)
+{
+	if (event->track != NULL) mark_track_changed(event->track, event->tick, event->tick);
+}
+
+static int is_note_on_or_off_event(MidiFileEvent_t event)
+{
+	return ((event->type == MIDI_FILE_EVENT_TYPE_NOTE_ON) || (event->type == MIDI_FILE_EVENT_TYPE_NOTE_OFF));
+}
+
+static struct MidiFileNotePairingLinks *get_note_pairing_links(MidiFileEvent_t event)
+{
+	if (event->type == MIDI_FILE_EVENT_TYPE_NOTE_ON) return &(event->u.note_on.pairing_links);
+	return &(event->u.note_off.pairing_links);
+}
+
+static int get_note_pairing_key(MidiFileEvent_t event)
+{
+	/* Out of range channels and notes share a list with their in range counterparts, so lookups still compare them. */
+	if (event->type == MIDI_FILE_EVENT_TYPE_NOTE_ON) return ((event->u.note_on.channel & 0x0F) << 7) | (event->u.note_on.note & 0x7F);
+	return ((event->u.note_off.channel & 0x0F) << 7) | (event->u.note_off.note & 0x7F);
+}
+
+static int event_follows_in_track(MidiFileEvent_t event, MidiFileEvent_t other_event)
+{
+	/* Only events at the same tick need a walk to tell their order, and only through that tick. */
+
+	MidiFileEvent_t subsequent_event;
+
+	if (event->tick != other_event->tick) return (event->tick > other_event->tick);
+
+	for (subsequent_event = other_event->next_event_in_track; (subsequent_event != NULL) && (subsequent_event->tick == event->tick); subsequent_event = subsequent_event->next_event_in_track)
 	{
-		return NULL;
+		if (subsequent_event == event) return 1;
 	}
 
-	file_format = read_uint16(io);
-	number_of_tracks = read_uint16(io);
-	MidiFileIO_read(io, 2, division_type_and_resolution);
+	return 0;
+}
+
+static void build_note_pairing_index(MidiFileTrack_t track)
+{
+	MidiFileEvent_t event;
+
+	track->last_events_with_same_note = (MidiFileEvent_t *)(MidiFileArena_allocate(track->midi_file->arena, sizeof(MidiFileEvent_t) * 16 * 128));
+	memset(track->last_events_with_same_note, 0, sizeof(MidiFileEvent_t) * 16 * 128);
 
-	switch ((signed char)(division_type_and_resolution[0]))
+	for (event = track->first_event; event != NULL; event = event->next_event_in_track)
 	{
-		case -24:
-		{
-			midi_file = MidiFile_new(file_format, MIDI_FILE_DIVISION_TYPE_SMPTE24, division_type_and_resolution[1]);
-			break;
-		}
-		case -25:
-		{
-			midi_file = MidiFile_new(file_format, MIDI_FILE_DIVISION_TYPE_SMPTE25, division_type_and_resolution[1]);
-			break;
-		}
-		case -29:
-		{
-			midi_file = MidiFile_new(file_format, MIDI_FILE_DIVISION_TYPE_SMPTE30DROP, division_type_and_resolution[1]);
-			break;
-		}
-		case -30:
-		{
-			midi_file = MidiFile_new(file_format, MIDI_FILE_DIVISION_TYPE_SMPTE30, division_type_and_resolution[1]);
-			break;
-		}
-		default:
+		if (is_note_on_or_off_event(event))
 		{
-			midi_file = MidiFile_new(file_format, MIDI_FILE_DIVISION_TYPE_PPQ, interpret_uint16(division_type_and_resolution));
-			break;
+			MidiFileEvent_t *last_event_with_same_note = &(track->last_events_with_same_note[get_note_pairing_key(event)]);
+			get_note_pairing_links(event)->previous_event_with_same_note = *last_event_with_same_note;
+			get_note_pairing_links(event)->next_event_with_same_note = NULL;
+			if (*last_event_with_same_note != NULL) get_note_pairing_links(*last_event_with_same_note)->next_event_with_same_note = event;
+			*last_event_with_same_note = event;
 		}
 	}
+}
 
-	/* forwards compatibility:  skip over any extra header data */
-	MidiFileIO_seek(io, chunk_start + chunk_size, SEEK_SET);
+static void drop_note_pairing_index(MidiFileTrack_t track)
+{
+	if (track->last_events_with_same_note == NULL) return;
+	MidiFileArena_deallocate(track->midi_file->arena, track->last_events_with_same_note, sizeof(MidiFileEvent_t) * 16 * 128);
+	track->last_events_with_same_note = NULL;
+}
 
-	while (number_of_tracks_read < number_of_tracks)
-	{
-		MidiFileIO_read(io, 4, chunk_id);
-		chunk_size = read_uint32(io);
-		chunk_start = MidiFileIO_tell(io);
+static void drop_note_pairing_index_for_event(MidiFileEvent_t event)
+{
+	/* Call before changing anything that affects how a note on or note off event pairs up. */
+	if ((event->track != NULL) && is_note_on_or_off_event(event)) drop_note_pairing_index(event->track);
+}
 
-		if (memcmp(chunk_id, "MTrk", 4) == 0)
-		{
-			MidiFileTrack_t track = MidiFile_createTrack(midi_file);
-			long tick, previous_tick = 0;
-			unsigned char status, running_status = 0;
-			int at_end_of_track = 0;
+static void add_event_to_note_pairing_index(MidiFileEvent_t new_event)
+{
+	/* Walk back from the end of the list for this note; edits tend to be near the end or near where the note already was. */
 
-			while ((MidiFileIO_tell(io) < chunk_start + chunk_size) && !at_end_of_track)
-			{
-				tick = read_variable_length_quantity(io) + previous_tick;
-				previous_tick = tick;
+	MidiFileEvent_t *last_event_with_same_note;
+	MidiFileEvent_t previous_event, next_event = NULL;
 
-				status = MidiFileIO_getc(io);
+	if ((new_event->track->last_events_with_same_note == NULL) || !is_note_on_or_off_event(new_event)) return;
+	last_event_with_same_note = &(new_event->track->last_events_with_same_note[get_note_pairing_key(new_event)]);
 
-				if ((status & 0x80) == 0x00)
-				{
-					status = running_status;
-					MidiFileIO_seek(io, -1, SEEK_CUR);
-				}
-				else
-				{
-					running_status = status;
-				}
+	for (previous_event = *last_event_with_same_note; (previous_event != NULL) && event_follows_in_track(previous_event, new_event); previous_event = get_note_pairing_links(previous_event)->previous_event_with_same_note)
+	{
+		next_event = previous_event;
+	}
 
-				switch (status & 0xF0)
+	get_note_pairing_links(new_event)->previous_event_with_same_note = previous_event;
+	get_note_pairing_links(new_event)->next_event_with_same_note = next_event;
+	if (previous_event != NULL) get_note_pairing_links(previous_event)->next_event_with_same_note = new_event;
+
+	if (next_event == NULL)
+	{
+		*last_event_with_same_note = new_event;
+	}
+	else
+	{
+		get_note_pairing_links(next_event)->previous_event_with_same_note = new_event;
+	}
+}
+
+static void remove_event_from_note_pairing_index(MidiFileEvent_t event)
+{
+	struct MidiFileNotePairingLinks *links;
+
+	if ((event->track->last_events_with_same_note == NULL) || !is_note_on_or_off_event(event)) return;
+	links = get_note_pairing_links(event);
+
+	if (links->previous_event_with_same_note != NULL) get_note_pairing_links(links->previous_event_with_same_note)->next_event_with_same_note = links->next_event_with_same_note;
+
+	if (links->next_event_with_same_note == NULL)
+	{
+		event->track->last_events_with_same_note[get_note_pairing_key(event)] = links->previous_event_with_same_note;
+	}
+	else
+	{
+		get_note_pairing_links(links->next_event_with_same_note)->previous_event_with_same_note = links->previous_event_with_same_note;
+	}
+}
+
+static int get_event_channel(MidiFileEvent_t event)
+{
+	switch (event->type)
+	{
+		case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
+		{
+			return event->u.note_off.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE_ON:
+		{
+			return event->u.note_on.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
+		{
+			return event->u.key_pressure.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
+		{
+			return event->u.control_change.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
+		{
+			return event->u.program_change.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE:
+		{
+			return event->u.channel_pressure.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_PITCH_WHEEL:
+		{
+			return event->u.pitch_wheel.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE:
+		{
+			return event->u.note.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE:
+		{
+			return event->u.fine_control_change.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_RPN:
+		{
+			return event->u.rpn.channel;
+		}
+		case MIDI_FILE_EVENT_TYPE_NRPN:
+		{
+			return event->u.nrpn.channel;
+		}
+		default:
+		{
+			return -1;
+		}
+	}
+}
+
+static int get_event_number(MidiFileEvent_t event)
+{
+	/* The note, controller, program or meta event number, whichever the type has. */
+
+	switch (event->type)
+	{
+		case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
+		{
+			return event->u.note_off.note;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE_ON:
+		{
+			return event->u.note_on.note;
+		}
+		case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
+		{
+			return event->u.key_pressure.note;
+		}
+		case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
+		{
+			return event->u.control_change.number;
+		}
+		case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
+		{
+			return event->u.program_change.number;
+		}
+		case MIDI_FILE_EVENT_TYPE_META:
+		{
+			return event->u.meta.number;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE:
+		{
+			return event->u.note.note;
+		}
+		case MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE:
+		{
+			return event->u.fine_control_change.coarse_number;
+		}
+		case MIDI_FILE_EVENT_TYPE_RPN:
+		{
+			return event->u.rpn.number;
+		}
+		case MIDI_FILE_EVENT_TYPE_NRPN:
+		{
+			return event->u.nrpn.number;
+		}
+		default:
+		{
+			return -1;
+		}
+	}
+}
+
+static MidiFileTypeIndex_t get_type_index(MidiFile_t midi_file)
+{
+	if (midi_file->type_index == NULL)
+	{
+		midi_file->type_index = (MidiFileTypeIndex_t)(MidiFileArena_allocate(midi_file->arena, sizeof(struct MidiFileTypeIndex)));
+		memset(midi_file->type_index, 0, sizeof(struct MidiFileTypeIndex));
+	}
+
+	return midi_file->type_index;
+}
+
+static struct MidiFileTypeIndexList *get_type_index_list(MidiFileTypeIndex_t type_index, MidiFileEventType_t type, int subtype, int is_subtype)
+{
+	/* Returns NULL for a subtype list of sysex events, which have no subtype. */
+
+	if (!is_subtype) return &(type_index->type_lists[type]);
+	if (type == MIDI_FILE_EVENT_TYPE_META) return &(type_index->meta_lists[subtype & 0xFF]);
+	if (type == MIDI_FILE_EVENT_TYPE_SYSEX) return NULL;
+	return &(type_index->channel_lists[type][subtype & 0x0F]);
+}
+
+static struct MidiFileTypeIndexList *get_type_index_list_for_event(MidiFileTypeIndex_t type_index, MidiFileEvent_t event, int is_subtype)
+{
+	return get_type_index_list(type_index, (MidiFileEventType_t)(event->type), (event->type == MIDI_FILE_EVENT_TYPE_META) ? event->u.meta.number : get_event_channel(event), is_subtype);
+}
+
+static struct MidiFileTypeIndexLinks *get_type_index_links(MidiFileEvent_t event, int is_subtype)
+{
+	return is_subtype ? &(event->type_index_entry->same_subtype) : &(event->type_index_entry->same_type);
+}
+
+static int event_follows_in_file(MidiFileEvent_t event, MidiFileEvent_t other_event)
+{
+	MidiFileEvent_t subsequent_event;
+
+	if (event->tick != other_event->tick) return (event->tick > other_event->tick);
+
+	for (subsequent_event = other_event->next_event_in_file; (subsequent_event != NULL) && (subsequent_event->tick == event->tick); subsequent_event = subsequent_event->next_event_in_file)
+	{
+		if (subsequent_event == event) return 1;
+	}
+
+	return 0;
+}
+
+static void link_event_into_type_index_list(MidiFileTypeIndex_t type_index, struct MidiFileTypeIndexList *list, int is_subtype, MidiFileEvent_t new_event)
+{
+	/*
+	 * Walk back through the file from the new event and back through the list
+	 * from its end in step, stopping at whichever finds the new event's
+	 * predecessor in the list first.  The file walk wins for common types and
+	 * the list walk for rare ones, or for appends.
+	 */
+
+	MidiFileEvent_t event_in_file = new_event->previous_event_in_file;
+	MidiFileEvent_t event_in_list = list->last_event;
+	MidiFileEvent_t previous_event, next_event;
+
+	while (1)
+	{
+		if ((event_in_list == NULL) || !event_follows_in_file(event_in_list, new_event))
+		{
+			previous_event = event_in_list;
+			break;
+		}
+
+		if ((event_in_file == NULL) || (get_type_index_list_for_event(type_index, event_in_file, is_subtype) == list))
+		{
+			previous_event = event_in_file;
+			break;
+		}
+
+		event_in_list = get_type_index_links(event_in_list, is_subtype)->previous_event;
+		event_in_file = event_in_file->previous_event_in_file;
+	}
+
+	next_event = (previous_event == NULL) ? list->first_event : get_type_index_links(previous_event, is_subtype)->next_event;
+	get_type_index_links(new_event, is_subtype)->previous_event = previous_event;
+	get_type_index_links(new_event, is_subtype)->next_event = next_event;
+
+	if (previous_event == NULL)
+	{
+		list->first_event = new_event;
+	}
+	else
+	{
+		get_type_index_links(previous_event, is_subtype)->next_event = new_event;
+	}
+
+	if (next_event == NULL)
+	{
+		list->last_event = new_event;
+	}
+	else
+	{
+		get_type_index_links(next_event, is_subtype)->previous_event = new_event;
+	}
+}
+
+static void unlink_event_from_type_index_list(struct MidiFileTypeIndexList *list, int is_subtype, MidiFileEvent_t event)
+{
+	struct MidiFileTypeIndexLinks *links = get_type_index_links(event, is_subtype);
+
+	if (links->previous_event == NULL)
+	{
+		list->first_event = links->next_event;
+	}
+	else
+	{
+		get_type_index_links(links->previous_event, is_subtype)->next_event = links->next_event;
+	}
+
+	if (links->next_event == NULL)
+	{
+		list->last_event = links->previous_event;
+	}
+	else
+	{
+		get_type_index_links(links->next_event, is_subtype)->previous_event = links->previous_event;
+	}
+}
+
+static void allocate_type_index_entry(MidiFileEvent_t event)
+{
+	if (event->type_index_entry != NULL) return;
+	event->type_index_entry = (struct MidiFileTypeIndexEntry *)(MidiFileArena_allocate(event->track->midi_file->arena, sizeof(struct MidiFileTypeIndexEntry)));
+}
+
+static void build_type_index_list(MidiFile_t midi_file, struct MidiFileTypeIndexList *list, int is_subtype)
+{
+	MidiFileEvent_t event;
+
+	for (event = midi_file->first_event; event != NULL; event = event->next_event_in_file)
+	{
+		if (get_type_index_list_for_event(midi_file->type_index, event, is_subtype) == list)
+		{
+			allocate_type_index_entry(event);
+			get_type_index_links(event, is_subtype)->previous_event = list->last_event;
+			get_type_index_links(event, is_subtype)->next_event = NULL;
+
+			if (list->last_event == NULL)
+			{
+				list->first_event = event;
+			}
+			else
+			{
+				get_type_index_links(list->last_event, is_subtype)->next_event = event;
+			}
+
+			list->last_event = event;
+		}
+	}
+
+	list->is_built = 1;
+}
+
+static void add_event_to_type_index(MidiFileEvent_t new_event)
+{
+	/* Call once the event is in the file list, and again after changing its type, channel or meta event number. */
+
+	MidiFileTypeIndex_t type_index;
+	struct MidiFileTypeIndexList *type_list, *subtype_list;
+
+	if ((new_event->track == NULL) || (new_event->type_index_entry != NULL) || ((type_index = new_event->track->midi_file->type_index) == NULL)) return;
+	type_list = get_type_index_list_for_event(type_index, new_event, 0);
+	subtype_list = get_type_index_list_for_event(type_index, new_event, 1);
+	if (!(type_list->is_built) && ((subtype_list == NULL) || !(subtype_list->is_built))) return;
+	allocate_type_index_entry(new_event);
+	if (type_list->is_built) link_event_into_type_index_list(type_index, type_list, 0, new_event);
+	if ((subtype_list != NULL) && subtype_list->is_built) link_event_into_type_index_list(type_index, subtype_list, 1, new_event);
+}
+
+static void remove_event_from_type_index(MidiFileEvent_t event)
+{
+	/* Call before the event leaves the file list, and before changing its type, channel or meta event number. */
+
+	MidiFileTypeIndex_t type_index;
+	struct MidiFileTypeIndexList *type_list, *subtype_list;
+
+	if (event->type_index_entry == NULL) return;
+	type_index = event->track->midi_file->type_index;
+	type_list = get_type_index_list_for_event(type_index, event, 0);
+	subtype_list = get_type_index_list_for_event(type_index, event, 1);
+	if (type_list->is_built) unlink_event_from_type_index_list(type_list, 0, event);
+	if ((subtype_list != NULL) && subtype_list->is_built) unlink_event_from_type_index_list(subtype_list, 1, event);
+	MidiFileArena_deallocate(event->track->midi_file->arena, event->type_index_entry, sizeof(struct MidiFileTypeIndexEntry));
+	event->type_index_entry = NULL;
+}
+
+static void drop_type_index(MidiFile_t midi_file)
+{
+	/* For rewriting the whole file at once; the lists are rebuilt as they are used again. */
+
+	MidiFileEvent_t event;
+
+	if (midi_file->type_index == NULL) return;
+
+	for (event = midi_file->first_event; event != NULL; event = event->next_event_in_file)
+	{
+		if (event->type_index_entry != NULL)
+		{
+			MidiFileArena_deallocate(midi_file->arena, event->type_index_entry, sizeof(struct MidiFileTypeIndexEntry));
+			event->type_index_entry = NULL;
+		}
+	}
+
+	MidiFileArena_deallocate(midi_file->arena, midi_file->type_index, sizeof(struct MidiFileTypeIndex));
+	midi_file->type_index = NULL;
+}
+
+static int event_matches_type_query(MidiFileEvent_t event, int channel, int number)
+{
+	return (((channel < 0) || (get_event_channel(event) == channel)) && ((number < 0) || (get_event_number(event) == number)));
+}
+
+static struct MidiFileTypeIndexList *get_type_index_list_for_query(MidiFile_t midi_file, MidiFileEventType_t type, int channel, int number, int *is_subtype)
+{
+	/* Picks the narrowest list that holds every match, building it if need be. */
+
+	MidiFileTypeIndex_t type_index = get_type_index(midi_file);
+	struct MidiFileTypeIndexList *list;
+
+	if ((type == MIDI_FILE_EVENT_TYPE_META) ? (number >= 0) : ((channel >= 0) && (type != MIDI_FILE_EVENT_TYPE_SYSEX)))
+	{
+		*is_subtype = 1;
+		list = get_type_index_list(type_index, type, (type == MIDI_FILE_EVENT_TYPE_META) ? number : channel, 1);
+	}
+	else
+	{
+		*is_subtype = 0;
+		list = get_type_index_list(type_index, type, 0, 0);
+	}
+
+	if (!(list->is_built)) build_type_index_list(midi_file, list, *is_subtype);
+	return list;
+}
+
+static void add_event_before(MidiFileEvent_t new_event, MidiFileEvent_t next_event)
+{
+	/* Add in proper sorted order, using the tick indexes to find the place. */
+
+	MidiFileEvent_t event;
+
+	mark_event_changed(new_event);
+
+	if ((next_event != NULL) && (next_event->track == new_event->track) && (next_event->tick == new_event->tick))
+	{
+		event = next_event;
+	}
+	else
+	{
+		event = MidiFileTickIndex_getFirstEventAtOrAfter(&(new_event->track->tick_index), new_event->tick);
+	}
+
+	new_event->next_event_in_track = event;
+
+	if (event == NULL)
+	{
+		new_event->previous_event_in_track = new_event->track->last_event;
+		new_event->track->last_event = new_event;
+	}
+	else
+	{
+		new_event->previous_event_in_track = event->previous_event_in_track;
+		event->previous_event_in_track = new_event;
+	}
+
+	if (new_event->previous_event_in_track == NULL)
+	{
+		new_event->track->first_event = new_event;
+	}
+	else
+	{
+		new_event->previous_event_in_track->next_event_in_track = new_event;
+	}
+
+	MidiFileTickIndex_addEvent(&(new_event->track->tick_index), new_event, new_event->previous_event_in_track, new_event->next_event_in_track);
+	add_event_to_note_pairing_index(new_event);
+	invalidate_conductor_track_maps_for_event(new_event);
+
+	event = MidiFileTickIndex_getFirstEventAtOrAfter(&(new_event->track->midi_file->tick_index), new_event->tick);
+
+	new_event->next_event_in_file = event;
+
+	if (event == NULL)
+	{
+		new_event->previous_event_in_file = new_event->track->midi_file->last_event;
+		new_event->track->midi_file->last_event = new_event;
+	}
+	else
+	{
+		new_event->previous_event_in_file = event->previous_event_in_file;
+		event->previous_event_in_file = new_event;
+	}
+
+	if (new_event->previous_event_in_file == NULL)
+	{
+		new_event->track->midi_file->first_event = new_event;
+	}
+	else
+	{
+		new_event->previous_event_in_file->next_event_in_file = new_event;
+	}
+
+	MidiFileTickIndex_addEvent(&(new_event->track->midi_file->tick_index), new_event, new_event->previous_event_in_file, new_event->next_event_in_file);
+	add_event_to_type_index(new_event);
+	count_event_in_file(new_event, 1);
+
+	if (new_event->tick > new_event->track->end_tick) new_event->track->end_tick = new_event->tick;
+}
+
+static void add_event_after(MidiFileEvent_t new_event, MidiFileEvent_t previous_event)
+{
+	/* Add in proper sorted order, using the tick indexes to find the place. */
+
+	MidiFileEvent_t event;
+
+	mark_event_changed(new_event);
+
+	if ((previous_event != NULL) && (previous_event->track == new_event->track) && (previous_event->tick == new_event->tick))
+	{
+		event = previous_event;
+	}
+	else
+	{
+		event = MidiFileTickIndex_getLastEventAtOrBefore(&(new_event->track->tick_index), new_event->tick);
+	}
+
+	new_event->previous_event_in_track = event;
+
+	if (event == NULL)
+	{
+		new_event->next_event_in_track = new_event->track->first_event;
+		new_event->track->first_event = new_event;
+	}
+	else
+	{
+		new_event->next_event_in_track = event->next_event_in_track;
+		event->next_event_in_track = new_event;
+	}
+
+	if (new_event->next_event_in_track == NULL)
+	{
+		new_event->track->last_event = new_event;
+	}
+	else
+	{
+		new_event->next_event_in_track->previous_event_in_track = new_event;
+	}
+
+	MidiFileTickIndex_addEvent(&(new_event->track->tick_index), new_event, new_event->previous_event_in_track, new_event->next_event_in_track);
+	add_event_to_note_pairing_index(new_event);
+	invalidate_conductor_track_maps_for_event(new_event);
+
+	if (new_event->tick > new_event->track->end_tick) new_event->track->end_tick = new_event->tick;
+
+	/* while loading, the file list is built in one go by link_tracks_into_file() */
+	if (new_event->track->midi_file->is_loading) return;
+
+	event = MidiFileTickIndex_getLastEventAtOrBefore(&(new_event->track->midi_file->tick_index), new_event->tick);
+
+	new_event->previous_event_in_file = event;
+
+	if (event == NULL)
+	{
+		new_event->next_event_in_file = new_event->track->midi_file->first_event;
+		new_event->track->midi_file->first_event = new_event;
+	}
+	else
+	{
+		new_event->next_event_in_file = event->next_event_in_file;
+		event->next_event_in_file = new_event;
+	}
+
+	if (new_event->next_event_in_file == NULL)
+	{
+		new_event->track->midi_file->last_event = new_event;
+	}
+	else
+	{
+		new_event->next_event_in_file->previous_event_in_file = new_event;
+	}
+
+	MidiFileTickIndex_addEvent(&(new_event->track->midi_file->tick_index), new_event, new_event->previous_event_in_file, new_event->next_event_in_file);
+	add_event_to_type_index(new_event);
+	count_event_in_file(new_event, 1);
+}
+
+static void add_event(MidiFileEvent_t new_event)
+{
+	add_event_after(new_event, NULL);
+}
+
+static void remove_event(MidiFileEvent_t event)
+{
+	mark_event_changed(event);
+	count_event_in_file(event, -1);
+	invalidate_conductor_track_maps_for_event(event);
+	remove_event_from_note_pairing_index(event);
+	remove_event_from_type_index(event);
+	MidiFileTickIndex_removeEvent(&(event->track->tick_index), event, event->previous_event_in_track, event->next_event_in_track);
+	MidiFileTickIndex_removeEvent(&(event->track->midi_file->tick_index), event, event->previous_event_in_file, event->next_event_in_file);
+
+	if (event->previous_event_in_track == NULL)
+	{
+		event->track->first_event = event->next_event_in_track;
+	}
+	else
+	{
+		event->previous_event_in_track->next_event_in_track = event->next_event_in_track;
+	}
+
+	if (event->next_event_in_track == NULL)
+	{
+		event->track->last_event = event->previous_event_in_track;
+	}
+	else
+	{
+		event->next_event_in_track->previous_event_in_track = event->previous_event_in_track;
+	}
+
+	if (event->previous_event_in_file == NULL)
+	{
+		event->track->midi_file->first_event = event->next_event_in_file;
+	}
+	else
+	{
+		event->previous_event_in_file->next_event_in_file = event->next_event_in_file;
+	}
+
+	if (event->next_event_in_file == NULL)
+	{
+		event->track->midi_file->last_event = event->previous_event_in_file;
+	}
+	else
+	{
+		event->next_event_in_file->previous_event_in_file = event->previous_event_in_file;
+	}
+}
+
+static MidiFileEvent_t new_sysex_event(MidiFileTrack_t track, long tick, int data_length)
+{
+	/* Allocates the event and room for its data, but leaves filling in the data and adding the event to the caller. */
+
+	MidiFileEvent_t new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+	new_event->track = track;
+	new_event->tick = tick;
+	new_event->type = MIDI_FILE_EVENT_TYPE_SYSEX;
+	new_event->u.sysex.data_length = data_length;
+	new_event->u.sysex.data_buffer = (unsigned char *)(MidiFileArena_allocate(new_event->arena, data_length));
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
+	new_event->is_selected = 0;
+	return new_event;
+}
+
+static MidiFileEvent_t new_meta_event(MidiFileTrack_t track, long tick, int number, int data_length)
+{
+	/* Allocates the event and room for its data, but leaves filling in the data and adding the event to the caller. */
+
+	MidiFileEvent_t new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+	new_event->track = track;
+	new_event->tick = tick;
+	new_event->type = MIDI_FILE_EVENT_TYPE_META;
+	new_event->u.meta.number = number;
+	new_event->u.meta.data_length = data_length;
+	new_event->u.meta.data_buffer = (unsigned char *)(MidiFileArena_allocate(new_event->arena, data_length + 1));
+	new_event->u.meta.data_buffer[data_length] = '\0';
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
+	new_event->is_selected = 0;
+	return new_event;
+}
+
+static double get_tempo(MidiFileEvent_t tempo_event)
+{
+	unsigned char *buffer = tempo_event->u.meta.data_buffer;
+	if (tempo_event->u.meta.data_length < 3) return 120.0;
+	return 60000000.0 / ((buffer[0] << 16) | (buffer[1] << 8) | buffer[2]);
+}
+
+static double get_seconds_per_tick(MidiFile_t midi_file, double tempo)
+{
+	if (midi_file->division_type == MIDI_FILE_DIVISION_TYPE_PPQ) return 60.0 / tempo / midi_file->resolution;
+	return 1.0 / midi_file->resolution / midi_file->number_of_frames_per_second;
+}
+
+static double get_beats_per_tick(MidiFile_t midi_file, double tempo)
+{
+	if (midi_file->division_type == MIDI_FILE_DIVISION_TYPE_PPQ) return 1.0 / midi_file->resolution;
+	return get_seconds_per_tick(midi_file, tempo) * tempo / 60.0;
+}
+
+static void update_tempo_map(MidiFile_t midi_file)
+{
+	MidiFileEvent_t event;
+	int number_of_tempo_map_entries = 1;
+
+	if (midi_file->tempo_map_is_valid) return;
+
+	for (event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x51); event != NULL; event = MidiFileEvent_getNextEventOfType(event, -1, 0x51))
+	{
+		if (event->track == midi_file->first_track) number_of_tempo_map_entries++;
+	}
+
+	if (number_of_tempo_map_entries > midi_file->number_of_tempo_map_entries)
+	{
+		free(midi_file->tempo_map);
+		midi_file->tempo_map = (struct MidiFileTempoMapEntry *)(malloc(sizeof(struct MidiFileTempoMapEntry) * number_of_tempo_map_entries));
+	}
+
+	midi_file->number_of_tempo_map_entries = 1;
+	midi_file->tempo_map[0].tick = 0;
+	midi_file->tempo_map[0].time = 0.0;
+	midi_file->tempo_map[0].beat = 0.0;
+	midi_file->tempo_map[0].tempo = 120.0;
+	midi_file->tempo_map[0].event = NULL;
+
+	for (event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x51); event != NULL; event = MidiFileEvent_getNextEventOfType(event, -1, 0x51))
+	{
+		if (event->track == midi_file->first_track)
+		{
+			struct MidiFileTempoMapEntry *previous_entry = &(midi_file->tempo_map[midi_file->number_of_tempo_map_entries - 1]);
+			struct MidiFileTempoMapEntry *entry = &(midi_file->tempo_map[midi_file->number_of_tempo_map_entries]);
+			entry->tick = event->tick;
+			entry->time = previous_entry->time + ((entry->tick - previous_entry->tick) * get_seconds_per_tick(midi_file, previous_entry->tempo));
+			entry->beat = previous_entry->beat + ((entry->tick - previous_entry->tick) * get_beats_per_tick(midi_file, previous_entry->tempo));
+			entry->tempo = get_tempo(event);
+			entry->event = event;
+			(midi_file->number_of_tempo_map_entries)++;
+		}
+	}
+
+	midi_file->tempo_map_is_valid = 1;
+}
+
+static struct MidiFileTempoMapEntry *get_tempo_map_entry_for_tick(MidiFile_t midi_file, long tick, int is_inclusive)
+{
+	/* Finds the last tempo change before the tick (or at it, if inclusive), or the start of the file if none. */
+
+	int low = 1, high;
+
+	update_tempo_map(midi_file);
+	high = midi_file->number_of_tempo_map_entries;
+
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+
+		if ((midi_file->tempo_map[middle].tick < tick) || (is_inclusive && (midi_file->tempo_map[middle].tick == tick)))
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return &(midi_file->tempo_map[low - 1]);
+}
+
+static struct MidiFileTempoMapEntry *get_tempo_map_entry_for_time(MidiFile_t midi_file, double time)
+{
+	/* Finds the last tempo change before the time, or the start of the file if none. */
+
+	int low = 1, high;
+
+	update_tempo_map(midi_file);
+	high = midi_file->number_of_tempo_map_entries;
+
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+
+		if (midi_file->tempo_map[middle].time < time)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return &(midi_file->tempo_map[low - 1]);
+}
+
+static struct MidiFileTempoMapEntry *get_tempo_map_entry_for_beat(MidiFile_t midi_file, double beat)
+{
+	/* Finds the last tempo change before the beat, or the start of the file if none. */
+
+	int low = 1, high;
+
+	update_tempo_map(midi_file);
+	high = midi_file->number_of_tempo_map_entries;
+
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+
+		if (midi_file->tempo_map[middle].beat < beat)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return &(midi_file->tempo_map[low - 1]);
+}
+
+static void update_meter_map(MidiFile_t midi_file)
+{
+	MidiFileEvent_t event;
+	int number_of_meter_map_entries = 1;
+
+	if (midi_file->meter_map_is_valid) return;
+
+	for (event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x58); event != NULL; event = MidiFileEvent_getNextEventOfType(event, -1, 0x58))
+	{
+		if (event->track == midi_file->first_track) number_of_meter_map_entries++;
+	}
+
+	if (number_of_meter_map_entries > midi_file->number_of_meter_map_entries)
+	{
+		free(midi_file->meter_map);
+		midi_file->meter_map = (struct MidiFileMeterMapEntry *)(malloc(sizeof(struct MidiFileMeterMapEntry) * number_of_meter_map_entries));
+	}
+
+	midi_file->number_of_meter_map_entries = 1;
+	midi_file->meter_map[0].tick = 0;
+	midi_file->meter_map[0].beat = 0.0;
+	midi_file->meter_map[0].measure = 0.0;
+	midi_file->meter_map[0].visible_measure = 1;
+	midi_file->meter_map[0].visible_beat = 1.0;
+	midi_file->meter_map[0].visible_whole_beat = 1;
+	midi_file->meter_map[0].visible_tick = 0;
+	midi_file->meter_map[0].numerator = 4;
+	midi_file->meter_map[0].denominator = 4;
+	midi_file->meter_map[0].event = NULL;
+
+	for (event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x58); event != NULL; event = MidiFileEvent_getNextEventOfType(event, -1, 0x58))
+	{
+		if (event->track == midi_file->first_track)
+		{
+			struct MidiFileMeterMapEntry *previous_entry = &(midi_file->meter_map[midi_file->number_of_meter_map_entries - 1]);
+			struct MidiFileMeterMapEntry *entry = &(midi_file->meter_map[midi_file->number_of_meter_map_entries]);
+			double fraction_of_measure;
+			entry->tick = event->tick;
+			entry->beat = MidiFile_getBeatFromTick(midi_file, entry->tick);
+			entry->measure = previous_entry->measure + ((entry->beat - previous_entry->beat) * ((double)(previous_entry->denominator) / previous_entry->numerator / 4));
+			entry->visible_measure = (long)(entry->measure) + 1;
+			fraction_of_measure = entry->measure - (double)(entry->visible_measure - 1);
+			entry->visible_beat = (fraction_of_measure * previous_entry->numerator) + 1.0;
+			entry->visible_whole_beat = (long)(fraction_of_measure * previous_entry->numerator) + 1;
+			entry->visible_tick = entry->tick - MidiFile_getTickFromBeat(midi_file, (float)((long)(entry->beat)));
+			entry->numerator = MidiFileTimeSignatureEvent_getNumerator(event);
+			entry->denominator = MidiFileTimeSignatureEvent_getDenominator(event);
+			entry->event = event;
+			(midi_file->number_of_meter_map_entries)++;
+		}
+	}
+
+	midi_file->meter_map_is_valid = 1;
+}
+
+static struct MidiFileMeterMapEntry *get_meter_map_entry(MidiFile_t midi_file, int (*entry_precedes)(struct MidiFileMeterMapEntry *entry, void *key), void *key)
+{
+	/* Finds the last time signature change for which entry_precedes() holds, or the start of the file if none; the predicate must be monotonic over the map. */
+
+	int low = 1, high;
+
+	update_meter_map(midi_file);
+	high = midi_file->number_of_meter_map_entries;
+
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+
+		if ((*entry_precedes)(&(midi_file->meter_map[middle]), key))
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return &(midi_file->meter_map[low - 1]);
+}
+
+static int meter_map_entry_precedes_tick(struct MidiFileMeterMapEntry *entry, void *key)
+{
+	return (entry->tick < *((long *)(key)));
+}
+
+static int meter_map_entry_precedes_or_is_at_tick(struct MidiFileMeterMapEntry *entry, void *key)
+{
+	return (entry->tick <= *((long *)(key)));
+}
+
+static int meter_map_entry_precedes_measure(struct MidiFileMeterMapEntry *entry, void *key)
+{
+	return (entry->measure < *((double *)(key)));
+}
+
+static int meter_map_entry_precedes_visible_measure(struct MidiFileMeterMapEntry *entry, void *key)
+{
+	return (entry->visible_measure < *((long *)(key)));
+}
+
+static int meter_map_entry_precedes_measure_beat(struct MidiFileMeterMapEntry *entry, void *key)
+{
+	MidiFileMeasureBeat_t measure_beat = (MidiFileMeasureBeat_t)(key);
+	return ((entry->visible_measure < measure_beat->measure) || ((entry->visible_measure == measure_beat->measure) && (entry->visible_beat < measure_beat->beat)));
+}
+
+static int meter_map_entry_precedes_measure_beat_tick(struct MidiFileMeterMapEntry *entry, void *key)
+{
+	MidiFileMeasureBeatTick_t measure_beat_tick = (MidiFileMeasureBeatTick_t)(key);
+	return ((entry->visible_measure < measure_beat_tick->measure) || ((entry->visible_measure == measure_beat_tick->measure) && ((entry->visible_whole_beat < measure_beat_tick->beat) || ((entry->visible_whole_beat == measure_beat_tick->beat) && (entry->visible_tick < measure_beat_tick->tick)))));
+}
+
+static struct MidiFileMeterMapEntry *get_meter_map_entry_for_visible_position(MidiFile_t midi_file, long visible_measure, int (*entry_precedes)(struct MidiFileMeterMapEntry *entry, void *key), void *key)
+{
+	/* Visible beats and ticks are not monotonic within a measure whose meter changes part way through, so search by measure and then step through the changes within it in order. */
+
+	struct MidiFileMeterMapEntry *entry = get_meter_map_entry(midi_file, meter_map_entry_precedes_visible_measure, &visible_measure);
+	struct MidiFileMeterMapEntry *end_of_map = midi_file->meter_map + midi_file->number_of_meter_map_entries;
+
+	while ((entry + 1 < end_of_map) && (entry[1].visible_measure == visible_measure) && (*entry_precedes)(entry + 1, key)) entry++;
+	return entry;
+}
+
+static double get_measure_from_tick(MidiFile_t midi_file, long tick, struct MidiFileMeterMapEntry **entry_out)
+{
+	struct MidiFileMeterMapEntry *entry = get_meter_map_entry(midi_file, meter_map_entry_precedes_tick, &tick);
+	*entry_out = entry;
+	return entry->measure + ((MidiFile_getBeatFromTick(midi_file, tick) - entry->beat) * ((double)(entry->denominator) / entry->numerator / 4));
+}
+
+static int event_precedes_in_file(MidiFileEvent_t event, MidiFileEvent_t other_event)
+{
+	/* Same as the order that adding the events one track at a time would produce. */
+	return (event->tick < other_event->tick) || ((event->tick == other_event->tick) && (event->track->number < other_event->track->number));
+}
+
+static void sift_down_merge_heap(MidiFileEvent_t *heap, int heap_size, int parent, MidiFileEvent_t event)
+{
+	int child;
+
+	for (; (child = (parent * 2) + 1) < heap_size; parent = child)
+	{
+		if ((child + 1 < heap_size) && event_precedes_in_file(heap[child + 1], heap[child])) child++;
+		if (!event_precedes_in_file(heap[child], event)) break;
+		heap[parent] = heap[child];
+	}
+
+	heap[parent] = event;
+}
+
+static void link_tracks_into_file(MidiFile_t midi_file)
+{
+	/* Builds the file list from the already sorted track lists with a k-way merge, using a binary heap of the next unmerged event in each track. */
+
+	MidiFileEvent_t *heap;
+	int heap_size = 0;
+	int parent;
+	MidiFileTrack_t track;
+
+	midi_file->is_loading = 0;
+	drop_type_index(midi_file);
+	if (midi_file->number_of_tracks == 0) return;
+	heap = (MidiFileEvent_t *)(malloc(sizeof(MidiFileEvent_t) * midi_file->number_of_tracks));
+
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
+	{
+		if (track->first_event != NULL) heap[heap_size++] = track->first_event;
+	}
+
+	for (parent = (heap_size / 2) - 1; parent >= 0; parent--) sift_down_merge_heap(heap, heap_size, parent, heap[parent]);
+
+	while (heap_size > 0)
+	{
+		MidiFileEvent_t event = heap[0];
+
+		event->previous_event_in_file = midi_file->last_event;
+		event->next_event_in_file = NULL;
+
+		if (midi_file->last_event == NULL)
+		{
+			midi_file->first_event = event;
+		}
+		else
+		{
+			midi_file->last_event->next_event_in_file = event;
+		}
+
+		midi_file->last_event = event;
+		MidiFileTickIndex_addEvent(&(midi_file->tick_index), event, event->previous_event_in_file, NULL);
+		count_event_in_file(event, 1);
+
+		if (event->next_event_in_track == NULL)
+		{
+			heap_size--;
+			if (heap_size > 0) sift_down_merge_heap(heap, heap_size, 0, heap[heap_size]);
+		}
+		else
+		{
+			sift_down_merge_heap(heap, heap_size, 0, event->next_event_in_track);
+		}
+	}
+
+	free(heap);
+}
+
+static void free_event(MidiFileEvent_t event)
+{
+	/* For events that are no longer in any list. */
+
+	switch (event->type)
+	{
+		case MIDI_FILE_EVENT_TYPE_SYSEX:
+		{
+			MidiFileArena_deallocate(event->arena, event->u.sysex.data_buffer, event->u.sysex.data_length);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_META:
+		{
+			MidiFileArena_deallocate(event->arena, event->u.meta.data_buffer, event->u.meta.data_length + 1);
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	MidiFileArena_deallocateEvent(event);
+}
+
+/*
+ * The bulk converters rewrite each track in a single pass instead of
+ * creating, moving and deleting events one at a time.  They unlink the file
+ * list, take each track's events as a plain list with
+ * begin_rewriting_track(), put back the ones they keep or make in order with
+ * append_event_to_track(), and finally merge the tracks back into the file
+ * list as loading does, which also puts events at the same tick in track
+ * order.
+ */
+
+static void begin_rewriting_file(MidiFile_t midi_file)
+{
+	drop_type_index(midi_file);
+	MidiFileTickIndex_clear(&(midi_file->tick_index));
+	midi_file->first_event = NULL;
+	midi_file->last_event = NULL;
+	midi_file->number_of_events = 0;
+	midi_file->number_of_foreign_events = 0;
+}
+
+static MidiFileEvent_t begin_rewriting_track(MidiFileTrack_t track)
+{
+	MidiFileEvent_t first_event = track->first_event;
+	mark_track_changed(track, LONG_MIN, LONG_MAX);
+	drop_note_pairing_index(track);
+	MidiFileTickIndex_clear(&(track->tick_index));
+	track->first_event = NULL;
+	track->last_event = NULL;
+	return first_event;
+}
+
+static void append_event_to_track(MidiFileTrack_t track, MidiFileEvent_t event)
+{
+	event->track = track;
+	event->previous_event_in_track = track->last_event;
+	event->next_event_in_track = NULL;
+
+	if (track->last_event == NULL)
+	{
+		track->first_event = event;
+	}
+	else
+	{
+		track->last_event->next_event_in_track = event;
+	}
+
+	track->last_event = event;
+	MidiFileTickIndex_addEvent(&(track->tick_index), event, event->previous_event_in_track, NULL);
+	if (event->tick > track->end_tick) track->end_tick = event->tick;
+}
+
+static void finish_rewriting_file(MidiFile_t midi_file)
+{
+	link_tracks_into_file(midi_file);
+}
+
+static void change_event_type(MidiFileEvent_t event, MidiFileEventType_t type)
+{
+	/* Lets a converter reuse an event it would otherwise delete; it stays selected if it was. */
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
+	event->type = type;
+	event->visited_epoch = event->track->midi_file->iteration_epoch;
+	add_event_to_type_index(event);
+}
+
+static MidiFileEvent_t new_event_like(MidiFileEvent_t template_event, MidiFileEventType_t type)
+{
+	MidiFileEvent_t new_event = MidiFileArena_allocateEvent(template_event->track->midi_file->arena);
+	new_event->track = template_event->track;
+	new_event->tick = template_event->tick;
+	new_event->type = type;
+	new_event->visited_epoch = template_event->track->midi_file->iteration_epoch;
+	new_event->is_selected = template_event->is_selected;
+	return new_event;
+}
+
+static unsigned int begin_iteration(MidiFile_t midi_file)
+{
+	/*
+	 * Each iteration gets a new epoch, and stamps the events it visits with
+	 * it, so nothing has to be reset up front.  New events are stamped with
+	 * the latest epoch so that the iteration which created them does not visit
+	 * them.  There is one stamp per event, so this only works for one
+	 * iteration at a time; MidiFileIterator_next() refuses to advance one that
+	 * a newer iteration has overtaken.  If the counter ever wraps around, the
+	 * old stamps are cleared so that none of them can pass for current.
+	 */
+
+	MidiFileEvent_t event;
+
+	if (++(midi_file->iteration_epoch) == 0)
+	{
+		for (event = midi_file->first_event; event != NULL; event = event->next_event_in_file) event->visited_epoch = 0;
+		midi_file->iteration_epoch = 1;
+	}
+
+	return midi_file->iteration_epoch;
+}
+
+static MidiFileEvent_t sort_events_by_tick(MidiFileEvent_t first_event, long number_of_events)
+{
+	/* A stable merge sort of a list linked through next_event_in_track. */
+
+	MidiFileEvent_t end_of_first_half, second_half, first_sorted_event = NULL, last_sorted_event = NULL;
+	long i;
+
+	if (number_of_events < 2) return first_event;
+
+	for (end_of_first_half = first_event, i = 1; i < number_of_events / 2; i++) end_of_first_half = end_of_first_half->next_event_in_track;
+	second_half = end_of_first_half->next_event_in_track;
+	end_of_first_half->next_event_in_track = NULL;
+
+	first_event = sort_events_by_tick(first_event, number_of_events / 2);
+	second_half = sort_events_by_tick(second_half, number_of_events - (number_of_events / 2));
+
+	while ((first_event != NULL) || (second_half != NULL))
+	{
+		MidiFileEvent_t event;
+
+		if ((second_half == NULL) || ((first_event != NULL) && (first_event->tick <= second_half->tick)))
+		{
+			event = first_event;
+			first_event = first_event->next_event_in_track;
+		}
+		else
+		{
+			event = second_half;
+			second_half = second_half->next_event_in_track;
+		}
+
+		if (last_sorted_event == NULL)
+		{
+			first_sorted_event = event;
+		}
+		else
+		{
+			last_sorted_event->next_event_in_track = event;
+		}
+
+		last_sorted_event = event;
+	}
+
+	last_sorted_event->next_event_in_track = NULL;
+	return first_sorted_event;
+}
+
+static unsigned char *read_chunk_header(unsigned char *position, unsigned char *end, unsigned char **chunk_id, unsigned char **chunk_end)
+{
+	/* Returns where the chunk's data starts, or NULL if there isn't a whole chunk header left.  A chunk which claims to run past the end is cut short. */
+
+	unsigned long chunk_size;
+
+	if (end - position < 8) return NULL;
+	*chunk_id = position;
+	chunk_size = interpret_uint32(position + 4);
+	position += 8;
+	*chunk_end = (chunk_size > (unsigned long)(end - position)) ? end : position + chunk_size;
+	return position;
+}
+
+static unsigned char *read_variable_length_quantity(unsigned char *position, unsigned char *end, unsigned long *value)
+{
+	/* Returns the position after the quantity, or NULL if it runs past the end. */
+
+	unsigned long result = 0;
+
+	while (position < end)
+	{
+		unsigned char b = *position++;
+		result = (result << 7) | (b & 0x7F);
+
+		if ((b & 0x80) == 0x00)
+		{
+			*value = result;
+			return position;
+		}
+	}
+
+	return NULL;
+}
+
+static void MidiFileReaderTrack_init(MidiFileReaderTrack_t reader_track, int number, unsigned char *position, unsigned char *end)
+{
+	reader_track->number = number;
+	reader_track->position = position;
+	reader_track->end = end;
+	reader_track->tick = 0;
+	reader_track->running_status = 0;
+}
+
+static int MidiFileReaderTrack_finish(MidiFileReaderTrack_t reader_track)
+{
+	reader_track->position = reader_track->end;
+	return -1;
+}
+
+static int MidiFileReaderTrack_readEvent(MidiFileReaderTrack_t reader_track, MidiFileReaderEvent_t event)
+{
+	/*
+	 * Decodes the next event in the track, returning -1 at the end.  Every
+	 * read is checked against the end of the chunk, so a truncated or corrupt
+	 * track loses its tail instead of running on into the next chunk or past
+	 * the end of the buffer.  The end of track meta event is reported like any
+	 * other, but nothing after it is.  The buffer is never written to.
+	 */
+
+	unsigned char *position = reader_track->position;
+	unsigned char *end = reader_track->end;
+	unsigned long delta_time;
+	unsigned char status;
+
+	while (position < end)
+	{
+		/* the common single byte delta time is decoded inline */
+
+		if ((*position & 0x80) == 0x00)
+		{
+			delta_time = *position++;
+		}
+		else if ((position = read_variable_length_quantity(position, end, &delta_time)) == NULL)
+		{
+			return MidiFileReaderTrack_finish(reader_track);
+		}
+
+		reader_track->tick += delta_time;
+		if (position == end) return MidiFileReaderTrack_finish(reader_track);
+
+		if ((*position & 0x80) == 0x00)
+		{
+			/* running status; the data byte is left in place */
+			status = reader_track->running_status;
+		}
+		else
+		{
+			status = *position++;
+			reader_track->running_status = status;
+		}
+
+		event->track_number = reader_track->number;
+		event->tick = reader_track->tick;
+		event->channel = status & 0x0F;
+		event->data_length = 0;
+		event->data = NULL;
+
+		switch (status & 0xF0)
+		{
+			case 0x80:
+			{
+				if (end - position < 2) return MidiFileReaderTrack_finish(reader_track);
+				event->type = MIDI_FILE_EVENT_TYPE_NOTE_OFF;
+				event->number = position[0];
+				event->value = position[1];
+				reader_track->position = position + 2;
+				return 0;
+			}
+			case 0x90:
+			{
+				if (end - position < 2) return MidiFileReaderTrack_finish(reader_track);
+				event->type = MIDI_FILE_EVENT_TYPE_NOTE_ON;
+				event->number = position[0];
+				event->value = position[1];
+				reader_track->position = position + 2;
+				return 0;
+			}
+			case 0xA0:
+			{
+				if (end - position < 2) return MidiFileReaderTrack_finish(reader_track);
+				event->type = MIDI_FILE_EVENT_TYPE_KEY_PRESSURE;
+				event->number = position[0];
+				event->value = position[1];
+				reader_track->position = position + 2;
+				return 0;
+			}
+			case 0xB0:
+			{
+				if (end - position < 2) return MidiFileReaderTrack_finish(reader_track);
+				event->type = MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE;
+				event->number = position[0];
+				event->value = position[1];
+				reader_track->position = position + 2;
+				return 0;
+			}
+			case 0xC0:
+			{
+				if (end - position < 1) return MidiFileReaderTrack_finish(reader_track);
+				event->type = MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE;
+				event->number = position[0];
+				event->value = 0;
+				reader_track->position = position + 1;
+				return 0;
+			}
+			case 0xD0:
+			{
+				if (end - position < 1) return MidiFileReaderTrack_finish(reader_track);
+				event->type = MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE;
+				event->number = 0;
+				event->value = position[0];
+				reader_track->position = position + 1;
+				return 0;
+			}
+			case 0xE0:
+			{
+				if (end - position < 2) return MidiFileReaderTrack_finish(reader_track);
+				event->type = MIDI_FILE_EVENT_TYPE_PITCH_WHEEL;
+				event->number = 0;
+				event->value = (position[1] << 7) | position[0];
+				reader_track->position = position + 2;
+				return 0;
+			}
+			case 0xF0:
+			{
+				unsigned long data_length;
+
+				switch (status)
 				{
-					case 0x80:
-					{
-						int channel = status & 0x0F;
-						int note = MidiFileIO_getc(io);
-						int velocity = MidiFileIO_getc(io);
-						MidiFileTrack_createNoteOffEvent(track, tick, channel, note, velocity);
-						break;
-					}
-					case 0x90:
-					{
-						int channel = status & 0x0F;
-						int note = MidiFileIO_getc(io);
-						int velocity = MidiFileIO_getc(io);
-						MidiFileTrack_createNoteOnEvent(track, tick, channel, note, velocity);
-						break;
-					}
-					case 0xA0:
-					{
-						int channel = status & 0x0F;
-						int note = MidiFileIO_getc(io);
-						int amount = MidiFileIO_getc(io);
-						MidiFileTrack_createKeyPressureEvent(track, tick, channel, note, amount);
-						break;
-					}
-					case 0xB0:
-					{
-						int channel = status & 0x0F;
-						int number = MidiFileIO_getc(io);
-						int value = MidiFileIO_getc(io);
-						MidiFileTrack_createControlChangeEvent(track, tick, channel, number, value);
-						break;
-					}
-					case 0xC0:
+					case 0xF0:
+					case 0xF7:
 					{
-						int channel = status & 0x0F;
-						int number = MidiFileIO_getc(io);
-						MidiFileTrack_createProgramChangeEvent(track, tick, channel, number);
-						break;
+						if (((position = read_variable_length_quantity(position, end, &data_length)) == NULL) || (data_length > (unsigned long)(end - position))) return MidiFileReaderTrack_finish(reader_track);
+						event->type = MIDI_FILE_EVENT_TYPE_SYSEX;
+						event->channel = -1;
+						event->number = status;
+						event->value = 0;
+						event->data_length = (int)(data_length);
+						event->data = position;
+						reader_track->position = position + data_length;
+						return 0;
 					}
-					case 0xD0:
+					case 0xFF:
 					{
-						int channel = status & 0x0F;
-						int amount = MidiFileIO_getc(io);
-						MidiFileTrack_createChannelPressureEvent(track, tick, channel, amount);
-						break;
+						if (position == end) return MidiFileReaderTrack_finish(reader_track);
+						event->number = *position++;
+						if (((position = read_variable_length_quantity(position, end, &data_length)) == NULL) || (data_length > (unsigned long)(end - position))) return MidiFileReaderTrack_finish(reader_track);
+						event->type = MIDI_FILE_EVENT_TYPE_META;
+						event->channel = -1;
+						event->value = 0;
+						event->data_length = (int)(data_length);
+						event->data = position;
+						reader_track->position = (event->number == 0x2F) ? end : position + data_length;
+						return 0;
 					}
-					case 0xE0:
+					default:
 					{
-						int channel = status & 0x0F;
-						int value = MidiFileIO_getc(io);
-						value = (MidiFileIO_getc(io) << 7) | value;
-						MidiFileTrack_createPitchWheelEvent(track, tick, channel, value);
 						break;
 					}
-					case 0xF0:
-					{
-						switch (status)
-						{
-							case 0xF0:
-							case 0xF7:
-							{
-								int data_length = read_variable_length_quantity(io) + 1;
-								unsigned char *data_buffer = malloc(data_length);
-								data_buffer[0] = status;
-								MidiFileIO_read(io, data_length - 1, data_buffer + 1);
-								MidiFileTrack_createSysexEvent(track, tick, data_length, data_buffer);
-								free(data_buffer);
-								break;
-							}
-							case 0xFF:
-							{
-								int number = MidiFileIO_getc(io);
-								int data_length = read_variable_length_quantity(io);
-								unsigned char *data_buffer = malloc(data_length);
-								MidiFileIO_read(io, data_length, data_buffer);
-
-								if (number == 0x2F)
-								{
-									MidiFileTrack_setEndTick(track, tick);
-									at_end_of_track = 1;
-								}
-								else
-								{
-									MidiFileTrack_createMetaEvent(track, tick, number, data_length, data_buffer);
-								}
-
-								free(data_buffer);
-								break;
-							}
-						}
+				}
+
+				break;
+			}
+			default:
+			{
+				/* a data byte without any running status to go with it gets read again as a delta time */
+				break;
+			}
+		}
+	}
+
+	return MidiFileReaderTrack_finish(reader_track);
+}
+
+static int reader_track_precedes(MidiFileReaderTrack_t reader_track, MidiFileReaderTrack_t other_reader_track)
+{
+	/* Compares the tracks' next events, in the same order as event_precedes_in_file(). */
+	return (reader_track->next_event.tick < other_reader_track->next_event.tick) || ((reader_track->next_event.tick == other_reader_track->next_event.tick) && (reader_track->number < other_reader_track->number));
+}
+
+static void sift_down_reader_heap(MidiFileReaderTrack_t *heap, int heap_size, int parent, MidiFileReaderTrack_t reader_track)
+{
+	int child;
+
+	for (; (child = (parent * 2) + 1) < heap_size; parent = child)
+	{
+		if ((child + 1 < heap_size) && reader_track_precedes(heap[child + 1], heap[child])) child++;
+		if (!reader_track_precedes(heap[child], reader_track)) break;
+		heap[parent] = heap[child];
+	}
+
+	heap[parent] = reader_track;
+}
+
+static MidiFileEvent_t new_loaded_event(MidiFileTrack_t track, MidiFileArena_t arena, long tick, MidiFileEventType_t type)
+{
+	/* Allocates the event, but leaves filling in the data and appending it to the track to the caller.  The arena is the file's own except in a parallel load. */
+
+	MidiFileEvent_t new_event = MidiFileArena_allocateEvent(arena);
+	new_event->track = track;
+	new_event->tick = tick;
+	new_event->type = type;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
+	new_event->is_selected = 0;
+	return new_event;
+}
+
+static void load_track(MidiFileTrack_t track, MidiFileArena_t arena, unsigned char *position, unsigned char *end, int is_mapped)
+{
+	/* Ticks never decrease within a track, so events are simply appended. */
+
+	struct MidiFileReaderTrack reader_track;
+	struct MidiFileReaderEvent reader_event;
+	unsigned char *terminator_position = NULL;
+	MidiFileEvent_t event;
+
+	MidiFileReaderTrack_init(&reader_track, track->number, position, end);
+
+	while (MidiFileReaderTrack_readEvent(&reader_track, &reader_event) == 0)
+	{
+		if (terminator_position != NULL)
+		{
+			/* the byte after a mapped meta event's data has been read by now, so its terminator can go there */
+			*terminator_position = '\0';
+			terminator_position = NULL;
+		}
+
+		switch (reader_event.type)
+		{
+			case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
+			{
+				event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_NOTE_OFF);
+				event->u.note_off.channel = reader_event.channel;
+				event->u.note_off.note = reader_event.number;
+				event->u.note_off.velocity = reader_event.value;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_NOTE_ON:
+			{
+				event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_NOTE_ON);
+				event->u.note_on.channel = reader_event.channel;
+				event->u.note_on.note = reader_event.number;
+				event->u.note_on.velocity = reader_event.value;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
+			{
+				event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_KEY_PRESSURE);
+				event->u.key_pressure.channel = reader_event.channel;
+				event->u.key_pressure.note = reader_event.number;
+				event->u.key_pressure.amount = reader_event.value;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
+			{
+				event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE);
+				event->u.control_change.channel = reader_event.channel;
+				event->u.control_change.number = reader_event.number;
+				event->u.control_change.value = reader_event.value;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
+			{
+				event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE);
+				event->u.program_change.channel = reader_event.channel;
+				event->u.program_change.number = reader_event.number;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE:
+			{
+				event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE);
+				event->u.channel_pressure.channel = reader_event.channel;
+				event->u.channel_pressure.amount = reader_event.value;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_PITCH_WHEEL:
+			{
+				event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_PITCH_WHEEL);
+				event->u.pitch_wheel.channel = reader_event.channel;
+				event->u.pitch_wheel.value = reader_event.value;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_SYSEX:
+			{
+				if (is_mapped)
+				{
+					/* the data stays where it is, with the status byte written over the last byte of the length in front of it */
+					event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_SYSEX);
+					event->u.sysex.data_length = reader_event.data_length + 1;
+					event->u.sysex.data_buffer = reader_event.data - 1;
+					reader_event.data[-1] = reader_event.number;
+				}
+				else
+				{
+					event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_SYSEX);
+					event->u.sysex.data_length = reader_event.data_length + 1;
+					event->u.sysex.data_buffer = (unsigned char *)(MidiFileArena_allocate(arena, reader_event.data_length + 1));
+					event->u.sysex.data_buffer[0] = reader_event.number;
+					memcpy(event->u.sysex.data_buffer + 1, reader_event.data, reader_event.data_length);
+				}
+
+				break;
+			}
+			default:
+			{
+				/* the only other type the reader returns is meta */
+
+				if (reader_event.number == 0x2F)
+				{
+					MidiFileTrack_setEndTick(track, reader_event.tick);
+					return;
+				}
+
+				if (is_mapped && (reader_event.data + reader_event.data_length < end))
+				{
+					/* the data stays where it is, with its terminator written over the byte after it once that has been read */
+					event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_META);
+					event->u.meta.number = reader_event.number;
+					event->u.meta.data_length = reader_event.data_length;
+					event->u.meta.data_buffer = reader_event.data;
+					terminator_position = reader_event.data + reader_event.data_length;
+				}
+				else
+				{
+					event = new_loaded_event(track, arena, reader_event.tick, MIDI_FILE_EVENT_TYPE_META);
+					event->u.meta.number = reader_event.number;
+					event->u.meta.data_length = reader_event.data_length;
+					event->u.meta.data_buffer = (unsigned char *)(MidiFileArena_allocate(arena, reader_event.data_length + 1));
+					memcpy(event->u.meta.data_buffer, reader_event.data, reader_event.data_length);
+					event->u.meta.data_buffer[reader_event.data_length] = '\0';
+				}
+
+				break;
+			}
+		}
+
+		append_event_to_track(track, event);
+	}
+
+	if (terminator_position != NULL) *terminator_position = '\0';
+}
+
+static unsigned char *read_header_chunk(unsigned char *buffer, unsigned char *end, int *file_format, int *number_of_tracks, MidiFileDivisionType_t *division_type, int *resolution)
+{
+	/* Returns where the chunks after the header start, or NULL if this is not a MIDI file. */
+
+	unsigned char *chunk_id, *chunk_start, *chunk_end;
+
+	/* check for the RMID variation on SMF; its chunk sizes are little-endian, and not needed since the SMF runs to the end */
+
+	if ((end - buffer >= 4) && (memcmp(buffer, "RIFF", 4) == 0))
+	{
+		if ((end - buffer < 20) || (memcmp(buffer + 8, "RMID", 4) != 0) || (memcmp(buffer + 12, "data", 4) != 0))
+		{
+			return NULL;
+		}
+
+		buffer += 20;
+	}
+
+	if ((chunk_start = read_chunk_header(buffer, end, &chunk_id, &chunk_end)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((memcmp(chunk_id, "MThd", 4) != 0) || (chunk_end - chunk_start < 6))
+	{
+		return NULL;
+	}
+
+	*file_format = interpret_uint16(chunk_start);
+	*number_of_tracks = interpret_uint16(chunk_start + 2);
+	*resolution = chunk_start[5];
+
+	switch ((signed char)(chunk_start[4]))
+	{
+		case -24:
+		{
+			*division_type = MIDI_FILE_DIVISION_TYPE_SMPTE24;
+			break;
+		}
+		case -25:
+		{
+			*division_type = MIDI_FILE_DIVISION_TYPE_SMPTE25;
+			break;
+		}
+		case -29:
+		{
+			*division_type = MIDI_FILE_DIVISION_TYPE_SMPTE30DROP;
+			break;
+		}
+		case -30:
+		{
+			*division_type = MIDI_FILE_DIVISION_TYPE_SMPTE30;
+			break;
+		}
+		default:
+		{
+			*division_type = MIDI_FILE_DIVISION_TYPE_PPQ;
+			*resolution = interpret_uint16(chunk_start + 4);
+			break;
+		}
+	}
+
+	return chunk_end;
+}
+
+static unsigned char *read_track_chunk_header(unsigned char *position, unsigned char *end, unsigned char **chunk_end)
+{
+	/* Returns where the next track's data starts, or NULL if there are no more.  For forwards compatibility, any other chunks on the way are skipped. */
+
+	unsigned char *chunk_id, *chunk_start;
+
+	for (; (chunk_start = read_chunk_header(position, end, &chunk_id, chunk_end)) != NULL; position = *chunk_end)
+	{
+		if (memcmp(chunk_id, "MTrk", 4) == 0) return chunk_start;
+	}
+
+	return NULL;
+}
+
+static MidiFile_t load_midi_file(unsigned char *buffer, long buffer_length, int is_mapped)
+{
+	MidiFile_t midi_file;
+	unsigned char *end = buffer + buffer_length;
+	unsigned char *position, *chunk_start, *chunk_end;
+	int file_format, number_of_tracks, resolution, number_of_tracks_read;
+	MidiFileDivisionType_t division_type;
+
+	if ((position = read_header_chunk(buffer, end, &file_format, &number_of_tracks, &division_type, &resolution)) == NULL) return NULL;
+	midi_file = MidiFile_new(file_format, division_type, resolution);
+
+	/* tracks are read into their own lists first, then merged into the file list all at once */
+	midi_file->is_loading = 1;
+
+	for (number_of_tracks_read = 0; (number_of_tracks_read < number_of_tracks) && ((chunk_start = read_track_chunk_header(position, end, &chunk_end)) != NULL); number_of_tracks_read++)
+	{
+		load_track(MidiFile_createTrack(midi_file), midi_file->arena, chunk_start, chunk_end, is_mapped);
+		position = chunk_end;
+	}
+
+	link_tracks_into_file(midi_file);
+	return midi_file;
+}
+
+static int get_number_of_processors(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO system_info;
+	GetSystemInfo(&system_info);
+	return (int)(system_info.dwNumberOfProcessors);
+#else
+	long number_of_processors = sysconf(_SC_NPROCESSORS_ONLN);
+	return (number_of_processors < 1) ? 1 : (int)(number_of_processors);
+#endif
+}
+
+static struct MidiFileParallelLoadTrack *MidiFileParallelLoad_takeTrack(MidiFileParallelLoad_t load)
+{
+	/* Returns NULL once every track has been taken. */
+
+	struct MidiFileParallelLoadTrack *next_track = NULL;
+
+#ifdef _WIN32
+	EnterCriticalSection(&(load->critical_section));
+#else
+	pthread_mutex_lock(&(load->mutex));
+#endif
+
+	if (load->next_track_number < load->number_of_tracks) next_track = &(load->tracks[(load->next_track_number)++]);
+
+#ifdef _WIN32
+	LeaveCriticalSection(&(load->critical_section));
+#else
+	pthread_mutex_unlock(&(load->mutex));
+#endif
+
+	return next_track;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI MidiFileParallelLoadWorker_run(LPVOID user_data)
+#else
+static void *MidiFileParallelLoadWorker_run(void *user_data)
+#endif
+{
+	MidiFileParallelLoadWorker_t worker = (MidiFileParallelLoadWorker_t)(user_data);
+	struct MidiFileParallelLoadTrack *next_track;
+	MidiFileTrack_t track;
+	MidiFileEvent_t event;
+
+	while ((next_track = MidiFileParallelLoad_takeTrack(worker->load)) != NULL)
+	{
+		track = next_track->track;
+
+		/* the tick index nodes come from the worker's arena too, but every event and node will belong to the file's arena once the arenas are spliced */
+		track->tick_index.arena = worker->arena;
+		load_track(track, worker->arena, next_track->start, next_track->end, 0);
+		track->tick_index.arena = worker->file_arena;
+		if (worker->arena != worker->file_arena) for (event = track->first_event; event != NULL; event = event->next_event_in_track) event->arena = worker->file_arena;
+	}
+
+	return 0;
+}
+
+static MidiFile_t load_midi_file_in_parallel(unsigned char *buffer, long buffer_length, int number_of_threads)
+{
+	MidiFile_t midi_file;
+	unsigned char *end = buffer + buffer_length;
+	unsigned char *position, *chunk_start, *chunk_end;
+	int file_format, number_of_tracks, resolution, number_of_tracks_read, worker_number;
+	MidiFileDivisionType_t division_type;
+	struct MidiFileParallelLoad load;
+	struct MidiFileParallelLoadWorker *workers;
+
+	if ((position = read_header_chunk(buffer, end, &file_format, &number_of_tracks, &division_type, &resolution)) == NULL) return NULL;
+	midi_file = MidiFile_new(file_format, division_type, resolution);
+	midi_file->is_loading = 1;
+	load.tracks = (struct MidiFileParallelLoadTrack *)(malloc(sizeof(struct MidiFileParallelLoadTrack) * (number_of_tracks + 1)));
+
+	for (number_of_tracks_read = 0; (number_of_tracks_read < number_of_tracks) && ((chunk_start = read_track_chunk_header(position, end, &chunk_end)) != NULL); number_of_tracks_read++)
+	{
+		load.tracks[number_of_tracks_read].track = MidiFile_createTrack(midi_file);
+		load.tracks[number_of_tracks_read].start = chunk_start;
+		load.tracks[number_of_tracks_read].end = chunk_end;
+		position = chunk_end;
+	}
+
+	load.number_of_tracks = number_of_tracks_read;
+	load.next_track_number = 0;
+#ifdef _WIN32
+	InitializeCriticalSection(&(load.critical_section));
+#else
+	pthread_mutex_init(&(load.mutex), NULL);
+#endif
+
+	if (number_of_threads <= 0) number_of_threads = get_number_of_processors();
+	if (number_of_threads > number_of_tracks_read) number_of_threads = number_of_tracks_read;
+	if (number_of_threads < 1) number_of_threads = 1;
+	workers = (struct MidiFileParallelLoadWorker *)(malloc(sizeof(struct MidiFileParallelLoadWorker) * number_of_threads));
+
+	for (worker_number = 0; worker_number < number_of_threads; worker_number++)
+	{
+		workers[worker_number].load = &load;
+		workers[worker_number].arena = (worker_number == 0) ? midi_file->arena : MidiFileArena_new();
+		workers[worker_number].file_arena = midi_file->arena;
+
+		/* if a thread cannot be started, the others simply take its share */
+#ifdef _WIN32
+		workers[worker_number].is_running = (worker_number > 0) && ((workers[worker_number].thread = CreateThread(NULL, 0, MidiFileParallelLoadWorker_run, &(workers[worker_number]), 0, NULL)) != NULL);
+#else
+		workers[worker_number].is_running = (worker_number > 0) && (pthread_create(&(workers[worker_number].thread), NULL, MidiFileParallelLoadWorker_run, &(workers[worker_number])) == 0);
+#endif
+	}
+
+	MidiFileParallelLoadWorker_run(&(workers[0]));
+
+	for (worker_number = 1; worker_number < number_of_threads; worker_number++)
+	{
+		if (workers[worker_number].is_running)
+		{
+#ifdef _WIN32
+			WaitForSingleObject(workers[worker_number].thread, INFINITE);
+			CloseHandle(workers[worker_number].thread);
+#else
+			pthread_join(workers[worker_number].thread, NULL);
+#endif
+		}
+
+		MidiFileArena_splice(midi_file->arena, workers[worker_number].arena);
+	}
+
+#ifdef _WIN32
+	DeleteCriticalSection(&(load.critical_section));
+#else
+	pthread_mutex_destroy(&(load.mutex));
+#endif
+	free(workers);
+	free(load.tracks);
+	link_tracks_into_file(midi_file);
+	return midi_file;
+}
+
+static unsigned char *read_file(FILE *in, long *length)
+{
+	/* Reads the whole of a file or stream into memory in one go, since the loader works on a buffer. */
+
+	long buffer_size = 64 * 1024;
+	unsigned char *buffer = (unsigned char *)(malloc(buffer_size));
+
+	*length = 0;
+
+	while (1)
+	{
+		*length += (long)(fread(buffer + *length, 1, buffer_size - *length, in));
+		if (*length < buffer_size) break;
+		buffer_size *= 2;
+		buffer = (unsigned char *)(realloc(buffer, buffer_size));
+	}
+
+	return buffer;
+}
+
+static MidiFileReader_t new_reader(unsigned char *buffer, long buffer_length, MidiFileReaderMode_t mode)
+{
+	/* Finds where each track starts without decoding any of them, then primes the heap in merged mode. */
+
+	MidiFileReader_t reader;
+	unsigned char *end = buffer + buffer_length;
+	unsigned char *position, *chunk_start, *chunk_end;
+	int file_format, number_of_tracks, resolution, parent;
+	MidiFileDivisionType_t division_type;
+
+	if ((position = read_header_chunk(buffer, end, &file_format, &number_of_tracks, &division_type, &resolution)) == NULL) return NULL;
+
+	reader = (MidiFileReader_t)(malloc(sizeof(struct MidiFileReader)));
+	reader->mode = mode;
+	reader->buffer = buffer;
+	reader->buffer_length = buffer_length;
+	reader->buffer_is_mapped = 0;
+	reader->buffer_is_owned = 0;
+	reader->file_format = file_format;
+	reader->division_type = division_type;
+	reader->resolution = resolution;
+	reader->number_of_tracks = 0;
+	reader->tracks = (struct MidiFileReaderTrack *)(malloc(sizeof(struct MidiFileReaderTrack) * (number_of_tracks + 1)));
+	reader->current_track_number = 0;
+	reader->heap = NULL;
+	reader->heap_size = 0;
+
+	for (; (reader->number_of_tracks < number_of_tracks) && ((chunk_start = read_track_chunk_header(position, end, &chunk_end)) != NULL); reader->number_of_tracks++)
+	{
+		MidiFileReaderTrack_init(&(reader->tracks[reader->number_of_tracks]), reader->number_of_tracks, chunk_start, chunk_end);
+		position = chunk_end;
+	}
+
+	if (mode == MIDI_FILE_READER_MODE_MERGED)
+	{
+		int number;
+
+		reader->heap = (MidiFileReaderTrack_t *)(malloc(sizeof(MidiFileReaderTrack_t) * (reader->number_of_tracks + 1)));
+
+		for (number = 0; number < reader->number_of_tracks; number++)
+		{
+			MidiFileReaderTrack_t reader_track = &(reader->tracks[number]);
+			if (MidiFileReaderTrack_readEvent(reader_track, &(reader_track->next_event)) == 0) reader->heap[reader->heap_size++] = reader_track;
+		}
+
+		for (parent = (reader->heap_size / 2) - 1; parent >= 0; parent--) sift_down_reader_heap(reader->heap, reader->heap_size, parent, reader->heap[parent]);
+	}
+
+	return reader;
+}
+
+static unsigned char *encode_header(unsigned char *position, int file_format, int number_of_tracks, MidiFileDivisionType_t division_type, int resolution)
+{
+	memcpy(position, "MThd", 4);
+	position = encode_uint32(position + 4, 6);
+	position = encode_uint16(position, (unsigned short)(file_format));
+	position = encode_uint16(position, (unsigned short)(number_of_tracks));
+
+	switch (division_type)
+	{
+		case MIDI_FILE_DIVISION_TYPE_PPQ:
+		{
+			position = encode_uint16(position, (unsigned short)(resolution));
+			break;
+		}
+		case MIDI_FILE_DIVISION_TYPE_SMPTE24:
+		{
+			*position++ = (unsigned char)(-24);
+			*position++ = (unsigned char)(resolution);
+			break;
+		}
+		case MIDI_FILE_DIVISION_TYPE_SMPTE25:
+		{
+			*position++ = (unsigned char)(-25);
+			*position++ = (unsigned char)(resolution);
+			break;
+		}
+		case MIDI_FILE_DIVISION_TYPE_SMPTE30DROP:
+		{
+			*position++ = (unsigned char)(-29);
+			*position++ = (unsigned char)(resolution);
+			break;
+		}
+		case MIDI_FILE_DIVISION_TYPE_SMPTE30:
+		{
+			*position++ = (unsigned char)(-30);
+			*position++ = (unsigned char)(resolution);
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	return position;
+}
+
+static long get_track_size(MidiFileTrack_t track)
+{
+	/* The number of bytes encode_event() and the end of track event will take, without encoding anything. */
+
+	MidiFileEvent_t event;
+	long size = 0, previous_tick = 0;
+
+	for (event = track->first_event; event != NULL; event = event->next_event_in_track)
+	{
+		size += get_variable_length_quantity_size((unsigned long)(event->tick - previous_tick));
+
+		switch (event->type)
+		{
+			case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
+			case MIDI_FILE_EVENT_TYPE_NOTE_ON:
+			case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
+			case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
+			case MIDI_FILE_EVENT_TYPE_PITCH_WHEEL:
+			{
+				size += 3;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
+			case MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE:
+			{
+				size += 2;
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_SYSEX:
+			{
+				size += 1 + get_variable_length_quantity_size(event->u.sysex.data_length - 1) + (event->u.sysex.data_length - 1);
+				break;
+			}
+			case MIDI_FILE_EVENT_TYPE_META:
+			{
+				size += 2 + get_variable_length_quantity_size(event->u.meta.data_length) + event->u.meta.data_length;
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+
+		previous_tick = event->tick;
+	}
+
+	return size + get_variable_length_quantity_size((unsigned long)(track->end_tick - previous_tick)) + 3;
+}
+
+static void save_event(MidiFileEvent_t event, long previous_tick, MidiFileOutput_t output)
+{
+	/* Everything but sysex and meta data is encoded in place; 16 bytes is enough for the longest of it. */
+
+	unsigned char *position = encode_variable_length_quantity(MidiFileOutput_reserve(output, 16), (unsigned long)(event->tick - previous_tick));
+
+	switch (event->type)
+	{
+		case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
+		{
+			*position++ = (unsigned char)(0x80 | (event->u.note_off.channel & 0x0F));
+			*position++ = (unsigned char)(event->u.note_off.note & 0x7F);
+			*position++ = (unsigned char)(event->u.note_off.velocity & 0x7F);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE_ON:
+		{
+			*position++ = (unsigned char)(0x90 | (event->u.note_on.channel & 0x0F));
+			*position++ = (unsigned char)(event->u.note_on.note & 0x7F);
+			*position++ = (unsigned char)(event->u.note_on.velocity & 0x7F);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
+		{
+			*position++ = (unsigned char)(0xA0 | (event->u.key_pressure.channel & 0x0F));
+			*position++ = (unsigned char)(event->u.key_pressure.note & 0x7F);
+			*position++ = (unsigned char)(event->u.key_pressure.amount & 0x7F);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
+		{
+			*position++ = (unsigned char)(0xB0 | (event->u.control_change.channel & 0x0F));
+			*position++ = (unsigned char)(event->u.control_change.number & 0x7F);
+			*position++ = (unsigned char)(event->u.control_change.value & 0x7F);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
+		{
+			*position++ = (unsigned char)(0xC0 | (event->u.program_change.channel & 0x0F));
+			*position++ = (unsigned char)(event->u.program_change.number & 0x7F);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE:
+		{
+			*position++ = (unsigned char)(0xD0 | (event->u.channel_pressure.channel & 0x0F));
+			*position++ = (unsigned char)(event->u.channel_pressure.amount & 0x7F);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_PITCH_WHEEL:
+		{
+			*position++ = (unsigned char)(0xE0 | (event->u.pitch_wheel.channel & 0x0F));
+			*position++ = (unsigned char)(event->u.pitch_wheel.value & 0x7F);
+			*position++ = (unsigned char)((event->u.pitch_wheel.value >> 7) & 0x7F);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_SYSEX:
+		{
+			*position++ = event->u.sysex.data_buffer[0];
+			MidiFileOutput_commit(output, encode_variable_length_quantity(position, event->u.sysex.data_length - 1));
+			MidiFileOutput_write(output, event->u.sysex.data_buffer + 1, event->u.sysex.data_length - 1);
+			return;
+		}
+		case MIDI_FILE_EVENT_TYPE_META:
+		{
+			*position++ = 0xFF;
+			*position++ = (unsigned char)(event->u.meta.number & 0x7F);
+			MidiFileOutput_commit(output, encode_variable_length_quantity(position, event->u.meta.data_length));
+			MidiFileOutput_write(output, event->u.meta.data_buffer, event->u.meta.data_length);
+			return;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	MidiFileOutput_commit(output, position);
+}
+
+static void save_track(MidiFileTrack_t track, MidiFileOutput_t output)
+{
+	MidiFileEvent_t event;
+	unsigned char *position;
+	long previous_tick = 0;
+
+	position = MidiFileOutput_reserve(output, 8);
+	memcpy(position, "MTrk", 4);
+	MidiFileOutput_commit(output, encode_uint32(position + 4, get_track_size(track)));
+
+	for (event = track->first_event; event != NULL; event = event->next_event_in_track)
+	{
+		save_event(event, previous_tick, output);
+		previous_tick = event->tick;
+	}
+
+	position = encode_variable_length_quantity(MidiFileOutput_reserve(output, 8), (unsigned long)(track->end_tick - previous_tick));
+	memcpy(position, "\xFF\x2F\x00", 3);
+	MidiFileOutput_commit(output, position + 3);
+}
+
+static void save_midi_file(MidiFile_t midi_file, MidiFileOutput_t output)
+{
+	MidiFileTrack_t track;
+
+	MidiFileOutput_commit(output, encode_header(MidiFileOutput_reserve(output, 14), midi_file->file_format, MidiFile_getNumberOfTracks(midi_file), midi_file->division_type, midi_file->resolution));
+	for (track = midi_file->first_track; track != NULL; track = track->next_track) save_track(track, output);
+	MidiFileOutput_flush(output);
+}
+
+static int write_to_file(unsigned char *buffer, int length, void *user_data)
+{
+	return (fwrite(buffer, 1, length, (FILE *)(user_data)) == (size_t)(length)) ? 0 : -1;
+}
+
+static int write_to_writer(unsigned char *buffer, int length, void *user_data)
+{
+	MidiFileWriter_t writer = (MidiFileWriter_t)(user_data);
+	if (fwrite(buffer, 1, length, writer->out) != (size_t)(length)) return -1;
+	writer->number_of_bytes_flushed += length;
+	return 0;
+}
+
+static int patch_file(FILE *file, long offset, unsigned char *data, int length)
+{
+	if ((fseek(file, offset, SEEK_SET) != 0) || (fwrite(data, 1, length, file) != (size_t)(length))) return -1;
+	return 0;
+}
+
+static int truncate_file(FILE *file, long length)
+{
+	if (fflush(file) != 0) return -1;
+#ifdef _WIN32
+	return _chsize(_fileno(file), length);
+#else
+	return ftruncate(fileno(file), length);
+#endif
+}
+
+static unsigned char *MidiFileWriter_startEvent(MidiFileWriter_t writer, long tick)
+{
+	/* Returns where to encode the rest of an event after its delta time, with room for 16 bytes, or NULL if it cannot be appended. */
+
+	unsigned char *position;
+
+	if ((writer == NULL) || (writer->track_start < 0) || (tick < writer->previous_tick)) return NULL;
+	position = encode_variable_length_quantity(MidiFileOutput_reserve(&(writer->output), 16), (unsigned long)(tick - writer->previous_tick));
+	writer->previous_tick = tick;
+	return position;
+}
+
+static int MidiFileWriter_finishEvent(MidiFileWriter_t writer, unsigned char *position)
+{
+	MidiFileOutput_commit(&(writer->output), position);
+	return writer->output.failed ? -1 : 0;
+}
+
+static void MidiFileWriter_finishTrack(MidiFileWriter_t writer)
+{
+	/* Appends the end of track event for good and patches in the chunk length, leaving the file position at the end. */
+
+	unsigned char chunk_size[4];
+	long track_end;
+
+	if (writer->track_start < 0) return;
+
+	MidiFileOutput_write(&(writer->output), (unsigned char *)("\x00\xFF\x2F\x00"), 4);
+	MidiFileOutput_flush(&(writer->output));
+	track_end = writer->number_of_bytes_flushed;
+	encode_uint32(chunk_size, (unsigned long)(track_end - writer->track_start));
+	if ((patch_file(writer->out, writer->track_start - 4, chunk_size, 4) != 0) || (fseek(writer->out, track_end, SEEK_SET) != 0)) writer->output.failed = 1;
+	writer->track_start = -1;
+}
+
+static void retain_snapshot_reference(long *reference_count)
+{
+#ifdef _WIN32
+	InterlockedIncrement((LONG volatile *)(reference_count));
+#else
+	__sync_add_and_fetch(reference_count, 1);
+#endif
+}
+
+static int release_snapshot_reference(long *reference_count)
+{
+	/* Returns nonzero if that was the last reference. */
+#ifdef _WIN32
+	return (InterlockedDecrement((LONG volatile *)(reference_count)) == 0);
+#else
+	return (__sync_sub_and_fetch(reference_count, 1) == 0);
+#endif
+}
+
+static void release_snapshot_track(struct MidiFileSnapshotTrack *snapshot_track)
+{
+	int chunk_number;
+
+	if ((snapshot_track == NULL) || !release_snapshot_reference(&(snapshot_track->reference_count))) return;
+
+	for (chunk_number = 0; chunk_number < snapshot_track->number_of_chunks; chunk_number++)
+	{
+		if (release_snapshot_reference(&(snapshot_track->chunks[chunk_number]->reference_count))) free(snapshot_track->chunks[chunk_number]);
+	}
+
+	free(snapshot_track->chunks);
+	free(snapshot_track);
+}
+
+static void write_snapshot_byte(struct MidiFileSnapshotBuffer *buffer, int value)
+{
+	if (buffer->length == buffer->size)
+	{
+		buffer->size = (buffer->size == 0) ? 4096 : (buffer->size * 2);
+		buffer->bytes = (unsigned char *)(realloc(buffer->bytes, buffer->size));
+	}
+
+	buffer->bytes[(buffer->length)++] = (unsigned char)(value);
+}
+
+static void write_snapshot_number(struct MidiFileSnapshotBuffer *buffer, unsigned long value)
+{
+	/* Seven bits at a time, least significant first, with the high bit set on all but the last byte. */
+
+	while (value >= 0x80)
+	{
+		write_snapshot_byte(buffer, (int)((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+
+	write_snapshot_byte(buffer, (int)(value));
+}
+
+static void write_snapshot_bytes(struct MidiFileSnapshotBuffer *buffer, unsigned char *data, int data_length)
+{
+	int i;
+	write_snapshot_number(buffer, (unsigned long)(data_length));
+	for (i = 0; i < data_length; i++) write_snapshot_byte(buffer, data[i]);
+}
+
+static unsigned long read_snapshot_number(unsigned char **position)
+{
+	unsigned long value = 0;
+	int shift = 0;
+
+	while (**position & 0x80)
+	{
+		value |= (unsigned long)(**position & 0x7F) << shift;
+		shift += 7;
+		(*position)++;
+	}
+
+	value |= (unsigned long)(**position) << shift;
+	(*position)++;
+	return value;
+}
+
+static void encode_snapshot_event(struct MidiFileSnapshotBuffer *buffer, MidiFileEvent_t event, long previous_tick)
+{
+	write_snapshot_number(buffer, (unsigned long)(event->tick - previous_tick));
+	write_snapshot_byte(buffer, event->type);
+
+	switch (event->type)
+	{
+		case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
+		{
+			write_snapshot_byte(buffer, event->u.note_off.channel);
+			write_snapshot_byte(buffer, event->u.note_off.note);
+			write_snapshot_byte(buffer, event->u.note_off.velocity);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE_ON:
+		{
+			write_snapshot_byte(buffer, event->u.note_on.channel);
+			write_snapshot_byte(buffer, event->u.note_on.note);
+			write_snapshot_byte(buffer, event->u.note_on.velocity);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
+		{
+			write_snapshot_byte(buffer, event->u.key_pressure.channel);
+			write_snapshot_byte(buffer, event->u.key_pressure.note);
+			write_snapshot_byte(buffer, event->u.key_pressure.amount);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
+		{
+			write_snapshot_byte(buffer, event->u.control_change.channel);
+			write_snapshot_byte(buffer, event->u.control_change.number);
+			write_snapshot_byte(buffer, event->u.control_change.value);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
+		{
+			write_snapshot_byte(buffer, event->u.program_change.channel);
+			write_snapshot_byte(buffer, event->u.program_change.number);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE:
+		{
+			write_snapshot_byte(buffer, event->u.channel_pressure.channel);
+			write_snapshot_byte(buffer, event->u.channel_pressure.amount);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_PITCH_WHEEL:
+		{
+			write_snapshot_byte(buffer, event->u.pitch_wheel.channel);
+			write_snapshot_number(buffer, (unsigned short)(event->u.pitch_wheel.value));
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_SYSEX:
+		{
+			write_snapshot_bytes(buffer, event->u.sysex.data_buffer, event->u.sysex.data_length);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_META:
+		{
+			write_snapshot_byte(buffer, event->u.meta.number);
+			write_snapshot_bytes(buffer, event->u.meta.data_buffer, event->u.meta.data_length);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE:
+		{
+			write_snapshot_byte(buffer, event->u.note.channel);
+			write_snapshot_byte(buffer, event->u.note.note);
+			write_snapshot_byte(buffer, event->u.note.velocity);
+			write_snapshot_byte(buffer, event->u.note.end_velocity);
+			write_snapshot_number(buffer, (unsigned long)(event->u.note.duration_ticks));
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE:
+		{
+			write_snapshot_byte(buffer, event->u.fine_control_change.channel);
+			write_snapshot_byte(buffer, event->u.fine_control_change.coarse_number);
+			write_snapshot_number(buffer, (unsigned short)(event->u.fine_control_change.value));
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_RPN:
+		{
+			write_snapshot_byte(buffer, event->u.rpn.channel);
+			write_snapshot_number(buffer, (unsigned short)(event->u.rpn.number));
+			write_snapshot_number(buffer, (unsigned short)(event->u.rpn.value));
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_NRPN:
+		{
+			write_snapshot_byte(buffer, event->u.nrpn.channel);
+			write_snapshot_number(buffer, (unsigned short)(event->u.nrpn.number));
+			write_snapshot_number(buffer, (unsigned short)(event->u.nrpn.value));
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+}
+
+static MidiFileEvent_t decode_snapshot_event(MidiFileTrack_t track, unsigned char **position, long *tick)
+{
+	/* Allocates and fills in the next event from a chunk, but leaves adding it to the caller. */
+
+	MidiFileEvent_t new_event;
+	int number, data_length;
+
+	*tick += (long)(read_snapshot_number(position));
+
+	switch ((signed char)(*((*position)++)))
+	{
+		case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_NOTE_OFF;
+			new_event->u.note_off.channel = *((*position)++);
+			new_event->u.note_off.note = *((*position)++);
+			new_event->u.note_off.velocity = *((*position)++);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE_ON:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_NOTE_ON;
+			new_event->u.note_on.channel = *((*position)++);
+			new_event->u.note_on.note = *((*position)++);
+			new_event->u.note_on.velocity = *((*position)++);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_KEY_PRESSURE;
+			new_event->u.key_pressure.channel = *((*position)++);
+			new_event->u.key_pressure.note = *((*position)++);
+			new_event->u.key_pressure.amount = *((*position)++);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE;
+			new_event->u.control_change.channel = *((*position)++);
+			new_event->u.control_change.number = *((*position)++);
+			new_event->u.control_change.value = *((*position)++);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE;
+			new_event->u.program_change.channel = *((*position)++);
+			new_event->u.program_change.number = *((*position)++);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE;
+			new_event->u.channel_pressure.channel = *((*position)++);
+			new_event->u.channel_pressure.amount = *((*position)++);
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_PITCH_WHEEL:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_PITCH_WHEEL;
+			new_event->u.pitch_wheel.channel = *((*position)++);
+			new_event->u.pitch_wheel.value = (short)(unsigned short)(read_snapshot_number(position));
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_SYSEX:
+		{
+			data_length = (int)(read_snapshot_number(position));
+			new_event = new_sysex_event(track, *tick, data_length);
+			memcpy(new_event->u.sysex.data_buffer, *position, data_length);
+			*position += data_length;
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_META:
+		{
+			number = *((*position)++);
+			data_length = (int)(read_snapshot_number(position));
+			new_event = new_meta_event(track, *tick, number, data_length);
+			memcpy(new_event->u.meta.data_buffer, *position, data_length);
+			*position += data_length;
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_NOTE;
+			new_event->u.note.channel = *((*position)++);
+			new_event->u.note.note = *((*position)++);
+			new_event->u.note.velocity = *((*position)++);
+			new_event->u.note.end_velocity = *((*position)++);
+			new_event->u.note.duration_ticks = (long)(read_snapshot_number(position));
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE;
+			new_event->u.fine_control_change.channel = *((*position)++);
+			new_event->u.fine_control_change.coarse_number = *((*position)++);
+			new_event->u.fine_control_change.value = (short)(unsigned short)(read_snapshot_number(position));
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_RPN:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_RPN;
+			new_event->u.rpn.channel = *((*position)++);
+			new_event->u.rpn.number = (short)(unsigned short)(read_snapshot_number(position));
+			new_event->u.rpn.value = (short)(unsigned short)(read_snapshot_number(position));
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_NRPN:
+		{
+			new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
+			new_event->type = MIDI_FILE_EVENT_TYPE_NRPN;
+			new_event->u.nrpn.channel = *((*position)++);
+			new_event->u.nrpn.number = (short)(unsigned short)(read_snapshot_number(position));
+			new_event->u.nrpn.value = (short)(unsigned short)(read_snapshot_number(position));
+			break;
+		}
+		default:
+		{
+			return NULL;
+		}
+	}
+
+	new_event->track = track;
+	new_event->tick = *tick;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
+	new_event->is_selected = 0;
+	return new_event;
+}
+
+static void append_snapshot_chunk(struct MidiFileSnapshotTrack *snapshot_track, int *chunks_size, struct MidiFileSnapshotChunk *chunk)
+{
+	if (snapshot_track->number_of_chunks == *chunks_size)
+	{
+		*chunks_size = (*chunks_size == 0) ? 16 : (*chunks_size * 2);
+		snapshot_track->chunks = (struct MidiFileSnapshotChunk **)(realloc(snapshot_track->chunks, sizeof(struct MidiFileSnapshotChunk *) * *chunks_size));
+	}
+
+	snapshot_track->chunks[(snapshot_track->number_of_chunks)++] = chunk;
+}
+
+static struct MidiFileSnapshotChunk *new_snapshot_chunk(struct MidiFileSnapshotBuffer *buffer, long first_tick, long last_tick, long number_of_events)
+{
+	/* Copies out the events encoded so far, and empties the buffer for the next chunk. */
+
+	struct MidiFileSnapshotChunk *chunk = (struct MidiFileSnapshotChunk *)(malloc(sizeof(struct MidiFileSnapshotChunk) + buffer->length));
+	chunk->reference_count = 1;
+	chunk->first_tick = first_tick;
+	chunk->last_tick = last_tick;
+	chunk->number_of_events = number_of_events;
+	chunk->data_length = buffer->length;
+	memcpy(chunk->data, buffer->bytes, buffer->length);
+	buffer->length = 0;
+	return chunk;
+}
+
+static struct MidiFileSnapshotTrack *take_snapshot_of_track(MidiFileTrack_t track, struct MidiFileSnapshotBuffer *buffer)
+{
+	/* Returns a new reference, sharing whatever the track has not changed since its last snapshot. */
+
+	struct MidiFileSnapshotTrack *previous_snapshot_track = track->snapshot_track;
+	struct MidiFileSnapshotTrack *new_snapshot_track;
+	int chunks_size = 0, number_of_prefix_chunks = 0, number_of_suffix_chunks = 0, chunk_number;
+	long first_tick = 0, previous_tick = 0, number_of_events = 0;
+	MidiFileEvent_t event;
+
+	if ((previous_snapshot_track != NULL) && (track->changed_start_tick > track->changed_end_tick) && (previous_snapshot_track->end_tick == track->end_tick))
+	{
+		retain_snapshot_reference(&(previous_snapshot_track->reference_count));
+		return previous_snapshot_track;
+	}
+
+	new_snapshot_track = (struct MidiFileSnapshotTrack *)(malloc(sizeof(struct MidiFileSnapshotTrack)));
+	new_snapshot_track->reference_count = 2; /* one for the caller, one for the track */
+	new_snapshot_track->end_tick = track->end_tick;
+	new_snapshot_track->number_of_chunks = 0;
+	new_snapshot_track->chunks = NULL;
+
+	if (previous_snapshot_track != NULL)
+	{
+		while ((number_of_prefix_chunks < previous_snapshot_track->number_of_chunks) && (previous_snapshot_track->chunks[number_of_prefix_chunks]->last_tick < track->changed_start_tick)) number_of_prefix_chunks++;
+		while ((number_of_prefix_chunks + number_of_suffix_chunks < previous_snapshot_track->number_of_chunks) && (previous_snapshot_track->chunks[previous_snapshot_track->number_of_chunks - number_of_suffix_chunks - 1]->first_tick > track->changed_end_tick)) number_of_suffix_chunks++;
+
+		for (chunk_number = 0; chunk_number < number_of_prefix_chunks; chunk_number++)
+		{
+			retain_snapshot_reference(&(previous_snapshot_track->chunks[chunk_number]->reference_count));
+			append_snapshot_chunk(new_snapshot_track, &chunks_size, previous_snapshot_track->chunks[chunk_number]);
+		}
+	}
+
+	event = (number_of_prefix_chunks == 0) ? track->first_event : MidiFileTickIndex_getFirstEventAtOrAfter(&(track->tick_index), previous_snapshot_track->chunks[number_of_prefix_chunks - 1]->last_tick + 1);
+
+	for (; (event != NULL) && ((number_of_suffix_chunks == 0) || (event->tick < previous_snapshot_track->chunks[previous_snapshot_track->number_of_chunks - number_of_suffix_chunks]->first_tick)); event = event->next_event_in_track)
+	{
+		if ((number_of_events >= MIDI_FILE_SNAPSHOT_CHUNK_SIZE) && (event->tick != previous_tick))
+		{
+			append_snapshot_chunk(new_snapshot_track, &chunks_size, new_snapshot_chunk(buffer, first_tick, previous_tick, number_of_events));
+			number_of_events = 0;
+		}
+
+		if (number_of_events == 0) first_tick = previous_tick = event->tick;
+		encode_snapshot_event(buffer, event, previous_tick);
+		previous_tick = event->tick;
+		number_of_events++;
+	}
+
+	if (number_of_events > 0) append_snapshot_chunk(new_snapshot_track, &chunks_size, new_snapshot_chunk(buffer, first_tick, previous_tick, number_of_events));
+
+	for (chunk_number = 0; chunk_number < number_of_suffix_chunks; chunk_number++)
+	{
+		retain_snapshot_reference(&(previous_snapshot_track->chunks[previous_snapshot_track->number_of_chunks - number_of_suffix_chunks + chunk_number]->reference_count));
+		append_snapshot_chunk(new_snapshot_track, &chunks_size, previous_snapshot_track->chunks[previous_snapshot_track->number_of_chunks - number_of_suffix_chunks + chunk_number]);
+	}
+
+	release_snapshot_track(previous_snapshot_track);
+	track->snapshot_track = new_snapshot_track;
+	track->changed_start_tick = LONG_MAX;
+	track->changed_end_tick = LONG_MIN;
+	return new_snapshot_track;
+}
+
+static void restore_snapshot_of_track(MidiFileTrack_t track, struct MidiFileSnapshotTrack *snapshot_track)
+{
+	/* Only replaces the events between the chunks which the track's last snapshot has in common with this one, and which are unchanged since. */
+
+	struct MidiFileSnapshotTrack *previous_snapshot_track = track->snapshot_track;
+	int number_of_prefix_chunks = 0, number_of_suffix_chunks = 0, chunk_number;
+	long chunk_event_number, tick;
+	unsigned char *position;
+	MidiFileEvent_t event, next_event, new_event;
+
+	if (previous_snapshot_track != NULL)
+	{
+		while ((number_of_prefix_chunks < previous_snapshot_track->number_of_chunks) && (number_of_prefix_chunks < snapshot_track->number_of_chunks) && (previous_snapshot_track->chunks[number_of_prefix_chunks] == snapshot_track->chunks[number_of_prefix_chunks]) && (snapshot_track->chunks[number_of_prefix_chunks]->last_tick < track->changed_start_tick)) number_of_prefix_chunks++;
+		while ((number_of_prefix_chunks + number_of_suffix_chunks < previous_snapshot_track->number_of_chunks) && (number_of_prefix_chunks + number_of_suffix_chunks < snapshot_track->number_of_chunks) && (previous_snapshot_track->chunks[previous_snapshot_track->number_of_chunks - number_of_suffix_chunks - 1] == snapshot_track->chunks[snapshot_track->number_of_chunks - number_of_suffix_chunks - 1]) && (snapshot_track->chunks[snapshot_track->number_of_chunks - number_of_suffix_chunks - 1]->first_tick > track->changed_end_tick)) number_of_suffix_chunks++;
+	}
+
+	if ((previous_snapshot_track != snapshot_track) || (track->changed_start_tick <= track->changed_end_tick))
+	{
+		drop_note_pairing_index(track);
+		event = (number_of_prefix_chunks == 0) ? track->first_event : MidiFileTickIndex_getFirstEventAtOrAfter(&(track->tick_index), snapshot_track->chunks[number_of_prefix_chunks - 1]->last_tick + 1);
+
+		for (; (event != NULL) && ((number_of_suffix_chunks == 0) || (event->tick < snapshot_track->chunks[snapshot_track->number_of_chunks - number_of_suffix_chunks]->first_tick)); event = next_event)
+		{
+			next_event = event->next_event_in_track;
+			MidiFileEvent_delete(event);
+		}
+
+		new_event = NULL;
+
+		for (chunk_number = number_of_prefix_chunks; chunk_number < snapshot_track->number_of_chunks - number_of_suffix_chunks; chunk_number++)
+		{
+			position = snapshot_track->chunks[chunk_number]->data;
+			tick = snapshot_track->chunks[chunk_number]->first_tick;
+
+			for (chunk_event_number = 0; chunk_event_number < snapshot_track->chunks[chunk_number]->number_of_events; chunk_event_number++)
+			{
+				event = decode_snapshot_event(track, &position, &tick);
+				add_event_after(event, new_event);
+				new_event = event;
+			}
+		}
+	}
+
+	track->end_tick = snapshot_track->end_tick;
+	retain_snapshot_reference(&(snapshot_track->reference_count));
+	release_snapshot_track(previous_snapshot_track);
+	track->snapshot_track = snapshot_track;
+	track->changed_start_tick = LONG_MAX;
+	track->changed_end_tick = LONG_MIN;
+}
+
+static int snapshot_events_are_equal(MidiFileEvent_t event, MidiFileEvent_t other_event, struct MidiFileSnapshotBuffer *buffer, struct MidiFileSnapshotBuffer *other_buffer)
+{
+	/* Compares everything but the tick and the selection flag, by way of the encoding snapshots use. */
+
+	buffer->length = 0;
+	other_buffer->length = 0;
+	encode_snapshot_event(buffer, event, event->tick);
+	encode_snapshot_event(other_buffer, other_event, other_event->tick);
+	return ((buffer->length == other_buffer->length) && (memcmp(buffer->bytes, other_buffer->bytes, buffer->length) == 0));
+}
+
+static void write_patch_file_header(struct MidiFileSnapshotBuffer *buffer, MidiFile_t midi_file)
+{
+	write_snapshot_number(buffer, (unsigned long)(midi_file->file_format));
+	write_snapshot_number(buffer, (unsigned long)(midi_file->division_type));
+	write_snapshot_number(buffer, (unsigned long)(midi_file->resolution));
+	write_snapshot_number(buffer, (unsigned long)(midi_file->number_of_frames_per_second * 100.0 + 0.5));
+	write_snapshot_number(buffer, (unsigned long)(midi_file->number_of_tracks));
+}
+
+static void diff_tracks(MidiFileTrack_t old_track, MidiFileTrack_t new_track, int track_number, struct MidiFileSnapshotBuffer *buffer, struct MidiFileSnapshotBuffer *hunk_buffer, struct MidiFileSnapshotBuffer *event_buffer, struct MidiFileSnapshotBuffer *other_event_buffer)
+{
+	/*
+	 * Walks both tracks a tick at a time.  Where the events at a tick differ,
+	 * the ones they start and end with in common are left alone, and the rest
+	 * become a hunk: the tick, the number of events before it at that tick,
+	 * and the old and new events in between.  Either track may be NULL, for
+	 * one missing on that side.
+	 */
+
+	MidiFileEvent_t old_event = (old_track == NULL) ? NULL : old_track->first_event;
+	MidiFileEvent_t new_event = (new_track == NULL) ? NULL : new_track->first_event;
+	MidiFileEvent_t old_hunk_event, new_hunk_event, event;
+	long tick, number_of_old_events, number_of_new_events, number_of_common_first_events, number_of_common_last_events, number_of_hunks = 0, old_end_tick, new_end_tick, i;
+	int byte_number;
+
+	hunk_buffer->length = 0;
+
+	while ((old_event != NULL) || (new_event != NULL))
+	{
+		if (old_event == NULL) tick = new_event->tick;
+		else if (new_event == NULL) tick = old_event->tick;
+		else tick = (old_event->tick < new_event->tick) ? old_event->tick : new_event->tick;
+
+		/* find the last events at this tick, then trim what the two end with and start with in common */
+
+		for (old_hunk_event = NULL, number_of_old_events = 0; (old_event != NULL) && (old_event->tick == tick); old_event = old_event->next_event_in_track, number_of_old_events++) old_hunk_event = old_event;
+		for (new_hunk_event = NULL, number_of_new_events = 0; (new_event != NULL) && (new_event->tick == tick); new_event = new_event->next_event_in_track, number_of_new_events++) new_hunk_event = new_event;
+
+		number_of_common_last_events = 0;
+
+		while ((number_of_common_last_events < number_of_old_events) && (number_of_common_last_events < number_of_new_events) && snapshot_events_are_equal(old_hunk_event, new_hunk_event, event_buffer, other_event_buffer))
+		{
+			old_hunk_event = old_hunk_event->previous_event_in_track;
+			new_hunk_event = new_hunk_event->previous_event_in_track;
+			number_of_common_last_events++;
+		}
+
+		number_of_old_events -= number_of_common_last_events;
+		number_of_new_events -= number_of_common_last_events;
+		if ((number_of_old_events == 0) && (number_of_new_events == 0)) continue;
+		for (i = 1; i < number_of_old_events; i++) old_hunk_event = old_hunk_event->previous_event_in_track;
+		for (i = 1; i < number_of_new_events; i++) new_hunk_event = new_hunk_event->previous_event_in_track;
+		number_of_common_first_events = 0;
+
+		while ((number_of_common_first_events < number_of_old_events) && (number_of_common_first_events < number_of_new_events) && snapshot_events_are_equal(old_hunk_event, new_hunk_event, event_buffer, other_event_buffer))
+		{
+			old_hunk_event = old_hunk_event->next_event_in_track;
+			new_hunk_event = new_hunk_event->next_event_in_track;
+			number_of_common_first_events++;
+		}
+
+		number_of_old_events -= number_of_common_first_events;
+		number_of_new_events -= number_of_common_first_events;
+		if ((number_of_old_events == 0) && (number_of_new_events == 0)) continue;
+
+		write_snapshot_number(hunk_buffer, (unsigned long)(tick));
+		write_snapshot_number(hunk_buffer, (unsigned long)(number_of_common_first_events));
+		write_snapshot_number(hunk_buffer, (unsigned long)(number_of_old_events));
+		write_snapshot_number(hunk_buffer, (unsigned long)(number_of_new_events));
+		for (i = 0, event = old_hunk_event; i < number_of_old_events; i++, event = event->next_event_in_track) encode_snapshot_event(hunk_buffer, event, tick);
+		for (i = 0, event = new_hunk_event; i < number_of_new_events; i++, event = event->next_event_in_track) encode_snapshot_event(hunk_buffer, event, tick);
+		number_of_hunks++;
+	}
+
+	old_end_tick = (old_track == NULL) ? 0 : old_track->end_tick;
+	new_end_tick = (new_track == NULL) ? 0 : new_track->end_tick;
+	if ((number_of_hunks == 0) && (old_end_tick == new_end_tick)) return;
+	write_snapshot_number(buffer, (unsigned long)(track_number + 1));
+	write_snapshot_number(buffer, (unsigned long)(old_end_tick));
+	write_snapshot_number(buffer, (unsigned long)(new_end_tick));
+	write_snapshot_number(buffer, (unsigned long)(number_of_hunks));
+	for (byte_number = 0; byte_number < hunk_buffer->length; byte_number++) write_snapshot_byte(buffer, hunk_buffer->bytes[byte_number]);
+}
+
+static int read_patch_number(unsigned char **position, unsigned char *end, long *value)
+{
+	/* Like read_snapshot_number(), but checked against the end, since a patch may have come from a file. */
+
+	unsigned long number = 0;
+	int shift = 0;
+
+	do
+	{
+		if ((*position >= end) || (shift >= (int)(sizeof(unsigned long) * 8))) return -1;
+		number |= (unsigned long)(**position & 0x7F) << shift;
+		shift += 7;
+	}
+	while (*((*position)++) & 0x80);
+
+	*value = (long)(number);
+	return 0;
+}
+
+static int skip_patch_event(unsigned char **position, unsigned char *end)
+{
+	long value;
+
+	if ((read_patch_number(position, end, &value) < 0) || (*position >= end)) return -1;
+
+	switch ((signed char)(*((*position)++)))
+	{
+		case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
+		case MIDI_FILE_EVENT_TYPE_NOTE_ON:
+		case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
+		case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
+		{
+			*position += 3;
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
+		case MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE:
+		{
+			*position += 2;
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_PITCH_WHEEL:
+		{
+			(*position)++;
+			return read_patch_number(position, end, &value);
+		}
+		case MIDI_FILE_EVENT_TYPE_SYSEX:
+		{
+			if ((read_patch_number(position, end, &value) < 0) || (value < 1) || (value > end - *position)) return -1;
+			*position += value;
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_META:
+		{
+			(*position)++;
+			if ((read_patch_number(position, end, &value) < 0) || (value < 0) || (value > end - *position)) return -1;
+			*position += value;
+			break;
+		}
+		case MIDI_FILE_EVENT_TYPE_NOTE:
+		{
+			*position += 4;
+			return read_patch_number(position, end, &value);
+		}
+		case MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE:
+		{
+			*position += 2;
+			return read_patch_number(position, end, &value);
+		}
+		case MIDI_FILE_EVENT_TYPE_RPN:
+		case MIDI_FILE_EVENT_TYPE_NRPN:
+		{
+			(*position)++;
+			if (read_patch_number(position, end, &value) < 0) return -1;
+			return read_patch_number(position, end, &value);
+		}
+		default:
+		{
+			return -1;
+		}
+	}
+
+	return (*position <= end) ? 0 : -1;
+}
+
+static int apply_patch_hunk(MidiFileTrack_t track, unsigned char **position, unsigned char *end, int is_reverting, int is_checking, struct MidiFileSnapshotBuffer *buffer)
+{
+	long tick, number_of_earlier_events, numbers_of_events[2], i;
+	unsigned char *events[2], *from_events, *to_events;
+	MidiFileEvent_t event, next_event, previous_event = NULL, new_event;
+	int side;
+
+	if ((read_patch_number(position, end, &tick) < 0) || (read_patch_number(position, end, &number_of_earlier_events) < 0) || (read_patch_number(position, end, &(numbers_of_events[0])) < 0) || (read_patch_number(position, end, &(numbers_of_events[1])) < 0)) return -1;
+
+	for (side = 0; side < 2; side++)
+	{
+		events[side] = *position;
+
+		for (i = 0; i < numbers_of_events[side]; i++)
+		{
+			if (skip_patch_event(position, end) < 0) return -1;
+		}
+	}
+
+	from_events = events[is_reverting ? 1 : 0];
+	to_events = events[is_reverting ? 0 : 1];
+	event = (track == NULL) ? NULL : MidiFileTickIndex_getFirstEventAtOrAfter(&(track->tick_index), tick);
+
+	for (i = 0; i < number_of_earlier_events; i++)
+	{
+		if ((event == NULL) || (event->tick != tick)) return -1;
+		previous_event = event;
+		event = event->next_event_in_track;
+	}
+
+	for (i = 0; i < numbers_of_events[is_reverting ? 1 : 0]; i++)
+	{
+		if ((event == NULL) || (event->tick != tick)) return -1;
+		next_event = event->next_event_in_track;
+
+		if (is_checking)
+		{
+			buffer->length = 0;
+			encode_snapshot_event(buffer, event, tick);
+			if ((buffer->length > end - from_events) || (memcmp(buffer->bytes, from_events, buffer->length) != 0)) return -1;
+			from_events += buffer->length;
+		}
+		else
+		{
+			MidiFileEvent_delete(event);
+		}
+
+		event = next_event;
+	}
+
+	if (is_checking) return 0;
+
+	for (i = 0; i < numbers_of_events[is_reverting ? 0 : 1]; i++)
+	{
+		long event_tick = tick;
+		new_event = decode_snapshot_event(track, &to_events, &event_tick);
+
+		if (previous_event != NULL)
+		{
+			add_event_after(new_event, previous_event);
+		}
+		else if ((event != NULL) && (event->tick == tick))
+		{
+			add_event_before(new_event, event);
+		}
+		else
+		{
+			add_event_after(new_event, NULL);
+		}
+
+		previous_event = new_event;
+	}
+
+	return 0;
+}
+
+static int apply_patch(MidiFile_t midi_file, MidiFilePatch_t patch, int is_reverting, int is_checking)
+{
+	/*
+	 * Called once to check that the patch fits the file, including that every
+	 * event it removes is there, and again to make the changes, so a patch
+	 * which does not apply leaves the file alone.
+	 */
+
+	unsigned char *position = patch->data + 4, *end = patch->data + patch->data_length;
+	long headers[2][5], *from_header, *to_header, track_number, end_ticks[2], number_of_hunks, hunk_number;
+	int side, i, result = -1;
+	MidiFileTrack_t track;
+	struct MidiFileSnapshotBuffer buffer;
+
+	for (side = 0; side < 2; side++)
+	{
+		for (i = 0; i < 5; i++)
+		{
+			if (read_patch_number(&position, end, &(headers[side][i])) < 0) return -1;
+		}
+	}
+
+	from_header = headers[is_reverting ? 1 : 0];
+	to_header = headers[is_reverting ? 0 : 1];
+	if ((midi_file->number_of_tracks != from_header[4]) || (to_header[4] < 0) || (to_header[4] > 0xFFFF)) return -1;
+
+	if (!is_checking)
+	{
+		midi_file->file_format = (int)(to_header[0]);
+		midi_file->division_type = (MidiFileDivisionType_t)(to_header[1]);
+		midi_file->resolution = (int)(to_header[2]);
+		midi_file->number_of_frames_per_second = (float)(to_header[3] / 100.0);
+		while (midi_file->number_of_tracks < to_header[4]) MidiFile_createTrack(midi_file);
+	}
+
+	buffer.bytes = NULL;
+	buffer.length = 0;
+	buffer.size = 0;
+
+	while (read_patch_number(&position, end, &track_number) == 0)
+	{
+		if (track_number == 0)
+		{
+			result = 0;
+			break;
+		}
+
+		track_number--;
+		if ((track_number < 0) || ((track_number >= from_header[4]) && (track_number >= to_header[4]))) break;
+		if ((read_patch_number(&position, end, &(end_ticks[0])) < 0) || (read_patch_number(&position, end, &(end_ticks[1])) < 0) || (read_patch_number(&position, end, &number_of_hunks) < 0)) break;
+		track = MidiFile_getTrackByNumber(midi_file, (int)(track_number), 0);
+
+		for (hunk_number = 0; hunk_number < number_of_hunks; hunk_number++)
+		{
+			if (apply_patch_hunk(track, &position, end, is_reverting, is_checking, &buffer) < 0) break;
+		}
+
+		if (hunk_number < number_of_hunks) break;
+		if (!is_checking) track->end_tick = end_ticks[is_reverting ? 0 : 1];
+	}
+
+	free(buffer.bytes);
+	if (result < 0) return -1;
+
+	if (!is_checking)
+	{
+		while (midi_file->number_of_tracks > to_header[4]) MidiFileTrack_delete(midi_file->last_track);
+		invalidate_conductor_track_maps(midi_file);
+	}
+
+	return 0;
+}
+
+/*
+ * Public API
+ */
+
+MidiFile_t MidiFile_load(char *filename)
+{
+	FILE *in;
+	unsigned char *buffer;
+	long buffer_length;
+	MidiFile_t midi_file;
+
+	if ((filename == NULL) || ((in = fopen(filename, "rb")) == NULL)) return NULL;
+
+	buffer = read_file(in, &buffer_length);
+	fclose(in);
+	midi_file = load_midi_file(buffer, buffer_length, 0);
+	free(buffer);
+	return midi_file;
+}
+
+MidiFile_t MidiFile_loadMapped(char *filename)
+{
+	unsigned char *buffer;
+	long buffer_length;
+	MidiFile_t midi_file;
+
+	if (filename == NULL) return NULL;
+
+	/* anything which cannot be mapped, like a pipe, is loaded the ordinary way */
+	if ((buffer = map_file(filename, &buffer_length)) == NULL) return MidiFile_load(filename);
+
+	if ((midi_file = load_midi_file(buffer, buffer_length, 1)) == NULL)
+	{
+		unmap_file(buffer, buffer_length);
+		return NULL;
+	}
+
+	midi_file->arena->mapping = buffer;
+	midi_file->arena->mapping_length = buffer_length;
+	return midi_file;
+}
+
+MidiFile_t MidiFile_loadParallel(char *filename, int number_of_threads)
+{
+	FILE *in;
+	unsigned char *buffer;
+	long buffer_length;
+	MidiFile_t midi_file;
+
+	if ((filename == NULL) || ((in = fopen(filename, "rb")) == NULL)) return NULL;
+
+	buffer = read_file(in, &buffer_length);
+	fclose(in);
+	midi_file = load_midi_file_in_parallel(buffer, buffer_length, number_of_threads);
+	free(buffer);
+	return midi_file;
+}
+
+int MidiFile_save(MidiFile_t midi_file, const char* filename)
+{
+	FILE *out;
+	int result;
+
+	if ((midi_file == NULL) || (filename == NULL) || ((out = fopen(filename, "wb")) == NULL)) return -1;
+
+	result = MidiFile_saveToCallback(midi_file, write_to_file, out);
+	if (fclose(out) != 0) result = -1;
+	return result;
+}
+
+MidiFile_t MidiFile_loadFromBuffer(unsigned char *buffer, int buffer_length)
+{
+	if ((buffer == NULL) || (buffer_length < 0)) return NULL;
+	return load_midi_file(buffer, buffer_length, 0);
+}
+
+int MidiFile_saveToBuffer(MidiFile_t midi_file, unsigned char *buffer)
+{
+	struct MidiFileOutput output;
+
+	if ((midi_file == NULL) || (buffer == NULL)) return -1;
+
+	MidiFileOutput_initForBuffer(&output, buffer, MidiFile_getFileSize(midi_file));
+	save_midi_file(midi_file, &output);
+	return 0;
+}
+
+int MidiFile_saveToCallback(MidiFile_t midi_file, MidiFileWriteCallback_t callback, void *user_data)
+{
+	struct MidiFileOutput output;
+	unsigned char *buffer;
+
+	if ((midi_file == NULL) || (callback == NULL)) return -1;
+
+	buffer = (unsigned char *)(malloc(MIDI_FILE_OUTPUT_BUFFER_SIZE));
+	MidiFileOutput_initForCallback(&output, buffer, callback, user_data);
+	save_midi_file(midi_file, &output);
+	free(buffer);
+	return output.failed ? -1 : 0;
+}
+
+int MidiFile_getFileSize(MidiFile_t midi_file)
+{
+	unsigned char header[14];
+	MidiFileTrack_t track;
+	long file_size;
+
+	if (midi_file == NULL) return -1;
+
+	file_size = (long)(encode_header(header, midi_file->file_format, MidiFile_getNumberOfTracks(midi_file), midi_file->division_type, midi_file->resolution) - header);
+	for (track = midi_file->first_track; track != NULL; track = track->next_track) file_size += 8 + get_track_size(track);
+	return (int)(file_size);
+}
+
+MidiFileReader_t MidiFileReader_open(char *filename, MidiFileReaderMode_t mode)
+{
+	FILE *in;
+	unsigned char *buffer;
+	long buffer_length;
+	MidiFileReader_t reader;
+
+	if (filename == NULL) return NULL;
+
+	if ((buffer = map_file(filename, &buffer_length)) != NULL)
+	{
+		if ((reader = new_reader(buffer, buffer_length, mode)) == NULL)
+		{
+			unmap_file(buffer, buffer_length);
+			return NULL;
+		}
+
+		reader->buffer_is_mapped = 1;
+		return reader;
+	}
+
+	/* anything which cannot be mapped, like a pipe, is read into memory instead */
+
+	if ((in = fopen(filename, "rb")) == NULL) return NULL;
+	buffer = read_file(in, &buffer_length);
+	fclose(in);
+
+	if ((reader = new_reader(buffer, buffer_length, mode)) == NULL)
+	{
+		free(buffer);
+		return NULL;
+	}
+
+	reader->buffer_is_owned = 1;
+	return reader;
+}
+
+MidiFileReader_t MidiFileReader_openFromBuffer(unsigned char *buffer, int buffer_length, MidiFileReaderMode_t mode)
+{
+	if ((buffer == NULL) || (buffer_length < 0)) return NULL;
+	return new_reader(buffer, buffer_length, mode);
+}
+
+int MidiFileReader_close(MidiFileReader_t reader)
+{
+	if (reader == NULL) return -1;
+
+	if (reader->buffer_is_mapped)
+	{
+		unmap_file(reader->buffer, reader->buffer_length);
+	}
+	else if (reader->buffer_is_owned)
+	{
+		free(reader->buffer);
+	}
+
+	free(reader->heap);
+	free(reader->tracks);
+	free(reader);
+	return 0;
+}
+
+int MidiFileReader_getFileFormat(MidiFileReader_t reader)
+{
+	if (reader == NULL) return -1;
+	return reader->file_format;
+}
+
+MidiFileDivisionType_t MidiFileReader_getDivisionType(MidiFileReader_t reader)
+{
+	if (reader == NULL) return MIDI_FILE_DIVISION_TYPE_INVALID;
+	return reader->division_type;
+}
+
+int MidiFileReader_getResolution(MidiFileReader_t reader)
+{
+	if (reader == NULL) return -1;
+	return reader->resolution;
+}
+
+int MidiFileReader_getNumberOfTracks(MidiFileReader_t reader)
+{
+	if (reader == NULL) return -1;
+	return reader->number_of_tracks;
+}
+
+int MidiFileReader_next(MidiFileReader_t reader, MidiFileReaderEvent_t event)
+{
+	MidiFileReaderTrack_t reader_track;
+
+	if ((reader == NULL) || (event == NULL)) return -1;
+
+	if (reader->mode == MIDI_FILE_READER_MODE_MERGED)
+	{
+		if (reader->heap_size == 0) return -1;
+		reader_track = reader->heap[0];
+		*event = reader_track->next_event;
+
+		if (MidiFileReaderTrack_readEvent(reader_track, &(reader_track->next_event)) == 0)
+		{
+			sift_down_reader_heap(reader->heap, reader->heap_size, 0, reader_track);
+		}
+		else
+		{
+			reader->heap_size--;
+			if (reader->heap_size > 0) sift_down_reader_heap(reader->heap, reader->heap_size, 0, reader->heap[reader->heap_size]);
+		}
+
+		return 0;
+	}
+	else
+	{
+		for (; reader->current_track_number < reader->number_of_tracks; reader->current_track_number++)
+		{
+			reader_track = &(reader->tracks[reader->current_track_number]);
+			if (MidiFileReaderTrack_readEvent(reader_track, event) == 0) return 0;
+		}
+
+		return -1;
+	}
+}
+
+MidiFileWriter_t MidiFileWriter_open(char *filename, int file_format, MidiFileDivisionType_t division_type, int resolution)
+{
+	MidiFileWriter_t writer;
+	FILE *out;
+
+	if ((filename == NULL) || ((out = fopen(filename, "wb")) == NULL)) return NULL;
+
+	writer = (MidiFileWriter_t)(malloc(sizeof(struct MidiFileWriter)));
+	writer->out = out;
+	MidiFileOutput_initForCallback(&(writer->output), (unsigned char *)(malloc(MIDI_FILE_OUTPUT_BUFFER_SIZE)), write_to_writer, writer);
+	writer->number_of_bytes_flushed = 0;
+	writer->file_format = file_format;
+	writer->division_type = division_type;
+	writer->resolution = resolution;
+	writer->number_of_tracks = 0;
+	writer->track_start = -1;
+	writer->previous_tick = 0;
+
+	/* the track count is patched in at each checkpoint */
+	MidiFileOutput_commit(&(writer->output), encode_header(MidiFileOutput_reserve(&(writer->output), 14), file_format, 0, division_type, resolution));
+	return writer;
+}
+
+int MidiFileWriter_close(MidiFileWriter_t writer)
+{
+	int result;
+
+	if (writer == NULL) return -1;
+
+	MidiFileWriter_finishTrack(writer);
+	result = MidiFileWriter_checkpoint(writer);
+	if (fclose(writer->out) != 0) result = -1;
+	free(writer->output.buffer);
+	free(writer);
+	return result;
+}
+
+int MidiFileWriter_checkpoint(MidiFileWriter_t writer)
+{
+	unsigned char buffer[4];
+	long file_size;
+
+	if (writer == NULL) return -1;
+
+	MidiFileOutput_flush(&(writer->output));
+	file_size = writer->number_of_bytes_flushed;
+
+	if (writer->track_start >= 0)
+	{
+		/* a provisional end of track event, for the next event to overwrite */
+		if (fwrite("\x00\xFF\x2F\x00", 1, 4, writer->out) != 4) writer->output.failed = 1;
+		encode_uint32(buffer, (unsigned long)(file_size + 4 - writer->track_start));
+		if (patch_file(writer->out, writer->track_start - 4, buffer, 4) != 0) writer->output.failed = 1;
+	}
+
+	encode_uint16(buffer, (unsigned short)(writer->number_of_tracks));
+	if (patch_file(writer->out, 10, buffer, 2) != 0) writer->output.failed = 1;
+	if ((fseek(writer->out, file_size, SEEK_SET) != 0) || (fflush(writer->out) != 0)) writer->output.failed = 1;
+	return writer->output.failed ? -1 : 0;
+}
+
+int MidiFileWriter_writeTrack(MidiFileWriter_t writer, MidiFileTrack_t track)
+{
+	if ((writer == NULL) || (track == NULL)) return -1;
+	MidiFileWriter_finishTrack(writer);
+	save_track(track, &(writer->output));
+	writer->number_of_tracks++;
+	return writer->output.failed ? -1 : 0;
+}
+
+int MidiFileWriter_startTrack(MidiFileWriter_t writer)
+{
+	unsigned char *position;
+
+	if (writer == NULL) return -1;
+
+	MidiFileWriter_finishTrack(writer);
+
+	/* the chunk length is patched in at each checkpoint, and when the track is finished */
+	position = MidiFileOutput_reserve(&(writer->output), 8);
+	memcpy(position, "MTrk\0\0\0\0", 8);
+	MidiFileOutput_commit(&(writer->output), position + 8);
+
+	writer->track_start = writer->number_of_bytes_flushed + writer->output.offset;
+	writer->number_of_tracks++;
+	writer->previous_tick = 0;
+	return writer->output.failed ? -1 : 0;
+}
+
+int MidiFileWriter_writeNoteOffEvent(MidiFileWriter_t writer, long tick, int channel, int note, int velocity)
+{
+	unsigned char *position;
+	if ((position = MidiFileWriter_startEvent(writer, tick)) == NULL) return -1;
+	*position++ = (unsigned char)(0x80 | (channel & 0x0F));
+	*position++ = (unsigned char)(note & 0x7F);
+	*position++ = (unsigned char)(velocity & 0x7F);
+	return MidiFileWriter_finishEvent(writer, position);
+}
+
+int MidiFileWriter_writeNoteOnEvent(MidiFileWriter_t writer, long tick, int channel, int note, int velocity)
+{
+	unsigned char *position;
+	if ((position = MidiFileWriter_startEvent(writer, tick)) == NULL) return -1;
+	*position++ = (unsigned char)(0x90 | (channel & 0x0F));
+	*position++ = (unsigned char)(note & 0x7F);
+	*position++ = (unsigned char)(velocity & 0x7F);
+	return MidiFileWriter_finishEvent(writer, position);
+}
+
+int MidiFileWriter_writeKeyPressureEvent(MidiFileWriter_t writer, long tick, int channel, int note, int amount)
+{
+	unsigned char *position;
+	if ((position = MidiFileWriter_startEvent(writer, tick)) == NULL) return -1;
+	*position++ = (unsigned char)(0xA0 | (channel & 0x0F));
+	*position++ = (unsigned char)(note & 0x7F);
+	*position++ = (unsigned char)(amount & 0x7F);
+	return MidiFileWriter_finishEvent(writer, position);
+}
 
-						break;
-					}
-				}
-			}
+int MidiFileWriter_writeControlChangeEvent(MidiFileWriter_t writer, long tick, int channel, int number, int value)
+{
+	unsigned char *position;
+	if ((position = MidiFileWriter_startEvent(writer, tick)) == NULL) return -1;
+	*position++ = (unsigned char)(0xB0 | (channel & 0x0F));
+	*position++ = (unsigned char)(number & 0x7F);
+	*position++ = (unsigned char)(value & 0x7F);
+	return MidiFileWriter_finishEvent(writer, position);
+}
 
-			number_of_tracks_read++;
-		}
+int MidiFileWriter_writeProgramChangeEvent(MidiFileWriter_t writer, long tick, int channel, int number)
+{
+	unsigned char *position;
+	if ((position = MidiFileWriter_startEvent(writer, tick)) == NULL) return -1;
+	*position++ = (unsigned char)(0xC0 | (channel & 0x0F));
+	*position++ = (unsigned char)(number & 0x7F);
+	return MidiFileWriter_finishEvent(writer, position);
+}
 
-		/* forwards compatibility:  skip over any unrecognized chunks, or extra data at the end of tracks */
-		MidiFileIO_seek(io, chunk_start + chunk_size, SEEK_SET);
-	}
+int MidiFileWriter_writeChannelPressureEvent(MidiFileWriter_t writer, long tick, int channel, int amount)
+{
+	unsigned char *position;
+	if ((position = MidiFileWriter_startEvent(writer, tick)) == NULL) return -1;
+	*position++ = (unsigned char)(0xD0 | (channel & 0x0F));
+	*position++ = (unsigned char)(amount & 0x7F);
+	return MidiFileWriter_finishEvent(writer, position);
+}
 
-	return midi_file;
+int MidiFileWriter_writePitchWheelEvent(MidiFileWriter_t writer, long tick, int channel, int value)
+{
+	unsigned char *position;
+	if ((position = MidiFileWriter_startEvent(writer, tick)) == NULL) return -1;
+	*position++ = (unsigned char)(0xE0 | (channel & 0x0F));
+	*position++ = (unsigned char)(value & 0x7F);
+	*position++ = (unsigned char)((value >> 7) & 0x7F);
+	return MidiFileWriter_finishEvent(writer, position);
 }
 
-static void save_midi_file(MidiFile_t midi_file, MidiFileIO_t io)
+int MidiFileWriter_writeSysexEvent(MidiFileWriter_t writer, long tick, int data_length, unsigned char *data_buffer)
 {
-	MidiFileTrack_t track;
+	unsigned char *position;
+	if ((data_length < 1) || (data_buffer == NULL) || ((position = MidiFileWriter_startEvent(writer, tick)) == NULL)) return -1;
+	*position++ = data_buffer[0];
+	MidiFileOutput_commit(&(writer->output), encode_variable_length_quantity(position, data_length - 1));
+	MidiFileOutput_write(&(writer->output), data_buffer + 1, data_length - 1);
+	return writer->output.failed ? -1 : 0;
+}
+
+int MidiFileWriter_writeMetaEvent(MidiFileWriter_t writer, long tick, int number, int data_length, unsigned char *data_buffer)
+{
+	unsigned char *position;
+	if ((data_length < 0) || ((data_buffer == NULL) && (data_length > 0)) || ((position = MidiFileWriter_startEvent(writer, tick)) == NULL)) return -1;
+	*position++ = 0xFF;
+	*position++ = (unsigned char)(number & 0x7F);
+	MidiFileOutput_commit(&(writer->output), encode_variable_length_quantity(position, data_length));
+	MidiFileOutput_write(&(writer->output), data_buffer, data_length);
+	return writer->output.failed ? -1 : 0;
+}
 
-	MidiFileIO_write(io, 4, (unsigned char *)("MThd"));
-	write_uint32(io, 6);
-	write_uint16(io, (unsigned short)(MidiFile_getFileFormat(midi_file)));
-	write_uint16(io, (unsigned short)(MidiFile_getNumberOfTracks(midi_file)));
+int MidiFileWriter_recover(char *filename)
+{
+	FILE *file;
+	unsigned char *buffer, *end, *position, *chunk_id, *chunk_start, *chunk_end;
+	long buffer_length;
+	int file_format, number_of_tracks, resolution, result = 0;
+	MidiFileDivisionType_t division_type;
+	unsigned char patch[4];
 
-	switch (MidiFile_getDivisionType(midi_file))
+	if ((filename == NULL) || ((file = fopen(filename, "r+b")) == NULL)) return -1;
+
+	buffer = read_file(file, &buffer_length);
+	end = buffer + buffer_length;
+
+	if (((end - buffer >= 4) && (memcmp(buffer, "RIFF", 4) == 0)) || ((position = read_header_chunk(buffer, end, &file_format, &number_of_tracks, &division_type, &resolution)) == NULL))
 	{
-		case MIDI_FILE_DIVISION_TYPE_PPQ:
-		{
-			write_uint16(io, (unsigned short)(MidiFile_getResolution(midi_file)));
-			break;
-		}
-		case MIDI_FILE_DIVISION_TYPE_SMPTE24:
-		{
-			MidiFileIO_putc(io, -24);
-			MidiFileIO_putc(io, MidiFile_getResolution(midi_file));
-			break;
-		}
-		case MIDI_FILE_DIVISION_TYPE_SMPTE25:
-		{
-			MidiFileIO_putc(io, -25);
-			MidiFileIO_putc(io, MidiFile_getResolution(midi_file));
-			break;
-		}
-		case MIDI_FILE_DIVISION_TYPE_SMPTE30DROP:
-		{
-			MidiFileIO_putc(io, -29);
-			MidiFileIO_putc(io, MidiFile_getResolution(midi_file));
-			break;
-		}
-		case MIDI_FILE_DIVISION_TYPE_SMPTE30:
-		{
-			MidiFileIO_putc(io, -30);
-			MidiFileIO_putc(io, MidiFile_getResolution(midi_file));
-			break;
-		}
-		default:
-		{
-			break;
-		}
+		free(buffer);
+		fclose(file);
+		return -1;
 	}
 
-	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
-	{
-		MidiFileEvent_t event;
-		long track_size_offset, track_start_offset, track_end_offset, tick, previous_tick;
+	/*
+	 * Each track is decoded up to its end of track event, ignoring the chunk
+	 * length, which is stale for the track still being written when the
+	 * writer stopped.  That track is the first without an end of track event;
+	 * it keeps every event up to the first one that was cut short, and gets a
+	 * new end of track event there.  Anything after it goes.
+	 */
 
-		MidiFileIO_write(io, 4, (unsigned char *)("MTrk"));
+	number_of_tracks = 0;
 
-		track_size_offset = MidiFileIO_tell(io);
-		write_uint32(io, 0);
+	while ((chunk_start = read_chunk_header(position, end, &chunk_id, &chunk_end)) != NULL)
+	{
+		struct MidiFileReaderTrack reader_track;
+		struct MidiFileReaderEvent event;
+		unsigned char *track_end = chunk_start;
+		int is_complete = 0;
 
-		track_start_offset = MidiFileIO_tell(io);
+		if (memcmp(chunk_id, "MTrk", 4) != 0)
+		{
+			position = chunk_end;
+			continue;
+		}
 
-		previous_tick = 0;
+		MidiFileReaderTrack_init(&reader_track, number_of_tracks, chunk_start, end);
 
-		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		while (MidiFileReaderTrack_readEvent(&reader_track, &event) == 0)
 		{
-			tick = MidiFileEvent_getTick(event);
-			write_variable_length_quantity(io, tick - previous_tick);
-
-			switch (MidiFileEvent_getType(event))
+			if ((event.type == MIDI_FILE_EVENT_TYPE_META) && (event.number == 0x2F))
 			{
-				case MIDI_FILE_EVENT_TYPE_NOTE_OFF:
-				{
-					MidiFileIO_putc(io, 0x80 | (MidiFileNoteOffEvent_getChannel(event) & 0x0F));
-					MidiFileIO_putc(io, MidiFileNoteOffEvent_getNote(event) & 0x7F);
-					MidiFileIO_putc(io, MidiFileNoteOffEvent_getVelocity(event) & 0x7F);
-					break;
-				}
-				case MIDI_FILE_EVENT_TYPE_NOTE_ON:
-				{
-					MidiFileIO_putc(io, 0x90 | (MidiFileNoteOnEvent_getChannel(event) & 0x0F));
-					MidiFileIO_putc(io, MidiFileNoteOnEvent_getNote(event) & 0x7F);
-					MidiFileIO_putc(io, MidiFileNoteOnEvent_getVelocity(event) & 0x7F);
-					break;
-				}
-				case MIDI_FILE_EVENT_TYPE_KEY_PRESSURE:
-				{
-					MidiFileIO_putc(io, 0xA0 | (MidiFileKeyPressureEvent_getChannel(event) & 0x0F));
-					MidiFileIO_putc(io, MidiFileKeyPressureEvent_getNote(event) & 0x7F);
-					MidiFileIO_putc(io, MidiFileKeyPressureEvent_getAmount(event) & 0x7F);
-					break;
-				}
-				case MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE:
-				{
-					MidiFileIO_putc(io, 0xB0 | (MidiFileControlChangeEvent_getChannel(event) & 0x0F));
-					MidiFileIO_putc(io, MidiFileControlChangeEvent_getNumber(event) & 0x7F);
-					MidiFileIO_putc(io, MidiFileControlChangeEvent_getValue(event) & 0x7F);
-					break;
-				}
-				case MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE:
-				{
-					MidiFileIO_putc(io, 0xC0 | (MidiFileProgramChangeEvent_getChannel(event) & 0x0F));
-					MidiFileIO_putc(io, MidiFileProgramChangeEvent_getNumber(event) & 0x7F);
-					break;
-				}
-				case MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE:
-				{
-					MidiFileIO_putc(io, 0xD0 | (MidiFileChannelPressureEvent_getChannel(event) & 0x0F));
-					MidiFileIO_putc(io, MidiFileChannelPressureEvent_getAmount(event) & 0x7F);
-					break;
-				}
-				case MIDI_FILE_EVENT_TYPE_PITCH_WHEEL:
-				{
-					int value = MidiFilePitchWheelEvent_getValue(event);
-					MidiFileIO_putc(io, 0xE0 | (MidiFilePitchWheelEvent_getChannel(event) & 0x0F));
-					MidiFileIO_putc(io, value & 0x7F);
-					MidiFileIO_putc(io, (value >> 7) & 0x7F);
-					break;
-				}
-				case MIDI_FILE_EVENT_TYPE_SYSEX:
-				{
-					int data_length = MidiFileSysexEvent_getDataLength(event);
-					unsigned char *data = MidiFileSysexEvent_getData(event);
-					MidiFileIO_putc(io, data[0]);
-					write_variable_length_quantity(io, data_length - 1);
-					MidiFileIO_write(io, data_length - 1, data + 1);
-					break;
-				}
-				case MIDI_FILE_EVENT_TYPE_META:
-				{
-					int data_length = MidiFileMetaEvent_getDataLength(event);
-					unsigned char *data = MidiFileMetaEvent_getData(event);
-					MidiFileIO_putc(io, 0xFF);
-					MidiFileIO_putc(io, MidiFileMetaEvent_getNumber(event) & 0x7F);
-					write_variable_length_quantity(io, data_length);
-					MidiFileIO_write(io, data_length, data);
-					break;
-				}
-				default:
-				{
-					break;
-				}
+				track_end = event.data + event.data_length;
+				is_complete = 1;
+				break;
 			}
 
-			previous_tick = tick;
+			track_end = reader_track.position;
 		}
 
-		write_variable_length_quantity(io, MidiFileTrack_getEndTick(track) - previous_tick);
-		MidiFileIO_write(io, 3, (unsigned char *)("\xFF\x2F\x00"));
-
-		track_end_offset = MidiFileIO_tell(io);
+		if (!is_complete)
+		{
+			if (patch_file(file, (long)(track_end - buffer), (unsigned char *)("\x00\xFF\x2F\x00"), 4) != 0) result = -1;
+			track_end += 4;
+		}
 
-		MidiFileIO_seek(io, track_size_offset, SEEK_SET);
-		write_uint32(io, track_end_offset - track_start_offset);
+		if (chunk_end != track_end)
+		{
+			encode_uint32(patch, (unsigned long)(track_end - chunk_start));
+			if (patch_file(file, (long)(chunk_start - buffer) - 4, patch, 4) != 0) result = -1;
+		}
 
-		MidiFileIO_seek(io, track_end_offset, SEEK_SET);
+		number_of_tracks++;
+		position = track_end;
+		if (!is_complete) break;
 	}
-}
-
-/*
- * Public API
- */
 
-MidiFile_t MidiFile_load(char *filename)
-{
-	FILE *in;
-	MidiFileIO_t io;
-	MidiFile_t midi_file;
+	encode_uint16(patch, (unsigned short)(number_of_tracks));
+	if (patch_file(file, 10, patch, 2) != 0) result = -1;
 
-	if ((filename == NULL) || ((in = fopen(filename, "rb")) == NULL)) return NULL;
+	/* a cut short track's new end of track event can run past the old end of the file, and that's fine */
+	if ((position < end) && (truncate_file(file, (long)(position - buffer)) != 0)) result = -1;
 
-	io = MidiFileIO_newFromFile(in);
-	midi_file = load_midi_file(io);
-	MidiFileIO_free(io);
-	return midi_file;
+	if (fclose(file) != 0) result = -1;
+	free(buffer);
+	return result;
 }
 
-int MidiFile_save(MidiFile_t midi_file, const char* filename)
+int MidiFileIterator_init(MidiFileIterator_t iterator, MidiFile_t midi_file)
 {
-	FILE *out;
-	MidiFileIO_t io;
-
-	if ((midi_file == NULL) || (filename == NULL) || ((out = fopen(filename, "wb")) == NULL)) return -1;
-
-	io = MidiFileIO_newFromFile(out);
-	save_midi_file(midi_file, io);
-	MidiFileIO_free(io);
+	if ((iterator == NULL) || (midi_file == NULL)) return -1;
+	iterator->midi_file = midi_file;
+	iterator->track = NULL;
+	iterator->epoch = begin_iteration(midi_file);
+	iterator->next_event = midi_file->first_event;
+	iterator->end_tick = -1;
 	return 0;
 }
 
-MidiFile_t MidiFile_loadFromBuffer(unsigned char *buffer)
+int MidiFileIterator_initForTrack(MidiFileIterator_t iterator, MidiFileTrack_t track)
 {
-	MidiFileIO_t io;
-	MidiFile_t midi_file;
-
-	if (buffer == NULL) return NULL;
-
-	io = MidiFileIO_newFromBuffer(buffer);
-	midi_file = load_midi_file(io);
-	MidiFileIO_free(io);
-	return midi_file;
+	if ((iterator == NULL) || (track == NULL)) return -1;
+	iterator->midi_file = track->midi_file;
+	iterator->track = track;
+	iterator->epoch = begin_iteration(track->midi_file);
+	iterator->next_event = track->first_event;
+	iterator->end_tick = -1;
+	return 0;
 }
 
-int MidiFile_saveToBuffer(MidiFile_t midi_file, unsigned char *buffer)
+MidiFileEvent_t MidiFileIterator_next(MidiFileIterator_t iterator)
 {
-	MidiFileIO_t io;
+	MidiFileEvent_t event;
 
-	if ((midi_file == NULL) || (buffer == NULL)) return -1;
+	if (iterator == NULL) return NULL;
 
-	io = MidiFileIO_newFromBuffer(buffer);
-	save_midi_file(midi_file, io);
-	MidiFileIO_free(io);
-	return 0;
-}
+	/* Another iteration has restamped events since this one started, so it can no longer tell which ones it has returned. */
+	assert(iterator->epoch == iterator->midi_file->iteration_epoch);
+	if (iterator->epoch != iterator->midi_file->iteration_epoch) return NULL;
 
-int MidiFile_getFileSize(MidiFile_t midi_file)
-{
-	MidiFileIO_t io;
-	int file_size;
+	event = iterator->next_event;
 
-	if (midi_file == NULL) return -1;
+	while ((event != NULL) && (event->visited_epoch == iterator->epoch))
+	{
+		event = (iterator->track == NULL) ? event->next_event_in_file : event->next_event_in_track;
+	}
+
+	if ((event == NULL) || ((iterator->end_tick >= 0) && (event->tick >= iterator->end_tick)))
+	{
+		event = NULL;
+		iterator->next_event = NULL;
+	}
+	else
+	{
+		event->visited_epoch = iterator->epoch;
+		iterator->next_event = (iterator->track == NULL) ? event->next_event_in_file : event->next_event_in_track;
+	}
 
-	io = MidiFileIO_newFromBuffer(NULL);
-	save_midi_file(midi_file, io);
-	file_size = (int)(MidiFileIO_tell(io));
-	MidiFileIO_free(io);
-	return file_size;
+	return event;
 }
 
 MidiFile_t MidiFile_new(int file_format, MidiFileDivisionType_t division_type, int resolution)
@@ -1130,12 +4743,24 @@ MidiFile_t MidiFile_new(int file_format, MidiFileDivisionType_t division_type, i
 	midi_file->last_track = NULL;
 	midi_file->first_event = NULL;
 	midi_file->last_event = NULL;
+	midi_file->arena = MidiFileArena_new();
+	midi_file->number_of_events = 0;
+	midi_file->number_of_foreign_events = 0;
+	MidiFileTickIndex_init(&(midi_file->tick_index), midi_file->arena);
+	midi_file->type_index = NULL;
 	midi_file->measure_beat = MidiFileMeasureBeat_new();
 	midi_file->measure_beat_tick = MidiFileMeasureBeatTick_new();
 	midi_file->hour_minute_second = MidiFileHourMinuteSecond_new();
 	midi_file->hour_minute_second_frame = MidiFileHourMinuteSecondFrame_new();
-	midi_file->event_iterator_current = NULL;
-	midi_file->event_iterator_next = NULL;
+	midi_file->event_iterator_is_running = 0;
+	midi_file->iteration_epoch = 0;
+	midi_file->is_loading = 0;
+	midi_file->tempo_map = NULL;
+	midi_file->number_of_tempo_map_entries = 0;
+	midi_file->tempo_map_is_valid = 0;
+	midi_file->meter_map = NULL;
+	midi_file->number_of_meter_map_entries = 0;
+	midi_file->meter_map_is_valid = 0;
 	return midi_file;
 }
 
@@ -1155,16 +4780,187 @@ int MidiFile_free(MidiFile_t midi_file)
 	MidiFileMeasureBeatTick_free(midi_file->measure_beat_tick);
 	MidiFileMeasureBeat_free(midi_file->measure_beat);
 
-	for (track = midi_file->first_track; track != NULL; track = next_track)
+	if ((midi_file->number_of_foreign_events == 0) && (midi_file->arena->number_of_live_events == midi_file->number_of_events))
+	{
+		/* everything in the file came from its arena and nothing else from the arena is still in use, so release it in one go */
+		for (track = midi_file->first_track; track != NULL; track = track->next_track) release_snapshot_track(track->snapshot_track);
+		MidiFileArena_free(midi_file->arena);
+	}
+	else
 	{
-		next_track = track->next_track;
-		MidiFileTrack_delete(track);
+		for (track = midi_file->first_track; track != NULL; track = next_track)
+		{
+			next_track = track->next_track;
+			MidiFileTrack_delete(track);
+		}
+
+		MidiFileTickIndex_clear(&(midi_file->tick_index));
+		MidiFileArena_release(midi_file->arena);
 	}
 
+	free(midi_file->meter_map);
+	free(midi_file->tempo_map);
 	free(midi_file);
 	return 0;
 }
 
+MidiFileSnapshot_t MidiFile_snapshot(MidiFile_t midi_file)
+{
+	MidiFileSnapshot_t snapshot;
+	struct MidiFileSnapshotBuffer buffer;
+	MidiFileTrack_t track;
+
+	if (midi_file == NULL) return NULL;
+
+	snapshot = (MidiFileSnapshot_t)(malloc(sizeof(struct MidiFileSnapshot)));
+	snapshot->file_format = midi_file->file_format;
+	snapshot->division_type = midi_file->division_type;
+	snapshot->resolution = midi_file->resolution;
+	snapshot->number_of_frames_per_second = midi_file->number_of_frames_per_second;
+	snapshot->number_of_tracks = midi_file->number_of_tracks;
+	snapshot->tracks = (struct MidiFileSnapshotTrack **)(malloc(sizeof(struct MidiFileSnapshotTrack *) * (midi_file->number_of_tracks + 1)));
+	buffer.bytes = NULL;
+	buffer.length = 0;
+	buffer.size = 0;
+
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
+	{
+		snapshot->tracks[track->number] = take_snapshot_of_track(track, &buffer);
+	}
+
+	free(buffer.bytes);
+	return snapshot;
+}
+
+int MidiFile_restore(MidiFile_t midi_file, MidiFileSnapshot_t snapshot)
+{
+	MidiFileTrack_t track;
+
+	if ((midi_file == NULL) || (snapshot == NULL)) return -1;
+	midi_file->file_format = snapshot->file_format;
+	midi_file->division_type = snapshot->division_type;
+	midi_file->resolution = snapshot->resolution;
+	midi_file->number_of_frames_per_second = snapshot->number_of_frames_per_second;
+	while (midi_file->number_of_tracks > snapshot->number_of_tracks) MidiFileTrack_delete(midi_file->last_track);
+	while (midi_file->number_of_tracks < snapshot->number_of_tracks) MidiFile_createTrack(midi_file);
+
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
+	{
+		restore_snapshot_of_track(track, snapshot->tracks[track->number]);
+	}
+
+	invalidate_conductor_track_maps(midi_file);
+	return 0;
+}
+
+MidiFile_t MidiFile_newFromSnapshot(MidiFileSnapshot_t snapshot)
+{
+	MidiFile_t midi_file;
+
+	if (snapshot == NULL) return NULL;
+	midi_file = MidiFile_new(snapshot->file_format, snapshot->division_type, snapshot->resolution);
+	MidiFile_restore(midi_file, snapshot);
+	return midi_file;
+}
+
+int MidiFileSnapshot_free(MidiFileSnapshot_t snapshot)
+{
+	int track_number;
+
+	if (snapshot == NULL) return -1;
+
+	for (track_number = 0; track_number < snapshot->number_of_tracks; track_number++)
+	{
+		release_snapshot_track(snapshot->tracks[track_number]);
+	}
+
+	free(snapshot->tracks);
+	free(snapshot);
+	return 0;
+}
+
+MidiFilePatch_t MidiFile_diff(MidiFile_t old_midi_file, MidiFile_t new_midi_file)
+{
+	MidiFilePatch_t patch;
+	struct MidiFileSnapshotBuffer buffer, hunk_buffer, event_buffer, other_event_buffer;
+	MidiFileTrack_t old_track, new_track;
+	int track_number;
+
+	if ((old_midi_file == NULL) || (new_midi_file == NULL)) return NULL;
+
+	buffer.bytes = hunk_buffer.bytes = event_buffer.bytes = other_event_buffer.bytes = NULL;
+	buffer.length = hunk_buffer.length = event_buffer.length = other_event_buffer.length = 0;
+	buffer.size = hunk_buffer.size = event_buffer.size = other_event_buffer.size = 0;
+	write_snapshot_byte(&buffer, 'M');
+	write_snapshot_byte(&buffer, 'F');
+	write_snapshot_byte(&buffer, 'd');
+	write_snapshot_byte(&buffer, 'f');
+	write_patch_file_header(&buffer, old_midi_file);
+	write_patch_file_header(&buffer, new_midi_file);
+
+	for (old_track = old_midi_file->first_track, new_track = new_midi_file->first_track, track_number = 0; (old_track != NULL) || (new_track != NULL); track_number++)
+	{
+		diff_tracks(old_track, new_track, track_number, &buffer, &hunk_buffer, &event_buffer, &other_event_buffer);
+		if (old_track != NULL) old_track = old_track->next_track;
+		if (new_track != NULL) new_track = new_track->next_track;
+	}
+
+	write_snapshot_byte(&buffer, 0);
+	free(other_event_buffer.bytes);
+	free(event_buffer.bytes);
+	free(hunk_buffer.bytes);
+
+	patch = (MidiFilePatch_t)(malloc(sizeof(struct MidiFilePatch)));
+	patch->data = buffer.bytes;
+	patch->data_length = buffer.length;
+	return patch;
+}
+
+int MidiFile_applyPatch(MidiFile_t midi_file, MidiFilePatch_t patch)
+{
+	if ((midi_file == NULL) || (patch == NULL) || (apply_patch(midi_file, patch, 0, 1) < 0)) return -1;
+	return apply_patch(midi_file, patch, 0, 0);
+}
+
+int MidiFile_revertPatch(MidiFile_t midi_file, MidiFilePatch_t patch)
+{
+	if ((midi_file == NULL) || (patch == NULL) || (apply_patch(midi_file, patch, 1, 1) < 0)) return -1;
+	return apply_patch(midi_file, patch, 1, 0);
+}
+
+MidiFilePatch_t MidiFilePatch_loadFromBuffer(unsigned char *buffer, int buffer_length)
+{
+	MidiFilePatch_t patch;
+
+	if ((buffer == NULL) || (buffer_length < 5) || (memcmp(buffer, "MFdf", 4) != 0)) return NULL;
+	patch = (MidiFilePatch_t)(malloc(sizeof(struct MidiFilePatch)));
+	patch->data = (unsigned char *)(malloc(buffer_length));
+	patch->data_length = buffer_length;
+	memcpy(patch->data, buffer, buffer_length);
+	return patch;
+}
+
+int MidiFilePatch_saveToBuffer(MidiFilePatch_t patch, unsigned char *buffer)
+{
+	if ((patch == NULL) || (buffer == NULL)) return -1;
+	memcpy(buffer, patch->data, patch->data_length);
+	return 0;
+}
+
+int MidiFilePatch_getSize(MidiFilePatch_t patch)
+{
+	if (patch == NULL) return -1;
+	return (int)(patch->data_length);
+}
+
+int MidiFilePatch_free(MidiFilePatch_t patch)
+{
+	if (patch == NULL) return -1;
+	free(patch->data);
+	free(patch);
+	return 0;
+}
+
 int MidiFile_getFileFormat(MidiFile_t midi_file)
 {
 	if (midi_file == NULL) return -1;
@@ -1188,6 +4984,7 @@ int MidiFile_setDivisionType(MidiFile_t midi_file, MidiFileDivisionType_t divisi
 {
 	if (midi_file == NULL) return -1;
 	midi_file->division_type = division_type;
+	invalidate_conductor_track_maps(midi_file);
 
 	switch (division_type)
 	{
@@ -1230,6 +5027,7 @@ int MidiFile_setResolution(MidiFile_t midi_file, int resolution)
 {
 	if (midi_file == NULL) return -1;
 	midi_file->resolution = resolution;
+	invalidate_conductor_track_maps(midi_file);
 	return 0;
 }
 
@@ -1243,6 +5041,7 @@ int MidiFile_setNumberOfFramesPerSecond(MidiFile_t midi_file, float number_of_fr
 {
 	if (midi_file == NULL) return -1;
 	midi_file->number_of_frames_per_second = number_of_frames_per_second;
+	invalidate_conductor_track_maps(midi_file);
 	return 0;
 }
 
@@ -1252,7 +5051,7 @@ MidiFileTrack_t MidiFile_createTrack(MidiFile_t midi_file)
 
 	if (midi_file == NULL) return NULL;
 
-	new_track = (MidiFileTrack_t)(malloc(sizeof(struct MidiFileTrack)));
+	new_track = (MidiFileTrack_t)(MidiFileArena_allocate(midi_file->arena, sizeof(struct MidiFileTrack)));
 	new_track->midi_file = midi_file;
 	new_track->number = midi_file->number_of_tracks;
 	new_track->end_tick = 0;
@@ -1273,8 +5072,12 @@ MidiFileTrack_t MidiFile_createTrack(MidiFile_t midi_file)
 
 	new_track->first_event = NULL;
 	new_track->last_event = NULL;
-	new_track->event_iterator_current = NULL;
-	new_track->event_iterator_next = NULL;
+	MidiFileTickIndex_init(&(new_track->tick_index), new_track->midi_file->arena);
+	new_track->event_iterator_is_running = 0;
+	new_track->last_events_with_same_note = NULL;
+	new_track->snapshot_track = NULL;
+	new_track->changed_start_tick = LONG_MAX;
+	new_track->changed_end_tick = LONG_MIN;
 
 	return new_track;
 }
@@ -1334,45 +5137,44 @@ MidiFileEvent_t MidiFile_getLastEvent(MidiFile_t midi_file)
 	return midi_file->last_event;
 }
 
-MidiFileEvent_t MidiFile_iterateEvents(MidiFile_t midi_file)
+MidiFileEvent_t MidiFile_getFirstEventOfType(MidiFile_t midi_file, MidiFileEventType_t type, int channel, int number)
 {
-	if (midi_file == NULL) return NULL;
+	struct MidiFileTypeIndexList *list;
+	int is_subtype;
+	MidiFileEvent_t event;
 
-	if (midi_file->event_iterator_current == NULL)
-	{
-		for (midi_file->event_iterator_current = MidiFile_getFirstEvent(midi_file); midi_file->event_iterator_current != NULL; midi_file->event_iterator_current = MidiFileEvent_getNextEventInFile(midi_file->event_iterator_current)) midi_file->event_iterator_current->should_be_visited = 1;
-		midi_file->event_iterator_current = MidiFile_getFirstEvent(midi_file);
-	}
-	else
-	{
-		midi_file->event_iterator_current = midi_file->event_iterator_next;
-	}
+	if ((midi_file == NULL) || (type < 0) || (type >= MIDI_FILE_TYPE_INDEX_NUMBER_OF_TYPES)) return NULL;
+	list = get_type_index_list_for_query(midi_file, type, channel, number, &is_subtype);
+	for (event = list->first_event; (event != NULL) && !event_matches_type_query(event, channel, number); event = get_type_index_links(event, is_subtype)->next_event) {}
+	return event;
+}
 
-	while ((midi_file->event_iterator_current != NULL) && !(midi_file->event_iterator_current->should_be_visited))
-	{
-		midi_file->event_iterator_current = MidiFileEvent_getNextEventInFile(midi_file->event_iterator_current);
-	}
+MidiFileEvent_t MidiFile_iterateEvents(MidiFile_t midi_file)
+{
+	MidiFileEvent_t event;
 
-	if (midi_file->event_iterator_current == NULL)
-	{
-		midi_file->event_iterator_next = NULL;
-	}
-	else
+	if (midi_file == NULL) return NULL;
+
+	if (!(midi_file->event_iterator_is_running))
 	{
-		midi_file->event_iterator_current->should_be_visited = 0;
-		midi_file->event_iterator_next = MidiFileEvent_getNextEventInFile(midi_file->event_iterator_current);
+		MidiFileIterator_init(&(midi_file->event_iterator), midi_file);
+		midi_file->event_iterator_is_running = 1;
 	}
 
-	return midi_file->event_iterator_current;
+	if ((event = MidiFileIterator_next(&(midi_file->event_iterator))) == NULL) midi_file->event_iterator_is_running = 0;
+	return event;
 }
 
 int MidiFile_visitEvents(MidiFile_t midi_file, MidiFileEventVisitorCallback_t visitor_callback, void *user_data)
 {
+	struct MidiFileIterator iterator;
 	MidiFileEvent_t event;
 
 	if ((midi_file == NULL) || (visitor_callback == NULL)) return -1;
 
-	for (event = MidiFile_iterateEvents(midi_file); event != NULL; event = MidiFile_iterateEvents(midi_file))
+	MidiFileIterator_init(&iterator, midi_file);
+
+	for (event = MidiFileIterator_next(&iterator); event != NULL; event = MidiFileIterator_next(&iterator))
 	{
 		(*visitor_callback)(event, user_data);
 	}
@@ -1428,71 +5230,155 @@ int MidiFile_convertTextEventsToSelectionFlags(MidiFile_t midi_file, char *label
 
 int MidiFile_convertStandardEventsToNoteEvents(MidiFile_t midi_file)
 {
+	/*
+	 * Each note end pairs with the earliest still unpaired note start for the
+	 * same channel and note, which is what converting the starts one by one
+	 * with MidiFileNoteStartEvent_getNoteEndEvent() came to.  Starts wait in a
+	 * queue per channel and note, linked through their note pairing links, and
+	 * turn into note events in place once their end turns up.
+	 */
+
 	MidiFileTrack_t track;
-	MidiFileEvent_t event;
+	MidiFileEvent_t event, next_event;
+	MidiFileEvent_t first_waiting_start_events[16 * 128];
+	MidiFileEvent_t last_waiting_start_events[16 * 128];
 
 	if (midi_file == NULL) return -1;
+	begin_rewriting_file(midi_file);
 
-	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
 	{
-		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		memset(first_waiting_start_events, 0, sizeof (MidiFileEvent_t) * 16 * 128);
+		memset(last_waiting_start_events, 0, sizeof (MidiFileEvent_t) * 16 * 128);
+
+		for (event = begin_rewriting_track(track); event != NULL; event = next_event)
 		{
-			MidiFileEvent_t end_event = MidiFileNoteStartEvent_getNoteEndEvent(event);
+			next_event = event->next_event_in_track;
 
-			if (end_event != NULL)
+			if (MidiFileEvent_isNoteStartEvent(event))
 			{
-				MidiFileEvent_t new_event = MidiFileTrack_createNoteEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileEvent_getTick(end_event) - MidiFileEvent_getTick(event),
-					MidiFileNoteStartEvent_getChannel(event),
-					MidiFileNoteStartEvent_getNote(event),
-					MidiFileNoteStartEvent_getVelocity(event),
-					MidiFileNoteEndEvent_getVelocity(end_event));
-
-				MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setPreviousEvent(new_event, event);
-				MidiFileEvent_delete(event);
-				MidiFileEvent_delete(end_event);
-				event = new_event;
+				int key = get_note_pairing_key(event);
+				get_note_pairing_links(event)->next_event_with_same_note = NULL;
+
+				if (last_waiting_start_events[key] == NULL)
+				{
+					first_waiting_start_events[key] = event;
+				}
+				else
+				{
+					get_note_pairing_links(last_waiting_start_events[key])->next_event_with_same_note = event;
+				}
+
+				last_waiting_start_events[key] = event;
+				append_event_to_track(track, event);
+			}
+			else if (MidiFileEvent_isNoteEndEvent(event) && (first_waiting_start_events[get_note_pairing_key(event)] != NULL))
+			{
+				int key = get_note_pairing_key(event);
+				MidiFileEvent_t start_event = first_waiting_start_events[key];
+				int channel = start_event->u.note_on.channel;
+				int note = start_event->u.note_on.note;
+				int velocity = start_event->u.note_on.velocity;
+
+				first_waiting_start_events[key] = get_note_pairing_links(start_event)->next_event_with_same_note;
+				if (first_waiting_start_events[key] == NULL) last_waiting_start_events[key] = NULL;
+
+				change_event_type(start_event, MIDI_FILE_EVENT_TYPE_NOTE);
+				start_event->u.note.duration_ticks = event->tick - start_event->tick;
+				start_event->u.note.channel = channel;
+				start_event->u.note.note = note;
+				start_event->u.note.velocity = velocity;
+				start_event->u.note.end_velocity = MidiFileNoteEndEvent_getVelocity(event);
+				free_event(event);
+			}
+			else
+			{
+				append_event_to_track(track, event);
 			}
 		}
 	}
 
+	finish_rewriting_file(midi_file);
 	return 0;
 }
 
 int MidiFile_convertNoteEventsToStandardEvents(MidiFile_t midi_file)
 {
+	/*
+	 * Note events turn into their start events in place.  The end events are
+	 * collected, sorted by tick, and merged in after any other events at the
+	 * same tick, where adding them one at a time would have put them.
+	 */
+
 	MidiFileTrack_t track;
-	MidiFileEvent_t event;
+	MidiFileEvent_t event, next_event, first_end_event, last_end_event;
+	long number_of_end_events;
 
 	if (midi_file == NULL) return -1;
+	begin_rewriting_file(midi_file);
 
-	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
 	{
-		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		first_end_event = NULL;
+		last_end_event = NULL;
+		number_of_end_events = 0;
+
+		for (event = track->first_event; event != NULL; event = event->next_event_in_track)
 		{
-			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_NOTE)
+			if (event->type == MIDI_FILE_EVENT_TYPE_NOTE)
 			{
-				MidiFileEvent_t note_start_event = MidiFileTrack_createNoteStartAndEndEvents(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileEvent_getTick(event) + MidiFileNoteEvent_getDurationTicks(event),
-					MidiFileNoteEvent_getChannel(event),
-					MidiFileNoteEvent_getNote(event),
-					MidiFileNoteEvent_getVelocity(event),
-					MidiFileNoteEvent_getEndVelocity(event));
-
-				MidiFileEvent_setSelected(note_start_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setSelected(MidiFileNoteStartEvent_getNoteEndEvent(note_start_event), MidiFileEvent_isSelected(event));
-				MidiFileEvent_setPreviousEvent(note_start_event, event);
-				MidiFileEvent_delete(event);
-				event = note_start_event;
+				long end_tick = event->tick + event->u.note.duration_ticks;
+				int channel = event->u.note.channel;
+				int note = event->u.note.note;
+				int velocity = event->u.note.velocity;
+				int end_velocity = event->u.note.end_velocity;
+				MidiFileEvent_t end_event = new_event_like(event, MIDI_FILE_EVENT_TYPE_NOTE_OFF);
+
+				change_event_type(event, MIDI_FILE_EVENT_TYPE_NOTE_ON);
+				event->u.note_on.channel = channel;
+				event->u.note_on.note = note;
+				event->u.note_on.velocity = velocity;
+
+				end_event->tick = end_tick;
+				end_event->u.note_off.channel = channel;
+				end_event->u.note_off.note = note;
+				end_event->u.note_off.velocity = end_velocity;
+				end_event->next_event_in_track = NULL;
+
+				if (last_end_event == NULL)
+				{
+					first_end_event = end_event;
+				}
+				else
+				{
+					last_end_event->next_event_in_track = end_event;
+				}
+
+				last_end_event = end_event;
+				number_of_end_events++;
+			}
+		}
+
+		first_end_event = sort_events_by_tick(first_end_event, number_of_end_events);
+
+		for (event = begin_rewriting_track(track); (event != NULL) || (first_end_event != NULL); )
+		{
+			if ((event != NULL) && ((first_end_event == NULL) || (event->tick <= first_end_event->tick)))
+			{
+				next_event = event->next_event_in_track;
+				append_event_to_track(track, event);
+				event = next_event;
+			}
+			else
+			{
+				next_event = first_end_event->next_event_in_track;
+				append_event_to_track(track, first_end_event);
+				first_end_event = next_event;
 			}
 		}
 	}
 
+	finish_rewriting_file(midi_file);
 	return 0;
 }
 
@@ -1503,122 +5389,127 @@ int MidiFile_convertStandardEventsToFineControlChangeEvents(MidiFile_t midi_file
 	int values[16][64];
 
 	if (midi_file == NULL) return -1;
+	begin_rewriting_file(midi_file);
 
-	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
 	{
 		memset(values, 0, sizeof (int) * 16 * 64);
 
-		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = next_event)
+		for (event = begin_rewriting_track(track); event != NULL; event = next_event)
 		{
-			next_event = MidiFileEvent_getNextEventInTrack(event);
+			next_event = event->next_event_in_track;
 
-			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
+			if ((event->type == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE) && (event->u.control_change.number < 64))
 			{
-				if (MidiFileControlChangeEvent_getNumber(event) < 32)
+				int channel = event->u.control_change.channel;
+				int number = event->u.control_change.number;
+				int value = event->u.control_change.value;
+				int coarse_value, fine_value;
+
+				if (number < 32)
 				{
-					if ((MidiFileEvent_getType(next_event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
-						&& (MidiFileControlChangeEvent_getChannel(next_event) == MidiFileControlChangeEvent_getChannel(event))
-						&& (MidiFileControlChangeEvent_getNumber(next_event) == MidiFileControlChangeEvent_getNumber(event) + 32))
+					coarse_value = value;
+
+					if ((next_event != NULL) && (next_event->type == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE) && (next_event->u.control_change.channel == channel) && (next_event->u.control_change.number == number + 32))
 					{
-						MidiFileEvent_t new_event = MidiFileTrack_createFineControlChangeEvent(
-							track,
-							MidiFileEvent_getTick(event),
-							MidiFileControlChangeEvent_getChannel(event),
-							MidiFileControlChangeEvent_getNumber(event),
-							0);
-
-						MidiFileFineControlChangeEvent_setCoarseValue(new_event, MidiFileControlChangeEvent_getValue(event));
-						MidiFileFineControlChangeEvent_setFineValue(new_event, MidiFileControlChangeEvent_getValue(next_event));
-						values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event)] = MidiFileControlChangeEvent_getValue(event);
-						values[MidiFileControlChangeEvent_getChannel(next_event)][MidiFileControlChangeEvent_getNumber(next_event)] = MidiFileControlChangeEvent_getValue(next_event);
-						MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-						MidiFileEvent_setPreviousEvent(new_event, next_event);
-						MidiFileEvent_delete(event);
-						MidiFileEvent_delete(next_event);
-						next_event = MidiFileEvent_getNextEventInTrack(new_event);
+						/* the pair becomes one event, where the second of them was */
+						MidiFileEvent_t fine_event = next_event;
+						fine_value = fine_event->u.control_change.value;
+						values[channel][number + 32] = fine_value;
+						event->tick = fine_event->tick;
+						next_event = fine_event->next_event_in_track;
+						free_event(fine_event);
 					}
 					else
 					{
-						MidiFileEvent_t new_event = MidiFileTrack_createFineControlChangeEvent(
-							track,
-							MidiFileEvent_getTick(event),
-							MidiFileControlChangeEvent_getChannel(event),
-							MidiFileControlChangeEvent_getNumber(event),
-							0);
-
-						MidiFileFineControlChangeEvent_setCoarseValue(new_event, MidiFileControlChangeEvent_getValue(event));
-						MidiFileFineControlChangeEvent_setFineValue(new_event, values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event) + 32]);
-						values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event)] = MidiFileControlChangeEvent_getValue(event);
-						MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-						MidiFileEvent_setPreviousEvent(new_event, event);
-						MidiFileEvent_delete(event);
-						next_event = MidiFileEvent_getNextEventInTrack(new_event);
+						fine_value = values[channel][number + 32];
 					}
 				}
-				else if (MidiFileControlChangeEvent_getNumber(event) < 64)
+				else
 				{
-					MidiFileEvent_t new_event = MidiFileTrack_createFineControlChangeEvent(
-						track,
-						MidiFileEvent_getTick(event),
-						MidiFileControlChangeEvent_getChannel(event),
-						MidiFileControlChangeEvent_getNumber(event),
-						0);
-
-					MidiFileFineControlChangeEvent_setCoarseValue(new_event, values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event) - 32]);
-					MidiFileFineControlChangeEvent_setFineValue(new_event, MidiFileControlChangeEvent_getValue(event));
-					values[MidiFileControlChangeEvent_getChannel(event)][MidiFileControlChangeEvent_getNumber(event)] = MidiFileControlChangeEvent_getValue(event);
-					MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-					MidiFileEvent_setPreviousEvent(new_event, event);
-					MidiFileEvent_delete(event);
-					next_event = MidiFileEvent_getNextEventInTrack(new_event);
+					coarse_value = values[channel][number - 32];
+					fine_value = value;
 				}
+
+				values[channel][number] = value;
+				change_event_type(event, MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE);
+				event->u.fine_control_change.channel = channel;
+				event->u.fine_control_change.coarse_number = number;
+				event->u.fine_control_change.value = 0;
+				MidiFileFineControlChangeEvent_setCoarseValue(event, coarse_value);
+				MidiFileFineControlChangeEvent_setFineValue(event, fine_value);
 			}
+
+			append_event_to_track(track, event);
 		}
 	}
 
+	finish_rewriting_file(midi_file);
 	return 0;
 }
 
 int MidiFile_convertFineControlChangeEventsToStandardEvents(MidiFile_t midi_file)
 {
 	MidiFileTrack_t track;
-	MidiFileEvent_t event;
+	MidiFileEvent_t event, next_event;
 
 	if (midi_file == NULL) return -1;
+	begin_rewriting_file(midi_file);
 
-	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
 	{
-		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		for (event = begin_rewriting_track(track); event != NULL; event = next_event)
 		{
-			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)
+			next_event = event->next_event_in_track;
+
+			if (event->type == MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)
 			{
-				MidiFileEvent_t coarse_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileFineControlChangeEvent_getChannel(event),
-					MidiFileFineControlChangeEvent_getCoarseNumber(event),
-					MidiFileFineControlChangeEvent_getCoarseValue(event));
-
-				MidiFileEvent_t fine_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileFineControlChangeEvent_getChannel(event),
-					MidiFileFineControlChangeEvent_getFineNumber(event),
-					MidiFileFineControlChangeEvent_getFineValue(event));
-
-				MidiFileEvent_setSelected(coarse_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setSelected(fine_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setPreviousEvent(coarse_event, event);
-				MidiFileEvent_setPreviousEvent(fine_event, coarse_event);
-				MidiFileEvent_delete(event);
-				event = fine_event;
+				MidiFileEvent_t fine_event = new_event_like(event, MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE);
+				int channel = MidiFileFineControlChangeEvent_getChannel(event);
+				int coarse_number = MidiFileFineControlChangeEvent_getCoarseNumber(event);
+				int coarse_value = MidiFileFineControlChangeEvent_getCoarseValue(event);
+
+				fine_event->u.control_change.channel = channel;
+				fine_event->u.control_change.number = MidiFileFineControlChangeEvent_getFineNumber(event);
+				fine_event->u.control_change.value = MidiFileFineControlChangeEvent_getFineValue(event);
+
+				change_event_type(event, MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE);
+				event->u.control_change.channel = channel;
+				event->u.control_change.number = coarse_number;
+				event->u.control_change.value = coarse_value;
+
+				append_event_to_track(track, event);
+				append_event_to_track(track, fine_event);
+			}
+			else
+			{
+				append_event_to_track(track, event);
 			}
 		}
 	}
 
+	finish_rewriting_file(midi_file);
 	return 0;
 }
 
+static void change_to_rpn_or_nrpn_event(MidiFileEvent_t event, int channel, int is_nrpn, int number, int value)
+{
+	if (is_nrpn)
+	{
+		change_event_type(event, MIDI_FILE_EVENT_TYPE_NRPN);
+		event->u.nrpn.channel = channel;
+		event->u.nrpn.number = number;
+		event->u.nrpn.value = value;
+	}
+	else
+	{
+		change_event_type(event, MIDI_FILE_EVENT_TYPE_RPN);
+		event->u.rpn.channel = channel;
+		event->u.rpn.number = number;
+		event->u.rpn.value = value;
+	}
+}
+
 int MidiFile_convertStandardEventsToRpnAndNrpnEvents(MidiFile_t midi_file)
 {
 	MidiFileTrack_t track;
@@ -1628,338 +5519,184 @@ int MidiFile_convertStandardEventsToRpnAndNrpnEvents(MidiFile_t midi_file)
 	int values[16];
 
 	if (midi_file == NULL) return -1;
+	begin_rewriting_file(midi_file);
 
-	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
 	{
 		memset(is_nrpn, 0, sizeof (int) * 16);
 		memset(numbers, 0, sizeof (int) * 16);
 		memset(values, 0, sizeof (int) * 16);
 
-		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = next_event)
+		for (event = begin_rewriting_track(track); event != NULL; event = next_event)
 		{
-			next_event = MidiFileEvent_getNextEventInTrack(event);
+			next_event = event->next_event_in_track;
 
-			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
+			if (event->type == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
 			{
-				if (MidiFileControlChangeEvent_getNumber(event) == 101)
-				{
-					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
-					{
-						is_nrpn[MidiFileControlChangeEvent_getChannel(event)] = 0;
-						numbers[MidiFileControlChangeEvent_getChannel(event)] = MidiFileControlChangeEvent_getValue(event) << 7;
-					}
-					else
-					{
-						numbers[MidiFileControlChangeEvent_getChannel(event)] = (MidiFileControlChangeEvent_getValue(event) << 7) | (numbers[MidiFileControlChangeEvent_getChannel(event)] & 0x7F) ;
-					}
-
-					values[MidiFileControlChangeEvent_getChannel(event)] = 0;
-					MidiFileEvent_delete(event);
-				}
-				else if (MidiFileControlChangeEvent_getNumber(event) == 100)
-				{
-					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
-					{
-						is_nrpn[MidiFileControlChangeEvent_getChannel(event)] = 0;
-						numbers[MidiFileControlChangeEvent_getChannel(event)] = MidiFileControlChangeEvent_getValue(event);
-					}
-					else
-					{
-						numbers[MidiFileControlChangeEvent_getChannel(event)] = (numbers[MidiFileControlChangeEvent_getChannel(event)] & ~0x7F) | MidiFileControlChangeEvent_getValue(event);
-					}
+				int channel = event->u.control_change.channel;
+				int value = event->u.control_change.value;
 
-					values[MidiFileControlChangeEvent_getChannel(event)] = 0;
-					MidiFileEvent_delete(event);
-				}
-				else if (MidiFileControlChangeEvent_getNumber(event) == 6)
+				switch (event->u.control_change.number)
 				{
-					if ((MidiFileEvent_getType(next_event) == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)
-						&& (MidiFileControlChangeEvent_getChannel(next_event) == MidiFileControlChangeEvent_getChannel(event))
-						&& (MidiFileControlChangeEvent_getNumber(next_event) == 38))
+					case 101:
 					{
-						MidiFileEvent_t new_event;
-
-						values[MidiFileControlChangeEvent_getChannel(event)] = (MidiFileControlChangeEvent_getValue(event) << 7) | MidiFileControlChangeEvent_getValue(next_event);
-
-						if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+						if (is_nrpn[channel])
 						{
-							new_event = MidiFileTrack_createNrpnEvent(
-								track,
-								MidiFileEvent_getTick(event),
-								MidiFileControlChangeEvent_getChannel(event),
-								numbers[MidiFileControlChangeEvent_getChannel(event)],
-								values[MidiFileControlChangeEvent_getChannel(event)]);
+							is_nrpn[channel] = 0;
+							numbers[channel] = value << 7;
 						}
 						else
 						{
-							new_event = MidiFileTrack_createRpnEvent(
-								track,
-								MidiFileEvent_getTick(event),
-								MidiFileControlChangeEvent_getChannel(event),
-								numbers[MidiFileControlChangeEvent_getChannel(event)],
-								values[MidiFileControlChangeEvent_getChannel(event)]);
+							numbers[channel] = (value << 7) | (numbers[channel] & 0x7F);
 						}
 
-						MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-						MidiFileEvent_setPreviousEvent(new_event, next_event);
-						MidiFileEvent_delete(event);
-						MidiFileEvent_delete(next_event);
-						next_event = MidiFileEvent_getNextEventInTrack(new_event);
+						values[channel] = 0;
+						free_event(event);
+						break;
 					}
-					else
+					case 100:
 					{
-						MidiFileEvent_t new_event;
-
-						values[MidiFileControlChangeEvent_getChannel(event)] = (MidiFileControlChangeEvent_getValue(event) << 7) | (values[MidiFileControlChangeEvent_getChannel(event)] & 0x7F);
-
-						if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+						if (is_nrpn[channel])
 						{
-							new_event = MidiFileTrack_createNrpnEvent(
-								track,
-								MidiFileEvent_getTick(event),
-								MidiFileControlChangeEvent_getChannel(event),
-								numbers[MidiFileControlChangeEvent_getChannel(event)],
-								values[MidiFileControlChangeEvent_getChannel(event)]);
+							is_nrpn[channel] = 0;
+							numbers[channel] = value;
 						}
 						else
 						{
-							new_event = MidiFileTrack_createRpnEvent(
-								track,
-								MidiFileEvent_getTick(event),
-								MidiFileControlChangeEvent_getChannel(event),
-								numbers[MidiFileControlChangeEvent_getChannel(event)],
-								values[MidiFileControlChangeEvent_getChannel(event)]);
+							numbers[channel] = (numbers[channel] & ~0x7F) | value;
 						}
 
-						MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-						MidiFileEvent_setPreviousEvent(new_event, event);
-						MidiFileEvent_delete(event);
-						next_event = MidiFileEvent_getNextEventInTrack(new_event);
-					}
-				}
-				else if (MidiFileControlChangeEvent_getNumber(event) == 38)
-				{
-					MidiFileEvent_t new_event;
-
-					values[MidiFileControlChangeEvent_getChannel(event)] = (values[MidiFileControlChangeEvent_getChannel(event)] & ~0x7F) | MidiFileControlChangeEvent_getValue(event);
-
-					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
-					{
-						new_event = MidiFileTrack_createNrpnEvent(
-							track,
-							MidiFileEvent_getTick(event),
-							MidiFileControlChangeEvent_getChannel(event),
-							numbers[MidiFileControlChangeEvent_getChannel(event)],
-							values[MidiFileControlChangeEvent_getChannel(event)]);
+						values[channel] = 0;
+						free_event(event);
+						break;
 					}
-					else
+					case 6:
 					{
-						new_event = MidiFileTrack_createRpnEvent(
-							track,
-							MidiFileEvent_getTick(event),
-							MidiFileControlChangeEvent_getChannel(event),
-							numbers[MidiFileControlChangeEvent_getChannel(event)],
-							values[MidiFileControlChangeEvent_getChannel(event)]);
-					}
-
-					MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-					MidiFileEvent_setPreviousEvent(new_event, event);
-					MidiFileEvent_delete(event);
-					next_event = MidiFileEvent_getNextEventInTrack(new_event);
-				}
-				else if (MidiFileControlChangeEvent_getNumber(event) == 96)
-				{
-					MidiFileEvent_t new_event;
-
-					values[MidiFileControlChangeEvent_getChannel(event)]++;
+						if ((next_event != NULL) && (next_event->type == MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE) && (next_event->u.control_change.channel == channel) && (next_event->u.control_change.number == 38))
+						{
+							/* the pair becomes one event, where the second of them was */
+							MidiFileEvent_t fine_event = next_event;
+							values[channel] = (value << 7) | fine_event->u.control_change.value;
+							next_event = fine_event->next_event_in_track;
+							free_event(fine_event);
+						}
+						else
+						{
+							values[channel] = (value << 7) | (values[channel] & 0x7F);
+						}
 
-					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+						change_to_rpn_or_nrpn_event(event, channel, is_nrpn[channel], numbers[channel], values[channel]);
+						append_event_to_track(track, event);
+						break;
+					}
+					case 38:
 					{
-						new_event = MidiFileTrack_createNrpnEvent(
-							track,
-							MidiFileEvent_getTick(event),
-							MidiFileControlChangeEvent_getChannel(event),
-							numbers[MidiFileControlChangeEvent_getChannel(event)],
-							values[MidiFileControlChangeEvent_getChannel(event)]);
+						values[channel] = (values[channel] & ~0x7F) | value;
+						change_to_rpn_or_nrpn_event(event, channel, is_nrpn[channel], numbers[channel], values[channel]);
+						append_event_to_track(track, event);
+						break;
 					}
-					else
+					case 96:
 					{
-						new_event = MidiFileTrack_createRpnEvent(
-							track,
-							MidiFileEvent_getTick(event),
-							MidiFileControlChangeEvent_getChannel(event),
-							numbers[MidiFileControlChangeEvent_getChannel(event)],
-							values[MidiFileControlChangeEvent_getChannel(event)]);
+						values[channel]++;
+						change_to_rpn_or_nrpn_event(event, channel, is_nrpn[channel], numbers[channel], values[channel]);
+						append_event_to_track(track, event);
+						break;
 					}
-
-					MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-					MidiFileEvent_setPreviousEvent(new_event, event);
-					MidiFileEvent_delete(event);
-					next_event = MidiFileEvent_getNextEventInTrack(new_event);
-				}
-				else if (MidiFileControlChangeEvent_getNumber(event) == 97)
-				{
-					MidiFileEvent_t new_event;
-
-					values[MidiFileControlChangeEvent_getChannel(event)]--;
-
-					if (is_nrpn[MidiFileControlChangeEvent_getChannel(event)])
+					case 97:
 					{
-						new_event = MidiFileTrack_createNrpnEvent(
-							track,
-							MidiFileEvent_getTick(event),
-							MidiFileControlChangeEvent_getChannel(event),
-							numbers[MidiFileControlChangeEvent_getChannel(event)],
-							values[MidiFileControlChangeEvent_getChannel(event)]);
+						values[channel]--;
+						change_to_rpn_or_nrpn_event(event, channel, is_nrpn[channel], numbers[channel], values[channel]);
+						append_event_to_track(track, event);
+						break;
 					}
-					else
+					default:
 					{
-						new_event = MidiFileTrack_createRpnEvent(
-							track,
-							MidiFileEvent_getTick(event),
-							MidiFileControlChangeEvent_getChannel(event),
-							numbers[MidiFileControlChangeEvent_getChannel(event)],
-							values[MidiFileControlChangeEvent_getChannel(event)]);
+						append_event_to_track(track, event);
+						break;
 					}
-
-					MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-					MidiFileEvent_setPreviousEvent(new_event, event);
-					MidiFileEvent_delete(event);
-					next_event = MidiFileEvent_getNextEventInTrack(new_event);
 				}
 			}
-			else if ((MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE) && (MidiFileFineControlChangeEvent_getCoarseNumber(event) == 6))
+			else if ((event->type == MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE) && (event->u.fine_control_change.coarse_number == 6))
 			{
-				MidiFileEvent_t new_event;
-
-				values[MidiFileFineControlChangeEvent_getChannel(event)] = MidiFileFineControlChangeEvent_getValue(event);
-
-				if (is_nrpn[MidiFileFineControlChangeEvent_getChannel(event)])
-				{
-					new_event = MidiFileTrack_createNrpnEvent(
-						track,
-						MidiFileEvent_getTick(event),
-						MidiFileFineControlChangeEvent_getChannel(event),
-						numbers[MidiFileFineControlChangeEvent_getChannel(event)],
-						values[MidiFileFineControlChangeEvent_getChannel(event)]);
-				}
-				else
-				{
-					new_event = MidiFileTrack_createRpnEvent(
-						track,
-						MidiFileEvent_getTick(event),
-						MidiFileFineControlChangeEvent_getChannel(event),
-						numbers[MidiFileFineControlChangeEvent_getChannel(event)],
-						values[MidiFileFineControlChangeEvent_getChannel(event)]);
-				}
-
-				MidiFileEvent_setSelected(new_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setPreviousEvent(new_event, event);
-				MidiFileEvent_delete(event);
-				next_event = MidiFileEvent_getNextEventInTrack(new_event);
+				int channel = event->u.fine_control_change.channel;
+				values[channel] = event->u.fine_control_change.value;
+				change_to_rpn_or_nrpn_event(event, channel, is_nrpn[channel], numbers[channel], values[channel]);
+				append_event_to_track(track, event);
+			}
+			else
+			{
+				append_event_to_track(track, event);
 			}
 		}
 	}
 
+	finish_rewriting_file(midi_file);
 	return 0;
 }
 
 int MidiFile_convertRpnAndNrpnEventsToStandardEvents(MidiFile_t midi_file)
 {
 	MidiFileTrack_t track;
-	MidiFileEvent_t event;
+	MidiFileEvent_t event, next_event;
 
 	if (midi_file == NULL) return -1;
+	begin_rewriting_file(midi_file);
 
-	for (track = MidiFile_getFirstTrack(midi_file); track != NULL; track = MidiFileTrack_getNextTrack(track))
+	for (track = midi_file->first_track; track != NULL; track = track->next_track)
 	{
-		for (event = MidiFileTrack_getFirstEvent(track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+		for (event = begin_rewriting_track(track); event != NULL; event = next_event)
 		{
-			if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_RPN)
+			next_event = event->next_event_in_track;
+
+			if ((event->type == MIDI_FILE_EVENT_TYPE_RPN) || (event->type == MIDI_FILE_EVENT_TYPE_NRPN))
 			{
-				MidiFileEvent_t coarse_number_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileRpnEvent_getChannel(event),
-					101,
-					MidiFileRpnEvent_getCoarseNumber(event));
-
-				MidiFileEvent_t fine_number_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileRpnEvent_getChannel(event),
-					100,
-					MidiFileRpnEvent_getFineNumber(event));
-
-				MidiFileEvent_t coarse_value_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileRpnEvent_getChannel(event),
-					6,
-					MidiFileRpnEvent_getCoarseValue(event));
-
-				MidiFileEvent_t fine_value_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileRpnEvent_getChannel(event),
-					38,
-					MidiFileRpnEvent_getFineValue(event));
-
-				MidiFileEvent_setSelected(coarse_number_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setSelected(fine_number_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setSelected(coarse_value_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setSelected(fine_value_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setPreviousEvent(coarse_number_event, event);
-				MidiFileEvent_setPreviousEvent(fine_number_event, coarse_number_event);
-				MidiFileEvent_setPreviousEvent(coarse_value_event, fine_number_event);
-				MidiFileEvent_setPreviousEvent(fine_value_event, coarse_value_event);
-				MidiFileEvent_delete(event);
-				event = fine_value_event;
+				/* the event itself becomes the first of the four controller messages */
+				int is_nrpn = (event->type == MIDI_FILE_EVENT_TYPE_NRPN);
+				int channel = is_nrpn ? event->u.nrpn.channel : event->u.rpn.channel;
+				int number = is_nrpn ? event->u.nrpn.number : event->u.rpn.number;
+				int value = is_nrpn ? event->u.nrpn.value : event->u.rpn.value;
+				int controller_numbers[4];
+				int controller_values[4];
+				int i;
+
+				controller_numbers[0] = is_nrpn ? 99 : 101;
+				controller_values[0] = (number >> 7) & 0x7F;
+				controller_numbers[1] = is_nrpn ? 98 : 100;
+				controller_values[1] = number & 0x7F;
+				controller_numbers[2] = 6;
+				controller_values[2] = (value >> 7) & 0x7F;
+				controller_numbers[3] = 38;
+				controller_values[3] = value & 0x7F;
+
+				for (i = 0; i < 4; i++)
+				{
+					MidiFileEvent_t controller_event;
+
+					if (i == 0)
+					{
+						controller_event = event;
+						change_event_type(controller_event, MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE);
+					}
+					else
+					{
+						controller_event = new_event_like(event, MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE);
+					}
+
+					controller_event->u.control_change.channel = channel;
+					controller_event->u.control_change.number = controller_numbers[i];
+					controller_event->u.control_change.value = controller_values[i];
+					append_event_to_track(track, controller_event);
+				}
 			}
-			else if (MidiFileEvent_getType(event) == MIDI_FILE_EVENT_TYPE_NRPN)
+			else
 			{
-				MidiFileEvent_t coarse_number_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileNrpnEvent_getChannel(event),
-					99,
-					MidiFileNrpnEvent_getCoarseNumber(event));
-
-				MidiFileEvent_t fine_number_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileNrpnEvent_getChannel(event),
-					98,
-					MidiFileNrpnEvent_getFineNumber(event));
-
-				MidiFileEvent_t coarse_value_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileNrpnEvent_getChannel(event),
-					6,
-					MidiFileNrpnEvent_getCoarseValue(event));
-
-				MidiFileEvent_t fine_value_event = MidiFileTrack_createControlChangeEvent(
-					MidiFileEvent_getTrack(event),
-					MidiFileEvent_getTick(event),
-					MidiFileNrpnEvent_getChannel(event),
-					38,
-					MidiFileNrpnEvent_getFineValue(event));
-
-				MidiFileEvent_setSelected(coarse_number_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setSelected(fine_number_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setSelected(coarse_value_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setSelected(fine_value_event, MidiFileEvent_isSelected(event));
-				MidiFileEvent_setPreviousEvent(coarse_number_event, event);
-				MidiFileEvent_setPreviousEvent(fine_number_event, coarse_number_event);
-				MidiFileEvent_setPreviousEvent(coarse_value_event, fine_number_event);
-				MidiFileEvent_setPreviousEvent(fine_value_event, coarse_value_event);
-				MidiFileEvent_delete(event);
-				event = fine_value_event;
+				append_event_to_track(track, event);
 			}
 		}
 	}
 
+	finish_rewriting_file(midi_file);
 	return 0;
 }
 
@@ -1972,84 +5709,12 @@ float MidiFile_getBeatFromTick(MidiFile_t midi_file, long tick)
 			return (float)(tick) / MidiFile_getResolution(midi_file);
 		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE24:
-		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_beat = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) < tick); event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					tempo_event_beat += (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(24.0) / (float)(60.0) * tempo);
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_beat + (((float)(tick - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(24.0) / (float)(60.0) * tempo);
-		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE25:
-		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_beat = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) < tick); event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					tempo_event_beat += (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(25.0) / (float)(60.0) * tempo);
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_beat + (((float)(tick - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(25.0) / (float)(60.0) * tempo);
-		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE30DROP:
-		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_beat = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) < tick); event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					tempo_event_beat += (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(29.97) / (float)(60.0) * tempo);
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_beat + (((float)(tick - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(29.97) / (float)(60.0) * tempo);
-		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE30:
 		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_beat = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) < tick); event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					tempo_event_beat += (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(30.0) / (float)(60.0) * tempo);
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_beat + (((float)(tick - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(30.0) / (float)(60.0) * tempo);
+			struct MidiFileTempoMapEntry *entry = get_tempo_map_entry_for_tick(midi_file, tick, 0);
+			return (float)(entry->beat + ((tick - entry->tick) * get_beats_per_tick(midi_file, entry->tempo)));
 		}
 		default:
 		{
@@ -2067,92 +5732,12 @@ long MidiFile_getTickFromBeat(MidiFile_t midi_file, float beat)
 			return (long)(beat * MidiFile_getResolution(midi_file));
 		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE24:
-		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_beat = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					float next_tempo_event_beat = tempo_event_beat + (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(24.0) / (float)(60.0) * tempo);
-					if (next_tempo_event_beat >= beat) break;
-					tempo_event_beat = next_tempo_event_beat;
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_tick + (long)((beat - tempo_event_beat) / tempo * 60.0 * 24.0 * MidiFile_getResolution(midi_file));
-		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE25:
-		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_beat = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					float next_tempo_event_beat = tempo_event_beat + (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(25.0) / (float)(60.0) * tempo);
-					if (next_tempo_event_beat >= beat) break;
-					tempo_event_beat = next_tempo_event_beat;
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_tick + (long)((beat - tempo_event_beat) / tempo * 60.0 * 25.0 * MidiFile_getResolution(midi_file));
-		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE30DROP:
-		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_beat = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					float next_tempo_event_beat = tempo_event_beat + (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(29.97) / (float)(60.0) * tempo);
-					if (next_tempo_event_beat >= beat) break;
-					tempo_event_beat = next_tempo_event_beat;
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_tick + (long)((beat - tempo_event_beat) / tempo * 60.0 * 29.97 * MidiFile_getResolution(midi_file));
-		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE30:
 		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_beat = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					float next_tempo_event_beat = tempo_event_beat + (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (float)(30.0) / (float)(60.0) * tempo);
-					if (next_tempo_event_beat >= beat) break;
-					tempo_event_beat = next_tempo_event_beat;
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_tick + (long)((beat - tempo_event_beat) / tempo * 60.0 * 30.0 * MidiFile_getResolution(midi_file));
+			struct MidiFileTempoMapEntry *entry = get_tempo_map_entry_for_beat(midi_file, beat);
+			return entry->tick + (long)((beat - entry->beat) / get_beats_per_tick(midi_file, entry->tempo));
 		}
 		default:
 		{
@@ -2167,23 +5752,8 @@ float MidiFile_getTimeFromTick(MidiFile_t midi_file, long tick)
 	{
 		case MIDI_FILE_DIVISION_TYPE_PPQ:
 		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_time = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) < tick); event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					tempo_event_time += (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (tempo / 60));
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_time + (((float)(tick - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (tempo / 60));
+			struct MidiFileTempoMapEntry *entry = get_tempo_map_entry_for_tick(midi_file, tick, 0);
+			return (float)(entry->time + ((tick - entry->tick) * get_seconds_per_tick(midi_file, entry->tempo)));
 		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE24:
 		{
@@ -2214,25 +5784,8 @@ long MidiFile_getTickFromTime(MidiFile_t midi_file, float time)
 	{
 		case MIDI_FILE_DIVISION_TYPE_PPQ:
 		{
-			MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-			MidiFileEvent_t event;
-			float tempo_event_time = 0.0;
-			long tempo_event_tick = 0;
-			float tempo = 120.0;
-
-			for (event = MidiFileTrack_getFirstEvent(conductor_track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-			{
-				if (MidiFileEvent_isTempoEvent(event))
-				{
-					float next_tempo_event_time = tempo_event_time + (((float)(MidiFileEvent_getTick(event) - tempo_event_tick)) / MidiFile_getResolution(midi_file) / (tempo / 60));
-					if (next_tempo_event_time >= time) break;
-					tempo_event_time = next_tempo_event_time;
-					tempo_event_tick = MidiFileEvent_getTick(event);
-					tempo = MidiFileTempoEvent_getTempo(event);
-				}
-			}
-
-			return tempo_event_tick + (long)((time - tempo_event_time) * (tempo / 60) * MidiFile_getResolution(midi_file));
+			struct MidiFileTempoMapEntry *entry = get_tempo_map_entry_for_time(midi_file, time);
+			return entry->tick + (long)((time - entry->time) / get_seconds_per_tick(midi_file, entry->tempo));
 		}
 		case MIDI_FILE_DIVISION_TYPE_SMPTE24:
 		{
@@ -2259,216 +5812,57 @@ long MidiFile_getTickFromTime(MidiFile_t midi_file, float time)
 
 float MidiFile_getMeasureFromTick(MidiFile_t midi_file, long tick)
 {
-	if (midi_file == NULL)
-	{
-		return -1.0;
-	}
-	else
-	{
-		MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-		MidiFileEvent_t event;
-		float time_signature_event_beat = 0.0;
-		float measure = 0.0;
-		int numerator = 4;
-		int denominator = 4;
-
-		for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) < tick); event = MidiFileEvent_getNextEventInTrack(event))
-		{
-			if (MidiFileEvent_isTimeSignatureEvent(event))
-			{
-				float next_time_signature_event_beat = MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(event));
-				measure += ((next_time_signature_event_beat - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-				time_signature_event_beat = next_time_signature_event_beat;
-				numerator = MidiFileTimeSignatureEvent_getNumerator(event);
-				denominator = MidiFileTimeSignatureEvent_getDenominator(event);
-			}
-		}
-
-		measure += ((MidiFile_getBeatFromTick(midi_file, tick) - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-		return measure;
-	}
+	struct MidiFileMeterMapEntry *entry;
+	if (midi_file == NULL) return -1.0;
+	return (float)(get_measure_from_tick(midi_file, tick, &entry));
 }
 
 long MidiFile_getTickFromMeasure(MidiFile_t midi_file, float measure)
 {
-	if (midi_file == NULL)
-	{
-		return -1;
-	}
-	else
-	{
-		MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-		MidiFileEvent_t event;
-		float time_signature_event_beat = 0.0;
-		float time_signature_event_measure = 0.0;
-		int numerator = 4;
-		int denominator = 4;
-
-		for (event = MidiFileTrack_getFirstEvent(conductor_track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-		{
-			if (MidiFileEvent_isTimeSignatureEvent(event))
-			{
-				float next_time_signature_event_beat = MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(event));
-				float next_time_signature_event_measure = time_signature_event_measure + ((next_time_signature_event_beat - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-				if (next_time_signature_event_measure >= measure) break;
-				time_signature_event_beat = next_time_signature_event_beat;
-				time_signature_event_measure = next_time_signature_event_measure;
-				numerator = MidiFileTimeSignatureEvent_getNumerator(event);
-				denominator = MidiFileTimeSignatureEvent_getDenominator(event);
-			}
-		}
-
-		return MidiFile_getTickFromBeat(midi_file, time_signature_event_beat + ((measure - time_signature_event_measure) / ((float)(denominator) / numerator / 4)));
-	}
-}
-
-int MidiFile_setMeasureBeatFromTick(MidiFile_t midi_file, long tick, MidiFileMeasureBeat_t measure_beat)
-{
-	if ((midi_file == NULL) || (measure_beat == NULL))
-	{
-		return -1;
-	}
-	else
-	{
-		MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-		MidiFileEvent_t event;
-		float time_signature_event_beat = 0.0;
-		float measure = 0.0;
-		int numerator = 4;
-		int denominator = 4;
-
-		for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) < tick); event = MidiFileEvent_getNextEventInTrack(event))
-		{
-			if (MidiFileEvent_isTimeSignatureEvent(event))
-			{
-				float next_time_signature_event_beat = MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(event));
-				measure += ((next_time_signature_event_beat - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-				time_signature_event_beat = next_time_signature_event_beat;
-				numerator = MidiFileTimeSignatureEvent_getNumerator(event);
-				denominator = MidiFileTimeSignatureEvent_getDenominator(event);
-			}
-		}
-
-		measure += ((MidiFile_getBeatFromTick(midi_file, tick) - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-		MidiFileMeasureBeat_setMeasure(measure_beat, (long)(measure) + 1);
-		MidiFileMeasureBeat_setBeat(measure_beat, ((measure - (float)(MidiFileMeasureBeat_getMeasure(measure_beat) - 1)) * numerator) + 1.0);
-		return 0;
-	}
-}
-
-long MidiFile_getTickFromMeasureBeat(MidiFile_t midi_file, MidiFileMeasureBeat_t measure_beat)
-{
-	if ((midi_file == NULL) || (measure_beat == NULL))
-	{
-		return -1;
-	}
-	else
-	{
-		MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-		MidiFileEvent_t event;
-		float time_signature_event_beat = 0.0;
-		float time_signature_event_measure = 0.0;
-		long time_signature_event_visible_measure = 1;
-		float time_signature_event_visible_beat = 1.0;
-		int numerator = 4;
-		int denominator = 4;
-
-		for (event = MidiFileTrack_getFirstEvent(conductor_track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-		{
-			if (MidiFileEvent_isTimeSignatureEvent(event))
-			{
-				float next_time_signature_event_beat = MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(event));
-				float next_time_signature_event_measure = time_signature_event_measure + ((next_time_signature_event_beat - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-				long next_time_signature_event_visible_measure = (long)(next_time_signature_event_measure) + 1;
-				float next_time_signature_event_visible_beat = ((next_time_signature_event_measure - (float)(next_time_signature_event_visible_measure - 1)) * numerator) + 1.0;
-				if ((next_time_signature_event_visible_measure > MidiFileMeasureBeat_getMeasure(measure_beat)) || ((next_time_signature_event_visible_measure == MidiFileMeasureBeat_getMeasure(measure_beat)) && (next_time_signature_event_visible_beat >= MidiFileMeasureBeat_getBeat(measure_beat)))) break;
-				time_signature_event_beat = next_time_signature_event_beat;
-				time_signature_event_measure = next_time_signature_event_measure;
-				time_signature_event_visible_measure = next_time_signature_event_visible_measure;
-				time_signature_event_visible_beat = next_time_signature_event_visible_beat;
-				numerator = MidiFileTimeSignatureEvent_getNumerator(event);
-				denominator = MidiFileTimeSignatureEvent_getDenominator(event);
-			}
-		}
-
-		return MidiFile_getTickFromBeat(midi_file, time_signature_event_beat + ((((MidiFileMeasureBeat_getMeasure(measure_beat) - time_signature_event_visible_measure) * numerator) + (MidiFileMeasureBeat_getBeat(measure_beat) - time_signature_event_visible_beat)) * 4 / denominator));
-	}
+	double key = measure;
+	struct MidiFileMeterMapEntry *entry;
+	if (midi_file == NULL) return -1;
+	entry = get_meter_map_entry(midi_file, meter_map_entry_precedes_measure, &key);
+	return MidiFile_getTickFromBeat(midi_file, (float)(entry->beat + ((measure - entry->measure) / ((double)(entry->denominator) / entry->numerator / 4))));
 }
 
-int MidiFile_setMeasureBeatTickFromTick(MidiFile_t midi_file, long tick, MidiFileMeasureBeatTick_t measure_beat_tick)
-{
-	if ((midi_file == NULL) || (measure_beat_tick == NULL))
-	{
-		return -1;
-	}
-	else
-	{
-		MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-		MidiFileEvent_t event;
-		float time_signature_event_beat = 0.0;
-		float measure = 0.0;
-		int numerator = 4;
-		int denominator = 4;
-
-		for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) < tick); event = MidiFileEvent_getNextEventInTrack(event))
-		{
-			if (MidiFileEvent_isTimeSignatureEvent(event))
-			{
-				float next_time_signature_event_beat = MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(event));
-				measure += ((next_time_signature_event_beat - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-				time_signature_event_beat = next_time_signature_event_beat;
-				numerator = MidiFileTimeSignatureEvent_getNumerator(event);
-				denominator = MidiFileTimeSignatureEvent_getDenominator(event);
-			}
-		}
-
-		measure += ((MidiFile_getBeatFromTick(midi_file, tick) - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-		MidiFileMeasureBeatTick_setMeasure(measure_beat_tick, (long)(measure) + 1);
-		MidiFileMeasureBeatTick_setBeat(measure_beat_tick, (long)((measure - (float)(MidiFileMeasureBeatTick_getMeasure(measure_beat_tick) - 1)) * numerator) + 1);
-		MidiFileMeasureBeatTick_setTick(measure_beat_tick, tick - MidiFile_getTickFromBeat(midi_file, (float)((long)(MidiFile_getBeatFromTick(midi_file, tick)))));
-		return 0;
-	}
+int MidiFile_setMeasureBeatFromTick(MidiFile_t midi_file, long tick, MidiFileMeasureBeat_t measure_beat)
+{
+	struct MidiFileMeterMapEntry *entry;
+	double measure;
+	if ((midi_file == NULL) || (measure_beat == NULL)) return -1;
+	measure = get_measure_from_tick(midi_file, tick, &entry);
+	MidiFileMeasureBeat_setMeasure(measure_beat, (long)(measure) + 1);
+	MidiFileMeasureBeat_setBeat(measure_beat, (float)(((measure - (double)(MidiFileMeasureBeat_getMeasure(measure_beat) - 1)) * entry->numerator) + 1.0));
+	return 0;
 }
 
-long MidiFile_getTickFromMeasureBeatTick(MidiFile_t midi_file, MidiFileMeasureBeatTick_t measure_beat_tick)
+long MidiFile_getTickFromMeasureBeat(MidiFile_t midi_file, MidiFileMeasureBeat_t measure_beat)
 {
-	if ((midi_file == NULL) || (measure_beat_tick == NULL))
-	{
-		return -1;
-	}
-	else
-	{
-		MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-		MidiFileEvent_t event;
-		float time_signature_event_beat = 0.0;
-		float time_signature_event_measure = 0.0;
-		long time_signature_event_visible_measure = 1;
-		long time_signature_event_visible_beat = 1;
-		int numerator = 4;
-		int denominator = 4;
+	struct MidiFileMeterMapEntry *entry;
+	if ((midi_file == NULL) || (measure_beat == NULL)) return -1;
+	entry = get_meter_map_entry_for_visible_position(midi_file, MidiFileMeasureBeat_getMeasure(measure_beat), meter_map_entry_precedes_measure_beat, measure_beat);
+	return MidiFile_getTickFromBeat(midi_file, (float)(entry->beat + ((((MidiFileMeasureBeat_getMeasure(measure_beat) - entry->visible_measure) * entry->numerator) + (MidiFileMeasureBeat_getBeat(measure_beat) - entry->visible_beat)) * 4 / entry->denominator)));
+}
 
-		for (event = MidiFileTrack_getFirstEvent(conductor_track); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-		{
-			if (MidiFileEvent_isTimeSignatureEvent(event))
-			{
-				long next_time_signature_event_tick = MidiFileEvent_getTick(event);
-				float next_time_signature_event_beat = MidiFile_getBeatFromTick(midi_file, next_time_signature_event_tick);
-				float next_time_signature_event_measure = time_signature_event_measure + ((next_time_signature_event_beat - time_signature_event_beat) * ((float)(denominator) / numerator / 4));
-				long next_time_signature_event_visible_measure = (long)(next_time_signature_event_measure) + 1;
-				long next_time_signature_event_visible_beat = (long)((next_time_signature_event_measure - (float)(next_time_signature_event_visible_measure - 1)) * numerator) + 1;
-				float next_time_signature_event_visible_tick = next_time_signature_event_tick - MidiFile_getTickFromBeat(midi_file, (float)((long)(next_time_signature_event_beat)));
-				if ((next_time_signature_event_visible_measure > MidiFileMeasureBeatTick_getMeasure(measure_beat_tick)) || ((next_time_signature_event_visible_measure == MidiFileMeasureBeatTick_getMeasure(measure_beat_tick)) && ((next_time_signature_event_visible_beat > MidiFileMeasureBeatTick_getBeat(measure_beat_tick)) || ((next_time_signature_event_visible_measure == MidiFileMeasureBeatTick_getBeat(measure_beat_tick)) && (next_time_signature_event_visible_tick >= MidiFileMeasureBeatTick_getTick(measure_beat_tick)))))) break;
-				time_signature_event_beat = next_time_signature_event_beat;
-				time_signature_event_measure = next_time_signature_event_measure;
-				time_signature_event_visible_measure = next_time_signature_event_visible_measure;
-				time_signature_event_visible_beat = next_time_signature_event_visible_beat;
-				numerator = MidiFileTimeSignatureEvent_getNumerator(event);
-				denominator = MidiFileTimeSignatureEvent_getDenominator(event);
-			}
-		}
+int MidiFile_setMeasureBeatTickFromTick(MidiFile_t midi_file, long tick, MidiFileMeasureBeatTick_t measure_beat_tick)
+{
+	struct MidiFileMeterMapEntry *entry;
+	double measure;
+	if ((midi_file == NULL) || (measure_beat_tick == NULL)) return -1;
+	measure = get_measure_from_tick(midi_file, tick, &entry);
+	MidiFileMeasureBeatTick_setMeasure(measure_beat_tick, (long)(measure) + 1);
+	MidiFileMeasureBeatTick_setBeat(measure_beat_tick, (long)((measure - (double)(MidiFileMeasureBeatTick_getMeasure(measure_beat_tick) - 1)) * entry->numerator) + 1);
+	MidiFileMeasureBeatTick_setTick(measure_beat_tick, (float)(tick - MidiFile_getTickFromBeat(midi_file, (float)((long)(MidiFile_getBeatFromTick(midi_file, tick))))));
+	return 0;
+}
 
-		return MidiFile_getTickFromBeat(midi_file, time_signature_event_beat + (((((MidiFileMeasureBeatTick_getMeasure(measure_beat_tick) - time_signature_event_visible_measure) * numerator) + (MidiFileMeasureBeatTick_getBeat(measure_beat_tick) - time_signature_event_visible_beat))) * 4 / denominator)) + MidiFileMeasureBeatTick_getTick(measure_beat_tick);
-	}
+long MidiFile_getTickFromMeasureBeatTick(MidiFile_t midi_file, MidiFileMeasureBeatTick_t measure_beat_tick)
+{
+	struct MidiFileMeterMapEntry *entry;
+	if ((midi_file == NULL) || (measure_beat_tick == NULL)) return -1;
+	entry = get_meter_map_entry_for_visible_position(midi_file, MidiFileMeasureBeatTick_getMeasure(measure_beat_tick), meter_map_entry_precedes_measure_beat_tick, measure_beat_tick);
+	return MidiFile_getTickFromBeat(midi_file, (float)(entry->beat + ((((MidiFileMeasureBeatTick_getMeasure(measure_beat_tick) - entry->visible_measure) * entry->numerator) + (MidiFileMeasureBeatTick_getBeat(measure_beat_tick) - entry->visible_whole_beat)) * 4 / entry->denominator))) + (long)(MidiFileMeasureBeatTick_getTick(measure_beat_tick));
 }
 
 int MidiFile_setHourMinuteSecondFromTick(MidiFile_t midi_file, long tick, MidiFileHourMinuteSecond_t hour_minute_second)
@@ -2588,9 +5982,9 @@ long MidiFile_getTickFromMarker(MidiFile_t midi_file, char *marker)
 {
 	MidiFileEvent_t event;
 
-	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInFile(event))
+	for (event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x06); event != NULL; event = MidiFileEvent_getNextEventOfType(event, -1, 0x06))
 	{
-		if (MidiFileEvent_isMarkerEvent(event) && (strcmp(MidiFileMarkerEvent_getText(event), marker) == 0)) return MidiFileEvent_getTick(event);
+		if (strcmp(MidiFileMarkerEvent_getText(event), marker) == 0) return MidiFileEvent_getTick(event);
 	}
 
 	return -1;
@@ -2612,56 +6006,40 @@ long MidiFile_getTickFromTimeString(MidiFile_t midi_file, char *time_string)
 
 MidiFileEvent_t MidiFile_getFirstEventForTick(MidiFile_t midi_file, long tick)
 {
-	MidiFileEvent_t first_event_for_tick = NULL;
-	MidiFileEvent_t event;
-
-	for (event = MidiFile_getLastEvent(midi_file); (event != NULL) && (MidiFileEvent_getTick(event) >= tick); event = MidiFileEvent_getPreviousEventInFile(event))
-	{
-		if (MidiFileEvent_getTick(event) == tick) first_event_for_tick = event;
-	}
+	MidiFileTickIndexNode_t node;
 
-	return first_event_for_tick;
+	if (midi_file == NULL) return NULL;
+	node = MidiFileTickIndex_getNode(&(midi_file->tick_index), tick);
+	return (node == NULL) ? NULL : node->first_event;
 }
 
 MidiFileEvent_t MidiFile_getLastEventForTick(MidiFile_t midi_file, long tick)
 {
-	MidiFileEvent_t last_event_for_tick = NULL;
-	MidiFileEvent_t event;
+	MidiFileTickIndexNode_t node;
 
-	for (event = MidiFile_getFirstEvent(midi_file); (event != NULL) && (MidiFileEvent_getTick(event) <= tick); event = MidiFileEvent_getNextEventInFile(event))
-	{
-		if (MidiFileEvent_getTick(event) == tick) last_event_for_tick = event;
-	}
+	if (midi_file == NULL) return NULL;
+	node = MidiFileTickIndex_getNode(&(midi_file->tick_index), tick);
+	return (node == NULL) ? NULL : node->last_event;
+}
 
-	return last_event_for_tick;
+int MidiFile_getEventsInRange(MidiFile_t midi_file, long start_tick, long end_tick, MidiFileIterator_t iterator)
+{
+	if (MidiFileIterator_init(iterator, midi_file) < 0) return -1;
+	iterator->next_event = MidiFileTickIndex_getFirstEventAtOrAfter(&(midi_file->tick_index), start_tick);
+	iterator->end_tick = end_tick;
+	return 0;
 }
 
 MidiFileEvent_t MidiFile_getLatestTempoEventForTick(MidiFile_t midi_file, long tick)
 {
-	MidiFileEvent_t tempo_event = NULL;
-	MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-	MidiFileEvent_t event;
-
-	for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) <= tick); event = MidiFileEvent_getNextEventInTrack(event))
-	{
-		if (MidiFileEvent_isTempoEvent(event)) tempo_event = event;
-	}
-
-	return tempo_event;
+	if (midi_file == NULL) return NULL;
+	return get_tempo_map_entry_for_tick(midi_file, tick, 1)->event;
 }
 
 MidiFileEvent_t MidiFile_getLatestTimeSignatureEventForTick(MidiFile_t midi_file, long tick)
 {
-	MidiFileEvent_t time_signature_event = NULL;
-	MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
-	MidiFileEvent_t event;
-
-	for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) <= tick); event = MidiFileEvent_getNextEventInTrack(event))
-	{
-		if (MidiFileEvent_isTimeSignatureEvent(event)) time_signature_event = event;
-	}
-
-	return time_signature_event;
+	if (midi_file == NULL) return NULL;
+	return get_meter_map_entry(midi_file, meter_map_entry_precedes_or_is_at_tick, &tick)->event;
 }
 
 MidiFileEvent_t MidiFile_getLatestKeySignatureEventForTick(MidiFile_t midi_file, long tick)
@@ -2670,9 +6048,9 @@ MidiFileEvent_t MidiFile_getLatestKeySignatureEventForTick(MidiFile_t midi_file,
 	MidiFileTrack_t conductor_track = MidiFile_getFirstTrack(midi_file);
 	MidiFileEvent_t event;
 
-	for (event = MidiFileTrack_getFirstEvent(conductor_track); (event != NULL) && (MidiFileEvent_getTick(event) <= tick); event = MidiFileEvent_getNextEventInTrack(event))
+	for (event = MidiFile_getFirstEventOfType(midi_file, MIDI_FILE_EVENT_TYPE_META, -1, 0x59); (event != NULL) && (MidiFileEvent_getTick(event) <= tick); event = MidiFileEvent_getNextEventOfType(event, -1, 0x59))
 	{
-		if (MidiFileEvent_isKeySignatureEvent(event)) key_signature_event = event;
+		if (MidiFileEvent_getTrack(event) == conductor_track) key_signature_event = event;
 	}
 
 	return key_signature_event;
@@ -2716,7 +6094,11 @@ int MidiFileTrack_delete(MidiFileTrack_t track)
 		MidiFileEvent_delete(event);
 	}
 
-	free(track);
+	MidiFileTickIndex_clear(&(track->tick_index));
+	drop_note_pairing_index(track);
+	release_snapshot_track(track->snapshot_track);
+	invalidate_conductor_track_maps(track->midi_file);
+	MidiFileArena_deallocate(track->midi_file->arena, track, sizeof(struct MidiFileTrack));
 	return 0;
 }
 
@@ -2747,28 +6129,28 @@ int MidiFileTrack_setEndTick(MidiFileTrack_t track, long end_tick)
 
 MidiFileEvent_t MidiFileTrack_getFirstEventForTick(MidiFileTrack_t track, long tick)
 {
-	MidiFileEvent_t first_event_for_tick = NULL;
-	MidiFileEvent_t event;
+	MidiFileTickIndexNode_t node;
 
-	for (event = MidiFileTrack_getLastEvent(track); (event != NULL) && (MidiFileEvent_getTick(event) >= tick); event = MidiFileEvent_getPreviousEventInTrack(event))
-	{
-		if (MidiFileEvent_getTick(event) == tick) first_event_for_tick = event;
-	}
-
-	return first_event_for_tick;
+	if (track == NULL) return NULL;
+	node = MidiFileTickIndex_getNode(&(track->tick_index), tick);
+	return (node == NULL) ? NULL : node->first_event;
 }
 
 MidiFileEvent_t MidiFileTrack_getLastEventForTick(MidiFileTrack_t track, long tick)
 {
-	MidiFileEvent_t last_event_for_tick = NULL;
-	MidiFileEvent_t event;
+	MidiFileTickIndexNode_t node;
 
-	for (event = MidiFileTrack_getFirstEvent(track); (event != NULL) && (MidiFileEvent_getTick(event) <= tick); event = MidiFileEvent_getNextEventInTrack(event))
-	{
-		if (MidiFileEvent_getTick(event) == tick) last_event_for_tick = event;
-	}
+	if (track == NULL) return NULL;
+	node = MidiFileTickIndex_getNode(&(track->tick_index), tick);
+	return (node == NULL) ? NULL : node->last_event;
+}
 
-	return last_event_for_tick;
+int MidiFileTrack_getEventsInRange(MidiFileTrack_t track, long start_tick, long end_tick, MidiFileIterator_t iterator)
+{
+	if (MidiFileIterator_initForTrack(iterator, track) < 0) return -1;
+	iterator->next_event = MidiFileTickIndex_getFirstEventAtOrAfter(&(track->tick_index), start_tick);
+	iterator->end_tick = end_tick;
+	return 0;
 }
 
 MidiFileTrack_t MidiFileTrack_createTrackBefore(MidiFileTrack_t track)
@@ -2777,7 +6159,7 @@ MidiFileTrack_t MidiFileTrack_createTrackBefore(MidiFileTrack_t track)
 
 	if (track == NULL) return NULL;
 
-	new_track = (MidiFileTrack_t)(malloc(sizeof(struct MidiFileTrack)));
+	new_track = (MidiFileTrack_t)(MidiFileArena_allocate(track->midi_file->arena, sizeof(struct MidiFileTrack)));
 	new_track->midi_file = track->midi_file;
 	new_track->number = track->number;
 	new_track->end_tick = 0;
@@ -2801,8 +6183,13 @@ MidiFileTrack_t MidiFileTrack_createTrackBefore(MidiFileTrack_t track)
 
 	new_track->first_event = NULL;
 	new_track->last_event = NULL;
-	new_track->event_iterator_current = NULL;
-	new_track->event_iterator_next = NULL;
+	MidiFileTickIndex_init(&(new_track->tick_index), new_track->midi_file->arena);
+	new_track->event_iterator_is_running = 0;
+	new_track->last_events_with_same_note = NULL;
+	new_track->snapshot_track = NULL;
+	new_track->changed_start_tick = LONG_MAX;
+	new_track->changed_end_tick = LONG_MIN;
+	invalidate_conductor_track_maps(new_track->midi_file);
 
 	return new_track;
 }
@@ -2825,14 +6212,14 @@ MidiFileEvent_t MidiFileTrack_createNoteOffEvent(MidiFileTrack_t track, long tic
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_NOTE_OFF;
 	new_event->u.note_off.channel = channel;
 	new_event->u.note_off.note = note;
 	new_event->u.note_off.velocity = velocity;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -2845,14 +6232,14 @@ MidiFileEvent_t MidiFileTrack_createNoteOnEvent(MidiFileTrack_t track, long tick
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_NOTE_ON;
 	new_event->u.note_on.channel = channel;
 	new_event->u.note_on.note = note;
 	new_event->u.note_on.velocity = velocity;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -2865,14 +6252,14 @@ MidiFileEvent_t MidiFileTrack_createKeyPressureEvent(MidiFileTrack_t track, long
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_KEY_PRESSURE;
 	new_event->u.key_pressure.channel = channel;
 	new_event->u.key_pressure.note = note;
 	new_event->u.key_pressure.amount = amount;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -2885,14 +6272,14 @@ MidiFileEvent_t MidiFileTrack_createControlChangeEvent(MidiFileTrack_t track, lo
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE;
 	new_event->u.control_change.channel = channel;
 	new_event->u.control_change.number = number;
 	new_event->u.control_change.value = value;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -2905,13 +6292,13 @@ MidiFileEvent_t MidiFileTrack_createProgramChangeEvent(MidiFileTrack_t track, lo
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE;
 	new_event->u.program_change.channel = channel;
 	new_event->u.program_change.number = number;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -2924,13 +6311,13 @@ MidiFileEvent_t MidiFileTrack_createChannelPressureEvent(MidiFileTrack_t track,
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE;
 	new_event->u.channel_pressure.channel = channel;
 	new_event->u.channel_pressure.amount = amount;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -2943,13 +6330,13 @@ MidiFileEvent_t MidiFileTrack_createPitchWheelEvent(MidiFileTrack_t track, long
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_PITCH_WHEEL;
 	new_event->u.pitch_wheel.channel = channel;
 	new_event->u.pitch_wheel.value = value;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -2962,15 +6349,8 @@ MidiFileEvent_t MidiFileTrack_createSysexEvent(MidiFileTrack_t track, long tick,
 
 	if ((track == NULL) || (data_length < 1) || (data_buffer == NULL)) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
-	new_event->track = track;
-	new_event->tick = tick;
-	new_event->type = MIDI_FILE_EVENT_TYPE_SYSEX;
-	new_event->u.sysex.data_length = data_length;
-	new_event->u.sysex.data_buffer = malloc(data_length);
+	new_event = new_sysex_event(track, tick, data_length);
 	memcpy(new_event->u.sysex.data_buffer, data_buffer, data_length);
-	new_event->should_be_visited = 0;
-	new_event->is_selected = 0;
 	add_event(new_event);
 
 	return new_event;
@@ -2982,17 +6362,8 @@ MidiFileEvent_t MidiFileTrack_createMetaEvent(MidiFileTrack_t track, long tick,
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
-	new_event->track = track;
-	new_event->tick = tick;
-	new_event->type = MIDI_FILE_EVENT_TYPE_META;
-	new_event->u.meta.number = number;
-	new_event->u.meta.data_length = data_length;
-	new_event->u.meta.data_buffer = malloc(data_length + 1);
+	new_event = new_meta_event(track, tick, number, data_length);
 	memcpy(new_event->u.meta.data_buffer, data_buffer, data_length);
-	new_event->u.meta.data_buffer[data_length] = '\0';
-	new_event->should_be_visited = 0;
-	new_event->is_selected = 0;
 	add_event(new_event);
 
 	return new_event;
@@ -3004,7 +6375,7 @@ MidiFileEvent_t MidiFileTrack_createNoteEvent(MidiFileTrack_t track, long tick,
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_NOTE;
@@ -3013,7 +6384,7 @@ MidiFileEvent_t MidiFileTrack_createNoteEvent(MidiFileTrack_t track, long tick,
 	new_event->u.note.note = note;
 	new_event->u.note.velocity = velocity;
 	new_event->u.note.end_velocity = end_velocity;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -3026,14 +6397,14 @@ MidiFileEvent_t MidiFileTrack_createFineControlChangeEvent(MidiFileTrack_t track
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE;
 	new_event->u.fine_control_change.channel = channel;
 	new_event->u.fine_control_change.coarse_number = coarse_number;
 	new_event->u.fine_control_change.value = value;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -3046,14 +6417,14 @@ MidiFileEvent_t MidiFileTrack_createRpnEvent(MidiFileTrack_t track, long tick, i
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_RPN;
 	new_event->u.rpn.channel = channel;
 	new_event->u.rpn.number = number;
 	new_event->u.rpn.value = value;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -3066,14 +6437,14 @@ MidiFileEvent_t MidiFileTrack_createNrpnEvent(MidiFileTrack_t track, long tick,
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
 	new_event->type = MIDI_FILE_EVENT_TYPE_NRPN;
 	new_event->u.nrpn.channel = channel;
 	new_event->u.nrpn.number = number;
 	new_event->u.nrpn.value = value;
-	new_event->should_be_visited = 0;
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -3189,17 +6560,93 @@ MidiFileEvent_t MidiFileTrack_createKeySignatureEvent(MidiFileTrack_t track, lon
 	return MidiFileTrack_createMetaEvent(track, tick, 0x59, 2, u.unsigned_buffer);
 }
 
+static int set_voice_event_data(MidiFileEvent_t event, unsigned long data)
+{
+	union
+	{
+		unsigned long data_as_uint32;
+		unsigned char data_as_bytes[4];
+	}
+	u;
+
+	u.data_as_uint32 = data;
+	drop_note_pairing_index_for_event(event);
+
+	switch (u.data_as_bytes[0] & 0xF0)
+	{
+		case 0x80:
+		{
+			if (event->track != NULL) drop_note_pairing_index(event->track);
+			event->type = MIDI_FILE_EVENT_TYPE_NOTE_OFF;
+			event->u.note_off.channel = u.data_as_bytes[0] & 0x0F;
+			event->u.note_off.note = u.data_as_bytes[1];
+			event->u.note_off.velocity = u.data_as_bytes[2];
+			return 0;
+		}
+		case 0x90:
+		{
+			if (event->track != NULL) drop_note_pairing_index(event->track);
+			event->type = MIDI_FILE_EVENT_TYPE_NOTE_ON;
+			event->u.note_on.channel = u.data_as_bytes[0] & 0x0F;
+			event->u.note_on.note = u.data_as_bytes[1];
+			event->u.note_on.velocity = u.data_as_bytes[2];
+			return 0;
+		}
+		case 0xA0:
+		{
+			event->type = MIDI_FILE_EVENT_TYPE_KEY_PRESSURE;
+			event->u.key_pressure.channel = u.data_as_bytes[0] & 0x0F;
+			event->u.key_pressure.note = u.data_as_bytes[1];
+			event->u.key_pressure.amount = u.data_as_bytes[2];
+			return 0;
+		}
+		case 0xB0:
+		{
+			event->type = MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE;
+			event->u.control_change.channel = u.data_as_bytes[0] & 0x0F;
+			event->u.control_change.number = u.data_as_bytes[1];
+			event->u.control_change.value = u.data_as_bytes[2];
+			return 0;
+		}
+		case 0xC0:
+		{
+			event->type = MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE;
+			event->u.program_change.channel = u.data_as_bytes[0] & 0x0F;
+			event->u.program_change.number = u.data_as_bytes[1];
+			return 0;
+		}
+		case 0xD0:
+		{
+			event->type = MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE;
+			event->u.channel_pressure.channel = u.data_as_bytes[0] & 0x0F;
+			event->u.channel_pressure.amount = u.data_as_bytes[1];
+			return 0;
+		}
+		case 0xE0:
+		{
+			event->type = MIDI_FILE_EVENT_TYPE_PITCH_WHEEL;
+			event->u.pitch_wheel.channel = u.data_as_bytes[0] & 0x0F;
+			event->u.pitch_wheel.value = (u.data_as_bytes[2] << 7) | u.data_as_bytes[1];
+			return 0;
+		}
+		default:
+		{
+			return -1;
+		}
+	}
+}
+
 MidiFileEvent_t MidiFileTrack_createVoiceEvent(MidiFileTrack_t track, long tick, unsigned long data)
 {
 	MidiFileEvent_t new_event;
 
 	if (track == NULL) return NULL;
 
-	new_event = (MidiFileEvent_t)(malloc(sizeof(struct MidiFileEvent)));
+	new_event = MidiFileArena_allocateEvent(track->midi_file->arena);
 	new_event->track = track;
 	new_event->tick = tick;
-	MidiFileVoiceEvent_setData(new_event, data);
-	new_event->should_be_visited = 0;
+	set_voice_event_data(new_event, data);
+	new_event->visited_epoch = track->midi_file->iteration_epoch;
 	new_event->is_selected = 0;
 	add_event(new_event);
 
@@ -3301,43 +6748,30 @@ MidiFileEvent_t MidiFileTrack_getLastEvent(MidiFileTrack_t track)
 
 MidiFileEvent_t MidiFileTrack_iterateEvents(MidiFileTrack_t track)
 {
-	if (track == NULL) return NULL;
-
-	if (track->event_iterator_current == NULL)
-	{
-		for (track->event_iterator_current = MidiFileTrack_getFirstEvent(track); track->event_iterator_current != NULL; track->event_iterator_current = MidiFileEvent_getNextEventInTrack(track->event_iterator_current)) track->event_iterator_current->should_be_visited = 1;
-		track->event_iterator_current = MidiFileTrack_getFirstEvent(track);
-	}
-	else
-	{
-		track->event_iterator_current = track->event_iterator_next;
-	}
+	MidiFileEvent_t event;
 
-	while ((track->event_iterator_current != NULL) && !(track->event_iterator_current->should_be_visited))
-	{
-		track->event_iterator_current = MidiFileEvent_getNextEventInTrack(track->event_iterator_current);
-	}
+	if (track == NULL) return NULL;
 
-	if (track->event_iterator_current == NULL)
-	{
-		track->event_iterator_next = NULL;
-	}
-	else
+	if (!(track->event_iterator_is_running))
 	{
-		track->event_iterator_current->should_be_visited = 0;
-		track->event_iterator_next = MidiFileEvent_getNextEventInTrack(track->event_iterator_current);
+		MidiFileIterator_initForTrack(&(track->event_iterator), track);
+		track->event_iterator_is_running = 1;
 	}
 
-	return track->event_iterator_current;
+	if ((event = MidiFileIterator_next(&(track->event_iterator))) == NULL) track->event_iterator_is_running = 0;
+	return event;
 }
 
 int MidiFileTrack_visitEvents(MidiFileTrack_t track, MidiFileEventVisitorCallback_t visitor_callback, void *user_data)
 {
+	struct MidiFileIterator iterator;
 	MidiFileEvent_t event;
 
 	if ((track == NULL) || (visitor_callback == NULL)) return -1;
 
-	for (event = MidiFileTrack_iterateEvents(track); event != NULL; event = MidiFileTrack_iterateEvents(track))
+	MidiFileIterator_initForTrack(&iterator, track);
+
+	for (event = MidiFileIterator_next(&iterator); event != NULL; event = MidiFileIterator_next(&iterator))
 	{
 		(*visitor_callback)(event, user_data);
 	}
@@ -3349,26 +6783,7 @@ int MidiFileEvent_delete(MidiFileEvent_t event)
 {
 	if (event == NULL) return -1;
 	if (event->track != NULL) remove_event(event);
-
-	switch (event->type)
-	{
-		case MIDI_FILE_EVENT_TYPE_SYSEX:
-		{
-			free(event->u.sysex.data_buffer);
-			break;
-		}
-		case MIDI_FILE_EVENT_TYPE_META:
-		{
-			free(event->u.meta.data_buffer);
-			break;
-		}
-		default:
-		{
-			break;
-		}
-	}
-
-	free(event);
+	free_event(event);
 	return 0;
 }
 
@@ -3401,6 +6816,7 @@ int MidiFileEvent_setTrack(MidiFileEvent_t event, MidiFileTrack_t track)
 
 	if (event->track != track)
 	{
+		if ((event->track == NULL) || (event->track->midi_file != track->midi_file)) event->visited_epoch = track->midi_file->iteration_epoch;
 		if (event->track != NULL) remove_event(event);
 		event->track = track;
 		add_event(event);
@@ -3473,6 +6889,24 @@ MidiFileEvent_t MidiFileEvent_getNextEventInFile(MidiFileEvent_t event)
 	return event->next_event_in_file;
 }
 
+MidiFileEvent_t MidiFileEvent_getNextEventOfType(MidiFileEvent_t event, int channel, int number)
+{
+	struct MidiFileTypeIndexList *list;
+	int is_subtype;
+
+	if ((event == NULL) || (event->track == NULL)) return NULL;
+	list = get_type_index_list_for_query(event->track->midi_file, (MidiFileEventType_t)(event->type), channel, number, &is_subtype);
+
+	if (list != get_type_index_list_for_event(event->track->midi_file->type_index, event, is_subtype))
+	{
+		/* the event has a different channel or meta event number than the one asked for, so it's only in the list for its type */
+		list = get_type_index_list_for_query(event->track->midi_file, (MidiFileEventType_t)(event->type), -1, -1, &is_subtype);
+	}
+
+	for (event = get_type_index_links(event, is_subtype)->next_event; (event != NULL) && !event_matches_type_query(event, channel, number); event = get_type_index_links(event, is_subtype)->next_event) {}
+	return event;
+}
+
 long MidiFileEvent_getTick(MidiFileEvent_t event)
 {
 	if (event == NULL) return -1;
@@ -3491,7 +6925,7 @@ int MidiFileEvent_setTick(MidiFileEvent_t event, long tick)
 MidiFileEventType_t MidiFileEvent_getType(MidiFileEvent_t event)
 {
 	if (event == NULL) return MIDI_FILE_EVENT_TYPE_INVALID;
-	return event->type;
+	return (MidiFileEventType_t)(event->type);
 }
 
 int MidiFileEvent_isSelected(MidiFileEvent_t event)
@@ -3503,7 +6937,7 @@ int MidiFileEvent_isSelected(MidiFileEvent_t event)
 int MidiFileEvent_setSelected(MidiFileEvent_t event, int is_selected)
 {
 	if (event == NULL) return -1;
-	event->is_selected = is_selected;
+	event->is_selected = (is_selected != 0);
 	return 0;
 }
 
@@ -3587,7 +7021,11 @@ int MidiFileNoteOffEvent_getChannel(MidiFileEvent_t event)
 int MidiFileNoteOffEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE_OFF)) return -1;
+	mark_event_changed(event);
+	if (event->u.note_off.channel != (channel & 0xFF)) drop_note_pairing_index_for_event(event);
+	remove_event_from_type_index(event);
 	event->u.note_off.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3600,6 +7038,8 @@ int MidiFileNoteOffEvent_getNote(MidiFileEvent_t event)
 int MidiFileNoteOffEvent_setNote(MidiFileEvent_t event, int note)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE_OFF)) return -1;
+	mark_event_changed(event);
+	if (event->u.note_off.note != (note & 0xFF)) drop_note_pairing_index_for_event(event);
 	event->u.note_off.note = note;
 	return 0;
 }
@@ -3613,6 +7053,7 @@ int MidiFileNoteOffEvent_getVelocity(MidiFileEvent_t event)
 int MidiFileNoteOffEvent_setVelocity(MidiFileEvent_t event, int velocity)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE_OFF)) return -1;
+	mark_event_changed(event);
 	event->u.note_off.velocity = velocity;
 	return 0;
 }
@@ -3626,7 +7067,11 @@ int MidiFileNoteOnEvent_getChannel(MidiFileEvent_t event)
 int MidiFileNoteOnEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE_ON)) return -1;
+	mark_event_changed(event);
+	if (event->u.note_on.channel != (channel & 0xFF)) drop_note_pairing_index_for_event(event);
+	remove_event_from_type_index(event);
 	event->u.note_on.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3639,6 +7084,8 @@ int MidiFileNoteOnEvent_getNote(MidiFileEvent_t event)
 int MidiFileNoteOnEvent_setNote(MidiFileEvent_t event, int note)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE_ON)) return -1;
+	mark_event_changed(event);
+	if (event->u.note_on.note != (note & 0xFF)) drop_note_pairing_index_for_event(event);
 	event->u.note_on.note = note;
 	return 0;
 }
@@ -3652,6 +7099,8 @@ int MidiFileNoteOnEvent_getVelocity(MidiFileEvent_t event)
 int MidiFileNoteOnEvent_setVelocity(MidiFileEvent_t event, int velocity)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE_ON)) return -1;
+	mark_event_changed(event);
+	if ((event->u.note_on.velocity == 0) != ((velocity & 0xFF) == 0)) drop_note_pairing_index_for_event(event);
 	event->u.note_on.velocity = velocity;
 	return 0;
 }
@@ -3665,7 +7114,10 @@ int MidiFileKeyPressureEvent_getChannel(MidiFileEvent_t event)
 int MidiFileKeyPressureEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_KEY_PRESSURE)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.key_pressure.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3678,6 +7130,7 @@ int MidiFileKeyPressureEvent_getNote(MidiFileEvent_t event)
 int MidiFileKeyPressureEvent_setNote(MidiFileEvent_t event, int note)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_KEY_PRESSURE)) return -1;
+	mark_event_changed(event);
 	event->u.key_pressure.note = note;
 	return 0;
 }
@@ -3691,6 +7144,7 @@ int MidiFileKeyPressureEvent_getAmount(MidiFileEvent_t event)
 int MidiFileKeyPressureEvent_setAmount(MidiFileEvent_t event, int amount)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_KEY_PRESSURE)) return -1;
+	mark_event_changed(event);
 	event->u.key_pressure.amount = amount;
 	return 0;
 }
@@ -3704,7 +7158,10 @@ int MidiFileControlChangeEvent_getChannel(MidiFileEvent_t event)
 int MidiFileControlChangeEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.control_change.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3717,6 +7174,7 @@ int MidiFileControlChangeEvent_getNumber(MidiFileEvent_t event)
 int MidiFileControlChangeEvent_setNumber(MidiFileEvent_t event, int number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
 	event->u.control_change.number = number;
 	return 0;
 }
@@ -3730,6 +7188,7 @@ int MidiFileControlChangeEvent_getValue(MidiFileEvent_t event)
 int MidiFileControlChangeEvent_setValue(MidiFileEvent_t event, int value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
 	event->u.control_change.value = value;
 	return 0;
 }
@@ -3743,7 +7202,10 @@ int MidiFileProgramChangeEvent_getChannel(MidiFileEvent_t event)
 int MidiFileProgramChangeEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.program_change.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3756,6 +7218,7 @@ int MidiFileProgramChangeEvent_getNumber(MidiFileEvent_t event)
 int MidiFileProgramChangeEvent_setNumber(MidiFileEvent_t event, int number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE)) return -1;
+	mark_event_changed(event);
 	event->u.program_change.number = number;
 	return 0;
 }
@@ -3769,7 +7232,10 @@ int MidiFileChannelPressureEvent_getChannel(MidiFileEvent_t event)
 int MidiFileChannelPressureEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.channel_pressure.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3782,6 +7248,7 @@ int MidiFileChannelPressureEvent_getAmount(MidiFileEvent_t event)
 int MidiFileChannelPressureEvent_setAmount(MidiFileEvent_t event, int amount)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE)) return -1;
+	mark_event_changed(event);
 	event->u.channel_pressure.amount = amount;
 	return 0;
 }
@@ -3795,7 +7262,10 @@ int MidiFilePitchWheelEvent_getChannel(MidiFileEvent_t event)
 int MidiFilePitchWheelEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_PITCH_WHEEL)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.pitch_wheel.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3808,6 +7278,7 @@ int MidiFilePitchWheelEvent_getValue(MidiFileEvent_t event)
 int MidiFilePitchWheelEvent_setValue(MidiFileEvent_t event, int value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_PITCH_WHEEL)) return -1;
+	mark_event_changed(event);
 	event->u.pitch_wheel.value = value;
 	return 0;
 }
@@ -3827,9 +7298,10 @@ unsigned char *MidiFileSysexEvent_getData(MidiFileEvent_t event)
 int MidiFileSysexEvent_setData(MidiFileEvent_t event, int data_length, unsigned char *data_buffer)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_SYSEX) || (data_length < 1) || (data_buffer == NULL)) return -1;
-	free(event->u.sysex.data_buffer);
+	mark_event_changed(event);
+	MidiFileArena_deallocate(event->arena, event->u.sysex.data_buffer, event->u.sysex.data_length);
 	event->u.sysex.data_length = data_length;
-	event->u.sysex.data_buffer = malloc(data_length);
+	event->u.sysex.data_buffer = (unsigned char *)(MidiFileArena_allocate(event->arena, data_length));
 	memcpy(event->u.sysex.data_buffer, data_buffer, data_length);
 	return 0;
 }
@@ -3843,7 +7315,11 @@ int MidiFileMetaEvent_getNumber(MidiFileEvent_t event)
 int MidiFileMetaEvent_setNumber(MidiFileEvent_t event, int number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_META)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.meta.number = number;
+	add_event_to_type_index(event);
+	invalidate_conductor_track_maps_for_event(event);
 	return 0;
 }
 
@@ -3862,11 +7338,13 @@ unsigned char *MidiFileMetaEvent_getData(MidiFileEvent_t event)
 int MidiFileMetaEvent_setData(MidiFileEvent_t event, int data_length, unsigned char *data_buffer)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_META) || (data_buffer == NULL)) return -1;
-	free(event->u.meta.data_buffer);
+	mark_event_changed(event);
+	MidiFileArena_deallocate(event->arena, event->u.meta.data_buffer, event->u.meta.data_length + 1);
 	event->u.meta.data_length = data_length;
-	event->u.meta.data_buffer = malloc(data_length + 1);
+	event->u.meta.data_buffer = (unsigned char *)(MidiFileArena_allocate(event->arena, data_length + 1));
 	memcpy(event->u.meta.data_buffer, data_buffer, data_length);
 	event->u.meta.data_buffer[data_length] = '\0';
+	invalidate_conductor_track_maps_for_event(event);
 	return 0;
 }
 
@@ -3879,6 +7357,7 @@ long MidiFileNoteEvent_getDurationTicks(MidiFileEvent_t event)
 int MidiFileNoteEvent_setDurationTicks(MidiFileEvent_t event, long duration_ticks)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE)) return -1;
+	mark_event_changed(event);
 	event->u.note.duration_ticks = duration_ticks;
 	return 0;
 }
@@ -3892,7 +7371,10 @@ int MidiFileNoteEvent_getChannel(MidiFileEvent_t event)
 int MidiFileNoteEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.note.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3905,6 +7387,7 @@ int MidiFileNoteEvent_getNote(MidiFileEvent_t event)
 int MidiFileNoteEvent_setNote(MidiFileEvent_t event, int note)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE)) return -1;
+	mark_event_changed(event);
 	event->u.note.note = note;
 	return 0;
 }
@@ -3918,6 +7401,7 @@ int MidiFileNoteEvent_getVelocity(MidiFileEvent_t event)
 int MidiFileNoteEvent_setVelocity(MidiFileEvent_t event, int velocity)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE)) return -1;
+	mark_event_changed(event);
 	event->u.note.velocity = velocity;
 	return 0;
 }
@@ -3931,6 +7415,7 @@ int MidiFileNoteEvent_getEndVelocity(MidiFileEvent_t event)
 int MidiFileNoteEvent_setEndVelocity(MidiFileEvent_t event, int end_velocity)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NOTE)) return -1;
+	mark_event_changed(event);
 	event->u.note.end_velocity = end_velocity;
 	return 0;
 }
@@ -3944,7 +7429,10 @@ int MidiFileFineControlChangeEvent_getChannel(MidiFileEvent_t event)
 int MidiFileFineControlChangeEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.fine_control_change.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -3957,6 +7445,7 @@ int MidiFileFineControlChangeEvent_getCoarseNumber(MidiFileEvent_t event)
 int MidiFileFineControlChangeEvent_setCoarseNumber(MidiFileEvent_t event, int coarse_number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
 	event->u.fine_control_change.coarse_number = coarse_number;
 	return 0;
 }
@@ -3970,6 +7459,7 @@ int MidiFileFineControlChangeEvent_getFineNumber(MidiFileEvent_t event)
 int MidiFileFineControlChangeEvent_setFineNumber(MidiFileEvent_t event, int fine_number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
 	event->u.fine_control_change.coarse_number = fine_number - 32;
 	return 0;
 }
@@ -3983,6 +7473,7 @@ int MidiFileFineControlChangeEvent_getValue(MidiFileEvent_t event)
 int MidiFileFineControlChangeEvent_setValue(MidiFileEvent_t event, int value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
 	event->u.fine_control_change.value = value;
 	return 0;
 }
@@ -3996,6 +7487,7 @@ int MidiFileFineControlChangeEvent_getCoarseValue(MidiFileEvent_t event)
 int MidiFileFineControlChangeEvent_setCoarseValue(MidiFileEvent_t event, int coarse_value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
 	event->u.fine_control_change.value = (coarse_value << 7) | (event->u.fine_control_change.value & 0x7F);
 	return 0;
 }
@@ -4009,6 +7501,7 @@ int MidiFileFineControlChangeEvent_getFineValue(MidiFileEvent_t event)
 int MidiFileFineControlChangeEvent_setFineValue(MidiFileEvent_t event, int fine_value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_FINE_CONTROL_CHANGE)) return -1;
+	mark_event_changed(event);
 	event->u.fine_control_change.value = (event->u.fine_control_change.value & ~0x7F) | (fine_value & 0x7F);
 	return 0;
 }
@@ -4022,7 +7515,10 @@ int MidiFileRpnEvent_getChannel(MidiFileEvent_t event)
 int MidiFileRpnEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_RPN)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.rpn.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -4035,6 +7531,7 @@ int MidiFileRpnEvent_getNumber(MidiFileEvent_t event)
 int MidiFileRpnEvent_setNumber(MidiFileEvent_t event, int number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_RPN)) return -1;
+	mark_event_changed(event);
 	event->u.rpn.number = number;
 	return 0;
 }
@@ -4048,6 +7545,7 @@ int MidiFileRpnEvent_getCoarseNumber(MidiFileEvent_t event)
 int MidiFileRpnEvent_setCoarseNumber(MidiFileEvent_t event, int coarse_number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_RPN)) return -1;
+	mark_event_changed(event);
 	event->u.rpn.number = (coarse_number << 7) | (event->u.rpn.number & 0x7F);
 	return 0;
 }
@@ -4061,6 +7559,7 @@ int MidiFileRpnEvent_getFineNumber(MidiFileEvent_t event)
 int MidiFileRpnEvent_setFineNumber(MidiFileEvent_t event, int fine_number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_RPN)) return -1;
+	mark_event_changed(event);
 	event->u.rpn.number = (event->u.rpn.number & ~0x7F) | (fine_number & 0x7F);
 	return 0;
 }
@@ -4074,6 +7573,7 @@ int MidiFileRpnEvent_getValue(MidiFileEvent_t event)
 int MidiFileRpnEvent_setValue(MidiFileEvent_t event, int value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_RPN)) return -1;
+	mark_event_changed(event);
 	event->u.rpn.value = value;
 	return 0;
 }
@@ -4087,6 +7587,7 @@ int MidiFileRpnEvent_getCoarseValue(MidiFileEvent_t event)
 int MidiFileRpnEvent_setCoarseValue(MidiFileEvent_t event, int coarse_value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_RPN)) return -1;
+	mark_event_changed(event);
 	event->u.rpn.value = (coarse_value << 7) | (event->u.rpn.value & 0x7F);
 	return 0;
 }
@@ -4100,6 +7601,7 @@ int MidiFileRpnEvent_getFineValue(MidiFileEvent_t event)
 int MidiFileRpnEvent_setFineValue(MidiFileEvent_t event, int fine_value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_RPN)) return -1;
+	mark_event_changed(event);
 	event->u.rpn.value = (event->u.rpn.value & ~0x7F) | (fine_value & 0x7F);
 	return 0;
 }
@@ -4113,7 +7615,10 @@ int MidiFileNrpnEvent_getChannel(MidiFileEvent_t event)
 int MidiFileNrpnEvent_setChannel(MidiFileEvent_t event, int channel)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NRPN)) return -1;
+	mark_event_changed(event);
+	remove_event_from_type_index(event);
 	event->u.nrpn.channel = channel;
+	add_event_to_type_index(event);
 	return 0;
 }
 
@@ -4126,6 +7631,7 @@ int MidiFileNrpnEvent_getNumber(MidiFileEvent_t event)
 int MidiFileNrpnEvent_setNumber(MidiFileEvent_t event, int number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NRPN)) return -1;
+	mark_event_changed(event);
 	event->u.nrpn.number = number;
 	return 0;
 }
@@ -4139,6 +7645,7 @@ int MidiFileNrpnEvent_getCoarseNumber(MidiFileEvent_t event)
 int MidiFileNrpnEvent_setCoarseNumber(MidiFileEvent_t event, int coarse_number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NRPN)) return -1;
+	mark_event_changed(event);
 	event->u.nrpn.number = (coarse_number << 7) | (event->u.nrpn.number & 0x7F);
 	return 0;
 }
@@ -4152,6 +7659,7 @@ int MidiFileNrpnEvent_getFineNumber(MidiFileEvent_t event)
 int MidiFileNrpnEvent_setFineNumber(MidiFileEvent_t event, int fine_number)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NRPN)) return -1;
+	mark_event_changed(event);
 	event->u.nrpn.number = (event->u.nrpn.number & ~0x7F) | (fine_number & 0x7F);
 	return 0;
 }
@@ -4165,6 +7673,7 @@ int MidiFileNrpnEvent_getValue(MidiFileEvent_t event)
 int MidiFileNrpnEvent_setValue(MidiFileEvent_t event, int value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NRPN)) return -1;
+	mark_event_changed(event);
 	event->u.nrpn.value = value;
 	return 0;
 }
@@ -4178,6 +7687,7 @@ int MidiFileNrpnEvent_getCoarseValue(MidiFileEvent_t event)
 int MidiFileNrpnEvent_setCoarseValue(MidiFileEvent_t event, int coarse_value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NRPN)) return -1;
+	mark_event_changed(event);
 	event->u.nrpn.value = (coarse_value << 7) | (event->u.nrpn.value & 0x7F);
 	return 0;
 }
@@ -4191,6 +7701,7 @@ int MidiFileNrpnEvent_getFineValue(MidiFileEvent_t event)
 int MidiFileNrpnEvent_setFineValue(MidiFileEvent_t event, int fine_value)
 {
 	if ((event == NULL) || (event->type != MIDI_FILE_EVENT_TYPE_NRPN)) return -1;
+	mark_event_changed(event);
 	event->u.nrpn.value = (event->u.nrpn.value & ~0x7F) | (fine_value & 0x7F);
 	return 0;
 }
@@ -4281,9 +7792,10 @@ MidiFileEvent_t MidiFileNoteStartEvent_getNoteEndEvent(MidiFileEvent_t event)
 {
 	MidiFileEvent_t subsequent_event;
 
-	if (! MidiFileEvent_isNoteStartEvent(event)) return NULL;
+	if ((! MidiFileEvent_isNoteStartEvent(event)) || (event->track == NULL)) return NULL;
+	if (event->track->last_events_with_same_note == NULL) build_note_pairing_index(event->track);
 
-	for (subsequent_event = MidiFileEvent_getNextEventInTrack(event); subsequent_event != NULL; subsequent_event = MidiFileEvent_getNextEventInTrack(subsequent_event))
+	for (subsequent_event = get_note_pairing_links(event)->next_event_with_same_note; subsequent_event != NULL; subsequent_event = get_note_pairing_links(subsequent_event)->next_event_with_same_note)
 	{
 		if (MidiFileEvent_isNoteEndEvent(subsequent_event) && (MidiFileNoteEndEvent_getChannel(subsequent_event) == MidiFileNoteStartEvent_getChannel(event)) && (MidiFileNoteEndEvent_getNote(subsequent_event) == MidiFileNoteStartEvent_getNote(event)))
 		{
@@ -4428,9 +7940,10 @@ MidiFileEvent_t MidiFileNoteEndEvent_getNoteStartEvent(MidiFileEvent_t event)
 {
 	MidiFileEvent_t preceding_event;
 
-	if (! MidiFileEvent_isNoteEndEvent(event)) return NULL;
+	if ((! MidiFileEvent_isNoteEndEvent(event)) || (event->track == NULL)) return NULL;
+	if (event->track->last_events_with_same_note == NULL) build_note_pairing_index(event->track);
 
-	for (preceding_event = MidiFileEvent_getPreviousEventInTrack(event); preceding_event != NULL; preceding_event = MidiFileEvent_getPreviousEventInTrack(preceding_event))
+	for (preceding_event = get_note_pairing_links(event)->previous_event_with_same_note; preceding_event != NULL; preceding_event = get_note_pairing_links(preceding_event)->previous_event_with_same_note)
 	{
 		if (MidiFileEvent_isNoteStartEvent(preceding_event) && (MidiFileNoteStartEvent_getChannel(preceding_event) == MidiFileNoteEndEvent_getChannel(event)) && (MidiFileNoteStartEvent_getNote(preceding_event) == MidiFileNoteEndEvent_getNote(event)))
 		{
@@ -4966,77 +8479,15 @@ unsigned long MidiFileVoiceEvent_getData(MidiFileEvent_t event)
 
 int MidiFileVoiceEvent_setData(MidiFileEvent_t event, unsigned long data)
 {
-	union
-	{
-		unsigned long data_as_uint32;
-		unsigned char data_as_bytes[4];
-	}
-	u;
+	int result;
 
 	if (event == NULL) return -1;
-
-	u.data_as_uint32 = data;
-
-	switch (u.data_as_bytes[0] & 0xF0)
-	{
-		case 0x80:
-		{
-			event->type = MIDI_FILE_EVENT_TYPE_NOTE_OFF;
-			event->u.note_off.channel = u.data_as_bytes[0] & 0x0F;
-			event->u.note_off.note = u.data_as_bytes[1];
-			event->u.note_off.velocity = u.data_as_bytes[2];
-			return 0;
-		}
-		case 0x90:
-		{
-			event->type = MIDI_FILE_EVENT_TYPE_NOTE_ON;
-			event->u.note_on.channel = u.data_as_bytes[0] & 0x0F;
-			event->u.note_on.note = u.data_as_bytes[1];
-			event->u.note_on.velocity = u.data_as_bytes[2];
-			return 0;
-		}
-		case 0xA0:
-		{
-			event->type = MIDI_FILE_EVENT_TYPE_KEY_PRESSURE;
-			event->u.key_pressure.channel = u.data_as_bytes[0] & 0x0F;
-			event->u.key_pressure.note = u.data_as_bytes[1];
-			event->u.key_pressure.amount = u.data_as_bytes[2];
-			return 0;
-		}
-		case 0xB0:
-		{
-			event->type = MIDI_FILE_EVENT_TYPE_CONTROL_CHANGE;
-			event->u.control_change.channel = u.data_as_bytes[0] & 0x0F;
-			event->u.control_change.number = u.data_as_bytes[1];
-			event->u.control_change.value = u.data_as_bytes[2];
-			return 0;
-		}
-		case 0xC0:
-		{
-			event->type = MIDI_FILE_EVENT_TYPE_PROGRAM_CHANGE;
-			event->u.program_change.channel = u.data_as_bytes[0] & 0x0F;
-			event->u.program_change.number = u.data_as_bytes[1];
-			return 0;
-		}
-		case 0xD0:
-		{
-			event->type = MIDI_FILE_EVENT_TYPE_CHANNEL_PRESSURE;
-			event->u.channel_pressure.channel = u.data_as_bytes[0] & 0x0F;
-			event->u.channel_pressure.amount = u.data_as_bytes[1];
-			return 0;
-		}
-		case 0xE0:
-		{
-			event->type = MIDI_FILE_EVENT_TYPE_PITCH_WHEEL;
-			event->u.pitch_wheel.channel = u.data_as_bytes[0] & 0x0F;
-			event->u.pitch_wheel.value = (u.data_as_bytes[2] << 7) | u.data_as_bytes[1];
-			return 0;
-		}
-		default:
-		{
-			return -1;
-		}
-	}
+	mark_event_changed(event);
+	invalidate_conductor_track_maps_for_event(event); /* while it is still the meta event it may be replacing */
+	remove_event_from_type_index(event);
+	result = set_voice_event_data(event, data);
+	add_event_to_type_index(event);
+	return result;
 }
 
 MidiFileMeasureBeat_t MidiFileMeasureBeat_new(void)
@@ -35,7 +35,13 @@
  * 7.  MidiFile_iterateEvents() and MidiFileTrack_iterateEvents() are specially
  *     designed so that you can add, delete, or change the tick of the current
  *     event (thereby modifying the sorting order) without upsetting the
- *     iterator.  Keep calling them until they return null.
+ *     iterator.  Keep calling them until they return null.  Events added
+ *     along the way are not visited.  A struct MidiFileIterator does the
+ *     same from the caller's stack, and starting one costs nothing, however
+ *     long the file.  Only one iteration over a file can be in progress at
+ *     a time, counting the visitor functions and the ones for single tracks;
+ *     starting another ends the earlier one, which must not be advanced
+ *     again.
  *
  * 8.  Because a note on event with a velocity of zero is functionally
  *     equivalent to a note off event, you cannot simply look at the type of
@@ -67,6 +73,77 @@
  *
  * 14. Events can be marked as "selected" but this is only meaningful in
  *     memory; it is not persisted to disk.
+ *
+ * 15. MidiFile_loadMapped() maps the file into memory rather than reading
+ *     it, and leaves sysex and meta data in place there instead of copying
+ *     it.  This suits large, sysex-heavy files which are mostly read.  The
+ *     file on disk is never changed; setting new data simply stops using the
+ *     mapped copy.
+ *
+ * 16. MidiFile_saveToCallback() hands the encoded file to the callback in
+ *     order, in a few large pieces, so it can be written to a pipe, socket,
+ *     or other stream which cannot seek.  The callback returns 0 on success.
+ *
+ * 17. For a single read-only pass over a file, MidiFileReader_open() avoids
+ *     building the whole event list.  MidiFileReader_next() decodes one event
+ *     at a time into a struct MidiFileReaderEvent, either a whole track at a
+ *     time or merged across tracks in the same order as MidiFile_getFirstEvent()
+ *     and MidiFileEvent_getNextEventInFile().  Memory use depends only on the
+ *     number of tracks.  Unlike a loaded file, the end of track meta event
+ *     (number 0x2F) is reported as an event.  Event data points into the file,
+ *     so don't use it after MidiFileReader_close().
+ *
+ * 18. MidiFileWriter_open() is for recordings too long to keep rewriting.
+ *     Whole tracks can be written from memory with MidiFileWriter_writeTrack(),
+ *     but the last one can be started with MidiFileWriter_startTrack() and
+ *     have events appended to it as they happen, in tick order.  After
+ *     MidiFileWriter_checkpoint() or MidiFileWriter_close(), the file on disk
+ *     is complete.  If the writer stopped in between, MidiFileWriter_recover()
+ *     repairs the file, keeping every event written out before it stopped.
+ *
+ * 19. MidiFile_loadParallel() decodes the tracks on several threads at once,
+ *     which pays off for files with many large tracks.  Passing 0 for the
+ *     number of threads uses one per processor.  The result is the same as
+ *     from MidiFile_load().  Because of it, programs using this library need
+ *     to link with -lpthread on Unix.
+ *
+ * 20. MidiFile_getFirstEventOfType() and MidiFileEvent_getNextEventOfType()
+ *     step through the events of one type in file order, optionally only
+ *     those with a given channel and number (the note, controller, program,
+ *     or meta event number, depending on the type).  They follow lists kept
+ *     for each type, for each type and channel, and for each meta event
+ *     number, so they only look at events of that type, or of that type and
+ *     channel or number.  Each list is built the first time it is needed.
+ *
+ * 21. MidiFile_getEventsInRange() and MidiFileTrack_getEventsInRange() set up
+ *     a struct MidiFileIterator over the events from a start tick up to but
+ *     not including an end tick.  The start is found through the same tick
+ *     index as MidiFile_getFirstEventForTick(), so drawing or playing part of
+ *     a long file costs time in proportion to the events in that part.
+ *
+ * 22. MidiFile_snapshot() captures the whole file, and MidiFile_restore()
+ *     puts it back into that state, for things like undo.  Snapshots of the
+ *     same file share the parts of each track that did not change in between,
+ *     so taking one after a small edit is cheap, and restoring one only
+ *     replaces the events in the parts that differ.  Restored events come back
+ *     unselected, and pointers to events in those parts are no longer valid.
+ *     Events at the same tick in different tracks may come back in another
+ *     order in the file's list.  A snapshot never changes once taken, and
+ *     unlike the rest of the library it can be handed to another thread, for
+ *     instance to build a copy for playback there with
+ *     MidiFile_newFromSnapshot(), while the original keeps being edited.
+ *     Free each with MidiFileSnapshot_free().
+ *
+ * 23. MidiFile_diff() works out how to get from one version of a file to
+ *     another as a patch: the events to remove, add, or change (which it
+ *     stores as removing the old event and adding the new one), track by
+ *     track and tick by tick, in time proportional to the number of events.
+ *     MidiFile_applyPatch() makes those changes to a file like the old
+ *     version, and MidiFile_revertPatch() undoes them on a file like the new
+ *     one.  Both check first that the file matches, and return -1 without
+ *     changing it if not.  MidiFilePatch_saveToBuffer() and
+ *     MidiFilePatch_loadFromBuffer() store a patch, typically much smaller
+ *     than the file, for instance as an autosave delta.
  */
 
 #ifdef __cplusplus
@@ -78,10 +155,17 @@ typedef struct MidiFile *MidiFile_t;
 typedef struct MidiFileTrack *MidiFileTrack_t;
 typedef struct MidiFileEvent *MidiFileEvent_t;
 typedef void (*MidiFileEventVisitorCallback_t)(MidiFileEvent_t event, void *user_data);
+typedef int (*MidiFileWriteCallback_t)(unsigned char *buffer, int length, void *user_data);
 typedef struct MidiFileMeasureBeat *MidiFileMeasureBeat_t;
 typedef struct MidiFileMeasureBeatTick *MidiFileMeasureBeatTick_t;
 typedef struct MidiFileHourMinuteSecond *MidiFileHourMinuteSecond_t;
 typedef struct MidiFileHourMinuteSecondFrame *MidiFileHourMinuteSecondFrame_t;
+typedef struct MidiFileReader *MidiFileReader_t;
+typedef struct MidiFileReaderEvent *MidiFileReaderEvent_t;
+typedef struct MidiFileWriter *MidiFileWriter_t;
+typedef struct MidiFileIterator *MidiFileIterator_t;
+typedef struct MidiFileSnapshot *MidiFileSnapshot_t;
+typedef struct MidiFilePatch *MidiFilePatch_t;
 
 typedef enum
 {
@@ -113,15 +197,88 @@ typedef enum
 }
 MidiFileEventType_t;
 
+typedef enum
+{
+	MIDI_FILE_READER_MODE_TRACK_BY_TRACK,
+	MIDI_FILE_READER_MODE_MERGED
+}
+MidiFileReaderMode_t;
+
+/* Filled in by MidiFileReader_next(), so it can live on the caller's stack. */
+struct MidiFileReaderEvent
+{
+	int track_number;
+	long tick;
+	MidiFileEventType_t type; /* only the standard types, not note, fine control change, RPN or NRPN */
+	int channel; /* -1 for sysex and meta events */
+	int number; /* the note, controller, program or meta event number, or the sysex status byte */
+	int value; /* the velocity, pressure amount, controller value or pitch wheel value */
+	int data_length;
+	unsigned char *data; /* sysex or meta event data, after the status byte; it points into the file and is not terminated */
+};
+
+/* Set up by MidiFileIterator_init() or MidiFileIterator_initForTrack(), so it can live on the caller's stack.  The fields are private, and only the most recently started iterator for a file can be advanced. */
+struct MidiFileIterator
+{
+	MidiFile_t midi_file;
+	MidiFileTrack_t track; /* NULL when iterating over the whole file */
+	unsigned int epoch;
+	MidiFileEvent_t next_event;
+	long end_tick; /* -1 for no end */
+};
+
 MidiFile_t MidiFile_load(char *filename);
+MidiFile_t MidiFile_loadMapped(char *filename);
+MidiFile_t MidiFile_loadParallel(char *filename, int number_of_threads);
 int MidiFile_save(MidiFile_t midi_file, const char* filename);
-MidiFile_t MidiFile_loadFromBuffer(unsigned char *buffer);
+MidiFile_t MidiFile_loadFromBuffer(unsigned char *buffer, int buffer_length);
 int MidiFile_saveToBuffer(MidiFile_t midi_file, unsigned char *buffer);
+int MidiFile_saveToCallback(MidiFile_t midi_file, MidiFileWriteCallback_t callback, void *user_data);
 int MidiFile_getFileSize(MidiFile_t midi_file);
 
+MidiFileReader_t MidiFileReader_open(char *filename, MidiFileReaderMode_t mode);
+MidiFileReader_t MidiFileReader_openFromBuffer(unsigned char *buffer, int buffer_length, MidiFileReaderMode_t mode);
+int MidiFileReader_close(MidiFileReader_t reader);
+int MidiFileReader_getFileFormat(MidiFileReader_t reader);
+MidiFileDivisionType_t MidiFileReader_getDivisionType(MidiFileReader_t reader);
+int MidiFileReader_getResolution(MidiFileReader_t reader);
+int MidiFileReader_getNumberOfTracks(MidiFileReader_t reader);
+int MidiFileReader_next(MidiFileReader_t reader, MidiFileReaderEvent_t event); /* returns -1 after the last event */
+
+MidiFileWriter_t MidiFileWriter_open(char *filename, int file_format, MidiFileDivisionType_t division_type, int resolution);
+int MidiFileWriter_close(MidiFileWriter_t writer);
+int MidiFileWriter_checkpoint(MidiFileWriter_t writer);
+int MidiFileWriter_writeTrack(MidiFileWriter_t writer, MidiFileTrack_t track);
+int MidiFileWriter_startTrack(MidiFileWriter_t writer);
+int MidiFileWriter_writeNoteOffEvent(MidiFileWriter_t writer, long tick, int channel, int note, int velocity);
+int MidiFileWriter_writeNoteOnEvent(MidiFileWriter_t writer, long tick, int channel, int note, int velocity);
+int MidiFileWriter_writeKeyPressureEvent(MidiFileWriter_t writer, long tick, int channel, int note, int amount);
+int MidiFileWriter_writeControlChangeEvent(MidiFileWriter_t writer, long tick, int channel, int number, int value);
+int MidiFileWriter_writeProgramChangeEvent(MidiFileWriter_t writer, long tick, int channel, int number);
+int MidiFileWriter_writeChannelPressureEvent(MidiFileWriter_t writer, long tick, int channel, int amount);
+int MidiFileWriter_writePitchWheelEvent(MidiFileWriter_t writer, long tick, int channel, int value);
+int MidiFileWriter_writeSysexEvent(MidiFileWriter_t writer, long tick, int data_length, unsigned char *data_buffer);
+int MidiFileWriter_writeMetaEvent(MidiFileWriter_t writer, long tick, int number, int data_length, unsigned char *data_buffer);
+int MidiFileWriter_recover(char *filename);
+
+int MidiFileIterator_init(MidiFileIterator_t iterator, MidiFile_t midi_file);
+int MidiFileIterator_initForTrack(MidiFileIterator_t iterator, MidiFileTrack_t track);
+MidiFileEvent_t MidiFileIterator_next(MidiFileIterator_t iterator); /* returns NULL after the last event */
+
 MidiFile_t MidiFile_new(int file_format, MidiFileDivisionType_t division_type, int resolution);
 MidiFile_t MidiFile_newFromTemplate(MidiFile_t template_midi_file);
 int MidiFile_free(MidiFile_t midi_file);
+MidiFileSnapshot_t MidiFile_snapshot(MidiFile_t midi_file);
+int MidiFile_restore(MidiFile_t midi_file, MidiFileSnapshot_t snapshot);
+MidiFile_t MidiFile_newFromSnapshot(MidiFileSnapshot_t snapshot);
+int MidiFileSnapshot_free(MidiFileSnapshot_t snapshot);
+MidiFilePatch_t MidiFile_diff(MidiFile_t old_midi_file, MidiFile_t new_midi_file);
+int MidiFile_applyPatch(MidiFile_t midi_file, MidiFilePatch_t patch);
+int MidiFile_revertPatch(MidiFile_t midi_file, MidiFilePatch_t patch);
+MidiFilePatch_t MidiFilePatch_loadFromBuffer(unsigned char *buffer, int buffer_length);
+int MidiFilePatch_saveToBuffer(MidiFilePatch_t patch, unsigned char *buffer);
+int MidiFilePatch_getSize(MidiFilePatch_t patch);
+int MidiFilePatch_free(MidiFilePatch_t patch);
 int MidiFile_getFileFormat(MidiFile_t midi_file);
 int MidiFile_setFileFormat(MidiFile_t midi_file, int file_format);
 MidiFileDivisionType_t MidiFile_getDivisionType(MidiFile_t midi_file);
@@ -137,6 +294,7 @@ MidiFileTrack_t MidiFile_getFirstTrack(MidiFile_t midi_file);
 MidiFileTrack_t MidiFile_getLastTrack(MidiFile_t midi_file);
 MidiFileEvent_t MidiFile_getFirstEvent(MidiFile_t midi_file);
 MidiFileEvent_t MidiFile_getLastEvent(MidiFile_t midi_file);
+MidiFileEvent_t MidiFile_getFirstEventOfType(MidiFile_t midi_file, MidiFileEventType_t type, int channel, int number); /* -1 for any channel or number */
 MidiFileEvent_t MidiFile_iterateEvents(MidiFile_t midi_file);
 int MidiFile_visitEvents(MidiFile_t midi_file, MidiFileEventVisitorCallback_t visitor_callback, void *user_data);
 int MidiFile_convertSelectionFlagsToTextEvents(MidiFile_t midi_file, char *label);
@@ -175,6 +333,7 @@ long MidiFile_getTickFromTimeString(MidiFile_t midi_file, char *time_string);
 
 MidiFileEvent_t MidiFile_getFirstEventForTick(MidiFile_t midi_file, long tick);
 MidiFileEvent_t MidiFile_getLastEventForTick(MidiFile_t midi_file, long tick);
+int MidiFile_getEventsInRange(MidiFile_t midi_file, long start_tick, long end_tick, MidiFileIterator_t iterator); /* end_tick is exclusive, or -1 for the end of the file */
 MidiFileEvent_t MidiFile_getLatestTempoEventForTick(MidiFile_t midi_file, long tick);
 MidiFileEvent_t MidiFile_getLatestTimeSignatureEventForTick(MidiFile_t midi_file, long tick);
 MidiFileEvent_t MidiFile_getLatestKeySignatureEventForTick(MidiFile_t midi_file, long tick);
@@ -186,6 +345,7 @@ long MidiFileTrack_getEndTick(MidiFileTrack_t track);
 int MidiFileTrack_setEndTick(MidiFileTrack_t track, long end_tick);
 MidiFileEvent_t MidiFileTrack_getFirstEventForTick(MidiFileTrack_t track, long tick);
 MidiFileEvent_t MidiFileTrack_getLastEventForTick(MidiFileTrack_t track, long tick);
+int MidiFileTrack_getEventsInRange(MidiFileTrack_t track, long start_tick, long end_tick, MidiFileIterator_t iterator); /* end_tick is exclusive, or -1 for the end of the track */
 MidiFileTrack_t MidiFileTrack_createTrackBefore(MidiFileTrack_t track);
 MidiFileTrack_t MidiFileTrack_getPreviousTrack(MidiFileTrack_t track);
 MidiFileTrack_t MidiFileTrack_getNextTrack(MidiFileTrack_t track);
@@ -229,6 +389,7 @@ MidiFileEvent_t MidiFileEvent_getPreviousEventInTrack(MidiFileEvent_t event);
 MidiFileEvent_t MidiFileEvent_getNextEventInTrack(MidiFileEvent_t event);
 MidiFileEvent_t MidiFileEvent_getPreviousEventInFile(MidiFileEvent_t event);
 MidiFileEvent_t MidiFileEvent_getNextEventInFile(MidiFileEvent_t event);
+MidiFileEvent_t MidiFileEvent_getNextEventOfType(MidiFileEvent_t event, int channel, int number); /* -1 for any channel or number */
 long MidiFileEvent_getTick(MidiFileEvent_t event);
 int MidiFileEvent_setTick(MidiFileEvent_t event, long tick);
 MidiFileEventType_t MidiFileEvent_getType(MidiFileEvent_t event);
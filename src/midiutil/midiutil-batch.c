@@ -0,0 +1,541 @@
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <glob.h>
+#endif
+
+#include <midiutil-common.h>
+#include <midiutil-system.h>
+#include <midiutil-batch.h>
+
+#define MIDI_UTIL_BATCH_ERROR_MESSAGE_SIZE 1024
+#define MIDI_UTIL_BATCH_LINE_SIZE 4096
+
+typedef struct MidiUtilBatch *MidiUtilBatch_t;
+typedef struct MidiUtilBatchFile *MidiUtilBatchFile_t;
+
+struct MidiUtilBatch
+{
+	MidiUtilPointerArray_t files;
+	MidiUtilProcessFileCallback_t callback;
+	void *user_data;
+	MidiUtilLock_t lock;
+	int next_file_number;
+	int number_of_running_threads;
+};
+
+struct MidiUtilBatchFile
+{
+	char *input_filename;
+	char *relative_filename; /* the output goes to the same place under the output directory; NULL if that would be outside it */
+	char *output_filename;
+	long msecs;
+	char *error_message; /* NULL on success */
+};
+
+static int is_separator(char c)
+{
+#ifdef _WIN32
+	return (c == '/') || (c == '\\');
+#else
+	return (c == '/');
+#endif
+}
+
+static int is_wildcard(char c)
+{
+#ifdef _WIN32
+	return (c == '*') || (c == '?');
+#else
+	return (c == '*') || (c == '?') || (c == '[');
+#endif
+}
+
+static char *copy_string(char *string)
+{
+	char *copy = (char *)(malloc(strlen(string) + 1));
+	strcpy(copy, string);
+	return copy;
+}
+
+static char *join_path(char *directory_name, char *relative_filename)
+{
+	int directory_name_length = strlen(directory_name);
+	char *filename = (char *)(malloc(directory_name_length + strlen(relative_filename) + 2));
+	strcpy(filename, directory_name);
+	if ((directory_name_length > 0) && !is_separator(directory_name[directory_name_length - 1])) strcat(filename, "/");
+	strcat(filename, relative_filename);
+	return filename;
+}
+
+static int get_root_length(char *directory_name)
+{
+	/* Where the relative part of a filename built with join_path() starts. */
+	int directory_name_length = strlen(directory_name);
+	return ((directory_name_length == 0) || is_separator(directory_name[directory_name_length - 1])) ? directory_name_length : directory_name_length + 1;
+}
+
+static int is_directory(char *filename)
+{
+	struct stat file_stat;
+	return (stat(filename, &file_stat) == 0) && ((file_stat.st_mode & S_IFMT) == S_IFDIR);
+}
+
+static int is_regular_file(char *filename)
+{
+	struct stat file_stat;
+	return (stat(filename, &file_stat) == 0) && ((file_stat.st_mode & S_IFMT) == S_IFREG);
+}
+
+static int has_midi_file_extension(char *filename)
+{
+	static char *extensions[] = { ".mid", ".midi", ".kar", ".rmi", NULL };
+	int filename_length = strlen(filename);
+	int extension_number;
+
+	for (extension_number = 0; extensions[extension_number] != NULL; extension_number++)
+	{
+		int extension_length = strlen(extensions[extension_number]);
+		int i;
+
+		if (filename_length <= extension_length) continue;
+		for (i = 0; (i < extension_length) && (tolower((unsigned char)(filename[filename_length - extension_length + i])) == extensions[extension_number][i]); i++) {}
+		if (i == extension_length) return 1;
+	}
+
+	return 0;
+}
+
+static MidiUtilBatchFile_t add_file(MidiUtilBatch_t batch, char *input_filename, int relative_filename_offset)
+{
+	MidiUtilBatchFile_t file = (MidiUtilBatchFile_t)(malloc(sizeof(struct MidiUtilBatchFile)));
+	file->input_filename = copy_string(input_filename);
+	file->relative_filename = copy_string(input_filename + relative_filename_offset);
+	file->output_filename = NULL;
+	file->msecs = 0;
+	file->error_message = NULL;
+	MidiUtilPointerArray_add(batch->files, file);
+	return file;
+}
+
+static int file_precedes(const void *file_pointer, const void *other_file_pointer)
+{
+	return strcmp((*((MidiUtilBatchFile_t *)(file_pointer)))->input_filename, (*((MidiUtilBatchFile_t *)(other_file_pointer)))->input_filename);
+}
+
+static void add_directory(MidiUtilBatch_t batch, char *directory_name, int root_length)
+{
+	/* Symbolic links to directories are not followed, so that a loop cannot trap the search. */
+
+#ifdef _WIN32
+	char *pattern = join_path(directory_name, "*");
+	WIN32_FIND_DATA find_data;
+	HANDLE find_handle = FindFirstFile(pattern, &find_data);
+
+	free(pattern);
+	if (find_handle == INVALID_HANDLE_VALUE) return;
+
+	do
+	{
+		char *filename;
+
+		if ((strcmp(find_data.cFileName, ".") == 0) || (strcmp(find_data.cFileName, "..") == 0)) continue;
+		filename = join_path(directory_name, find_data.cFileName);
+
+		if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) add_directory(batch, filename, root_length);
+		}
+		else if (has_midi_file_extension(filename))
+		{
+			add_file(batch, filename, root_length);
+		}
+
+		free(filename);
+	}
+	while (FindNextFile(find_handle, &find_data));
+
+	FindClose(find_handle);
+#else
+	DIR *directory = opendir(directory_name);
+	struct dirent *entry;
+
+	if (directory == NULL) return;
+
+	while ((entry = readdir(directory)) != NULL)
+	{
+		char *filename;
+		struct stat file_stat;
+
+		if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) continue;
+		filename = join_path(directory_name, entry->d_name);
+
+		if (lstat(filename, &file_stat) == 0)
+		{
+			if (S_ISDIR(file_stat.st_mode))
+			{
+				add_directory(batch, filename, root_length);
+			}
+			else if (has_midi_file_extension(filename) && is_regular_file(filename))
+			{
+				add_file(batch, filename, root_length);
+			}
+		}
+
+		free(filename);
+	}
+
+	closedir(directory);
+#endif
+}
+
+static int add_matching_files(MidiUtilBatch_t batch, char *pattern)
+{
+	/* Outputs are placed relative to the last directory before the first wildcard. */
+
+	int root_length = 0;
+	int i;
+
+	for (i = 0; (pattern[i] != '\0') && !is_wildcard(pattern[i]); i++)
+	{
+		if (is_separator(pattern[i])) root_length = i + 1;
+	}
+
+#ifdef _WIN32
+	{
+		char *directory_name = (char *)(malloc(root_length + 1));
+		WIN32_FIND_DATA find_data;
+		HANDLE find_handle;
+
+		strncpy(directory_name, pattern, root_length);
+		directory_name[root_length] = '\0';
+
+		/* FindFirstFile() only expands wildcards in the last part of the pattern */
+		if ((find_handle = FindFirstFile(pattern, &find_data)) != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				{
+					char *filename = join_path(directory_name, find_data.cFileName);
+					add_file(batch, filename, root_length);
+					free(filename);
+				}
+			}
+			while (FindNextFile(find_handle, &find_data));
+
+			FindClose(find_handle);
+		}
+
+		free(directory_name);
+		return 0;
+	}
+#else
+	{
+		glob_t glob_result;
+		size_t path_number;
+
+		switch (glob(pattern, 0, NULL, &glob_result))
+		{
+			case 0:
+			{
+				for (path_number = 0; path_number < glob_result.gl_pathc; path_number++)
+				{
+					if (is_regular_file(glob_result.gl_pathv[path_number])) add_file(batch, glob_result.gl_pathv[path_number], root_length);
+				}
+
+				globfree(&glob_result);
+				return 0;
+			}
+			case GLOB_NOMATCH:
+			{
+				return 0;
+			}
+			default:
+			{
+				return -1;
+			}
+		}
+	}
+#endif
+}
+
+static char *get_normalized_relative_filename(char *filename)
+{
+	/* Drops empty and "." parts and resolves ".." against the parts before it.  Returns NULL if that would climb above the start, or leaves nothing. */
+
+	char *relative_filename = (char *)(malloc(strlen(filename) + 1));
+	int relative_filename_length = 0;
+	int i = 0;
+
+	while (filename[i] != '\0')
+	{
+		int part_length;
+
+		for (part_length = 0; (filename[i + part_length] != '\0') && !is_separator(filename[i + part_length]); part_length++) {}
+
+		if ((part_length == 2) && (filename[i] == '.') && (filename[i + 1] == '.'))
+		{
+			if (relative_filename_length == 0)
+			{
+				free(relative_filename);
+				return NULL;
+			}
+
+			while ((relative_filename_length > 0) && (relative_filename[relative_filename_length - 1] != '/')) relative_filename_length--;
+			if (relative_filename_length > 0) relative_filename_length--;
+		}
+		else if ((part_length > 1) || ((part_length == 1) && (filename[i] != '.')))
+		{
+			if (relative_filename_length > 0) relative_filename[relative_filename_length++] = '/';
+			memcpy(relative_filename + relative_filename_length, filename + i, part_length);
+			relative_filename_length += part_length;
+		}
+
+		i += part_length;
+		if (filename[i] != '\0') i++;
+	}
+
+	relative_filename[relative_filename_length] = '\0';
+
+	if (relative_filename_length == 0)
+	{
+		free(relative_filename);
+		return NULL;
+	}
+
+	return relative_filename;
+}
+
+static void add_listed_files(MidiUtilBatch_t batch, FILE *in)
+{
+	/* Listed paths can point anywhere, so the relative filename is normalised to keep the output inside the output directory. */
+
+	char line[MIDI_UTIL_BATCH_LINE_SIZE];
+
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		int line_length = strlen(line);
+		int relative_filename_offset = 0;
+		MidiUtilBatchFile_t file;
+
+		while ((line_length > 0) && ((line[line_length - 1] == '\n') || (line[line_length - 1] == '\r'))) line[--line_length] = '\0';
+		if (line_length == 0) continue;
+
+#ifdef _WIN32
+		if ((line_length >= 2) && (line[1] == ':')) relative_filename_offset = 2;
+#endif
+
+		file = add_file(batch, line, 0);
+		free(file->relative_filename);
+		file->relative_filename = get_normalized_relative_filename(line + relative_filename_offset);
+	}
+}
+
+static void make_parent_directories(char *filename)
+{
+	/* Failures are left for writing the file to report. */
+
+	char *directory_name = copy_string(filename);
+	int i;
+
+	for (i = 1; directory_name[i] != '\0'; i++)
+	{
+		if (is_separator(directory_name[i]) && !is_separator(directory_name[i - 1]))
+		{
+			char separator = directory_name[i];
+			directory_name[i] = '\0';
+#ifdef _WIN32
+			_mkdir(directory_name);
+#else
+			mkdir(directory_name, 0777);
+#endif
+			directory_name[i] = separator;
+		}
+	}
+
+	free(directory_name);
+}
+
+static int get_directory_name_length(char *filename)
+{
+	int directory_name_length = 0;
+	int i;
+
+	for (i = 0; filename[i] != '\0'; i++)
+	{
+		if (is_separator(filename[i])) directory_name_length = i;
+	}
+
+	return directory_name_length;
+}
+
+static void process_files_helper(void *user_data)
+{
+	MidiUtilBatch_t batch = (MidiUtilBatch_t)(user_data);
+	char error_message[MIDI_UTIL_BATCH_ERROR_MESSAGE_SIZE];
+
+	while (1)
+	{
+		MidiUtilBatchFile_t file = NULL;
+		long start_time_msecs;
+
+		MidiUtilLock_lock(batch->lock);
+		if (batch->next_file_number < MidiUtilPointerArray_getSize(batch->files)) file = (MidiUtilBatchFile_t)(MidiUtilPointerArray_get(batch->files, (batch->next_file_number)++));
+		MidiUtilLock_unlock(batch->lock);
+		if (file == NULL) break;
+		if (file->error_message != NULL) continue;
+
+		start_time_msecs = MidiUtil_getCurrentTimeMsecs();
+		error_message[0] = '\0';
+		if ((batch->callback)(file->input_filename, file->output_filename, error_message, sizeof(error_message), batch->user_data) != 0) file->error_message = copy_string(error_message);
+		file->msecs = MidiUtil_getCurrentTimeMsecs() - start_time_msecs;
+	}
+
+	MidiUtilLock_lock(batch->lock);
+	(batch->number_of_running_threads)--;
+	MidiUtilLock_notify(batch->lock);
+	MidiUtilLock_unlock(batch->lock);
+}
+
+int MidiUtil_isBatchInput(char *input)
+{
+	int i;
+
+	if (input == NULL) return 0;
+	if (strcmp(input, "-") == 0) return 1;
+
+	for (i = 0; input[i] != '\0'; i++)
+	{
+		if (is_wildcard(input[i])) return 1;
+	}
+
+	return is_directory(input);
+}
+
+int MidiUtil_processFiles(char *input, char *output, int number_of_threads, MidiUtilProcessFileCallback_t callback, void *user_data)
+{
+	struct MidiUtilBatch batch;
+	long start_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	int number_of_files, file_number, thread_number;
+	int number_of_failed_files = 0;
+	MidiUtilBatchFile_t file, previous_file = NULL;
+	MidiUtilStringIntMap_t output_file_numbers;
+
+	if ((input == NULL) || (callback == NULL)) return -1;
+
+	if (!MidiUtil_isBatchInput(input))
+	{
+		char error_message[MIDI_UTIL_BATCH_ERROR_MESSAGE_SIZE];
+
+		error_message[0] = '\0';
+		if (callback(input, (output == NULL) ? input : output, error_message, sizeof(error_message), user_data) == 0) return 0;
+		fprintf(stderr, "Error:  %s\n", error_message);
+		return 1;
+	}
+
+	batch.files = MidiUtilPointerArray_new(1024);
+	batch.callback = callback;
+	batch.user_data = user_data;
+
+	if (strcmp(input, "-") == 0)
+	{
+		add_listed_files(&batch, stdin);
+	}
+	else if (is_directory(input))
+	{
+		add_directory(&batch, input, get_root_length(input));
+		qsort(MidiUtilPointerArray_getBuffer(batch.files), MidiUtilPointerArray_getSize(batch.files), sizeof(void *), file_precedes);
+	}
+	else if (add_matching_files(&batch, input) != 0)
+	{
+		fprintf(stderr, "Error:  Cannot list the files matching \"%s\".\n", input);
+		MidiUtilPointerArray_free(batch.files);
+		return -1;
+	}
+
+	number_of_files = MidiUtilPointerArray_getSize(batch.files);
+	output_file_numbers = MidiUtilStringIntMap_new(number_of_files);
+
+	for (file_number = 0; file_number < number_of_files; file_number++)
+	{
+		char error_message[MIDI_UTIL_BATCH_ERROR_MESSAGE_SIZE];
+		int other_file_number;
+
+		file = (MidiUtilBatchFile_t)(MidiUtilPointerArray_get(batch.files, file_number));
+
+		if (output == NULL)
+		{
+			file->output_filename = copy_string(file->input_filename);
+		}
+		else if (file->relative_filename == NULL)
+		{
+			file->error_message = copy_string("Cannot place the output inside the output directory.");
+			continue;
+		}
+		else
+		{
+			file->output_filename = join_path(output, file->relative_filename);
+		}
+
+		/* Two workers must never write the same file at once. */
+		if ((other_file_number = MidiUtilStringIntMap_get(output_file_numbers, (unsigned char *)(file->output_filename), -1)) >= 0)
+		{
+			sprintf(error_message, "Same output file as \"%.900s\".", ((MidiUtilBatchFile_t)(MidiUtilPointerArray_get(batch.files, other_file_number)))->input_filename);
+			file->error_message = copy_string(error_message);
+			continue;
+		}
+
+		MidiUtilStringIntMap_set(output_file_numbers, (unsigned char *)(file->output_filename), file_number);
+
+		if (output != NULL)
+		{
+			/* create the mirrored directories up front, only once for each run of files in the same one */
+			if ((previous_file == NULL) || (get_directory_name_length(file->output_filename) != get_directory_name_length(previous_file->output_filename)) || (strncmp(file->output_filename, previous_file->output_filename, get_directory_name_length(file->output_filename)) != 0)) make_parent_directories(file->output_filename);
+			previous_file = file;
+		}
+	}
+
+	MidiUtilStringIntMap_free(output_file_numbers);
+
+	if (number_of_threads <= 0) number_of_threads = MidiUtil_getNumberOfProcessors();
+	if (number_of_threads > number_of_files) number_of_threads = number_of_files;
+	batch.lock = MidiUtilLock_new();
+	batch.next_file_number = 0;
+	batch.number_of_running_threads = number_of_threads;
+	for (thread_number = 0; thread_number < number_of_threads; thread_number++) MidiUtil_startThread(process_files_helper, &batch);
+
+	MidiUtilLock_lock(batch.lock);
+	while (batch.number_of_running_threads > 0) MidiUtilLock_wait(batch.lock, -1);
+	MidiUtilLock_unlock(batch.lock);
+	MidiUtilLock_free(batch.lock);
+
+	for (file_number = 0; file_number < number_of_files; file_number++)
+	{
+		file = (MidiUtilBatchFile_t)(MidiUtilPointerArray_get(batch.files, file_number));
+		printf("%s\t%.3fs\t%s\n", file->input_filename, file->msecs / 1000.0, (file->error_message == NULL) ? "OK" : file->error_message);
+		if (file->error_message != NULL) number_of_failed_files++;
+		free(file->input_filename);
+		free(file->relative_filename);
+		free(file->output_filename);
+		free(file->error_message);
+		free(file);
+	}
+
+	printf("%d files, %d failed, %.3fs with %d %s\n", number_of_files, number_of_failed_files, (MidiUtil_getCurrentTimeMsecs() - start_time_msecs) / 1000.0, number_of_threads, (number_of_threads == 1) ? "thread" : "threads");
+	MidiUtilPointerArray_free(batch.files);
+	return number_of_failed_files;
+}
+
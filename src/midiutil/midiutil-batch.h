@@ -0,0 +1,34 @@
+#ifndef MIDIUTIL_BATCH_INCLUDED
+#define MIDIUTIL_BATCH_INCLUDED
+
+/*
+ * Common helpers for running the same transformation over many MIDI files in
+ * one process.  Besides a single filename, the input can be a directory (which
+ * is searched recursively for .mid, .midi, .kar and .rmi files), a wildcard
+ * pattern, or "-" to read a list of filenames from stdin, one per line.  In
+ * those cases the files are handed out to a pool of worker threads, each
+ * output goes to the same relative path under the output directory (or over
+ * its input if there is none), and a line per file with its time and any
+ * error is printed at the end, followed by the totals.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Returns 0 on success, or -1 after filling in the error message. */
+typedef int (*MidiUtilProcessFileCallback_t)(char *input_filename, char *output_filename, char *error_message, size_t error_message_size, void *user_data);
+
+int MidiUtil_isBatchInput(char *input);
+
+/* Returns the number of files which failed, or -1 if the input could not be listed.  Zero threads means one per processor. */
+int MidiUtil_processFiles(char *input, char *output, int number_of_threads, MidiUtilProcessFileCallback_t callback, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,48 +4,6 @@
 #include <string.h>
 #include <midiutil-common.h>
 
-typedef struct MidiUtilIntIntMapNode *MidiUtilIntIntMapNode_t;
-typedef struct MidiUtilIntPointerMapNode *MidiUtilIntPointerMapNode_t;
-typedef struct MidiUtilLongIntMapNode *MidiUtilLongIntMapNode_t;
-typedef struct MidiUtilLongPointerMapNode *MidiUtilLongPointerMapNode_t;
-typedef struct MidiUtilPointerIntMapNode *MidiUtilPointerIntMapNode_t;
-typedef struct MidiUtilPointerPointerMapNode *MidiUtilPointerPointerMapNode_t;
-typedef struct MidiUtilBlobIntMapNode *MidiUtilBlobIntMapNode_t;
-typedef struct MidiUtilBlobPointerMapNode *MidiUtilBlobPointerMapNode_t;
-typedef struct MidiUtilStringIntMapNode *MidiUtilStringIntMapNode_t;
-typedef struct MidiUtilStringPointerMapNode *MidiUtilStringPointerMapNode_t;
-
-struct MidiUtilByteArray
-{
-	int capacity;
-	int size;
-	unsigned char *buffer;
-};
-
-struct MidiUtilIntArray
-{
-	MidiUtilByteArray_t byte_array;
-};
-
-struct MidiUtilLongArray
-{
-	MidiUtilByteArray_t byte_array;
-};
-
-struct MidiUtilFloatArray
-{
-	MidiUtilByteArray_t byte_array;
-};
-
-struct MidiUtilDoubleArray
-{
-	MidiUtilByteArray_t byte_array;
-};
-
-struct MidiUtilPointerArray
-{
-	MidiUtilByteArray_t byte_array;
-};
 
 struct MidiUtilString
 {
@@ -64,2388 +22,1498 @@ struct MidiUtilStringArray
 	MidiUtilBlobArray_t blob_array;
 };
 
-struct MidiUtilIntIntMap
+typedef enum
 {
-	int number_of_buckets;
-	MidiUtilIntIntMapNode_t *bucket_node_lists;
-};
+	MIDI_UTIL_HASH_MAP_KEY_TYPE_INT,
+	MIDI_UTIL_HASH_MAP_KEY_TYPE_LONG,
+	MIDI_UTIL_HASH_MAP_KEY_TYPE_POINTER,
+	MIDI_UTIL_HASH_MAP_KEY_TYPE_BLOB /* strings are stored as blobs including their terminator */
+}
+MidiUtilHashMapKeyType_t;
 
-struct MidiUtilIntIntMapNode
+/* All the maps share one open-addressing table with Robin Hood probing, which keeps entries in place rather than in malloc'd nodes. */
+struct MidiUtilHashMapSlot
 {
-	int key;
-	int value;
-	MidiUtilIntIntMapNode_t next;
+	unsigned int hash; /* zero for an empty slot */
+	int key_size;
+
+	union
+	{
+		int int_key;
+		long long_key;
+		void *pointer_key;
+		unsigned char *blob_key;
+	}
+	key;
+
+	union
+	{
+		int int_value;
+		void *pointer_value;
+	}
+	value;
 };
 
-struct MidiUtilIntPointerMap
+struct MidiUtilHashMap
 {
-	int number_of_buckets;
-	MidiUtilIntPointerMapNode_t *bucket_node_lists;
+	MidiUtilHashMapKeyType_t key_type;
+	int capacity; /* always a power of two */
+	int size;
+	struct MidiUtilHashMapSlot *slots;
 	void (*free_callback)(void *value, void *user_data);
 	void *free_callback_user_data;
 };
 
-struct MidiUtilIntPointerMapNode
+struct MidiUtilIntIntMap
 {
-	int key;
-	void *value;
-	MidiUtilIntPointerMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
-struct MidiUtilLongIntMap
+struct MidiUtilIntPointerMap
 {
-	int number_of_buckets;
-	MidiUtilLongIntMapNode_t *bucket_node_lists;
+	struct MidiUtilHashMap hash_map;
 };
 
-struct MidiUtilLongIntMapNode
+struct MidiUtilLongIntMap
 {
-	int key;
-	int value;
-	MidiUtilLongIntMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
 struct MidiUtilLongPointerMap
 {
-	int number_of_buckets;
-	MidiUtilLongPointerMapNode_t *bucket_node_lists;
-	void (*free_callback)(void *value, void *user_data);
-	void *free_callback_user_data;
-};
-
-struct MidiUtilLongPointerMapNode
-{
-	int key;
-	void *value;
-	MidiUtilLongPointerMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
 struct MidiUtilPointerIntMap
 {
-	int number_of_buckets;
-	MidiUtilPointerIntMapNode_t *bucket_node_lists;
-};
-
-struct MidiUtilPointerIntMapNode
-{
-	void *key;
-	int value;
-	MidiUtilPointerIntMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
 struct MidiUtilPointerPointerMap
 {
-	int number_of_buckets;
-	MidiUtilPointerPointerMapNode_t *bucket_node_lists;
-	void (*free_callback)(void *value, void *user_data);
-	void *free_callback_user_data;
-};
-
-struct MidiUtilPointerPointerMapNode
-{
-	void *key;
-	void *value;
-	MidiUtilPointerPointerMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
 struct MidiUtilBlobIntMap
 {
-	int number_of_buckets;
-	MidiUtilBlobIntMapNode_t *bucket_node_lists;
-};
-
-struct MidiUtilBlobIntMapNode
-{
-	unsigned char *key;
-	int key_size;
-	int value;
-	MidiUtilBlobIntMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
 struct MidiUtilBlobPointerMap
 {
-	int number_of_buckets;
-	MidiUtilBlobPointerMapNode_t *bucket_node_lists;
-	void (*free_callback)(void *value, void *user_data);
-	void *free_callback_user_data;
-};
-
-struct MidiUtilBlobPointerMapNode
-{
-	unsigned char *key;
-	int key_size;
-	void *value;
-	MidiUtilBlobPointerMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
 struct MidiUtilStringIntMap
 {
-	int number_of_buckets;
-	MidiUtilStringIntMapNode_t *bucket_node_lists;
-};
-
-struct MidiUtilStringIntMapNode
-{
-	unsigned char *key;
-	int value;
-	MidiUtilStringIntMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
 struct MidiUtilStringPointerMap
 {
-	int number_of_buckets;
-	MidiUtilStringPointerMapNode_t *bucket_node_lists;
-	void (*free_callback)(void *value, void *user_data);
-	void *free_callback_user_data;
-};
-
-struct MidiUtilStringPointerMapNode
-{
-	unsigned char *key;
-	void *value;
-	MidiUtilStringPointerMapNode_t next;
+	struct MidiUtilHashMap hash_map;
 };
 
-MidiUtilByteArray_t MidiUtilByteArray_new(int initial_capacity)
-{
-	MidiUtilByteArray_t array = (MidiUtilByteArray_t)(malloc(sizeof (struct MidiUtilByteArray)));
-	array->capacity = initial_capacity;
-	array->size = 0;
-	array->buffer = (unsigned char *)(malloc(initial_capacity));
-	memset(array->buffer, 0, initial_capacity);
-	return array;
-}
+static int get_grown_array_capacity(int capacity, int minimum_capacity)
+{
+	/* Doubling keeps a run of adds amortised constant time, where growing by a fixed step made it quadratic. */
+	capacity *= 2;
+	if (capacity < 16) capacity = 16;
+	return (capacity < minimum_capacity) ? minimum_capacity : capacity;
+}
+
+/* The fixed-size element arrays only differ in their element type, so they are all stamped out from this one definition.  Elements past the size are zeroed as the size grows over them. */
+
+#define MIDI_UTIL_DEFINE_ARRAY(array_name, value_type) \
+\
+struct MidiUtil##array_name \
+{ \
+	int capacity; \
+	int size; \
+	value_type *buffer; \
+}; \
+\
+MidiUtil##array_name##_t MidiUtil##array_name##_new(int initial_capacity) \
+{ \
+	MidiUtil##array_name##_t array = (MidiUtil##array_name##_t)(malloc(sizeof (struct MidiUtil##array_name))); \
+	array->capacity = (initial_capacity > 0) ? initial_capacity : 0; \
+	array->size = 0; \
+	array->buffer = (value_type *)(malloc((array->capacity > 0 ? array->capacity : 1) * sizeof (value_type))); \
+	return array; \
+} \
+\
+void MidiUtil##array_name##_free(MidiUtil##array_name##_t array) \
+{ \
+	free(array->buffer); \
+	free(array); \
+} \
+\
+void MidiUtil##array_name##_clear(MidiUtil##array_name##_t array) \
+{ \
+	array->size = 0; \
+} \
+\
+int MidiUtil##array_name##_getCapacity(MidiUtil##array_name##_t array) \
+{ \
+	return array->capacity; \
+} \
+\
+void MidiUtil##array_name##_setCapacity(MidiUtil##array_name##_t array, int capacity) \
+{ \
+	if (capacity < 0) capacity = 0; \
+	if (array->size > capacity) array->size = capacity; \
+	array->capacity = capacity; \
+	array->buffer = (value_type *)(realloc(array->buffer, (capacity > 0 ? capacity : 1) * sizeof (value_type))); \
+} \
+\
+void MidiUtil##array_name##_reserve(MidiUtil##array_name##_t array, int capacity) \
+{ \
+	if (capacity > array->capacity) MidiUtil##array_name##_setCapacity(array, capacity); \
+} \
+\
+int MidiUtil##array_name##_getSize(MidiUtil##array_name##_t array) \
+{ \
+	return array->size; \
+} \
+\
+void MidiUtil##array_name##_setSize(MidiUtil##array_name##_t array, int size) \
+{ \
+	if (size > array->capacity) MidiUtil##array_name##_setCapacity(array, get_grown_array_capacity(array->capacity, size)); \
+	if (size > array->size) memset(array->buffer + array->size, 0, (size - array->size) * sizeof (value_type)); \
+	array->size = size; \
+} \
+\
+value_type *MidiUtil##array_name##_getBuffer(MidiUtil##array_name##_t array) \
+{ \
+	return array->buffer; \
+} \
+\
+value_type MidiUtil##array_name##_get(MidiUtil##array_name##_t array, int element_number) \
+{ \
+	if ((element_number >= 0) && (element_number < array->size)) \
+	{ \
+		return array->buffer[element_number]; \
+	} \
+	else \
+	{ \
+		return (value_type)(0); \
+	} \
+} \
+\
+void MidiUtil##array_name##_set(MidiUtil##array_name##_t array, int element_number, value_type value) \
+{ \
+	if (element_number >= array->size) MidiUtil##array_name##_setSize(array, element_number + 1); \
+	array->buffer[element_number] = value; \
+} \
+\
+void MidiUtil##array_name##_add(MidiUtil##array_name##_t array, value_type value) \
+{ \
+	if (array->size == array->capacity) MidiUtil##array_name##_setCapacity(array, get_grown_array_capacity(array->capacity, array->size + 1)); \
+	array->buffer[array->size++] = value; \
+} \
+\
+void MidiUtil##array_name##_addUnchecked(MidiUtil##array_name##_t array, value_type value) \
+{ \
+	array->buffer[array->size++] = value; \
+} \
+\
+void MidiUtil##array_name##_insert(MidiUtil##array_name##_t array, int element_number, value_type value) \
+{ \
+	MidiUtil##array_name##_insertValues(array, element_number, &value, 1); \
+} \
+\
+void MidiUtil##array_name##_remove(MidiUtil##array_name##_t array, int element_number) \
+{ \
+	MidiUtil##array_name##_removeValues(array, element_number, 1); \
+} \
+\
+void MidiUtil##array_name##_swapRemove(MidiUtil##array_name##_t array, int element_number) \
+{ \
+	array->buffer[element_number] = array->buffer[--(array->size)]; \
+} \
+\
+void MidiUtil##array_name##_setValues(MidiUtil##array_name##_t array, value_type *values, int number_of_values) \
+{ \
+	array->size = 0; \
+	MidiUtil##array_name##_addValues(array, values, number_of_values); \
+} \
+\
+void MidiUtil##array_name##_addValues(MidiUtil##array_name##_t array, value_type *values, int number_of_values) \
+{ \
+	if (array->size + number_of_values > array->capacity) MidiUtil##array_name##_setCapacity(array, get_grown_array_capacity(array->capacity, array->size + number_of_values)); \
+	memcpy(array->buffer + array->size, values, number_of_values * sizeof (value_type)); \
+	array->size += number_of_values; \
+} \
+\
+void MidiUtil##array_name##_replaceValues(MidiUtil##array_name##_t array, int element_number, value_type *values, int number_of_values) \
+{ \
+	if (element_number + number_of_values > array->size) MidiUtil##array_name##_setSize(array, element_number + number_of_values); \
+	memcpy(array->buffer + element_number, values, number_of_values * sizeof (value_type)); \
+} \
+\
+void MidiUtil##array_name##_insertValues(MidiUtil##array_name##_t array, int element_number, value_type *values, int number_of_values) \
+{ \
+	int tail_size = array->size - element_number; \
+	MidiUtil##array_name##_setSize(array, array->size + number_of_values); \
+	memmove(array->buffer + element_number + number_of_values, array->buffer + element_number, tail_size * sizeof (value_type)); \
+	memcpy(array->buffer + element_number, values, number_of_values * sizeof (value_type)); \
+} \
+\
+void MidiUtil##array_name##_removeValues(MidiUtil##array_name##_t array, int element_number, int number_of_values) \
+{ \
+	memmove(array->buffer + element_number, array->buffer + element_number + number_of_values, (array->size - element_number - number_of_values) * sizeof (value_type)); \
+	array->size -= number_of_values; \
+}
+
+MIDI_UTIL_DEFINE_ARRAY(ByteArray, unsigned char)
+MIDI_UTIL_DEFINE_ARRAY(IntArray, int)
+MIDI_UTIL_DEFINE_ARRAY(LongArray, long)
+MIDI_UTIL_DEFINE_ARRAY(FloatArray, float)
+MIDI_UTIL_DEFINE_ARRAY(DoubleArray, double)
+MIDI_UTIL_DEFINE_ARRAY(PointerArray, void *)
 
-void MidiUtilByteArray_free(MidiUtilByteArray_t array)
+MidiUtilString_t MidiUtilString_new(int initial_capacity)
 {
-	free(array->buffer);
-	free(array);
+	MidiUtilString_t string = (MidiUtilString_t)(malloc(sizeof (struct MidiUtilString)));
+	string->byte_array = MidiUtilByteArray_new(initial_capacity);
+	MidiUtilByteArray_set(string->byte_array, 0, '\0');
+	return string;
 }
 
-void MidiUtilByteArray_clear(MidiUtilByteArray_t array)
+void MidiUtilString_free(MidiUtilString_t string)
 {
-	MidiUtilByteArray_setSize(array, 0);
+	MidiUtilByteArray_free(string->byte_array);
+	free(string);
 }
 
-int MidiUtilByteArray_getCapacity(MidiUtilByteArray_t array)
+void MidiUtilString_clear(MidiUtilString_t string)
 {
-	return array->capacity;
+	MidiUtilByteArray_clear(string->byte_array);
+	MidiUtilByteArray_set(string->byte_array, 0, '\0');
 }
 
-void MidiUtilByteArray_setCapacity(MidiUtilByteArray_t array, int capacity)
+int MidiUtilString_getCapacity(MidiUtilString_t string)
 {
-	if (array->size > capacity) array->size = capacity;
-	array->capacity = capacity;
-	array->buffer = realloc(array->buffer, capacity);
-	memset(array->buffer + array->size, 0, capacity - array->size);
+	return MidiUtilByteArray_getCapacity(string->byte_array);
 }
 
-int MidiUtilByteArray_getSize(MidiUtilByteArray_t array)
+void MidiUtilString_setCapacity(MidiUtilString_t string, int capacity)
 {
-	return array->size;
+	MidiUtilByteArray_setCapacity(string->byte_array, capacity);
 }
 
-void MidiUtilByteArray_setSize(MidiUtilByteArray_t array, int size)
+int MidiUtilString_getSize(MidiUtilString_t string)
 {
-	if (size < array->size)
-	{
-		memset(array->buffer + size, 0, array->size - size);
-	}
-	else if (size >= array->capacity)
-	{
-		/* TODO: consider growth algorithm from <http://www.python.org/~jeremy/weblog/040115.html> */
-		MidiUtilByteArray_setCapacity(array, size - (size % 4096) + 4096);
-	}
-
-	array->size = size;
+	return MidiUtilByteArray_getSize(string->byte_array) - 1;
 }
 
-unsigned char *MidiUtilByteArray_getBuffer(MidiUtilByteArray_t array)
+unsigned char *MidiUtilString_get(MidiUtilString_t string)
 {
-	return array->buffer;
+	return MidiUtilByteArray_getBuffer(string->byte_array);
 }
 
-unsigned char MidiUtilByteArray_get(MidiUtilByteArray_t array, int element_number)
+void MidiUtilString_set(MidiUtilString_t string, unsigned char *value)
 {
-	if (element_number < array->size)
-	{
-		return array->buffer[element_number];
-	}
-	else
-	{
-		return 0;
-	}
+	MidiUtilByteArray_setValues(string->byte_array, value, strlen((char *)(value)) + 1);
 }
 
-void MidiUtilByteArray_set(MidiUtilByteArray_t array, int element_number, unsigned char value)
+void MidiUtilString_addChar(MidiUtilString_t string, unsigned char value)
 {
-	if (element_number >= array->size) MidiUtilByteArray_setSize(array, element_number + 1);
-	array->buffer[element_number] = value;
+	int size = MidiUtilString_getSize(string);
+	MidiUtilByteArray_set(string->byte_array, size, value);
+	MidiUtilByteArray_set(string->byte_array, size + 1, '\0');
 }
 
-void MidiUtilByteArray_add(MidiUtilByteArray_t array, unsigned char value)
+void MidiUtilString_addString(MidiUtilString_t string, unsigned char *value)
 {
-	MidiUtilByteArray_set(array, array->size, value);
+	MidiUtilByteArray_replaceValues(string->byte_array, MidiUtilString_getSize(string), value, strlen((char *)(value)) + 1);
 }
 
-void MidiUtilByteArray_insert(MidiUtilByteArray_t array, int element_number, unsigned char value)
+MidiUtilBlobArray_t MidiUtilBlobArray_new(int initial_element_capacity, int initial_byte_capacity)
 {
-	MidiUtilByteArray_setSize(array, array->size + 1);
-	memmove(array->buffer + element_number + 1, array->buffer + element_number, array->size - element_number + 1);
-	array->buffer[element_number] = value;
+	MidiUtilBlobArray_t array = (MidiUtilBlobArray_t)(malloc(sizeof (struct MidiUtilBlobArray)));
+	array->offset_array = MidiUtilIntArray_new(initial_element_capacity);
+	array->size_array = MidiUtilIntArray_new(initial_element_capacity);
+	array->data = MidiUtilByteArray_new(initial_byte_capacity);
+	return array;
 }
 
-void MidiUtilByteArray_remove(MidiUtilByteArray_t array, int element_number)
+void MidiUtilBlobArray_free(MidiUtilBlobArray_t array)
 {
-	memmove(array->buffer + element_number, array->buffer + element_number + 1, array->size - element_number - 1);
-	MidiUtilByteArray_setSize(array, array->size - 1);
+	MidiUtilByteArray_free(array->data);
+	MidiUtilIntArray_free(array->size_array);
+	MidiUtilIntArray_free(array->offset_array);
+	free(array);
 }
 
-void MidiUtilByteArray_setValues(MidiUtilByteArray_t array, unsigned char *values, int number_of_values)
+void MidiUtilBlobArray_clear(MidiUtilBlobArray_t array)
 {
-	MidiUtilByteArray_setSize(array, number_of_values);
-	memcpy(array->buffer, values, number_of_values);
+	MidiUtilIntArray_clear(array->offset_array);
+	MidiUtilIntArray_clear(array->size_array);
+	MidiUtilByteArray_clear(array->data);
 }
 
-void MidiUtilByteArray_addValues(MidiUtilByteArray_t array, unsigned char *values, int number_of_values)
+int MidiUtilBlobArray_getSize(MidiUtilBlobArray_t array)
 {
-	int offset = array->size;
-	MidiUtilByteArray_setSize(array, offset + number_of_values);
-	memcpy(array->buffer + offset, values, number_of_values);
+	return MidiUtilIntArray_getSize(array->offset_array);
 }
 
-void MidiUtilByteArray_replaceValues(MidiUtilByteArray_t array, int element_number, unsigned char *values, int number_of_values)
+unsigned char *MidiUtilBlobArray_getValue(MidiUtilBlobArray_t array, int element_number)
 {
-	if (element_number + number_of_values > array->size) MidiUtilByteArray_setSize(array, element_number + number_of_values);
-	memcpy(array->buffer + element_number, values, number_of_values);
+	return MidiUtilByteArray_getBuffer(array->data) + MidiUtilIntArray_get(array->offset_array, element_number);
 }
 
-void MidiUtilByteArray_insertValues(MidiUtilByteArray_t array, int element_number, unsigned char *values, int number_of_values)
+int MidiUtilBlobArray_getValueSize(MidiUtilBlobArray_t array, int element_number)
 {
-	MidiUtilByteArray_setSize(array, array->size + number_of_values);
-	memmove(array->buffer + element_number + number_of_values, array->buffer + element_number, array->size - element_number + number_of_values);
-	memcpy(array->buffer + element_number, values, number_of_values);
+	return MidiUtilIntArray_get(array->size_array, element_number);
 }
 
-void MidiUtilByteArray_removeValues(MidiUtilByteArray_t array, int element_number, int number_of_values)
+void MidiUtilBlobArray_set(MidiUtilBlobArray_t array, int element_number, unsigned char *value, int value_size)
 {
-	memmove(array->buffer + element_number, array->buffer + element_number + number_of_values, array->size - element_number - number_of_values);
-	MidiUtilByteArray_setSize(array, array->size - number_of_values);
-}
+	int size = MidiUtilBlobArray_getSize(array);
+	int offset;
 
-MidiUtilIntArray_t MidiUtilIntArray_new(int initial_capacity)
-{
-	MidiUtilIntArray_t array = (MidiUtilIntArray_t)(malloc(sizeof (struct MidiUtilIntArray)));
-	array->byte_array = MidiUtilByteArray_new(initial_capacity * sizeof (int));
-	return array;
-}
+	if ((element_number < size) && (value_size <= MidiUtilIntArray_get(array->size_array, element_number)))
+	{
+		offset = MidiUtilIntArray_get(array->offset_array, element_number);
+	}
+	else
+	{
+		if (size == 0)
+		{
+			offset = 0;
+		}
+		else
+		{
+			offset = MidiUtilIntArray_get(array->offset_array, size - 1) + MidiUtilIntArray_get(array->size_array, size - 1);
+		}
 
-void MidiUtilIntArray_free(MidiUtilIntArray_t array)
-{
-	MidiUtilByteArray_free(array->byte_array);
-	free(array);
-}
+		MidiUtilIntArray_set(array->offset_array, element_number, offset);
+		MidiUtilByteArray_setSize(array->data, offset + value_size);
+	}
 
-void MidiUtilIntArray_clear(MidiUtilIntArray_t array)
-{
-	MidiUtilByteArray_clear(array->byte_array);
+	MidiUtilIntArray_set(array->size_array, element_number, value_size);
+	if (value_size > 0) memcpy(MidiUtilByteArray_getBuffer(array->data) + offset, value, value_size);
 }
 
-int MidiUtilIntArray_getCapacity(MidiUtilIntArray_t array)
+void MidiUtilBlobArray_add(MidiUtilBlobArray_t array, unsigned char *value, int value_size)
 {
-	return MidiUtilByteArray_getCapacity(array->byte_array) / sizeof (int);
+	MidiUtilBlobArray_set(array, MidiUtilBlobArray_getSize(array), value, value_size);
 }
 
-void MidiUtilIntArray_setCapacity(MidiUtilIntArray_t array, int capacity)
+void MidiUtilBlobArray_insert(MidiUtilBlobArray_t array, int element_number, unsigned char *value, int value_size)
 {
-	MidiUtilByteArray_setCapacity(array->byte_array, capacity * sizeof (int));
-}
+	int size = MidiUtilBlobArray_getSize(array);
+	int offset = MidiUtilIntArray_get(array->offset_array, size - 1) + MidiUtilIntArray_get(array->size_array, size - 1);
 
-int MidiUtilIntArray_getSize(MidiUtilIntArray_t array)
-{
-	return MidiUtilByteArray_getSize(array->byte_array) / sizeof (int);
-}
+	if (value_size > 0)
+	{
+		MidiUtilByteArray_setSize(array->data, offset + value_size);
+		memcpy(MidiUtilByteArray_getBuffer(array->data) + offset, value, value_size);
+	}
 
-void MidiUtilIntArray_setSize(MidiUtilIntArray_t array, int size)
-{
-	MidiUtilByteArray_setSize(array->byte_array, size * sizeof (int));
+	MidiUtilIntArray_insert(array->offset_array, element_number, offset);
+	MidiUtilIntArray_insert(array->size_array, element_number, value_size);
 }
 
-int *MidiUtilIntArray_getBuffer(MidiUtilIntArray_t array)
+void MidiUtilBlobArray_remove(MidiUtilBlobArray_t array, int element_number)
 {
-	return (int *)(MidiUtilByteArray_getBuffer(array->byte_array));
+	MidiUtilBlobArray_set(array, element_number, NULL, 0);
 }
 
-int MidiUtilIntArray_get(MidiUtilIntArray_t array, int element_number)
+MidiUtilStringArray_t MidiUtilStringArray_new(int initial_element_capacity, int initial_byte_capacity)
 {
-	return MidiUtilIntArray_getBuffer(array)[element_number];
+	MidiUtilStringArray_t array = (MidiUtilStringArray_t)(malloc(sizeof (struct MidiUtilStringArray)));
+	array->blob_array = MidiUtilBlobArray_new(initial_element_capacity, initial_byte_capacity);
+	return array;
 }
 
-void MidiUtilIntArray_set(MidiUtilIntArray_t array, int element_number, int value)
+void MidiUtilStringArray_free(MidiUtilStringArray_t array)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (int), (unsigned char *)(&value), sizeof (int));
+	MidiUtilBlobArray_free(array->blob_array);
+	free(array);
 }
 
-void MidiUtilIntArray_add(MidiUtilIntArray_t array, int value)
+void MidiUtilStringArray_clear(MidiUtilStringArray_t array)
 {
-	MidiUtilIntArray_set(array, MidiUtilIntArray_getSize(array), value);
+	MidiUtilBlobArray_clear(array->blob_array);
 }
 
-void MidiUtilIntArray_insert(MidiUtilIntArray_t array, int element_number, int value)
+int MidiUtilStringArray_getSize(MidiUtilStringArray_t array)
 {
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (int), (unsigned char *)(&value), sizeof (int));
+	return MidiUtilBlobArray_getSize(array->blob_array);
 }
 
-void MidiUtilIntArray_remove(MidiUtilIntArray_t array, int element_number)
+unsigned char *MidiUtilStringArray_get(MidiUtilStringArray_t array, int element_number)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (int), sizeof (int));
+	return MidiUtilBlobArray_getValue(array->blob_array, element_number);
 }
 
-void MidiUtilIntArray_setValues(MidiUtilIntArray_t array, int *values, int number_of_values)
+void MidiUtilStringArray_set(MidiUtilStringArray_t array, int element_number, unsigned char *value)
 {
-	MidiUtilByteArray_setValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (int));
+	MidiUtilBlobArray_set(array->blob_array, element_number, value, strlen((char *)(value)) + 1);
 }
 
-void MidiUtilIntArray_addValues(MidiUtilIntArray_t array, int *values, int number_of_values)
+void MidiUtilStringArray_add(MidiUtilStringArray_t array, unsigned char *value)
 {
-	MidiUtilByteArray_addValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (int));
+	MidiUtilBlobArray_add(array->blob_array, value, strlen((char *)(value)) + 1);
 }
 
-void MidiUtilIntArray_replaceValues(MidiUtilIntArray_t array, int element_number, int *values, int number_of_values)
+void MidiUtilStringArray_insert(MidiUtilStringArray_t array, int element_number, unsigned char *value)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (int), (unsigned char *)(values), number_of_values * sizeof (int));
+	MidiUtilBlobArray_insert(array->blob_array, element_number, value, strlen((char *)(value)) + 1);
 }
 
-void MidiUtilIntArray_insertValues(MidiUtilIntArray_t array, int element_number, int *values, int number_of_values)
+void MidiUtilStringArray_remove(MidiUtilStringArray_t array, int element_number)
 {
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (int), (unsigned char *)(values), number_of_values * sizeof (int));
+	MidiUtilBlobArray_remove(array->blob_array, element_number);
 }
 
-void MidiUtilIntArray_removeValues(MidiUtilIntArray_t array, int element_number, int number_of_values)
+static unsigned int get_hash_of_integer(unsigned long long key)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (int), number_of_values * sizeof (int));
+	/* The splitmix64 finalizer, so that keys which differ only in their high bits, like aligned pointers, still spread over the low bits that pick a slot. */
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return (unsigned int)(key ^ (key >> 32));
 }
 
-MidiUtilLongArray_t MidiUtilLongArray_new(int initial_capacity)
+static unsigned int get_hash_of_bytes(unsigned char *key, int key_size)
 {
-	MidiUtilLongArray_t array = (MidiUtilLongArray_t)(malloc(sizeof (struct MidiUtilLongArray)));
-	array->byte_array = MidiUtilByteArray_new(initial_capacity * sizeof (long));
-	return array;
-}
+	/* FNV-1a, finished with the murmur3 mixer because FNV alone leaves the low bits weak for short keys. */
+	unsigned int hash = 2166136261U;
+	int i;
 
-void MidiUtilLongArray_free(MidiUtilLongArray_t array)
-{
-	MidiUtilByteArray_free(array->byte_array);
-	free(array);
-}
+	for (i = 0; i < key_size; i++)
+	{
+		hash ^= key[i];
+		hash *= 16777619U;
+	}
 
-void MidiUtilLongArray_clear(MidiUtilLongArray_t array)
-{
-	MidiUtilByteArray_clear(array->byte_array);
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+	return hash;
 }
 
-int MidiUtilLongArray_getCapacity(MidiUtilLongArray_t array)
+static unsigned int get_hash_map_key_hash(struct MidiUtilHashMap *hash_map, void *key, int key_size)
 {
-	return MidiUtilByteArray_getCapacity(array->byte_array) / sizeof (long);
-}
+	unsigned int hash;
 
-void MidiUtilLongArray_setCapacity(MidiUtilLongArray_t array, int capacity)
-{
-	MidiUtilByteArray_setCapacity(array->byte_array, capacity * sizeof (long));
-}
+	switch (hash_map->key_type)
+	{
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_INT:
+		{
+			hash = get_hash_of_integer((unsigned long long)(*((int *)(key))));
+			break;
+		}
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_LONG:
+		{
+			hash = get_hash_of_integer((unsigned long long)(*((long *)(key))));
+			break;
+		}
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_POINTER:
+		{
+			hash = get_hash_of_integer((unsigned long long)((size_t)(*((void **)(key)))));
+			break;
+		}
+		default:
+		{
+			hash = get_hash_of_bytes((unsigned char *)(key), key_size);
+			break;
+		}
+	}
 
-int MidiUtilLongArray_getSize(MidiUtilLongArray_t array)
-{
-	return MidiUtilByteArray_getSize(array->byte_array) / sizeof (long);
+	/* Zero marks an empty slot. */
+	return (hash == 0) ? 1 : hash;
 }
 
-void MidiUtilLongArray_setSize(MidiUtilLongArray_t array, int size)
+static int hash_map_slot_has_key(struct MidiUtilHashMap *hash_map, struct MidiUtilHashMapSlot *slot, void *key, int key_size)
 {
-	MidiUtilByteArray_setSize(array->byte_array, size * sizeof (long));
+	switch (hash_map->key_type)
+	{
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_INT:
+		{
+			return (slot->key.int_key == *((int *)(key)));
+		}
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_LONG:
+		{
+			return (slot->key.long_key == *((long *)(key)));
+		}
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_POINTER:
+		{
+			return (slot->key.pointer_key == *((void **)(key)));
+		}
+		default:
+		{
+			return ((slot->key_size == key_size) && (memcmp(slot->key.blob_key, key, key_size) == 0));
+		}
+	}
 }
 
-long *MidiUtilLongArray_getBuffer(MidiUtilLongArray_t array)
+static int get_hash_map_probe_distance(struct MidiUtilHashMap *hash_map, int slot_number, unsigned int hash)
 {
-	return (long *)(MidiUtilByteArray_getBuffer(array->byte_array));
+	return (slot_number - (int)(hash & (unsigned int)(hash_map->capacity - 1))) & (hash_map->capacity - 1);
 }
 
-long MidiUtilLongArray_get(MidiUtilLongArray_t array, int element_number)
+static void init_hash_map(struct MidiUtilHashMap *hash_map, MidiUtilHashMapKeyType_t key_type, int initial_capacity)
 {
-	return MidiUtilLongArray_getBuffer(array)[element_number];
+	hash_map->key_type = key_type;
+	hash_map->capacity = 8;
+	while ((hash_map->capacity / 8) * 7 < initial_capacity) hash_map->capacity *= 2;
+	hash_map->size = 0;
+	hash_map->slots = (struct MidiUtilHashMapSlot *)(calloc(hash_map->capacity, sizeof (struct MidiUtilHashMapSlot)));
+	hash_map->free_callback = NULL;
+	hash_map->free_callback_user_data = NULL;
 }
 
-void MidiUtilLongArray_set(MidiUtilLongArray_t array, int element_number, long value)
+static void release_hash_map_slot(struct MidiUtilHashMap *hash_map, struct MidiUtilHashMapSlot *slot)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (long), (unsigned char *)(&value), sizeof (long));
+	if (hash_map->key_type == MIDI_UTIL_HASH_MAP_KEY_TYPE_BLOB) free(slot->key.blob_key);
+	if (hash_map->free_callback != NULL) (*(hash_map->free_callback))(slot->value.pointer_value, hash_map->free_callback_user_data);
 }
 
-void MidiUtilLongArray_add(MidiUtilLongArray_t array, long value)
+static void clear_hash_map(struct MidiUtilHashMap *hash_map)
 {
-	MidiUtilLongArray_set(array, MidiUtilLongArray_getSize(array), value);
-}
+	int slot_number;
 
-void MidiUtilLongArray_insert(MidiUtilLongArray_t array, int element_number, long value)
-{
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (long), (unsigned char *)(&value), sizeof (long));
-}
+	for (slot_number = 0; slot_number < hash_map->capacity; slot_number++)
+	{
+		if (hash_map->slots[slot_number].hash != 0)
+		{
+			release_hash_map_slot(hash_map, &(hash_map->slots[slot_number]));
+			hash_map->slots[slot_number].hash = 0;
+		}
+	}
 
-void MidiUtilLongArray_remove(MidiUtilLongArray_t array, int element_number)
-{
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (long), sizeof (long));
+	hash_map->size = 0;
 }
 
-void MidiUtilLongArray_setValues(MidiUtilLongArray_t array, long *values, int number_of_values)
+static struct MidiUtilHashMapSlot *find_hash_map_slot(struct MidiUtilHashMap *hash_map, void *key, int key_size)
 {
-	MidiUtilByteArray_setValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (long));
-}
+	unsigned int hash = get_hash_map_key_hash(hash_map, key, key_size);
+	int mask = hash_map->capacity - 1;
+	int slot_number = (int)(hash & (unsigned int)(mask));
+	int distance;
 
-void MidiUtilLongArray_addValues(MidiUtilLongArray_t array, long *values, int number_of_values)
-{
-	MidiUtilByteArray_addValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (long));
+	/* Robin Hood order means that once we pass a slot whose entry is closer to home than we are, the key cannot be further along. */
+	for (distance = 0; ; distance++)
+	{
+		struct MidiUtilHashMapSlot *slot = &(hash_map->slots[slot_number]);
+		if ((slot->hash == 0) || (get_hash_map_probe_distance(hash_map, slot_number, slot->hash) < distance)) return NULL;
+		if ((slot->hash == hash) && hash_map_slot_has_key(hash_map, slot, key, key_size)) return slot;
+		slot_number = (slot_number + 1) & mask;
+	}
 }
 
-void MidiUtilLongArray_replaceValues(MidiUtilLongArray_t array, int element_number, long *values, int number_of_values)
+static struct MidiUtilHashMapSlot *insert_hash_map_slot(struct MidiUtilHashMap *hash_map, struct MidiUtilHashMapSlot *new_slot)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (long), (unsigned char *)(values), number_of_values * sizeof (long));
-}
+	/* Takes the place of any entry that is closer to its home slot, and carries that one on instead.  Returns where new_slot ended up. */
+	struct MidiUtilHashMapSlot carried_slot = *new_slot;
+	struct MidiUtilHashMapSlot *result = NULL;
+	int mask = hash_map->capacity - 1;
+	int slot_number = (int)(carried_slot.hash & (unsigned int)(mask));
+	int distance = 0;
 
-void MidiUtilLongArray_insertValues(MidiUtilLongArray_t array, int element_number, long *values, int number_of_values)
-{
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (long), (unsigned char *)(values), number_of_values * sizeof (long));
-}
+	while (1)
+	{
+		struct MidiUtilHashMapSlot *slot = &(hash_map->slots[slot_number]);
 
-void MidiUtilLongArray_removeValues(MidiUtilLongArray_t array, int element_number, int number_of_values)
+		if (slot->hash == 0)
+		{
+			*slot = carried_slot;
+			return (result == NULL) ? slot : result;
+		}
+		else
+		{
+			int slot_distance = get_hash_map_probe_distance(hash_map, slot_number, slot->hash);
+
+			if (slot_distance < distance)
+			{
+				struct MidiUtilHashMapSlot swapped_slot = *slot;
+				*slot = carried_slot;
+				carried_slot = swapped_slot;
+				distance = slot_distance;
+				if (result == NULL) result = slot;
+			}
+		}
+
+		slot_number = (slot_number + 1) & mask;
+		distance++;
+	}
+}
+
+static struct MidiUtilHashMapSlot *add_hash_map_slot(struct MidiUtilHashMap *hash_map, void *key, int key_size, int *is_new)
+{
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(hash_map, key, key_size);
+	struct MidiUtilHashMapSlot new_slot;
+
+	if (slot != NULL)
+	{
+		*is_new = 0;
+		return slot;
+	}
+
+	/* Grow at seven eighths full, which Robin Hood probing keeps short even at that load. */
+	if ((hash_map->size + 1) > (hash_map->capacity / 8) * 7)
+	{
+		struct MidiUtilHashMapSlot *old_slots = hash_map->slots;
+		int old_capacity = hash_map->capacity;
+		int slot_number;
+
+		hash_map->capacity *= 2;
+		hash_map->slots = (struct MidiUtilHashMapSlot *)(calloc(hash_map->capacity, sizeof (struct MidiUtilHashMapSlot)));
+
+		for (slot_number = 0; slot_number < old_capacity; slot_number++)
+		{
+			if (old_slots[slot_number].hash != 0) insert_hash_map_slot(hash_map, &(old_slots[slot_number]));
+		}
+
+		free(old_slots);
+	}
+
+	new_slot.hash = get_hash_map_key_hash(hash_map, key, key_size);
+	new_slot.key_size = key_size;
+
+	switch (hash_map->key_type)
+	{
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_INT:
+		{
+			new_slot.key.int_key = *((int *)(key));
+			break;
+		}
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_LONG:
+		{
+			new_slot.key.long_key = *((long *)(key));
+			break;
+		}
+		case MIDI_UTIL_HASH_MAP_KEY_TYPE_POINTER:
+		{
+			new_slot.key.pointer_key = *((void **)(key));
+			break;
+		}
+		default:
+		{
+			new_slot.key.blob_key = (unsigned char *)(malloc(key_size));
+			memcpy(new_slot.key.blob_key, key, key_size);
+			break;
+		}
+	}
+
+	new_slot.value.pointer_value = NULL;
+	hash_map->size++;
+	*is_new = 1;
+	return insert_hash_map_slot(hash_map, &new_slot);
+}
+
+static void remove_hash_map_slot(struct MidiUtilHashMap *hash_map, void *key, int key_size)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (long), number_of_values * sizeof (long));
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(hash_map, key, key_size);
+	int mask = hash_map->capacity - 1;
+	int slot_number, next_slot_number;
+
+	if (slot == NULL) return;
+	release_hash_map_slot(hash_map, slot);
+	hash_map->size--;
+
+	/* Shift the rest of the run back by one instead of leaving a tombstone, so lookups never have to skip over deleted slots. */
+	slot_number = (int)(slot - hash_map->slots);
+	next_slot_number = (slot_number + 1) & mask;
+
+	while ((hash_map->slots[next_slot_number].hash != 0) && (get_hash_map_probe_distance(hash_map, next_slot_number, hash_map->slots[next_slot_number].hash) > 0))
+	{
+		hash_map->slots[slot_number] = hash_map->slots[next_slot_number];
+		slot_number = next_slot_number;
+		next_slot_number = (next_slot_number + 1) & mask;
+	}
+
+	hash_map->slots[slot_number].hash = 0;
 }
 
-MidiUtilFloatArray_t MidiUtilFloatArray_new(int initial_capacity)
+static struct MidiUtilHashMapSlot *get_next_hash_map_slot(struct MidiUtilHashMap *hash_map, int *position)
 {
-	MidiUtilFloatArray_t array = (MidiUtilFloatArray_t)(malloc(sizeof (struct MidiUtilFloatArray)));
-	array->byte_array = MidiUtilByteArray_new(initial_capacity * sizeof (float));
-	return array;
+	while (*position < hash_map->capacity)
+	{
+		struct MidiUtilHashMapSlot *slot = &(hash_map->slots[(*position)++]);
+		if (slot->hash != 0) return slot;
+	}
+
+	return NULL;
 }
 
-void MidiUtilFloatArray_free(MidiUtilFloatArray_t array)
+MidiUtilIntIntMap_t MidiUtilIntIntMap_new(int initial_capacity)
 {
-	MidiUtilByteArray_free(array->byte_array);
-	free(array);
+	MidiUtilIntIntMap_t map = (MidiUtilIntIntMap_t)(malloc(sizeof (struct MidiUtilIntIntMap)));
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_INT, initial_capacity);
+	return map;
 }
 
-void MidiUtilFloatArray_clear(MidiUtilFloatArray_t array)
+void MidiUtilIntIntMap_free(MidiUtilIntIntMap_t map)
 {
-	MidiUtilByteArray_clear(array->byte_array);
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
+	free(map);
 }
 
-int MidiUtilFloatArray_getCapacity(MidiUtilFloatArray_t array)
+void MidiUtilIntIntMap_clear(MidiUtilIntIntMap_t map)
 {
-	return MidiUtilByteArray_getCapacity(array->byte_array) / sizeof (float);
+	clear_hash_map(&(map->hash_map));
 }
 
-void MidiUtilFloatArray_setCapacity(MidiUtilFloatArray_t array, int capacity)
+int MidiUtilIntIntMap_getSize(MidiUtilIntIntMap_t map)
 {
-	MidiUtilByteArray_setCapacity(array->byte_array, capacity * sizeof (float));
+	return map->hash_map.size;
 }
 
-int MidiUtilFloatArray_getSize(MidiUtilFloatArray_t array)
+int MidiUtilIntIntMap_hasKey(MidiUtilIntIntMap_t map, int key)
 {
-	return MidiUtilByteArray_getSize(array->byte_array) / sizeof (float);
+	return (find_hash_map_slot(&(map->hash_map), &key, 0) != NULL);
 }
 
-void MidiUtilFloatArray_setSize(MidiUtilFloatArray_t array, int size)
+int MidiUtilIntIntMap_get(MidiUtilIntIntMap_t map, int key, int default_value)
 {
-	MidiUtilByteArray_setSize(array->byte_array, size * sizeof (float));
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), &key, 0);
+	return (slot == NULL) ? default_value : slot->value.int_value;
 }
 
-float *MidiUtilFloatArray_getBuffer(MidiUtilFloatArray_t array)
+void MidiUtilIntIntMap_set(MidiUtilIntIntMap_t map, int key, int value)
 {
-	return (float *)(MidiUtilByteArray_getBuffer(array->byte_array));
+	int is_new;
+	add_hash_map_slot(&(map->hash_map), &key, 0, &is_new)->value.int_value = value;
 }
 
-float MidiUtilFloatArray_get(MidiUtilFloatArray_t array, int element_number)
+void MidiUtilIntIntMap_remove(MidiUtilIntIntMap_t map, int key)
 {
-	return MidiUtilFloatArray_getBuffer(array)[element_number];
+	remove_hash_map_slot(&(map->hash_map), &key, 0);
 }
 
-void MidiUtilFloatArray_set(MidiUtilFloatArray_t array, int element_number, float value)
+void MidiUtilIntIntMap_enumerate(MidiUtilIntIntMap_t map, int (*callback)(int key, int value, void *user_data), void *user_data)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (float), (unsigned char *)(&value), sizeof (float));
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
+
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
+	{
+		if ((*callback)(slot->key.int_key, slot->value.int_value, user_data)) break;
+	}
 }
 
-void MidiUtilFloatArray_add(MidiUtilFloatArray_t array, float value)
+int MidiUtilIntIntMap_getNext(MidiUtilIntIntMap_t map, int *position, int *key, int *value)
 {
-	MidiUtilFloatArray_set(array, MidiUtilFloatArray_getSize(array), value);
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.int_key;
+		if (value != NULL) *value = slot->value.int_value;
+		return 1;
+	}
 }
 
-void MidiUtilFloatArray_insert(MidiUtilFloatArray_t array, int element_number, float value)
+MidiUtilIntPointerMap_t MidiUtilIntPointerMap_new(int initial_capacity)
 {
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (float), (unsigned char *)(&value), sizeof (float));
+	MidiUtilIntPointerMap_t map = (MidiUtilIntPointerMap_t)(malloc(sizeof (struct MidiUtilIntPointerMap)));
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_INT, initial_capacity);
+	return map;
 }
 
-void MidiUtilFloatArray_remove(MidiUtilFloatArray_t array, int element_number)
+void MidiUtilIntPointerMap_setFreeCallback(MidiUtilIntPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (float), sizeof (float));
+	map->hash_map.free_callback = callback;
+	map->hash_map.free_callback_user_data = user_data;
 }
 
-void MidiUtilFloatArray_setValues(MidiUtilFloatArray_t array, float *values, int number_of_values)
+void MidiUtilIntPointerMap_free(MidiUtilIntPointerMap_t map)
 {
-	MidiUtilByteArray_setValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (float));
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
+	free(map);
 }
 
-void MidiUtilFloatArray_addValues(MidiUtilFloatArray_t array, float *values, int number_of_values)
+void MidiUtilIntPointerMap_clear(MidiUtilIntPointerMap_t map)
 {
-	MidiUtilByteArray_addValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (float));
+	clear_hash_map(&(map->hash_map));
 }
 
-void MidiUtilFloatArray_replaceValues(MidiUtilFloatArray_t array, int element_number, float *values, int number_of_values)
+int MidiUtilIntPointerMap_getSize(MidiUtilIntPointerMap_t map)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (float), (unsigned char *)(values), number_of_values * sizeof (float));
+	return map->hash_map.size;
 }
 
-void MidiUtilFloatArray_insertValues(MidiUtilFloatArray_t array, int element_number, float *values, int number_of_values)
+int MidiUtilIntPointerMap_hasKey(MidiUtilIntPointerMap_t map, int key)
 {
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (float), (unsigned char *)(values), number_of_values * sizeof (float));
+	return (find_hash_map_slot(&(map->hash_map), &key, 0) != NULL);
 }
 
-void MidiUtilFloatArray_removeValues(MidiUtilFloatArray_t array, int element_number, int number_of_values)
+void *MidiUtilIntPointerMap_get(MidiUtilIntPointerMap_t map, int key)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (float), number_of_values * sizeof (float));
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), &key, 0);
+	return (slot == NULL) ? NULL : slot->value.pointer_value;
 }
 
-MidiUtilDoubleArray_t MidiUtilDoubleArray_new(int initial_capacity)
+void MidiUtilIntPointerMap_set(MidiUtilIntPointerMap_t map, int key, void *value)
 {
-	MidiUtilDoubleArray_t array = (MidiUtilDoubleArray_t)(malloc(sizeof (struct MidiUtilDoubleArray)));
-	array->byte_array = MidiUtilByteArray_new(initial_capacity * sizeof (double));
-	return array;
+	int is_new;
+	struct MidiUtilHashMapSlot *slot = add_hash_map_slot(&(map->hash_map), &key, 0, &is_new);
+	if ((!is_new) && (map->hash_map.free_callback != NULL)) (*(map->hash_map.free_callback))(slot->value.pointer_value, map->hash_map.free_callback_user_data);
+	slot->value.pointer_value = value;
 }
 
-void MidiUtilDoubleArray_free(MidiUtilDoubleArray_t array)
+void MidiUtilIntPointerMap_remove(MidiUtilIntPointerMap_t map, int key)
 {
-	MidiUtilByteArray_free(array->byte_array);
-	free(array);
+	remove_hash_map_slot(&(map->hash_map), &key, 0);
 }
 
-void MidiUtilDoubleArray_clear(MidiUtilDoubleArray_t array)
+void MidiUtilIntPointerMap_enumerate(MidiUtilIntPointerMap_t map, int (*callback)(int key, void *value, void *user_data), void *user_data)
 {
-	MidiUtilByteArray_clear(array->byte_array);
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
+
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
+	{
+		if ((*callback)(slot->key.int_key, slot->value.pointer_value, user_data)) break;
+	}
 }
 
-int MidiUtilDoubleArray_getCapacity(MidiUtilDoubleArray_t array)
+int MidiUtilIntPointerMap_getNext(MidiUtilIntPointerMap_t map, int *position, int *key, void **value)
 {
-	return MidiUtilByteArray_getCapacity(array->byte_array) / sizeof (double);
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.int_key;
+		if (value != NULL) *value = slot->value.pointer_value;
+		return 1;
+	}
 }
 
-void MidiUtilDoubleArray_setCapacity(MidiUtilDoubleArray_t array, int capacity)
+MidiUtilLongIntMap_t MidiUtilLongIntMap_new(int initial_capacity)
 {
-	MidiUtilByteArray_setCapacity(array->byte_array, capacity * sizeof (double));
+	MidiUtilLongIntMap_t map = (MidiUtilLongIntMap_t)(malloc(sizeof (struct MidiUtilLongIntMap)));
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_LONG, initial_capacity);
+	return map;
 }
 
-int MidiUtilDoubleArray_getSize(MidiUtilDoubleArray_t array)
+void MidiUtilLongIntMap_free(MidiUtilLongIntMap_t map)
 {
-	return MidiUtilByteArray_getSize(array->byte_array) / sizeof (double);
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
+	free(map);
 }
 
-void MidiUtilDoubleArray_setSize(MidiUtilDoubleArray_t array, int size)
+void MidiUtilLongIntMap_clear(MidiUtilLongIntMap_t map)
 {
-	MidiUtilByteArray_setSize(array->byte_array, size * sizeof (double));
+	clear_hash_map(&(map->hash_map));
 }
 
-double *MidiUtilDoubleArray_getBuffer(MidiUtilDoubleArray_t array)
+int MidiUtilLongIntMap_getSize(MidiUtilLongIntMap_t map)
 {
-	return (double *)(MidiUtilByteArray_getBuffer(array->byte_array));
+	return map->hash_map.size;
 }
 
-double MidiUtilDoubleArray_get(MidiUtilDoubleArray_t array, int element_number)
+int MidiUtilLongIntMap_hasKey(MidiUtilLongIntMap_t map, long key)
 {
-	return MidiUtilDoubleArray_getBuffer(array)[element_number];
+	return (find_hash_map_slot(&(map->hash_map), &key, 0) != NULL);
 }
 
-void MidiUtilDoubleArray_set(MidiUtilDoubleArray_t array, int element_number, double value)
+int MidiUtilLongIntMap_get(MidiUtilLongIntMap_t map, long key, int default_value)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (double), (unsigned char *)(&value), sizeof (double));
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), &key, 0);
+	return (slot == NULL) ? default_value : slot->value.int_value;
 }
 
-void MidiUtilDoubleArray_add(MidiUtilDoubleArray_t array, double value)
+void MidiUtilLongIntMap_set(MidiUtilLongIntMap_t map, long key, int value)
 {
-	MidiUtilDoubleArray_set(array, MidiUtilDoubleArray_getSize(array), value);
+	int is_new;
+	add_hash_map_slot(&(map->hash_map), &key, 0, &is_new)->value.int_value = value;
 }
 
-void MidiUtilDoubleArray_insert(MidiUtilDoubleArray_t array, int element_number, double value)
+void MidiUtilLongIntMap_remove(MidiUtilLongIntMap_t map, long key)
 {
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (double), (unsigned char *)(&value), sizeof (double));
+	remove_hash_map_slot(&(map->hash_map), &key, 0);
 }
 
-void MidiUtilDoubleArray_remove(MidiUtilDoubleArray_t array, int element_number)
+void MidiUtilLongIntMap_enumerate(MidiUtilLongIntMap_t map, int (*callback)(long key, int value, void *user_data), void *user_data)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (double), sizeof (double));
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
+
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
+	{
+		if ((*callback)(slot->key.long_key, slot->value.int_value, user_data)) break;
+	}
 }
 
-void MidiUtilDoubleArray_setValues(MidiUtilDoubleArray_t array, double *values, int number_of_values)
+int MidiUtilLongIntMap_getNext(MidiUtilLongIntMap_t map, int *position, long *key, int *value)
 {
-	MidiUtilByteArray_setValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (double));
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.long_key;
+		if (value != NULL) *value = slot->value.int_value;
+		return 1;
+	}
 }
 
-void MidiUtilDoubleArray_addValues(MidiUtilDoubleArray_t array, double *values, int number_of_values)
+MidiUtilLongPointerMap_t MidiUtilLongPointerMap_new(int initial_capacity)
 {
-	MidiUtilByteArray_addValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (double));
+	MidiUtilLongPointerMap_t map = (MidiUtilLongPointerMap_t)(malloc(sizeof (struct MidiUtilLongPointerMap)));
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_LONG, initial_capacity);
+	return map;
 }
 
-void MidiUtilDoubleArray_replaceValues(MidiUtilDoubleArray_t array, int element_number, double *values, int number_of_values)
+void MidiUtilLongPointerMap_setFreeCallback(MidiUtilLongPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (double), (unsigned char *)(values), number_of_values * sizeof (double));
+	map->hash_map.free_callback = callback;
+	map->hash_map.free_callback_user_data = user_data;
 }
 
-void MidiUtilDoubleArray_insertValues(MidiUtilDoubleArray_t array, int element_number, double *values, int number_of_values)
+void MidiUtilLongPointerMap_free(MidiUtilLongPointerMap_t map)
 {
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (double), (unsigned char *)(values), number_of_values * sizeof (double));
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
+	free(map);
 }
 
-void MidiUtilDoubleArray_removeValues(MidiUtilDoubleArray_t array, int element_number, int number_of_values)
+void MidiUtilLongPointerMap_clear(MidiUtilLongPointerMap_t map)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (double), number_of_values * sizeof (double));
+	clear_hash_map(&(map->hash_map));
 }
 
-MidiUtilPointerArray_t MidiUtilPointerArray_new(int initial_capacity)
+int MidiUtilLongPointerMap_getSize(MidiUtilLongPointerMap_t map)
 {
-	MidiUtilPointerArray_t array = (MidiUtilPointerArray_t)(malloc(sizeof (struct MidiUtilPointerArray)));
-	array->byte_array = MidiUtilByteArray_new(initial_capacity * sizeof (void *));
-	return array;
+	return map->hash_map.size;
 }
 
-void MidiUtilPointerArray_free(MidiUtilPointerArray_t array)
+int MidiUtilLongPointerMap_hasKey(MidiUtilLongPointerMap_t map, long key)
 {
-	MidiUtilByteArray_free(array->byte_array);
-	free(array);
+	return (find_hash_map_slot(&(map->hash_map), &key, 0) != NULL);
 }
 
-void MidiUtilPointerArray_clear(MidiUtilPointerArray_t array)
+void *MidiUtilLongPointerMap_get(MidiUtilLongPointerMap_t map, long key)
 {
-	MidiUtilByteArray_clear(array->byte_array);
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), &key, 0);
+	return (slot == NULL) ? NULL : slot->value.pointer_value;
 }
 
-int MidiUtilPointerArray_getCapacity(MidiUtilPointerArray_t array)
+void MidiUtilLongPointerMap_set(MidiUtilLongPointerMap_t map, long key, void *value)
 {
-	return MidiUtilByteArray_getCapacity(array->byte_array) / sizeof (void *);
+	int is_new;
+	struct MidiUtilHashMapSlot *slot = add_hash_map_slot(&(map->hash_map), &key, 0, &is_new);
+	if ((!is_new) && (map->hash_map.free_callback != NULL)) (*(map->hash_map.free_callback))(slot->value.pointer_value, map->hash_map.free_callback_user_data);
+	slot->value.pointer_value = value;
 }
 
-void MidiUtilPointerArray_setCapacity(MidiUtilPointerArray_t array, int capacity)
+void MidiUtilLongPointerMap_remove(MidiUtilLongPointerMap_t map, long key)
 {
-	MidiUtilByteArray_setCapacity(array->byte_array, capacity * sizeof (void *));
+	remove_hash_map_slot(&(map->hash_map), &key, 0);
 }
 
-int MidiUtilPointerArray_getSize(MidiUtilPointerArray_t array)
+void MidiUtilLongPointerMap_enumerate(MidiUtilLongPointerMap_t map, int (*callback)(long key, void *value, void *user_data), void *user_data)
 {
-	return MidiUtilByteArray_getSize(array->byte_array) / sizeof (void *);
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
+
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
+	{
+		if ((*callback)(slot->key.long_key, slot->value.pointer_value, user_data)) break;
+	}
 }
 
-void MidiUtilPointerArray_setSize(MidiUtilPointerArray_t array, int size)
+int MidiUtilLongPointerMap_getNext(MidiUtilLongPointerMap_t map, int *position, long *key, void **value)
 {
-	MidiUtilByteArray_setSize(array->byte_array, size * sizeof (void *));
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.long_key;
+		if (value != NULL) *value = slot->value.pointer_value;
+		return 1;
+	}
 }
 
-void **MidiUtilPointerArray_getBuffer(MidiUtilPointerArray_t array)
+MidiUtilPointerIntMap_t MidiUtilPointerIntMap_new(int initial_capacity)
 {
-	return (void **)(MidiUtilByteArray_getBuffer(array->byte_array));
+	MidiUtilPointerIntMap_t map = (MidiUtilPointerIntMap_t)(malloc(sizeof (struct MidiUtilPointerIntMap)));
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_POINTER, initial_capacity);
+	return map;
 }
 
-void *MidiUtilPointerArray_get(MidiUtilPointerArray_t array, int element_number)
+void MidiUtilPointerIntMap_free(MidiUtilPointerIntMap_t map)
 {
-	return MidiUtilPointerArray_getBuffer(array)[element_number];
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
+	free(map);
 }
 
-void MidiUtilPointerArray_set(MidiUtilPointerArray_t array, int element_number, void *value)
+void MidiUtilPointerIntMap_clear(MidiUtilPointerIntMap_t map)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (void *), (unsigned char *)(&value), sizeof (void *));
+	clear_hash_map(&(map->hash_map));
 }
 
-void MidiUtilPointerArray_add(MidiUtilPointerArray_t array, void *value)
+int MidiUtilPointerIntMap_getSize(MidiUtilPointerIntMap_t map)
 {
-	MidiUtilPointerArray_set(array, MidiUtilPointerArray_getSize(array), value);
+	return map->hash_map.size;
 }
 
-void MidiUtilPointerArray_insert(MidiUtilPointerArray_t array, int element_number, void *value)
+int MidiUtilPointerIntMap_hasKey(MidiUtilPointerIntMap_t map, void *key)
 {
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (void *), (unsigned char *)(&value), sizeof (void *));
+	return (find_hash_map_slot(&(map->hash_map), &key, 0) != NULL);
 }
 
-void MidiUtilPointerArray_remove(MidiUtilPointerArray_t array, int element_number)
+int MidiUtilPointerIntMap_get(MidiUtilPointerIntMap_t map, void *key, int default_value)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (void *), sizeof (void *));
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), &key, 0);
+	return (slot == NULL) ? default_value : slot->value.int_value;
 }
 
-void MidiUtilPointerArray_setValues(MidiUtilPointerArray_t array, void **values, int number_of_values)
+void MidiUtilPointerIntMap_set(MidiUtilPointerIntMap_t map, void *key, int value)
 {
-	MidiUtilByteArray_setValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (void *));
+	int is_new;
+	add_hash_map_slot(&(map->hash_map), &key, 0, &is_new)->value.int_value = value;
 }
 
-void MidiUtilPointerArray_addValues(MidiUtilPointerArray_t array, void **values, int number_of_values)
+void MidiUtilPointerIntMap_remove(MidiUtilPointerIntMap_t map, void *key)
 {
-	MidiUtilByteArray_addValues(array->byte_array, (unsigned char *)(values), number_of_values * sizeof (void *));
+	remove_hash_map_slot(&(map->hash_map), &key, 0);
 }
 
-void MidiUtilPointerArray_replaceValues(MidiUtilPointerArray_t array, int element_number, void **values, int number_of_values)
+void MidiUtilPointerIntMap_enumerate(MidiUtilPointerIntMap_t map, int (*callback)(void *key, int value, void *user_data), void *user_data)
 {
-	MidiUtilByteArray_replaceValues(array->byte_array, element_number * sizeof (void *), (unsigned char *)(values), number_of_values * sizeof (void *));
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
+
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
+	{
+		if ((*callback)(slot->key.pointer_key, slot->value.int_value, user_data)) break;
+	}
 }
 
-void MidiUtilPointerArray_insertValues(MidiUtilPointerArray_t array, int element_number, void **values, int number_of_values)
+int MidiUtilPointerIntMap_getNext(MidiUtilPointerIntMap_t map, int *position, void **key, int *value)
 {
-	MidiUtilByteArray_insertValues(array->byte_array, element_number * sizeof (void *), (unsigned char *)(values), number_of_values * sizeof (void *));
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.pointer_key;
+		if (value != NULL) *value = slot->value.int_value;
+		return 1;
+	}
 }
 
-void MidiUtilPointerArray_removeValues(MidiUtilPointerArray_t array, int element_number, int number_of_values)
+MidiUtilPointerPointerMap_t MidiUtilPointerPointerMap_new(int initial_capacity)
 {
-	MidiUtilByteArray_removeValues(array->byte_array, element_number * sizeof (void *), number_of_values * sizeof (void *));
+	MidiUtilPointerPointerMap_t map = (MidiUtilPointerPointerMap_t)(malloc(sizeof (struct MidiUtilPointerPointerMap)));
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_POINTER, initial_capacity);
+	return map;
 }
 
-MidiUtilString_t MidiUtilString_new(int initial_capacity)
+void MidiUtilPointerPointerMap_setFreeCallback(MidiUtilPointerPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data)
 {
-	MidiUtilString_t string = (MidiUtilString_t)(malloc(sizeof (struct MidiUtilString)));
-	string->byte_array = MidiUtilByteArray_new(initial_capacity);
-	MidiUtilByteArray_set(string->byte_array, 0, '\0');
-	return string;
+	map->hash_map.free_callback = callback;
+	map->hash_map.free_callback_user_data = user_data;
 }
 
-void MidiUtilString_free(MidiUtilString_t string)
+void MidiUtilPointerPointerMap_free(MidiUtilPointerPointerMap_t map)
 {
-	MidiUtilByteArray_free(string->byte_array);
-	free(string);
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
+	free(map);
 }
 
-void MidiUtilString_clear(MidiUtilString_t string)
+void MidiUtilPointerPointerMap_clear(MidiUtilPointerPointerMap_t map)
 {
-	MidiUtilByteArray_clear(string->byte_array);
-	MidiUtilByteArray_set(string->byte_array, 0, '\0');
+	clear_hash_map(&(map->hash_map));
 }
 
-int MidiUtilString_getCapacity(MidiUtilString_t string)
+int MidiUtilPointerPointerMap_getSize(MidiUtilPointerPointerMap_t map)
 {
-	return MidiUtilByteArray_getCapacity(string->byte_array);
+	return map->hash_map.size;
 }
 
-void MidiUtilString_setCapacity(MidiUtilString_t string, int capacity)
+int MidiUtilPointerPointerMap_hasKey(MidiUtilPointerPointerMap_t map, void *key)
 {
-	MidiUtilByteArray_setCapacity(string->byte_array, capacity);
+	return (find_hash_map_slot(&(map->hash_map), &key, 0) != NULL);
 }
 
-int MidiUtilString_getSize(MidiUtilString_t string)
+void *MidiUtilPointerPointerMap_get(MidiUtilPointerPointerMap_t map, void *key)
 {
-	return MidiUtilByteArray_getSize(string->byte_array) - 1;
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), &key, 0);
+	return (slot == NULL) ? NULL : slot->value.pointer_value;
 }
 
-unsigned char *MidiUtilString_get(MidiUtilString_t string)
+void MidiUtilPointerPointerMap_set(MidiUtilPointerPointerMap_t map, void *key, void *value)
 {
-	return MidiUtilByteArray_getBuffer(string->byte_array);
+	int is_new;
+	struct MidiUtilHashMapSlot *slot = add_hash_map_slot(&(map->hash_map), &key, 0, &is_new);
+	if ((!is_new) && (map->hash_map.free_callback != NULL)) (*(map->hash_map.free_callback))(slot->value.pointer_value, map->hash_map.free_callback_user_data);
+	slot->value.pointer_value = value;
 }
 
-void MidiUtilString_set(MidiUtilString_t string, unsigned char *value)
+void MidiUtilPointerPointerMap_remove(MidiUtilPointerPointerMap_t map, void *key)
 {
-	MidiUtilByteArray_setValues(string->byte_array, value, strlen((char *)(value)) + 1);
+	remove_hash_map_slot(&(map->hash_map), &key, 0);
 }
 
-void MidiUtilString_addChar(MidiUtilString_t string, unsigned char value)
+void MidiUtilPointerPointerMap_enumerate(MidiUtilPointerPointerMap_t map, int (*callback)(void *key, void *value, void *user_data), void *user_data)
 {
-	int size = MidiUtilString_getSize(string);
-	MidiUtilByteArray_set(string->byte_array, size, value);
-	MidiUtilByteArray_set(string->byte_array, size + 1, '\0');
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
+
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
+	{
+		if ((*callback)(slot->key.pointer_key, slot->value.pointer_value, user_data)) break;
+	}
 }
 
-void MidiUtilString_addString(MidiUtilString_t string, unsigned char *value)
+int MidiUtilPointerPointerMap_getNext(MidiUtilPointerPointerMap_t map, int *position, void **key, void **value)
 {
-	MidiUtilByteArray_replaceValues(string->byte_array, MidiUtilString_getSize(string), value, strlen((char *)(value)) + 1);
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.pointer_key;
+		if (value != NULL) *value = slot->value.pointer_value;
+		return 1;
+	}
 }
 
-MidiUtilBlobArray_t MidiUtilBlobArray_new(int initial_element_capacity, int initial_byte_capacity)
+MidiUtilBlobIntMap_t MidiUtilBlobIntMap_new(int initial_capacity)
 {
-	MidiUtilBlobArray_t array = (MidiUtilBlobArray_t)(malloc(sizeof (struct MidiUtilBlobArray)));
-	array->offset_array = MidiUtilIntArray_new(initial_element_capacity);
-	array->size_array = MidiUtilIntArray_new(initial_element_capacity);
-	array->data = MidiUtilByteArray_new(initial_byte_capacity);
-	return array;
+	MidiUtilBlobIntMap_t map = (MidiUtilBlobIntMap_t)(malloc(sizeof (struct MidiUtilBlobIntMap)));
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_BLOB, initial_capacity);
+	return map;
 }
 
-void MidiUtilBlobArray_free(MidiUtilBlobArray_t array)
+void MidiUtilBlobIntMap_free(MidiUtilBlobIntMap_t map)
 {
-	MidiUtilByteArray_free(array->data);
-	MidiUtilIntArray_free(array->size_array);
-	MidiUtilIntArray_free(array->offset_array);
-	free(array);
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
+	free(map);
 }
 
-void MidiUtilBlobArray_clear(MidiUtilBlobArray_t array)
+void MidiUtilBlobIntMap_clear(MidiUtilBlobIntMap_t map)
 {
-	MidiUtilIntArray_clear(array->offset_array);
-	MidiUtilIntArray_clear(array->size_array);
-	MidiUtilByteArray_clear(array->data);
+	clear_hash_map(&(map->hash_map));
 }
 
-int MidiUtilBlobArray_getSize(MidiUtilBlobArray_t array)
+int MidiUtilBlobIntMap_getSize(MidiUtilBlobIntMap_t map)
 {
-	return MidiUtilIntArray_getSize(array->offset_array);
+	return map->hash_map.size;
 }
 
-unsigned char *MidiUtilBlobArray_getValue(MidiUtilBlobArray_t array, int element_number)
+int MidiUtilBlobIntMap_hasKey(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size)
 {
-	return MidiUtilByteArray_getBuffer(array->data) + MidiUtilIntArray_get(array->offset_array, element_number);
+	return (find_hash_map_slot(&(map->hash_map), key, key_size) != NULL);
 }
 
-int MidiUtilBlobArray_getValueSize(MidiUtilBlobArray_t array, int element_number)
+int MidiUtilBlobIntMap_get(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size, int default_value)
 {
-	return MidiUtilIntArray_get(array->size_array, element_number);
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), key, key_size);
+	return (slot == NULL) ? default_value : slot->value.int_value;
 }
 
-void MidiUtilBlobArray_set(MidiUtilBlobArray_t array, int element_number, unsigned char *value, int value_size)
+void MidiUtilBlobIntMap_set(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size, int value)
 {
-	int size = MidiUtilBlobArray_getSize(array);
-	int offset;
+	int is_new;
+	add_hash_map_slot(&(map->hash_map), key, key_size, &is_new)->value.int_value = value;
+}
 
-	if ((element_number < size) && (value_size <= MidiUtilIntArray_get(array->size_array, element_number)))
+void MidiUtilBlobIntMap_remove(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size)
+{
+	remove_hash_map_slot(&(map->hash_map), key, key_size);
+}
+
+void MidiUtilBlobIntMap_enumerate(MidiUtilBlobIntMap_t map, int (*callback)(unsigned char *key, int key_size, int value, void *user_data), void *user_data)
+{
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
+
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
 	{
-		offset = MidiUtilIntArray_get(array->offset_array, element_number);
+		if ((*callback)(slot->key.blob_key, slot->key_size, slot->value.int_value, user_data)) break;
 	}
-	else
-	{
-		if (size == 0)
-		{
-			offset = 0;
-		}
-		else
-		{
-			offset = MidiUtilIntArray_get(array->offset_array, size - 1) + MidiUtilIntArray_get(array->size_array, size - 1);
-		}
-
-		MidiUtilIntArray_set(array->offset_array, element_number, offset);
-		MidiUtilByteArray_setSize(array->data, offset + value_size);
-	}
-
-	MidiUtilIntArray_set(array->size_array, element_number, value_size);
-	if (value_size > 0) memcpy(MidiUtilByteArray_getBuffer(array->data) + offset, value, value_size);
-}
-
-void MidiUtilBlobArray_add(MidiUtilBlobArray_t array, unsigned char *value, int value_size)
-{
-	MidiUtilBlobArray_set(array, MidiUtilBlobArray_getSize(array), value, value_size);
-}
-
-void MidiUtilBlobArray_insert(MidiUtilBlobArray_t array, int element_number, unsigned char *value, int value_size)
-{
-	int size = MidiUtilBlobArray_getSize(array);
-	int offset = MidiUtilIntArray_get(array->offset_array, size - 1) + MidiUtilIntArray_get(array->size_array, size - 1);
-
-	if (value_size > 0)
-	{
-		MidiUtilByteArray_setSize(array->data, offset + value_size);
-		memcpy(MidiUtilByteArray_getBuffer(array->data) + offset, value, value_size);
-	}
-
-	MidiUtilIntArray_insert(array->offset_array, element_number, offset);
-	MidiUtilIntArray_insert(array->size_array, element_number, value_size);
-}
-
-void MidiUtilBlobArray_remove(MidiUtilBlobArray_t array, int element_number)
-{
-	MidiUtilBlobArray_set(array, element_number, NULL, 0);
-}
-
-MidiUtilStringArray_t MidiUtilStringArray_new(int initial_element_capacity, int initial_byte_capacity)
-{
-	MidiUtilStringArray_t array = (MidiUtilStringArray_t)(malloc(sizeof (struct MidiUtilStringArray)));
-	array->blob_array = MidiUtilBlobArray_new(initial_element_capacity, initial_byte_capacity);
-	return array;
-}
-
-void MidiUtilStringArray_free(MidiUtilStringArray_t array)
-{
-	MidiUtilBlobArray_free(array->blob_array);
-	free(array);
-}
-
-void MidiUtilStringArray_clear(MidiUtilStringArray_t array)
-{
-	MidiUtilBlobArray_clear(array->blob_array);
-}
-
-int MidiUtilStringArray_getSize(MidiUtilStringArray_t array)
-{
-	return MidiUtilBlobArray_getSize(array->blob_array);
-}
-
-unsigned char *MidiUtilStringArray_get(MidiUtilStringArray_t array, int element_number)
-{
-	return MidiUtilBlobArray_getValue(array->blob_array, element_number);
-}
-
-void MidiUtilStringArray_set(MidiUtilStringArray_t array, int element_number, unsigned char *value)
-{
-	MidiUtilBlobArray_set(array->blob_array, element_number, value, strlen((char *)(value)) + 1);
-}
-
-void MidiUtilStringArray_add(MidiUtilStringArray_t array, unsigned char *value)
-{
-	MidiUtilBlobArray_add(array->blob_array, value, strlen((char *)(value)) + 1);
-}
-
-void MidiUtilStringArray_insert(MidiUtilStringArray_t array, int element_number, unsigned char *value)
-{
-	MidiUtilBlobArray_insert(array->blob_array, element_number, value, strlen((char *)(value)) + 1);
-}
-
-void MidiUtilStringArray_remove(MidiUtilStringArray_t array, int element_number)
-{
-	MidiUtilBlobArray_remove(array->blob_array, element_number);
-}
-
-static int _hashInt(int key, int number_of_buckets)
-{
-	return (key * 62342347) % number_of_buckets;
-}
-
-MidiUtilIntIntMap_t MidiUtilIntIntMap_new(int number_of_buckets)
-{
-	MidiUtilIntIntMap_t map = (MidiUtilIntIntMap_t)(malloc(sizeof (struct MidiUtilIntIntMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilIntIntMapNode_t *)(malloc(sizeof (MidiUtilIntIntMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	return map;
-}
-
-void MidiUtilIntIntMap_free(MidiUtilIntIntMap_t map)
-{
-	MidiUtilIntIntMap_clear(map);
-	free(map->bucket_node_lists);
-	free(map);
-}
-
-void MidiUtilIntIntMap_clear(MidiUtilIntIntMap_t map)
-{
-	int bucket_number;
-	MidiUtilIntIntMapNode_t node;
-	MidiUtilIntIntMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			next_node = node->next;
-			free(node);
-		}
-
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
-}
-
-int MidiUtilIntIntMap_hasKey(MidiUtilIntIntMap_t map, int key)
-{
-	MidiUtilIntIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashInt(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return 1;
-	}
-
-	return 0;
-}
-
-int MidiUtilIntIntMap_get(MidiUtilIntIntMap_t map, int key, int default_value)
-{
-	MidiUtilIntIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashInt(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return node->value;
-	}
-
-	return default_value;
-}
-
-void MidiUtilIntIntMap_set(MidiUtilIntIntMap_t map, int key, int value)
-{
-	int bucket_number = _hashInt(key, map->number_of_buckets);
-	MidiUtilIntIntMapNode_t node;
-	MidiUtilIntIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilIntIntMapNode_t)(malloc(sizeof (struct MidiUtilIntIntMapNode)));
-	node->key = key;
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
-}
-
-void MidiUtilIntIntMap_remove(MidiUtilIntIntMap_t map, int key)
-{
-	int bucket_number = _hashInt(key, map->number_of_buckets);
-	MidiUtilIntIntMapNode_t node;
-	MidiUtilIntIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
-
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-}
-
-void MidiUtilIntIntMap_enumerate(MidiUtilIntIntMap_t map, int (*callback)(int key, int value, void *user_data), void *user_data)
-{
-	int bucket_number;
-	MidiUtilIntIntMapNode_t node;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->value, user_data)) break;
-		}
-	}
-}
-
-MidiUtilIntPointerMap_t MidiUtilIntPointerMap_new(int number_of_buckets)
-{
-	MidiUtilIntPointerMap_t map = (MidiUtilIntPointerMap_t)(malloc(sizeof (struct MidiUtilIntPointerMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilIntPointerMapNode_t *)(malloc(sizeof (MidiUtilIntPointerMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	map->free_callback = NULL;
-	map->free_callback_user_data = NULL;
-	return map;
-}
-
-void MidiUtilIntPointerMap_setFreeCallback(MidiUtilIntPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data)
-{
-	map->free_callback = callback;
-	map->free_callback_user_data = user_data;
-}
-
-void MidiUtilIntPointerMap_free(MidiUtilIntPointerMap_t map)
-{
-	MidiUtilIntPointerMap_clear(map);
-	free(map->bucket_node_lists);
-	free(map);
-}
-
-void MidiUtilIntPointerMap_clear(MidiUtilIntPointerMap_t map)
-{
-	int bucket_number;
-	MidiUtilIntPointerMapNode_t node;
-	MidiUtilIntPointerMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			next_node = node->next;
-			free(node);
-		}
-
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
-}
-
-int MidiUtilIntPointerMap_hasKey(MidiUtilIntPointerMap_t map, int key)
-{
-	MidiUtilIntPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashInt(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return 1;
-	}
-
-	return 0;
-}
-
-void *MidiUtilIntPointerMap_get(MidiUtilIntPointerMap_t map, int key)
-{
-	MidiUtilIntPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashInt(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return node->value;
-	}
-
-	return NULL;
-}
-
-void MidiUtilIntPointerMap_set(MidiUtilIntPointerMap_t map, int key, void *value)
-{
-	int bucket_number = _hashInt(key, map->number_of_buckets);
-	MidiUtilIntPointerMapNode_t node;
-	MidiUtilIntPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilIntPointerMapNode_t)(malloc(sizeof (struct MidiUtilIntPointerMapNode)));
-	node->key = key;
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
-}
-
-void MidiUtilIntPointerMap_remove(MidiUtilIntPointerMap_t map, int key)
-{
-	int bucket_number = _hashInt(key, map->number_of_buckets);
-	MidiUtilIntPointerMapNode_t node;
-	MidiUtilIntPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
-
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-}
-
-void MidiUtilIntPointerMap_enumerate(MidiUtilIntPointerMap_t map, int (*callback)(int key, void *value, void *user_data), void *user_data)
-{
-	int bucket_number;
-	MidiUtilIntPointerMapNode_t node;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->value, user_data)) break;
-		}
-	}
-}
-
-MidiUtilLongIntMap_t MidiUtilLongIntMap_new(int number_of_buckets)
-{
-	MidiUtilLongIntMap_t map = (MidiUtilLongIntMap_t)(malloc(sizeof (struct MidiUtilLongIntMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilLongIntMapNode_t *)(malloc(sizeof (MidiUtilLongIntMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	return map;
-}
-
-void MidiUtilLongIntMap_free(MidiUtilLongIntMap_t map)
-{
-	MidiUtilLongIntMap_clear(map);
-	free(map->bucket_node_lists);
-	free(map);
-}
-
-void MidiUtilLongIntMap_clear(MidiUtilLongIntMap_t map)
-{
-	int bucket_number;
-	MidiUtilLongIntMapNode_t node;
-	MidiUtilLongIntMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			next_node = node->next;
-			free(node);
-		}
-
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
-}
-
-int MidiUtilLongIntMap_hasKey(MidiUtilLongIntMap_t map, long key)
-{
-	MidiUtilLongIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashInt(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return 1;
-	}
-
-	return 0;
-}
-
-int MidiUtilLongIntMap_get(MidiUtilLongIntMap_t map, long key, int default_value)
-{
-	MidiUtilLongIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashInt(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return node->value;
-	}
-
-	return default_value;
-}
-
-void MidiUtilLongIntMap_set(MidiUtilLongIntMap_t map, long key, int value)
-{
-	int bucket_number = _hashInt(key, map->number_of_buckets);
-	MidiUtilLongIntMapNode_t node;
-	MidiUtilLongIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilLongIntMapNode_t)(malloc(sizeof (struct MidiUtilLongIntMapNode)));
-	node->key = key;
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
-}
-
-void MidiUtilLongIntMap_remove(MidiUtilLongIntMap_t map, long key)
-{
-	int bucket_number = _hashInt(key, map->number_of_buckets);
-	MidiUtilLongIntMapNode_t node;
-	MidiUtilLongIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
-
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-}
-
-void MidiUtilLongIntMap_enumerate(MidiUtilLongIntMap_t map, int (*callback)(long key, int value, void *user_data), void *user_data)
-{
-	int bucket_number;
-	MidiUtilLongIntMapNode_t node;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->value, user_data)) break;
-		}
-	}
-}
-
-MidiUtilLongPointerMap_t MidiUtilLongPointerMap_new(int number_of_buckets)
-{
-	MidiUtilLongPointerMap_t map = (MidiUtilLongPointerMap_t)(malloc(sizeof (struct MidiUtilLongPointerMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilLongPointerMapNode_t *)(malloc(sizeof (MidiUtilLongPointerMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	map->free_callback = NULL;
-	map->free_callback_user_data = NULL;
-	return map;
-}
-
-void MidiUtilLongPointerMap_setFreeCallback(MidiUtilLongPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data)
-{
-	map->free_callback = callback;
-	map->free_callback_user_data = user_data;
-}
-
-void MidiUtilLongPointerMap_free(MidiUtilLongPointerMap_t map)
-{
-	MidiUtilLongPointerMap_clear(map);
-	free(map->bucket_node_lists);
-	free(map);
-}
-
-void MidiUtilLongPointerMap_clear(MidiUtilLongPointerMap_t map)
-{
-	int bucket_number;
-	MidiUtilLongPointerMapNode_t node;
-	MidiUtilLongPointerMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			next_node = node->next;
-			free(node);
-		}
-
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
-}
-
-int MidiUtilLongPointerMap_hasKey(MidiUtilLongPointerMap_t map, long key)
-{
-	MidiUtilLongPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashInt(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return 1;
-	}
-
-	return 0;
-}
-
-void *MidiUtilLongPointerMap_get(MidiUtilLongPointerMap_t map, long key)
-{
-	MidiUtilLongPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashInt(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return node->value;
-	}
-
-	return NULL;
-}
-
-void MidiUtilLongPointerMap_set(MidiUtilLongPointerMap_t map, long key, void *value)
-{
-	int bucket_number = _hashInt(key, map->number_of_buckets);
-	MidiUtilLongPointerMapNode_t node;
-	MidiUtilLongPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilLongPointerMapNode_t)(malloc(sizeof (struct MidiUtilLongPointerMapNode)));
-	node->key = key;
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
-}
-
-void MidiUtilLongPointerMap_remove(MidiUtilLongPointerMap_t map, long key)
-{
-	int bucket_number = _hashInt(key, map->number_of_buckets);
-	MidiUtilLongPointerMapNode_t node;
-	MidiUtilLongPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
-
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-}
-
-void MidiUtilLongPointerMap_enumerate(MidiUtilLongPointerMap_t map, int (*callback)(long key, void *value, void *user_data), void *user_data)
-{
-	int bucket_number;
-	MidiUtilLongPointerMapNode_t node;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->value, user_data)) break;
-		}
-	}
-}
-
-static int _hashPointer(void *key, int number_of_buckets)
-{
-	/* TODO: check this for correctness */
-	return (int)(((long)(key) * 62342347) % number_of_buckets);
-}
-
-MidiUtilPointerIntMap_t MidiUtilPointerIntMap_new(int number_of_buckets)
-{
-	MidiUtilPointerIntMap_t map = (MidiUtilPointerIntMap_t)(malloc(sizeof (struct MidiUtilPointerIntMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilPointerIntMapNode_t *)(malloc(sizeof (MidiUtilPointerIntMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	return map;
-}
-
-void MidiUtilPointerIntMap_free(MidiUtilPointerIntMap_t map)
-{
-	MidiUtilPointerIntMap_clear(map);
-	free(map->bucket_node_lists);
-	free(map);
-}
-
-void MidiUtilPointerIntMap_clear(MidiUtilPointerIntMap_t map)
-{
-	int bucket_number;
-	MidiUtilPointerIntMapNode_t node;
-	MidiUtilPointerIntMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			next_node = node->next;
-			free(node);
-		}
-
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
-}
-
-int MidiUtilPointerIntMap_hasKey(MidiUtilPointerIntMap_t map, void *key)
-{
-	MidiUtilPointerIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashPointer(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return 1;
-	}
-
-	return 0;
-}
-
-int MidiUtilPointerIntMap_get(MidiUtilPointerIntMap_t map, void *key, int default_value)
-{
-	MidiUtilPointerIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashPointer(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return node->value;
-	}
-
-	return default_value;
-}
-
-void MidiUtilPointerIntMap_set(MidiUtilPointerIntMap_t map, void *key, int value)
-{
-	int bucket_number = _hashPointer(key, map->number_of_buckets);
-	MidiUtilPointerIntMapNode_t node;
-	MidiUtilPointerIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilPointerIntMapNode_t)(malloc(sizeof (struct MidiUtilPointerIntMapNode)));
-	node->key = key;
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
-}
-
-void MidiUtilPointerIntMap_remove(MidiUtilPointerIntMap_t map, void *key)
-{
-	int bucket_number = _hashPointer(key, map->number_of_buckets);
-	MidiUtilPointerIntMapNode_t node;
-	MidiUtilPointerIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
-
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-}
-
-void MidiUtilPointerIntMap_enumerate(MidiUtilPointerIntMap_t map, int (*callback)(void *key, int value, void *user_data), void *user_data)
-{
-	int bucket_number;
-	MidiUtilPointerIntMapNode_t node;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->value, user_data)) break;
-		}
-	}
-}
-
-MidiUtilPointerPointerMap_t MidiUtilPointerPointerMap_new(int number_of_buckets)
-{
-	MidiUtilPointerPointerMap_t map = (MidiUtilPointerPointerMap_t)(malloc(sizeof (struct MidiUtilPointerPointerMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilPointerPointerMapNode_t *)(malloc(sizeof (MidiUtilPointerPointerMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	map->free_callback = NULL;
-	map->free_callback_user_data = NULL;
-	return map;
-}
-
-void MidiUtilPointerPointerMap_setFreeCallback(MidiUtilPointerPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data)
-{
-	map->free_callback = callback;
-	map->free_callback_user_data = user_data;
-}
-
-void MidiUtilPointerPointerMap_free(MidiUtilPointerPointerMap_t map)
-{
-	MidiUtilPointerPointerMap_clear(map);
-	free(map->bucket_node_lists);
-	free(map);
-}
-
-void MidiUtilPointerPointerMap_clear(MidiUtilPointerPointerMap_t map)
-{
-	int bucket_number;
-	MidiUtilPointerPointerMapNode_t node;
-	MidiUtilPointerPointerMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			next_node = node->next;
-			free(node);
-		}
-
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
-}
-
-int MidiUtilPointerPointerMap_hasKey(MidiUtilPointerPointerMap_t map, void *key)
-{
-	MidiUtilPointerPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashPointer(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return 1;
-	}
-
-	return 0;
-}
-
-void *MidiUtilPointerPointerMap_get(MidiUtilPointerPointerMap_t map, void *key)
-{
-	MidiUtilPointerPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashPointer(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (node->key == key) return node->value;
-	}
-
-	return NULL;
-}
-
-void MidiUtilPointerPointerMap_set(MidiUtilPointerPointerMap_t map, void *key, void *value)
-{
-	int bucket_number = _hashPointer(key, map->number_of_buckets);
-	MidiUtilPointerPointerMapNode_t node;
-	MidiUtilPointerPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilPointerPointerMapNode_t)(malloc(sizeof (struct MidiUtilPointerPointerMapNode)));
-	node->key = key;
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
-}
-
-void MidiUtilPointerPointerMap_remove(MidiUtilPointerPointerMap_t map, void *key)
-{
-	int bucket_number = _hashPointer(key, map->number_of_buckets);
-	MidiUtilPointerPointerMapNode_t node;
-	MidiUtilPointerPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (node->key == key)
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
-
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-}
-
-void MidiUtilPointerPointerMap_enumerate(MidiUtilPointerPointerMap_t map, int (*callback)(void *key, void *value, void *user_data), void *user_data)
-{
-	int bucket_number;
-	MidiUtilPointerPointerMapNode_t node;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->value, user_data)) break;
-		}
-	}
-}
-
-static int _hashBlob(unsigned char *key, int key_size, int number_of_buckets)
-{
-	int i;
-	int bucket_number = 0;
-	for (i = 0; i < key_size; i++) bucket_number = ((bucket_number * 128) + (int)(key[i])) % number_of_buckets;
-	return bucket_number;
-}
-
-MidiUtilBlobIntMap_t MidiUtilBlobIntMap_new(int number_of_buckets)
-{
-	MidiUtilBlobIntMap_t map = (MidiUtilBlobIntMap_t)(malloc(sizeof (struct MidiUtilBlobIntMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilBlobIntMapNode_t *)(malloc(sizeof (MidiUtilBlobIntMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	return map;
-}
-
-void MidiUtilBlobIntMap_free(MidiUtilBlobIntMap_t map)
-{
-	MidiUtilBlobIntMap_clear(map);
-	free(map->bucket_node_lists);
-	free(map);
-}
-
-void MidiUtilBlobIntMap_clear(MidiUtilBlobIntMap_t map)
-{
-	int bucket_number;
-	MidiUtilBlobIntMapNode_t node;
-	MidiUtilBlobIntMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			next_node = node->next;
-			free(node->key);
-			free(node);
-		}
-
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
-}
-
-int MidiUtilBlobIntMap_hasKey(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size)
-{
-	MidiUtilBlobIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashBlob(key, key_size, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if ((node->key_size == key_size) && (memcmp(node->key, key, key_size) == 0)) return 1;
-	}
-
-	return 0;
-}
-
-int MidiUtilBlobIntMap_get(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size, int default_value)
-{
-	MidiUtilBlobIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashBlob(key, key_size, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if ((node->key_size == key_size) && (memcmp(node->key, key, key_size) == 0)) return node->value;
-	}
-
-	return default_value;
 }
 
-void MidiUtilBlobIntMap_set(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size, int value)
+int MidiUtilBlobIntMap_getNext(MidiUtilBlobIntMap_t map, int *position, unsigned char **key, int *key_size, int *value)
 {
-	int bucket_number = _hashBlob(key, key_size, map->number_of_buckets);
-	MidiUtilBlobIntMapNode_t node;
-	MidiUtilBlobIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if ((node->key_size == key_size) && (memcmp(node->key, key, key_size) == 0))
-		{
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
 
-	node = (MidiUtilBlobIntMapNode_t)(malloc(sizeof (struct MidiUtilBlobIntMapNode)));
-	node->key = malloc(key_size);
-	memcpy(node->key, key, key_size);
-	node->key_size = key_size;
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
+	if (slot == NULL)
 	{
-		map->bucket_node_lists[bucket_number] = node;
+		return 0;
 	}
 	else
 	{
-		previous_node->next = node;
-	}
-}
-
-void MidiUtilBlobIntMap_remove(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size)
-{
-	int bucket_number = _hashBlob(key, key_size, map->number_of_buckets);
-	MidiUtilBlobIntMapNode_t node;
-	MidiUtilBlobIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if ((node->key_size == key_size) && (memcmp(node->key, key, key_size) == 0))
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
-
-			free(node->key);
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-}
-
-void MidiUtilBlobIntMap_enumerate(MidiUtilBlobIntMap_t map, int (*callback)(unsigned char *key, int key_size, int value, void *user_data), void *user_data)
-{
-	int bucket_number;
-	MidiUtilBlobIntMapNode_t node;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->key_size, node->value, user_data)) break;
-		}
+		if (key != NULL) *key = slot->key.blob_key;
+		if (key_size != NULL) *key_size = slot->key_size;
+		if (value != NULL) *value = slot->value.int_value;
+		return 1;
 	}
 }
 
-MidiUtilBlobPointerMap_t MidiUtilBlobPointerMap_new(int number_of_buckets)
+MidiUtilBlobPointerMap_t MidiUtilBlobPointerMap_new(int initial_capacity)
 {
 	MidiUtilBlobPointerMap_t map = (MidiUtilBlobPointerMap_t)(malloc(sizeof (struct MidiUtilBlobPointerMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilBlobPointerMapNode_t *)(malloc(sizeof (MidiUtilBlobPointerMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	map->free_callback = NULL;
-	map->free_callback_user_data = NULL;
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_BLOB, initial_capacity);
 	return map;
 }
 
 void MidiUtilBlobPointerMap_setFreeCallback(MidiUtilBlobPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data)
 {
-	map->free_callback = callback;
-	map->free_callback_user_data = user_data;
+	map->hash_map.free_callback = callback;
+	map->hash_map.free_callback_user_data = user_data;
 }
 
 void MidiUtilBlobPointerMap_free(MidiUtilBlobPointerMap_t map)
 {
-	MidiUtilBlobPointerMap_clear(map);
-	free(map->bucket_node_lists);
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
 	free(map);
 }
 
 void MidiUtilBlobPointerMap_clear(MidiUtilBlobPointerMap_t map)
 {
-	int bucket_number;
-	MidiUtilBlobPointerMapNode_t node;
-	MidiUtilBlobPointerMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			free(node->key);
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			next_node = node->next;
-			free(node);
-		}
+	clear_hash_map(&(map->hash_map));
+}
 
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
+int MidiUtilBlobPointerMap_getSize(MidiUtilBlobPointerMap_t map)
+{
+	return map->hash_map.size;
 }
 
 int MidiUtilBlobPointerMap_hasKey(MidiUtilBlobPointerMap_t map, unsigned char *key, int key_size)
 {
-	MidiUtilBlobPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashBlob(key, key_size, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if ((node->key_size == key_size) && (memcmp(node->key, key, key_size) == 0)) return 1;
-	}
-
-	return 0;
+	return (find_hash_map_slot(&(map->hash_map), key, key_size) != NULL);
 }
 
 void *MidiUtilBlobPointerMap_get(MidiUtilBlobPointerMap_t map, unsigned char *key, int key_size)
 {
-	MidiUtilBlobPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashBlob(key, key_size, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if ((node->key_size == key_size) && (memcmp(node->key, key, key_size) == 0)) return node->value;
-	}
-
-	return NULL;
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), key, key_size);
+	return (slot == NULL) ? NULL : slot->value.pointer_value;
 }
 
 void MidiUtilBlobPointerMap_set(MidiUtilBlobPointerMap_t map, unsigned char *key, int key_size, void *value)
 {
-	int bucket_number = _hashBlob(key, key_size, map->number_of_buckets);
-	MidiUtilBlobPointerMapNode_t node;
-	MidiUtilBlobPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if ((node->key_size == key_size) && (memcmp(node->key, key, key_size) == 0))
-		{
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilBlobPointerMapNode_t)(malloc(sizeof (struct MidiUtilBlobPointerMapNode)));
-	node->key = malloc(key_size);
-	memcpy(node->key, key, key_size);
-	node->key_size = key_size;
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
+	int is_new;
+	struct MidiUtilHashMapSlot *slot = add_hash_map_slot(&(map->hash_map), key, key_size, &is_new);
+	if ((!is_new) && (map->hash_map.free_callback != NULL)) (*(map->hash_map.free_callback))(slot->value.pointer_value, map->hash_map.free_callback_user_data);
+	slot->value.pointer_value = value;
 }
 
 void MidiUtilBlobPointerMap_remove(MidiUtilBlobPointerMap_t map, unsigned char *key, int key_size)
 {
-	int bucket_number = _hashBlob(key, key_size, map->number_of_buckets);
-	MidiUtilBlobPointerMapNode_t node;
-	MidiUtilBlobPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if ((node->key_size == key_size) && (memcmp(node->key, key, key_size) == 0))
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
-
-			free(node->key);
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
+	remove_hash_map_slot(&(map->hash_map), key, key_size);
 }
 
 void MidiUtilBlobPointerMap_enumerate(MidiUtilBlobPointerMap_t map, int (*callback)(unsigned char *key, int key_size, void *value, void *user_data), void *user_data)
 {
-	int bucket_number;
-	MidiUtilBlobPointerMapNode_t node;
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
 
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
 	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->key_size, node->value, user_data)) break;
-		}
+		if ((*callback)(slot->key.blob_key, slot->key_size, slot->value.pointer_value, user_data)) break;
 	}
 }
 
-static int _hashString(unsigned char *key, int number_of_buckets)
+int MidiUtilBlobPointerMap_getNext(MidiUtilBlobPointerMap_t map, int *position, unsigned char **key, int *key_size, void **value)
 {
-	int i;
-	int bucket_number = 0;
-	for (i = 0; key[i] != '\0'; i++) bucket_number = ((bucket_number * 128) + (int)(key[i])) % number_of_buckets;
-	return bucket_number;
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.blob_key;
+		if (key_size != NULL) *key_size = slot->key_size;
+		if (value != NULL) *value = slot->value.pointer_value;
+		return 1;
+	}
 }
 
-MidiUtilStringIntMap_t MidiUtilStringIntMap_new(int number_of_buckets)
+MidiUtilStringIntMap_t MidiUtilStringIntMap_new(int initial_capacity)
 {
 	MidiUtilStringIntMap_t map = (MidiUtilStringIntMap_t)(malloc(sizeof (struct MidiUtilStringIntMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilStringIntMapNode_t *)(malloc(sizeof (MidiUtilStringIntMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_BLOB, initial_capacity);
 	return map;
 }
 
 void MidiUtilStringIntMap_free(MidiUtilStringIntMap_t map)
 {
-	MidiUtilStringIntMap_clear(map);
-	free(map->bucket_node_lists);
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
 	free(map);
 }
 
 void MidiUtilStringIntMap_clear(MidiUtilStringIntMap_t map)
 {
-	int bucket_number;
-	MidiUtilStringIntMapNode_t node;
-	MidiUtilStringIntMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			free(node->key);
-			next_node = node->next;
-			free(node);
-		}
+	clear_hash_map(&(map->hash_map));
+}
 
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
+int MidiUtilStringIntMap_getSize(MidiUtilStringIntMap_t map)
+{
+	return map->hash_map.size;
 }
 
 int MidiUtilStringIntMap_hasKey(MidiUtilStringIntMap_t map, unsigned char *key)
 {
-	MidiUtilStringIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashString(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (strcmp((char *)(node->key), (char *)(key)) == 0) return 1;
-	}
-
-	return 0;
+	return (find_hash_map_slot(&(map->hash_map), key, (int)(strlen((char *)(key))) + 1) != NULL);
 }
 
 int MidiUtilStringIntMap_get(MidiUtilStringIntMap_t map, unsigned char *key, int default_value)
 {
-	MidiUtilStringIntMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashString(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (strcmp((char *)(node->key), (char *)(key)) == 0) return node->value;
-	}
-
-	return default_value;
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), key, (int)(strlen((char *)(key))) + 1);
+	return (slot == NULL) ? default_value : slot->value.int_value;
 }
 
 void MidiUtilStringIntMap_set(MidiUtilStringIntMap_t map, unsigned char *key, int value)
 {
-	int bucket_number = _hashString(key, map->number_of_buckets);
-	MidiUtilStringIntMapNode_t node;
-	MidiUtilStringIntMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (strcmp((char *)(node->key), (char *)(key)) == 0)
-		{
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilStringIntMapNode_t)(malloc(sizeof (struct MidiUtilStringIntMapNode)));
-	node->key = (unsigned char *)(strdup((char *)(key)));
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
+	int is_new;
+	add_hash_map_slot(&(map->hash_map), key, (int)(strlen((char *)(key))) + 1, &is_new)->value.int_value = value;
 }
 
 void MidiUtilStringIntMap_remove(MidiUtilStringIntMap_t map, unsigned char *key)
 {
-	int bucket_number = _hashString(key, map->number_of_buckets);
-	MidiUtilStringIntMapNode_t node;
-	MidiUtilStringIntMapNode_t previous_node = NULL;
+	remove_hash_map_slot(&(map->hash_map), key, (int)(strlen((char *)(key))) + 1);
+}
 
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (strcmp((char *)(node->key), (char *)(key)) == 0)
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
+void MidiUtilStringIntMap_enumerate(MidiUtilStringIntMap_t map, int (*callback)(unsigned char *key, int value, void *user_data), void *user_data)
+{
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
 
-			free(node->key);
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
+	{
+		if ((*callback)(slot->key.blob_key, slot->value.int_value, user_data)) break;
 	}
 }
 
-void MidiUtilStringIntMap_enumerate(MidiUtilStringIntMap_t map, int (*callback)(unsigned char *key, int value, void *user_data), void *user_data)
+int MidiUtilStringIntMap_getNext(MidiUtilStringIntMap_t map, int *position, unsigned char **key, int *value)
 {
-	int bucket_number;
-	MidiUtilStringIntMapNode_t node;
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
 
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
+	if (slot == NULL)
 	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->value, user_data)) break;
-		}
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.blob_key;
+		if (value != NULL) *value = slot->value.int_value;
+		return 1;
 	}
 }
 
-MidiUtilStringPointerMap_t MidiUtilStringPointerMap_new(int number_of_buckets)
+MidiUtilStringPointerMap_t MidiUtilStringPointerMap_new(int initial_capacity)
 {
 	MidiUtilStringPointerMap_t map = (MidiUtilStringPointerMap_t)(malloc(sizeof (struct MidiUtilStringPointerMap)));
-	int bucket_number;
-	map->number_of_buckets = number_of_buckets;
-	map->bucket_node_lists = (MidiUtilStringPointerMapNode_t *)(malloc(sizeof (MidiUtilStringPointerMapNode_t) * number_of_buckets));
-	for (bucket_number = 0; bucket_number < number_of_buckets; bucket_number++) map->bucket_node_lists[bucket_number] = NULL;
-	map->free_callback = NULL;
-	map->free_callback_user_data = NULL;
+	init_hash_map(&(map->hash_map), MIDI_UTIL_HASH_MAP_KEY_TYPE_BLOB, initial_capacity);
 	return map;
 }
 
 void MidiUtilStringPointerMap_setFreeCallback(MidiUtilStringPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data)
 {
-	map->free_callback = callback;
-	map->free_callback_user_data = user_data;
+	map->hash_map.free_callback = callback;
+	map->hash_map.free_callback_user_data = user_data;
 }
 
 void MidiUtilStringPointerMap_free(MidiUtilStringPointerMap_t map)
 {
-	MidiUtilStringPointerMap_clear(map);
-	free(map->bucket_node_lists);
+	clear_hash_map(&(map->hash_map));
+	free(map->hash_map.slots);
 	free(map);
 }
 
 void MidiUtilStringPointerMap_clear(MidiUtilStringPointerMap_t map)
 {
-	int bucket_number;
-	MidiUtilStringPointerMapNode_t node;
-	MidiUtilStringPointerMapNode_t next_node = NULL;
-
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
-	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = next_node)
-		{
-			free(node->key);
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			next_node = node->next;
-			free(node);
-		}
+	clear_hash_map(&(map->hash_map));
+}
 
-		map->bucket_node_lists[bucket_number] = NULL;
-	}
+int MidiUtilStringPointerMap_getSize(MidiUtilStringPointerMap_t map)
+{
+	return map->hash_map.size;
 }
 
 int MidiUtilStringPointerMap_hasKey(MidiUtilStringPointerMap_t map, unsigned char *key)
 {
-	MidiUtilStringPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashString(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (strcmp((char *)(node->key), (char *)(key)) == 0) return 1;
-	}
-
-	return 0;
+	return (find_hash_map_slot(&(map->hash_map), key, (int)(strlen((char *)(key))) + 1) != NULL);
 }
 
 void *MidiUtilStringPointerMap_get(MidiUtilStringPointerMap_t map, unsigned char *key)
 {
-	MidiUtilStringPointerMapNode_t node;
-
-	for (node = map->bucket_node_lists[_hashString(key, map->number_of_buckets)]; node != NULL; node = node->next)
-	{
-		if (strcmp((char *)(node->key), (char *)(key)) == 0) return node->value;
-	}
-
-	return NULL;
+	struct MidiUtilHashMapSlot *slot = find_hash_map_slot(&(map->hash_map), key, (int)(strlen((char *)(key))) + 1);
+	return (slot == NULL) ? NULL : slot->value.pointer_value;
 }
 
 void MidiUtilStringPointerMap_set(MidiUtilStringPointerMap_t map, unsigned char *key, void *value)
 {
-	int bucket_number = _hashString(key, map->number_of_buckets);
-	MidiUtilStringPointerMapNode_t node;
-	MidiUtilStringPointerMapNode_t previous_node = NULL;
-
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (strcmp((char *)(node->key), (char *)(key)) == 0)
-		{
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			node->value = value;
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
-	}
-
-	node = (MidiUtilStringPointerMapNode_t)(malloc(sizeof (struct MidiUtilStringPointerMapNode)));
-	node->key = (unsigned char *)(strdup((char *)(key)));
-	node->value = value;
-	node->next = NULL;
-
-	if (previous_node == NULL)
-	{
-		map->bucket_node_lists[bucket_number] = node;
-	}
-	else
-	{
-		previous_node->next = node;
-	}
+	int is_new;
+	struct MidiUtilHashMapSlot *slot = add_hash_map_slot(&(map->hash_map), key, (int)(strlen((char *)(key))) + 1, &is_new);
+	if ((!is_new) && (map->hash_map.free_callback != NULL)) (*(map->hash_map.free_callback))(slot->value.pointer_value, map->hash_map.free_callback_user_data);
+	slot->value.pointer_value = value;
 }
 
 void MidiUtilStringPointerMap_remove(MidiUtilStringPointerMap_t map, unsigned char *key)
 {
-	int bucket_number = _hashString(key, map->number_of_buckets);
-	MidiUtilStringPointerMapNode_t node;
-	MidiUtilStringPointerMapNode_t previous_node = NULL;
+	remove_hash_map_slot(&(map->hash_map), key, (int)(strlen((char *)(key))) + 1);
+}
 
-	for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-	{
-		if (strcmp((char *)(node->key), (char *)(key)) == 0)
-		{
-			if (previous_node == NULL)
-			{
-				map->bucket_node_lists[bucket_number] = node->next;
-			}
-			else
-			{
-				previous_node->next = node->next;
-			}
+void MidiUtilStringPointerMap_enumerate(MidiUtilStringPointerMap_t map, int (*callback)(unsigned char *key, void *value, void *user_data), void *user_data)
+{
+	int position = 0;
+	struct MidiUtilHashMapSlot *slot;
 
-			free(node->key);
-			if (map->free_callback != NULL) (*(map->free_callback))(node->value, map->free_callback_user_data);
-			free(node);
-			return;
-		}
-		else
-		{
-			previous_node = node;
-		}
+	while ((slot = get_next_hash_map_slot(&(map->hash_map), &position)) != NULL)
+	{
+		if ((*callback)(slot->key.blob_key, slot->value.pointer_value, user_data)) break;
 	}
 }
 
-void MidiUtilStringPointerMap_enumerate(MidiUtilStringPointerMap_t map, int (*callback)(unsigned char *key, void *value, void *user_data), void *user_data)
+int MidiUtilStringPointerMap_getNext(MidiUtilStringPointerMap_t map, int *position, unsigned char **key, void **value)
 {
-	int bucket_number;
-	MidiUtilStringPointerMapNode_t node;
+	struct MidiUtilHashMapSlot *slot = get_next_hash_map_slot(&(map->hash_map), position);
 
-	for (bucket_number = 0; bucket_number < map->number_of_buckets; bucket_number++)
+	if (slot == NULL)
 	{
-		for (node = map->bucket_node_lists[bucket_number]; node != NULL; node = node->next)
-		{
-			if ((*callback)(node->key, node->value, user_data)) break;
-		}
+		return 0;
+	}
+	else
+	{
+		if (key != NULL) *key = slot->key.blob_key;
+		if (value != NULL) *value = slot->value.pointer_value;
+		return 1;
 	}
 }
 
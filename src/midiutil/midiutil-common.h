@@ -54,19 +54,24 @@ typedef enum
 }
 MidiUtilMessageSize_t;
 
+/* Growable arrays.  _reserve() makes room up front so that _addUnchecked() can skip the capacity check, and _swapRemove() fills the gap with the last element instead of shifting the rest down. */
+
 MidiUtilByteArray_t MidiUtilByteArray_new(int initial_capacity);
 void MidiUtilByteArray_free(MidiUtilByteArray_t array);
 void MidiUtilByteArray_clear(MidiUtilByteArray_t array);
 int MidiUtilByteArray_getCapacity(MidiUtilByteArray_t array);
 void MidiUtilByteArray_setCapacity(MidiUtilByteArray_t array, int capacity);
+void MidiUtilByteArray_reserve(MidiUtilByteArray_t array, int capacity);
 int MidiUtilByteArray_getSize(MidiUtilByteArray_t array);
 void MidiUtilByteArray_setSize(MidiUtilByteArray_t array, int size);
 unsigned char *MidiUtilByteArray_getBuffer(MidiUtilByteArray_t array);
 unsigned char MidiUtilByteArray_get(MidiUtilByteArray_t array, int element_number);
 void MidiUtilByteArray_set(MidiUtilByteArray_t array, int element_number, unsigned char value);
 void MidiUtilByteArray_add(MidiUtilByteArray_t array, unsigned char value);
+void MidiUtilByteArray_addUnchecked(MidiUtilByteArray_t array, unsigned char value);
 void MidiUtilByteArray_insert(MidiUtilByteArray_t array, int element_number, unsigned char value);
 void MidiUtilByteArray_remove(MidiUtilByteArray_t array, int element_number);
+void MidiUtilByteArray_swapRemove(MidiUtilByteArray_t array, int element_number);
 void MidiUtilByteArray_setValues(MidiUtilByteArray_t array, unsigned char *values, int number_of_values);
 void MidiUtilByteArray_addValues(MidiUtilByteArray_t array, unsigned char *values, int number_of_values);
 void MidiUtilByteArray_replaceValues(MidiUtilByteArray_t array, int element_number, unsigned char *values, int number_of_values);
@@ -78,14 +83,17 @@ void MidiUtilIntArray_free(MidiUtilIntArray_t array);
 void MidiUtilIntArray_clear(MidiUtilIntArray_t array);
 int MidiUtilIntArray_getCapacity(MidiUtilIntArray_t array);
 void MidiUtilIntArray_setCapacity(MidiUtilIntArray_t array, int capacity);
+void MidiUtilIntArray_reserve(MidiUtilIntArray_t array, int capacity);
 int MidiUtilIntArray_getSize(MidiUtilIntArray_t array);
 void MidiUtilIntArray_setSize(MidiUtilIntArray_t array, int size);
 int *MidiUtilIntArray_getBuffer(MidiUtilIntArray_t array);
 int MidiUtilIntArray_get(MidiUtilIntArray_t array, int element_number);
 void MidiUtilIntArray_set(MidiUtilIntArray_t array, int element_number, int value);
 void MidiUtilIntArray_add(MidiUtilIntArray_t array, int value);
+void MidiUtilIntArray_addUnchecked(MidiUtilIntArray_t array, int value);
 void MidiUtilIntArray_insert(MidiUtilIntArray_t array, int element_number, int value);
 void MidiUtilIntArray_remove(MidiUtilIntArray_t array, int element_number);
+void MidiUtilIntArray_swapRemove(MidiUtilIntArray_t array, int element_number);
 void MidiUtilIntArray_setValues(MidiUtilIntArray_t array, int *values, int number_of_values);
 void MidiUtilIntArray_addValues(MidiUtilIntArray_t array, int *values, int number_of_values);
 void MidiUtilIntArray_replaceValues(MidiUtilIntArray_t array, int element_number, int *values, int number_of_values);
@@ -97,14 +105,17 @@ void MidiUtilLongArray_free(MidiUtilLongArray_t array);
 void MidiUtilLongArray_clear(MidiUtilLongArray_t array);
 int MidiUtilLongArray_getCapacity(MidiUtilLongArray_t array);
 void MidiUtilLongArray_setCapacity(MidiUtilLongArray_t array, int capacity);
+void MidiUtilLongArray_reserve(MidiUtilLongArray_t array, int capacity);
 int MidiUtilLongArray_getSize(MidiUtilLongArray_t array);
 void MidiUtilLongArray_setSize(MidiUtilLongArray_t array, int size);
 long *MidiUtilLongArray_getBuffer(MidiUtilLongArray_t array);
 long MidiUtilLongArray_get(MidiUtilLongArray_t array, int element_number);
 void MidiUtilLongArray_set(MidiUtilLongArray_t array, int element_number, long value);
 void MidiUtilLongArray_add(MidiUtilLongArray_t array, long value);
+void MidiUtilLongArray_addUnchecked(MidiUtilLongArray_t array, long value);
 void MidiUtilLongArray_insert(MidiUtilLongArray_t array, int element_number, long value);
 void MidiUtilLongArray_remove(MidiUtilLongArray_t array, int element_number);
+void MidiUtilLongArray_swapRemove(MidiUtilLongArray_t array, int element_number);
 void MidiUtilLongArray_setValues(MidiUtilLongArray_t array, long *values, int number_of_values);
 void MidiUtilLongArray_addValues(MidiUtilLongArray_t array, long *values, int number_of_values);
 void MidiUtilLongArray_replaceValues(MidiUtilLongArray_t array, int element_number, long *values, int number_of_values);
@@ -116,14 +127,17 @@ void MidiUtilFloatArray_free(MidiUtilFloatArray_t array);
 void MidiUtilFloatArray_clear(MidiUtilFloatArray_t array);
 int MidiUtilFloatArray_getCapacity(MidiUtilFloatArray_t array);
 void MidiUtilFloatArray_setCapacity(MidiUtilFloatArray_t array, int capacity);
+void MidiUtilFloatArray_reserve(MidiUtilFloatArray_t array, int capacity);
 int MidiUtilFloatArray_getSize(MidiUtilFloatArray_t array);
 void MidiUtilFloatArray_setSize(MidiUtilFloatArray_t array, int size);
 float *MidiUtilFloatArray_getBuffer(MidiUtilFloatArray_t array);
 float MidiUtilFloatArray_get(MidiUtilFloatArray_t array, int element_number);
 void MidiUtilFloatArray_set(MidiUtilFloatArray_t array, int element_number, float value);
 void MidiUtilFloatArray_add(MidiUtilFloatArray_t array, float value);
+void MidiUtilFloatArray_addUnchecked(MidiUtilFloatArray_t array, float value);
 void MidiUtilFloatArray_insert(MidiUtilFloatArray_t array, int element_number, float value);
 void MidiUtilFloatArray_remove(MidiUtilFloatArray_t array, int element_number);
+void MidiUtilFloatArray_swapRemove(MidiUtilFloatArray_t array, int element_number);
 void MidiUtilFloatArray_setValues(MidiUtilFloatArray_t array, float *values, int number_of_values);
 void MidiUtilFloatArray_addValues(MidiUtilFloatArray_t array, float *values, int number_of_values);
 void MidiUtilFloatArray_replaceValues(MidiUtilFloatArray_t array, int element_number, float *values, int number_of_values);
@@ -135,14 +149,17 @@ void MidiUtilDoubleArray_free(MidiUtilDoubleArray_t array);
 void MidiUtilDoubleArray_clear(MidiUtilDoubleArray_t array);
 int MidiUtilDoubleArray_getCapacity(MidiUtilDoubleArray_t array);
 void MidiUtilDoubleArray_setCapacity(MidiUtilDoubleArray_t array, int capacity);
+void MidiUtilDoubleArray_reserve(MidiUtilDoubleArray_t array, int capacity);
 int MidiUtilDoubleArray_getSize(MidiUtilDoubleArray_t array);
 void MidiUtilDoubleArray_setSize(MidiUtilDoubleArray_t array, int size);
 double *MidiUtilDoubleArray_getBuffer(MidiUtilDoubleArray_t array);
 double MidiUtilDoubleArray_get(MidiUtilDoubleArray_t array, int element_number);
 void MidiUtilDoubleArray_set(MidiUtilDoubleArray_t array, int element_number, double value);
 void MidiUtilDoubleArray_add(MidiUtilDoubleArray_t array, double value);
+void MidiUtilDoubleArray_addUnchecked(MidiUtilDoubleArray_t array, double value);
 void MidiUtilDoubleArray_insert(MidiUtilDoubleArray_t array, int element_number, double value);
 void MidiUtilDoubleArray_remove(MidiUtilDoubleArray_t array, int element_number);
+void MidiUtilDoubleArray_swapRemove(MidiUtilDoubleArray_t array, int element_number);
 void MidiUtilDoubleArray_setValues(MidiUtilDoubleArray_t array, double *values, int number_of_values);
 void MidiUtilDoubleArray_addValues(MidiUtilDoubleArray_t array, double *values, int number_of_values);
 void MidiUtilDoubleArray_replaceValues(MidiUtilDoubleArray_t array, int element_number, double *values, int number_of_values);
@@ -154,14 +171,17 @@ void MidiUtilPointerArray_free(MidiUtilPointerArray_t array);
 void MidiUtilPointerArray_clear(MidiUtilPointerArray_t array);
 int MidiUtilPointerArray_getCapacity(MidiUtilPointerArray_t array);
 void MidiUtilPointerArray_setCapacity(MidiUtilPointerArray_t array, int capacity);
+void MidiUtilPointerArray_reserve(MidiUtilPointerArray_t array, int capacity);
 int MidiUtilPointerArray_getSize(MidiUtilPointerArray_t array);
 void MidiUtilPointerArray_setSize(MidiUtilPointerArray_t array, int size);
 void **MidiUtilPointerArray_getBuffer(MidiUtilPointerArray_t array);
 void *MidiUtilPointerArray_get(MidiUtilPointerArray_t array, int element_number);
 void MidiUtilPointerArray_set(MidiUtilPointerArray_t array, int element_number, void *value);
 void MidiUtilPointerArray_add(MidiUtilPointerArray_t array, void *value);
+void MidiUtilPointerArray_addUnchecked(MidiUtilPointerArray_t array, void *value);
 void MidiUtilPointerArray_insert(MidiUtilPointerArray_t array, int element_number, void *value);
 void MidiUtilPointerArray_remove(MidiUtilPointerArray_t array, int element_number);
+void MidiUtilPointerArray_swapRemove(MidiUtilPointerArray_t array, int element_number);
 void MidiUtilPointerArray_setValues(MidiUtilPointerArray_t array, void **values, int number_of_values);
 void MidiUtilPointerArray_addValues(MidiUtilPointerArray_t array, void **values, int number_of_values);
 void MidiUtilPointerArray_replaceValues(MidiUtilPointerArray_t array, int element_number, void **values, int number_of_values);
@@ -200,100 +220,121 @@ void MidiUtilStringArray_add(MidiUtilStringArray_t array, unsigned char *value);
 void MidiUtilStringArray_insert(MidiUtilStringArray_t array, int element_number, unsigned char *value);
 void MidiUtilStringArray_remove(MidiUtilStringArray_t array, int element_number);
 
-MidiUtilIntIntMap_t MidiUtilIntIntMap_new(int number_of_buckets);
+/* Maps grow as needed, so the capacity given to _new() is only a hint.  To walk a map without a callback, start getNext() with *position set to 0; it returns 0 after the last entry.  Adding or removing entries invalidates positions. */
+MidiUtilIntIntMap_t MidiUtilIntIntMap_new(int initial_capacity);
 void MidiUtilIntIntMap_free(MidiUtilIntIntMap_t map);
 void MidiUtilIntIntMap_clear(MidiUtilIntIntMap_t map);
+int MidiUtilIntIntMap_getSize(MidiUtilIntIntMap_t map);
 int MidiUtilIntIntMap_hasKey(MidiUtilIntIntMap_t map, int key);
 int MidiUtilIntIntMap_get(MidiUtilIntIntMap_t map, int key, int default_value);
 void MidiUtilIntIntMap_set(MidiUtilIntIntMap_t map, int key, int value);
 void MidiUtilIntIntMap_remove(MidiUtilIntIntMap_t map, int key);
 void MidiUtilIntIntMap_enumerate(MidiUtilIntIntMap_t map, int (*callback)(int key, int value, void *user_data), void *user_data);
+int MidiUtilIntIntMap_getNext(MidiUtilIntIntMap_t map, int *position, int *key, int *value);
 
-MidiUtilIntPointerMap_t MidiUtilIntPointerMap_new(int number_of_buckets);
+MidiUtilIntPointerMap_t MidiUtilIntPointerMap_new(int initial_capacity);
 void MidiUtilIntPointerMap_setFreeCallback(MidiUtilIntPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data);
 void MidiUtilIntPointerMap_free(MidiUtilIntPointerMap_t map);
 void MidiUtilIntPointerMap_clear(MidiUtilIntPointerMap_t map);
+int MidiUtilIntPointerMap_getSize(MidiUtilIntPointerMap_t map);
 int MidiUtilIntPointerMap_hasKey(MidiUtilIntPointerMap_t map, int key);
 void *MidiUtilIntPointerMap_get(MidiUtilIntPointerMap_t map, int key);
 void MidiUtilIntPointerMap_set(MidiUtilIntPointerMap_t map, int key, void *value);
 void MidiUtilIntPointerMap_remove(MidiUtilIntPointerMap_t map, int key);
 void MidiUtilIntPointerMap_enumerate(MidiUtilIntPointerMap_t map, int (*callback)(int key, void *value, void *user_data), void *user_data);
+int MidiUtilIntPointerMap_getNext(MidiUtilIntPointerMap_t map, int *position, int *key, void **value);
 
-MidiUtilLongIntMap_t MidiUtilLongIntMap_new(int number_of_buckets);
+MidiUtilLongIntMap_t MidiUtilLongIntMap_new(int initial_capacity);
 void MidiUtilLongIntMap_free(MidiUtilLongIntMap_t map);
 void MidiUtilLongIntMap_clear(MidiUtilLongIntMap_t map);
+int MidiUtilLongIntMap_getSize(MidiUtilLongIntMap_t map);
 int MidiUtilLongIntMap_hasKey(MidiUtilLongIntMap_t map, long key);
 int MidiUtilLongIntMap_get(MidiUtilLongIntMap_t map, long key, int default_value);
 void MidiUtilLongIntMap_set(MidiUtilLongIntMap_t map, long key, int value);
 void MidiUtilLongIntMap_remove(MidiUtilLongIntMap_t map, long key);
 void MidiUtilLongIntMap_enumerate(MidiUtilLongIntMap_t map, int (*callback)(long key, int value, void *user_data), void *user_data);
+int MidiUtilLongIntMap_getNext(MidiUtilLongIntMap_t map, int *position, long *key, int *value);
 
-MidiUtilLongPointerMap_t MidiUtilLongPointerMap_new(int number_of_buckets);
+MidiUtilLongPointerMap_t MidiUtilLongPointerMap_new(int initial_capacity);
 void MidiUtilLongPointerMap_setFreeCallback(MidiUtilLongPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data);
 void MidiUtilLongPointerMap_free(MidiUtilLongPointerMap_t map);
 void MidiUtilLongPointerMap_clear(MidiUtilLongPointerMap_t map);
+int MidiUtilLongPointerMap_getSize(MidiUtilLongPointerMap_t map);
 int MidiUtilLongPointerMap_hasKey(MidiUtilLongPointerMap_t map, long key);
 void *MidiUtilLongPointerMap_get(MidiUtilLongPointerMap_t map, long key);
 void MidiUtilLongPointerMap_set(MidiUtilLongPointerMap_t map, long key, void *value);
 void MidiUtilLongPointerMap_remove(MidiUtilLongPointerMap_t map, long key);
 void MidiUtilLongPointerMap_enumerate(MidiUtilLongPointerMap_t map, int (*callback)(long key, void *value, void *user_data), void *user_data);
+int MidiUtilLongPointerMap_getNext(MidiUtilLongPointerMap_t map, int *position, long *key, void **value);
 
-MidiUtilPointerIntMap_t MidiUtilPointerIntMap_new(int number_of_buckets);
+MidiUtilPointerIntMap_t MidiUtilPointerIntMap_new(int initial_capacity);
 void MidiUtilPointerIntMap_free(MidiUtilPointerIntMap_t map);
 void MidiUtilPointerIntMap_clear(MidiUtilPointerIntMap_t map);
+int MidiUtilPointerIntMap_getSize(MidiUtilPointerIntMap_t map);
 int MidiUtilPointerIntMap_hasKey(MidiUtilPointerIntMap_t map, void *key);
 int MidiUtilPointerIntMap_get(MidiUtilPointerIntMap_t map, void *key, int default_value);
 void MidiUtilPointerIntMap_set(MidiUtilPointerIntMap_t map, void *key, int value);
 void MidiUtilPointerIntMap_remove(MidiUtilPointerIntMap_t map, void *key);
 void MidiUtilPointerIntMap_enumerate(MidiUtilPointerIntMap_t map, int (*callback)(void *key, int value, void *user_data), void *user_data);
+int MidiUtilPointerIntMap_getNext(MidiUtilPointerIntMap_t map, int *position, void **key, int *value);
 
-MidiUtilPointerPointerMap_t MidiUtilPointerPointerMap_new(int number_of_buckets);
+MidiUtilPointerPointerMap_t MidiUtilPointerPointerMap_new(int initial_capacity);
 void MidiUtilPointerPointerMap_setFreeCallback(MidiUtilPointerPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data);
 void MidiUtilPointerPointerMap_free(MidiUtilPointerPointerMap_t map);
 void MidiUtilPointerPointerMap_clear(MidiUtilPointerPointerMap_t map);
+int MidiUtilPointerPointerMap_getSize(MidiUtilPointerPointerMap_t map);
 int MidiUtilPointerPointerMap_hasKey(MidiUtilPointerPointerMap_t map, void *key);
 void *MidiUtilPointerPointerMap_get(MidiUtilPointerPointerMap_t map, void *key);
 void MidiUtilPointerPointerMap_set(MidiUtilPointerPointerMap_t map, void *key, void *value);
 void MidiUtilPointerPointerMap_remove(MidiUtilPointerPointerMap_t map, void *key);
 void MidiUtilPointerPointerMap_enumerate(MidiUtilPointerPointerMap_t map, int (*callback)(void *key, void *value, void *user_data), void *user_data);
+int MidiUtilPointerPointerMap_getNext(MidiUtilPointerPointerMap_t map, int *position, void **key, void **value);
 
-MidiUtilBlobIntMap_t MidiUtilBlobIntMap_new(int number_of_buckets);
+MidiUtilBlobIntMap_t MidiUtilBlobIntMap_new(int initial_capacity);
 void MidiUtilBlobIntMap_free(MidiUtilBlobIntMap_t map);
 void MidiUtilBlobIntMap_clear(MidiUtilBlobIntMap_t map);
+int MidiUtilBlobIntMap_getSize(MidiUtilBlobIntMap_t map);
 int MidiUtilBlobIntMap_hasKey(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size);
 int MidiUtilBlobIntMap_get(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size, int default_value);
 void MidiUtilBlobIntMap_set(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size, int value);
 void MidiUtilBlobIntMap_remove(MidiUtilBlobIntMap_t map, unsigned char *key, int key_size);
 void MidiUtilBlobIntMap_enumerate(MidiUtilBlobIntMap_t map, int (*callback)(unsigned char *key, int key_size, int value, void *user_data), void *user_data);
+int MidiUtilBlobIntMap_getNext(MidiUtilBlobIntMap_t map, int *position, unsigned char **key, int *key_size, int *value);
 
-MidiUtilBlobPointerMap_t MidiUtilBlobPointerMap_new(int number_of_buckets);
+MidiUtilBlobPointerMap_t MidiUtilBlobPointerMap_new(int initial_capacity);
 void MidiUtilBlobPointerMap_setFreeCallback(MidiUtilBlobPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data);
 void MidiUtilBlobPointerMap_free(MidiUtilBlobPointerMap_t map);
 void MidiUtilBlobPointerMap_clear(MidiUtilBlobPointerMap_t map);
+int MidiUtilBlobPointerMap_getSize(MidiUtilBlobPointerMap_t map);
 int MidiUtilBlobPointerMap_hasKey(MidiUtilBlobPointerMap_t map, unsigned char *key, int key_size);
 void *MidiUtilBlobPointerMap_get(MidiUtilBlobPointerMap_t map, unsigned char *key, int key_size);
 void MidiUtilBlobPointerMap_set(MidiUtilBlobPointerMap_t map, unsigned char *key, int key_size, void *value);
 void MidiUtilBlobPointerMap_remove(MidiUtilBlobPointerMap_t map, unsigned char *key, int key_size);
 void MidiUtilBlobPointerMap_enumerate(MidiUtilBlobPointerMap_t map, int (*callback)(unsigned char *key, int key_size, void *value, void *user_data), void *user_data);
+int MidiUtilBlobPointerMap_getNext(MidiUtilBlobPointerMap_t map, int *position, unsigned char **key, int *key_size, void **value);
 
-MidiUtilStringIntMap_t MidiUtilStringIntMap_new(int number_of_buckets);
+MidiUtilStringIntMap_t MidiUtilStringIntMap_new(int initial_capacity);
 void MidiUtilStringIntMap_free(MidiUtilStringIntMap_t map);
 void MidiUtilStringIntMap_clear(MidiUtilStringIntMap_t map);
+int MidiUtilStringIntMap_getSize(MidiUtilStringIntMap_t map);
 int MidiUtilStringIntMap_hasKey(MidiUtilStringIntMap_t map, unsigned char *key);
 int MidiUtilStringIntMap_get(MidiUtilStringIntMap_t map, unsigned char *key, int default_value);
 void MidiUtilStringIntMap_set(MidiUtilStringIntMap_t map, unsigned char *key, int value);
 void MidiUtilStringIntMap_remove(MidiUtilStringIntMap_t map, unsigned char *key);
 void MidiUtilStringIntMap_enumerate(MidiUtilStringIntMap_t map, int (*callback)(unsigned char *key, int value, void *user_data), void *user_data);
+int MidiUtilStringIntMap_getNext(MidiUtilStringIntMap_t map, int *position, unsigned char **key, int *value);
 
-MidiUtilStringPointerMap_t MidiUtilStringPointerMap_new(int number_of_buckets);
+MidiUtilStringPointerMap_t MidiUtilStringPointerMap_new(int initial_capacity);
 void MidiUtilStringPointerMap_setFreeCallback(MidiUtilStringPointerMap_t map, void (*callback)(void *value, void *user_data), void *user_data);
 void MidiUtilStringPointerMap_free(MidiUtilStringPointerMap_t map);
 void MidiUtilStringPointerMap_clear(MidiUtilStringPointerMap_t map);
+int MidiUtilStringPointerMap_getSize(MidiUtilStringPointerMap_t map);
 int MidiUtilStringPointerMap_hasKey(MidiUtilStringPointerMap_t map, unsigned char *key);
 void *MidiUtilStringPointerMap_get(MidiUtilStringPointerMap_t map, unsigned char *key);
 void MidiUtilStringPointerMap_set(MidiUtilStringPointerMap_t map, unsigned char *key, void *value);
 void MidiUtilStringPointerMap_remove(MidiUtilStringPointerMap_t map, unsigned char *key);
 void MidiUtilStringPointerMap_enumerate(MidiUtilStringPointerMap_t map, int (*callback)(unsigned char *key, void *value, void *user_data), void *user_data);
+int MidiUtilStringPointerMap_getNext(MidiUtilStringPointerMap_t map, int *position, unsigned char **key, void **value);
 
 void MidiUtil_quicksort(int number_of_elements, int (*compare_callback)(int first_element_number, int second_element_number, void *user_data), void (*exchange_callback)(int first_element_number, int second_element_number, void *user_data), void *user_data);
 void MidiUtil_heapsort(int number_of_elements, int (*compare_callback)(int first_element_number, int second_element_number, void *user_data), void (*exchange_callback)(int first_element_number, int second_element_number, void *user_data), void *user_data);
@@ -8,13 +8,18 @@
 #include <string.h>
 
 #ifndef _WIN32
+#include <errno.h>
 #include <pthread.h>
 #include <signal.h>
-#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #include <midiutil-common.h>
 #include <midiutil-system.h>
 
@@ -29,14 +34,70 @@ struct MidiUtilLock
 #endif
 };
 
+/* Alarms are kept in a binary heap of slot numbers, and freed slots are reused through a list threaded through heap_index. */
+#define MIDI_UTIL_ALARM_SLOT_BITS 24
+
+struct MidiUtilAlarmEntry
+{
+	long long end_time_nsecs;
+	long long handle; /* zero while the slot is free */
+	void (*callback)(int cancelled, void *user_data);
+	void *user_data;
+	int heap_index; /* next free slot number while the slot is free */
+};
+
 struct MidiUtilAlarm
 {
 	MidiUtilLock_t lock;
-	MidiUtilLongArray_t end_time_msecs_array;
-	MidiUtilPointerArray_t callback_array;
-	MidiUtilPointerArray_t user_data_array;
+	struct MidiUtilAlarmEntry *entries;
+	int number_of_entries;
+	int entry_capacity;
+	int first_free_entry_number;
+	int *heap;
+	int heap_size;
+	long long next_sequence_number;
+	int number_of_running_threads;
 	int start_shutdown;
-	int finish_shutdown;
+};
+
+/* Messages up to this size are copied into the ring slot itself, and only longer ones such as sysex go through the arena. */
+#define MIDI_UTIL_MESSAGE_RING_INLINE_SIZE 12
+#define MIDI_UTIL_CACHE_LINE_SIZE 64
+
+struct MidiUtilMessageRingSlot
+{
+	double timestamp;
+	int message_size;
+	unsigned char message[MIDI_UTIL_MESSAGE_RING_INLINE_SIZE];
+	unsigned long sysex_position;
+};
+
+struct MidiUtilMessageRing
+{
+	struct MidiUtilMessageRingSlot *slots;
+	unsigned long number_of_slots;
+	unsigned char *sysex_buffer;
+	unsigned long sysex_buffer_size;
+#ifndef __linux__
+	MidiUtilLock_t lock;
+#endif
+
+	/* The padding keeps what each side writes on a cache line of its own, so the two threads do not keep taking it away from each other.  Each side also caches the other's position and only reloads it when the ring looks full or empty. */
+	char producer_padding[MIDI_UTIL_CACHE_LINE_SIZE];
+	volatile unsigned long write_position;
+	unsigned long sysex_write_position;
+	unsigned long cached_read_position;
+	unsigned long cached_sysex_read_position;
+
+	char consumer_padding[MIDI_UTIL_CACHE_LINE_SIZE];
+	volatile unsigned long read_position;
+	volatile unsigned long sysex_read_position;
+	unsigned long cached_write_position;
+	int has_pending_message;
+
+	char wakeup_padding[MIDI_UTIL_CACHE_LINE_SIZE];
+	volatile int is_consumer_waiting;
+	volatile int has_wakeup;
 };
 
 void MidiUtil_startThread(void (*callback)(void *user_data), void *user_data)
@@ -50,6 +111,18 @@ void MidiUtil_startThread(void (*callback)(void *user_data), void *user_data)
 #endif
 }
 
+int MidiUtil_getNumberOfProcessors(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO system_info;
+	GetSystemInfo(&system_info);
+	return (int)(system_info.dwNumberOfProcessors);
+#else
+	long number_of_processors = sysconf(_SC_NPROCESSORS_ONLN);
+	return (number_of_processors < 1) ? 1 : (int)(number_of_processors);
+#endif
+}
+
 MidiUtilLock_t MidiUtilLock_new(void)
 {
 	MidiUtilLock_t lock = (MidiUtilLock_t)(malloc(sizeof (struct MidiUtilLock)));
@@ -57,8 +130,14 @@ MidiUtilLock_t MidiUtilLock_new(void)
 	InitializeCriticalSection(&(lock->critical_section));
 	InitializeConditionVariable(&(lock->condition_variable));
 #else
+	pthread_condattr_t condattr;
 	pthread_mutex_init(&(lock->mutex), NULL);
-	pthread_cond_init(&(lock->cond), NULL);
+	pthread_condattr_init(&condattr);
+#ifndef __APPLE__
+	pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC); /* so timeouts are not thrown off by changes to the wall clock */
+#endif
+	pthread_cond_init(&(lock->cond), &condattr);
+	pthread_condattr_destroy(&condattr);
 #endif
 	return lock;
 }
@@ -103,17 +182,33 @@ void MidiUtilLock_wait(MidiUtilLock_t lock, long timeout_msecs)
 	}
 	else
 	{
-		struct timeval current_time;
-		struct timespec target_time;
-
-		gettimeofday(&current_time, NULL);
-		target_time.tv_sec = current_time.tv_sec + (timeout_msecs / 1000);
-		target_time.tv_nsec = (current_time.tv_usec + (((timeout_msecs + 1000) % 1000) * 1000)) * 1000;
-		pthread_cond_timedwait(&(lock->cond), &(lock->mutex), &target_time);
+		MidiUtilLock_waitUntil(lock, MidiUtil_getCurrentTimeNsecs() + ((long long)(timeout_msecs) * 1000000));
 	}
 #endif
 }
 
+void MidiUtilLock_waitUntil(MidiUtilLock_t lock, long long end_time_nsecs)
+{
+#ifdef _WIN32
+	long long timeout_nsecs = end_time_nsecs - MidiUtil_getCurrentTimeNsecs();
+	SleepConditionVariableCS(&(lock->condition_variable), &(lock->critical_section), (timeout_nsecs <= 0) ? 0 : (DWORD)((timeout_nsecs + 999999) / 1000000));
+#elif defined(__APPLE__)
+	long long timeout_nsecs = end_time_nsecs - MidiUtil_getCurrentTimeNsecs();
+	struct timespec timeout;
+
+	if (timeout_nsecs < 0) timeout_nsecs = 0;
+	timeout.tv_sec = (time_t)(timeout_nsecs / 1000000000);
+	timeout.tv_nsec = (long)(timeout_nsecs % 1000000000);
+	pthread_cond_timedwait_relative_np(&(lock->cond), &(lock->mutex), &timeout);
+#else
+	struct timespec end_time;
+
+	end_time.tv_sec = (time_t)(end_time_nsecs / 1000000000);
+	end_time.tv_nsec = (long)(end_time_nsecs % 1000000000);
+	pthread_cond_timedwait(&(lock->cond), &(lock->mutex), &end_time);
+#endif
+}
+
 void MidiUtilLock_notify(MidiUtilLock_t lock)
 {
 #ifdef _WIN32
@@ -137,18 +232,61 @@ void MidiUtil_sleep(long msecs)
 #ifdef _WIN32
 	Sleep(msecs);
 #else
-	usleep(msecs * 1000);
+	MidiUtil_sleepUntil(MidiUtil_getCurrentTimeNsecs() + ((long long)(msecs) * 1000000));
+#endif
+}
+
+void MidiUtil_sleepUntil(long long end_time_nsecs)
+{
+#ifdef _WIN32
+	long long timeout_nsecs = end_time_nsecs - MidiUtil_getCurrentTimeNsecs();
+	if (timeout_nsecs > 0) Sleep((DWORD)((timeout_nsecs + 999999) / 1000000));
+#elif defined(__APPLE__)
+	long long timeout_nsecs;
+	struct timespec timeout;
+
+	while ((timeout_nsecs = end_time_nsecs - MidiUtil_getCurrentTimeNsecs()) > 0)
+	{
+		timeout.tv_sec = (time_t)(timeout_nsecs / 1000000000);
+		timeout.tv_nsec = (long)(timeout_nsecs % 1000000000);
+		nanosleep(&timeout, NULL);
+	}
+#else
+	struct timespec end_time;
+
+	end_time.tv_sec = (time_t)(end_time_nsecs / 1000000000);
+	end_time.tv_nsec = (long)(end_time_nsecs % 1000000000);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &end_time, NULL) == EINTR);
+#endif
+}
+
+long long MidiUtil_getCurrentTimeNsecs(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return ((counter.QuadPart / frequency.QuadPart) * 1000000000) + (((counter.QuadPart % frequency.QuadPart) * 1000000000) / frequency.QuadPart);
+#else
+	struct timespec current_time;
+	clock_gettime(CLOCK_MONOTONIC, &current_time);
+	return ((long long)(current_time.tv_sec) * 1000000000) + current_time.tv_nsec;
 #endif
 }
 
+static volatile long long msecs_origin_nsecs = 0;
+
 long MidiUtil_getCurrentTimeMsecs(void)
 {
+	/* Counted from the first call rather than from boot, so that a 32-bit long, as on Windows, lasts 24 days of running rather than of uptime. */
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 #ifdef _WIN32
-	return (long)(timeGetTime());
+	InterlockedCompareExchange64((LONGLONG volatile *)(&msecs_origin_nsecs), current_time_nsecs, 0);
+	return (long)((current_time_nsecs - InterlockedCompareExchange64((LONGLONG volatile *)(&msecs_origin_nsecs), 0, 0)) / 1000000);
 #else
-	struct timeval current_time;
-	gettimeofday(&current_time, NULL);
-	return ((long)(current_time.tv_sec) * 1000) + (long)(current_time.tv_usec / 1000);
+	long long origin_nsecs = 0;
+	__atomic_compare_exchange_n(&msecs_origin_nsecs, &origin_nsecs, current_time_nsecs, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	return (long)((current_time_nsecs - __atomic_load_n(&msecs_origin_nsecs, __ATOMIC_ACQUIRE)) / 1000000);
 #endif
 }
 
@@ -256,137 +394,507 @@ void MidiUtil_waitForExit(void (*callback)(void *user_data), void *user_data)
 
 #endif
 
-static void alarm_helper(void *user_data)
+static int alarm_entry_is_earlier(MidiUtilAlarm_t alarm, int entry_number, int other_entry_number)
 {
-	MidiUtilAlarm_t alarm = (MidiUtilAlarm_t)(user_data);
-	int should_shutdown = 0;
+	/* Handles grow with every add, so breaking ties on them fires alarms for the same time in the order they were added. */
+	struct MidiUtilAlarmEntry *entry = &(alarm->entries[entry_number]);
+	struct MidiUtilAlarmEntry *other_entry = &(alarm->entries[other_entry_number]);
+	return (entry->end_time_nsecs < other_entry->end_time_nsecs) || ((entry->end_time_nsecs == other_entry->end_time_nsecs) && (entry->handle < other_entry->handle));
+}
+
+static void set_alarm_heap_entry(MidiUtilAlarm_t alarm, int heap_index, int entry_number)
+{
+	alarm->heap[heap_index] = entry_number;
+	alarm->entries[entry_number].heap_index = heap_index;
+}
+
+static void sift_alarm_up(MidiUtilAlarm_t alarm, int heap_index)
+{
+	int entry_number = alarm->heap[heap_index];
+
+	while (heap_index > 0)
+	{
+		int parent_heap_index = (heap_index - 1) / 2;
+		if (!alarm_entry_is_earlier(alarm, entry_number, alarm->heap[parent_heap_index])) break;
+		set_alarm_heap_entry(alarm, heap_index, alarm->heap[parent_heap_index]);
+		heap_index = parent_heap_index;
+	}
+
+	set_alarm_heap_entry(alarm, heap_index, entry_number);
+}
 
-	while (!should_shutdown)
+static void sift_alarm_down(MidiUtilAlarm_t alarm, int heap_index)
+{
+	int entry_number = alarm->heap[heap_index];
+
+	while (1)
 	{
-		void (*callback)(int cancelled, void *user_data) = NULL;
-		void *user_data = NULL;
+		int child_heap_index = (heap_index * 2) + 1;
+		if (child_heap_index >= alarm->heap_size) break;
+		if ((child_heap_index + 1 < alarm->heap_size) && alarm_entry_is_earlier(alarm, alarm->heap[child_heap_index + 1], alarm->heap[child_heap_index])) child_heap_index++;
+		if (!alarm_entry_is_earlier(alarm, alarm->heap[child_heap_index], entry_number)) break;
+		set_alarm_heap_entry(alarm, heap_index, alarm->heap[child_heap_index]);
+		heap_index = child_heap_index;
+	}
 
-		MidiUtilLock_lock(alarm->lock);
+	set_alarm_heap_entry(alarm, heap_index, entry_number);
+}
+
+static long long add_alarm_entry(MidiUtilAlarm_t alarm, long long end_time_nsecs, void (*callback)(int cancelled, void *user_data), void *user_data)
+{
+	int entry_number;
+	struct MidiUtilAlarmEntry *entry;
+
+	if (alarm->first_free_entry_number >= 0)
+	{
+		entry_number = alarm->first_free_entry_number;
+		alarm->first_free_entry_number = alarm->entries[entry_number].heap_index;
+	}
+	else
+	{
+		/* The slot number has to fit below the sequence number in the handle. */
+		if (alarm->number_of_entries == (1 << MIDI_UTIL_ALARM_SLOT_BITS)) return 0;
 
-		if (alarm->start_shutdown)
+		if (alarm->number_of_entries == alarm->entry_capacity)
 		{
-			should_shutdown = 1;
-			alarm->finish_shutdown = 1;
-			MidiUtilLock_notify(alarm->lock);
+			alarm->entry_capacity *= 2;
+			alarm->entries = (struct MidiUtilAlarmEntry *)(realloc(alarm->entries, alarm->entry_capacity * sizeof (struct MidiUtilAlarmEntry)));
+			alarm->heap = (int *)(realloc(alarm->heap, alarm->entry_capacity * sizeof (int)));
 		}
-		else if (MidiUtilPointerArray_getSize(alarm->callback_array) > 0)
+
+		entry_number = alarm->number_of_entries++;
+	}
+
+	entry = &(alarm->entries[entry_number]);
+	entry->end_time_nsecs = end_time_nsecs;
+	entry->handle = (alarm->next_sequence_number++ << MIDI_UTIL_ALARM_SLOT_BITS) | entry_number;
+	entry->callback = callback;
+	entry->user_data = user_data;
+	alarm->heap[alarm->heap_size] = entry_number;
+	sift_alarm_up(alarm, alarm->heap_size++);
+
+	/* Only a new earliest alarm changes how long the dispatcher has to wait. */
+	if (entry->heap_index == 0) MidiUtilLock_notify(alarm->lock);
+	return entry->handle;
+}
+
+static void remove_alarm_entry(MidiUtilAlarm_t alarm, int entry_number)
+{
+	int heap_index = alarm->entries[entry_number].heap_index;
+
+	if (heap_index < --(alarm->heap_size))
+	{
+		int last_entry_number = alarm->heap[alarm->heap_size];
+		set_alarm_heap_entry(alarm, heap_index, last_entry_number);
+		sift_alarm_up(alarm, heap_index);
+		sift_alarm_down(alarm, alarm->entries[last_entry_number].heap_index);
+	}
+
+	alarm->entries[entry_number].handle = 0;
+	alarm->entries[entry_number].heap_index = alarm->first_free_entry_number;
+	alarm->first_free_entry_number = entry_number;
+}
+
+static void take_alarm_entry(MidiUtilAlarm_t alarm, int entry_number, MidiUtilPointerArray_t callback_array, MidiUtilPointerArray_t user_data_array)
+{
+	MidiUtilPointerArray_add(callback_array, alarm->entries[entry_number].callback);
+	MidiUtilPointerArray_add(user_data_array, alarm->entries[entry_number].user_data);
+	remove_alarm_entry(alarm, entry_number);
+}
+
+static void call_alarm_callbacks(int cancelled, MidiUtilPointerArray_t callback_array, MidiUtilPointerArray_t user_data_array)
+{
+	/* Only ever called without the lock, so that a callback can add or cancel alarms itself. */
+	int number_of_callbacks = MidiUtilPointerArray_getSize(callback_array);
+	int callback_number;
+
+	for (callback_number = 0; callback_number < number_of_callbacks; callback_number++)
+	{
+		((void (*)(int cancelled, void *user_data))(MidiUtilPointerArray_get(callback_array, callback_number)))(cancelled, MidiUtilPointerArray_get(user_data_array, callback_number));
+	}
+
+	MidiUtilPointerArray_clear(callback_array);
+	MidiUtilPointerArray_clear(user_data_array);
+}
+
+static void cancel_all_alarm_entries(MidiUtilAlarm_t alarm, MidiUtilPointerArray_t callback_array, MidiUtilPointerArray_t user_data_array)
+{
+	while (alarm->heap_size > 0) take_alarm_entry(alarm, alarm->heap[0], callback_array, user_data_array);
+}
+
+static void alarm_helper(void *user_data)
+{
+	MidiUtilAlarm_t alarm = (MidiUtilAlarm_t)(user_data);
+	MidiUtilPointerArray_t callback_array = MidiUtilPointerArray_new(32);
+	MidiUtilPointerArray_t user_data_array = MidiUtilPointerArray_new(32);
+
+	MidiUtilLock_lock(alarm->lock);
+
+	while (!(alarm->start_shutdown))
+	{
+		if (alarm->heap_size == 0)
 		{
-			long msecs = MidiUtilLongArray_get(alarm->end_time_msecs_array, 0) - MidiUtil_getCurrentTimeMsecs();
+			MidiUtilLock_wait(alarm->lock, -1);
+		}
+		else
+		{
+			long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 
-			if (msecs > 0)
+			if (alarm->entries[alarm->heap[0]].end_time_nsecs > current_time_nsecs)
 			{
-				MidiUtilLock_wait(alarm->lock, msecs);
+				MidiUtilLock_waitUntil(alarm->lock, alarm->entries[alarm->heap[0]].end_time_nsecs);
 			}
 			else
 			{
-				callback = (void (*)(int cancelled, void *user_data))(MidiUtilPointerArray_get(alarm->callback_array, 0));
-				user_data = MidiUtilPointerArray_get(alarm->user_data_array, 0);
-				MidiUtilLongArray_remove(alarm->end_time_msecs_array, 0);
-				MidiUtilPointerArray_remove(alarm->callback_array, 0);
-				MidiUtilPointerArray_remove(alarm->user_data_array, 0);
+				/* Take everything that is due in one go, so that a burst of alarms costs one wakeup and one lock round trip. */
+				while ((alarm->heap_size > 0) && (alarm->entries[alarm->heap[0]].end_time_nsecs <= current_time_nsecs)) take_alarm_entry(alarm, alarm->heap[0], callback_array, user_data_array);
+
+				/* Let another dispatcher, if any, watch for the next alarm while this one is busy with callbacks. */
+				if (alarm->heap_size > 0) MidiUtilLock_notify(alarm->lock);
+
+				MidiUtilLock_unlock(alarm->lock);
+				call_alarm_callbacks(0, callback_array, user_data_array);
+				MidiUtilLock_lock(alarm->lock);
 			}
 		}
-
-		MidiUtilLock_unlock(alarm->lock);
-		if (callback != NULL) callback(0, user_data);
 	}
+
+	alarm->number_of_running_threads--;
+	MidiUtilLock_notifyAll(alarm->lock);
+	MidiUtilLock_unlock(alarm->lock);
+	MidiUtilPointerArray_free(callback_array);
+	MidiUtilPointerArray_free(user_data_array);
 }
 
 MidiUtilAlarm_t MidiUtilAlarm_new(void)
 {
-	MidiUtilAlarm_t alarm = (MidiUtilAlarm_t)(malloc(sizeof(struct MidiUtilAlarm)));
+	return MidiUtilAlarm_newWithThreads(1);
+}
+
+MidiUtilAlarm_t MidiUtilAlarm_newWithThreads(int number_of_threads)
+{
+	MidiUtilAlarm_t alarm;
+	int thread_number;
+
+	if (number_of_threads < 1) return NULL;
+	alarm = (MidiUtilAlarm_t)(malloc(sizeof(struct MidiUtilAlarm)));
 	alarm->lock = MidiUtilLock_new();
-	alarm->end_time_msecs_array = MidiUtilLongArray_new(128);
-	alarm->callback_array = MidiUtilPointerArray_new(128);
-	alarm->user_data_array = MidiUtilPointerArray_new(128);
+	alarm->entry_capacity = 128;
+	alarm->entries = (struct MidiUtilAlarmEntry *)(malloc(alarm->entry_capacity * sizeof (struct MidiUtilAlarmEntry)));
+	alarm->number_of_entries = 0;
+	alarm->first_free_entry_number = -1;
+	alarm->heap = (int *)(malloc(alarm->entry_capacity * sizeof (int)));
+	alarm->heap_size = 0;
+	alarm->next_sequence_number = 1;
+	alarm->number_of_running_threads = number_of_threads;
 	alarm->start_shutdown = 0;
-	alarm->finish_shutdown = 0;
-	MidiUtil_startThread(alarm_helper, alarm);
+	for (thread_number = 0; thread_number < number_of_threads; thread_number++) MidiUtil_startThread(alarm_helper, alarm);
 	return alarm;
 }
 
 void MidiUtilAlarm_free(MidiUtilAlarm_t alarm)
 {
-	MidiUtilLock_lock(alarm->lock);
-	alarm->start_shutdown = 1;
-	MidiUtilLock_notify(alarm->lock);
-	MidiUtilLock_unlock(alarm->lock);
+	MidiUtilPointerArray_t callback_array = MidiUtilPointerArray_new(8);
+	MidiUtilPointerArray_t user_data_array = MidiUtilPointerArray_new(8);
 
 	MidiUtilLock_lock(alarm->lock);
-	while (!(alarm->finish_shutdown)) MidiUtilLock_wait(alarm->lock, -1);
+	alarm->start_shutdown = 1;
+	MidiUtilLock_notifyAll(alarm->lock);
+	while (alarm->number_of_running_threads > 0) MidiUtilLock_wait(alarm->lock, -1);
+	cancel_all_alarm_entries(alarm, callback_array, user_data_array);
 	MidiUtilLock_unlock(alarm->lock);
+	call_alarm_callbacks(1, callback_array, user_data_array);
+	MidiUtilPointerArray_free(callback_array);
+	MidiUtilPointerArray_free(user_data_array);
 
-	MidiUtilLongArray_free(alarm->end_time_msecs_array);
-	MidiUtilPointerArray_free(alarm->callback_array);
-	MidiUtilPointerArray_free(alarm->user_data_array);
+	free(alarm->entries);
+	free(alarm->heap);
 	MidiUtilLock_free(alarm->lock);
 	free(alarm);
 }
 
-void MidiUtilAlarm_set(MidiUtilAlarm_t alarm, long msecs, void (*callback)(int cancelled, void *user_data), void *user_data)
+long long MidiUtilAlarm_set(MidiUtilAlarm_t alarm, long msecs, void (*callback)(int cancelled, void *user_data), void *user_data)
 {
-	long end_time_msecs = MidiUtil_getCurrentTimeMsecs() + msecs;
-	int number_of_events, event_number;
+	long long end_time_nsecs = MidiUtil_getCurrentTimeNsecs() + ((long long)(msecs) * 1000000);
+	MidiUtilPointerArray_t callback_array = MidiUtilPointerArray_new(8);
+	MidiUtilPointerArray_t user_data_array = MidiUtilPointerArray_new(8);
+	long long handle;
 
 	MidiUtilLock_lock(alarm->lock);
-	number_of_events = MidiUtilPointerArray_getSize(alarm->callback_array);
+	cancel_all_alarm_entries(alarm, callback_array, user_data_array);
+	handle = add_alarm_entry(alarm, end_time_nsecs, callback, user_data);
+	MidiUtilLock_unlock(alarm->lock);
+	call_alarm_callbacks(1, callback_array, user_data_array);
+	MidiUtilPointerArray_free(callback_array);
+	MidiUtilPointerArray_free(user_data_array);
+	return handle;
+}
 
-	for (event_number = 0; event_number < number_of_events; event_number++)
-	{
-		((void (*)(int cancelled, void *user_data))(MidiUtilPointerArray_get(alarm->callback_array, event_number)))(1, MidiUtilPointerArray_get(alarm->user_data_array, event_number));
-	}
+long long MidiUtilAlarm_add(MidiUtilAlarm_t alarm, long msecs, void (*callback)(int cancelled, void *user_data), void *user_data)
+{
+	return MidiUtilAlarm_addAt(alarm, MidiUtil_getCurrentTimeNsecs() + ((long long)(msecs) * 1000000), callback, user_data);
+}
 
-	MidiUtilLongArray_clear(alarm->end_time_msecs_array);
-	MidiUtilPointerArray_clear(alarm->callback_array);
-	MidiUtilPointerArray_clear(alarm->user_data_array);
-	MidiUtilLongArray_add(alarm->end_time_msecs_array, end_time_msecs);
-	MidiUtilPointerArray_add(alarm->callback_array, callback);
-	MidiUtilPointerArray_add(alarm->user_data_array, user_data);
-	MidiUtilLock_notify(alarm->lock);
+long long MidiUtilAlarm_addAt(MidiUtilAlarm_t alarm, long long end_time_nsecs, void (*callback)(int cancelled, void *user_data), void *user_data)
+{
+	long long handle;
+
+	MidiUtilLock_lock(alarm->lock);
+	handle = add_alarm_entry(alarm, end_time_nsecs, callback, user_data);
 	MidiUtilLock_unlock(alarm->lock);
+	return handle;
 }
 
-void MidiUtilAlarm_add(MidiUtilAlarm_t alarm, long msecs, void (*callback)(int cancelled, void *user_data), void *user_data)
+int MidiUtilAlarm_cancelOne(MidiUtilAlarm_t alarm, long long handle)
 {
-	long end_time_msecs = MidiUtil_getCurrentTimeMsecs() + msecs;
-	int number_of_events, event_number;
+	int entry_number = (int)(handle & ((1 << MIDI_UTIL_ALARM_SLOT_BITS) - 1));
+	void (*callback)(int cancelled, void *user_data) = NULL;
+	void *user_data = NULL;
 
 	MidiUtilLock_lock(alarm->lock);
-	number_of_events = MidiUtilPointerArray_getSize(alarm->callback_array);
 
-	for (event_number = number_of_events - 1; event_number >= 0; event_number--)
+	/* A handle from an alarm that has already fired or been cancelled no longer matches its slot, even once the slot has been reused. */
+	if ((handle > 0) && (entry_number < alarm->number_of_entries) && (alarm->entries[entry_number].handle == handle))
 	{
-		if (end_time_msecs >= MidiUtilLongArray_get(alarm->end_time_msecs_array, event_number)) break;
+		callback = alarm->entries[entry_number].callback;
+		user_data = alarm->entries[entry_number].user_data;
+		remove_alarm_entry(alarm, entry_number);
 	}
 
-	MidiUtilLongArray_insert(alarm->end_time_msecs_array, event_number + 1, end_time_msecs);
-	MidiUtilPointerArray_insert(alarm->callback_array, event_number + 1, callback);
-	MidiUtilPointerArray_insert(alarm->user_data_array, event_number + 1, user_data);
-	MidiUtilLock_notify(alarm->lock);
 	MidiUtilLock_unlock(alarm->lock);
+	if (callback == NULL) return -1;
+	callback(1, user_data);
+	return 0;
 }
 
 void MidiUtilAlarm_cancel(MidiUtilAlarm_t alarm)
 {
-	int number_of_events, event_number;
+	MidiUtilPointerArray_t callback_array = MidiUtilPointerArray_new(8);
+	MidiUtilPointerArray_t user_data_array = MidiUtilPointerArray_new(8);
 
 	MidiUtilLock_lock(alarm->lock);
-	number_of_events = MidiUtilPointerArray_getSize(alarm->callback_array);
+	cancel_all_alarm_entries(alarm, callback_array, user_data_array);
+	MidiUtilLock_unlock(alarm->lock);
+	call_alarm_callbacks(1, callback_array, user_data_array);
+	MidiUtilPointerArray_free(callback_array);
+	MidiUtilPointerArray_free(user_data_array);
+}
+
+static unsigned long load_ring_position(volatile unsigned long *position)
+{
+#ifdef _WIN32
+	return (unsigned long)(InterlockedCompareExchange((LONG volatile *)(position), 0, 0));
+#else
+	return __atomic_load_n(position, __ATOMIC_ACQUIRE);
+#endif
+}
 
-	for (event_number = 0; event_number < number_of_events; event_number++)
+static void store_ring_position(volatile unsigned long *position, unsigned long value)
+{
+#ifdef _WIN32
+	InterlockedExchange((LONG volatile *)(position), (LONG)(value));
+#else
+	__atomic_store_n(position, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static int load_ring_flag(volatile int *flag)
+{
+#ifdef _WIN32
+	return (int)(InterlockedCompareExchange((LONG volatile *)(flag), 0, 0));
+#else
+	return __atomic_load_n(flag, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static int exchange_ring_flag(volatile int *flag, int value)
+{
+#ifdef _WIN32
+	return (int)(InterlockedExchange((LONG volatile *)(flag), value));
+#else
+	return __atomic_exchange_n(flag, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static int message_ring_has_messages(MidiUtilMessageRing_t ring)
+{
+	return (load_ring_position(&(ring->write_position)) != ring->read_position + ring->has_pending_message);
+}
+
+static void wake_message_ring_consumer(MidiUtilMessageRing_t ring)
+{
+	/* Only costs a system call when the consumer has actually gone to sleep. */
+	if (exchange_ring_flag(&(ring->is_consumer_waiting), 0))
 	{
-		((void (*)(int cancelled, void *user_data))(MidiUtilPointerArray_get(alarm->callback_array, event_number)))(1, MidiUtilPointerArray_get(alarm->user_data_array, event_number));
+#ifdef __linux__
+		syscall(SYS_futex, &(ring->is_consumer_waiting), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+		MidiUtilLock_lock(ring->lock);
+		MidiUtilLock_notify(ring->lock);
+		MidiUtilLock_unlock(ring->lock);
+#endif
 	}
+}
 
-	MidiUtilLongArray_clear(alarm->end_time_msecs_array);
-	MidiUtilPointerArray_clear(alarm->callback_array);
-	MidiUtilPointerArray_clear(alarm->user_data_array);
-	MidiUtilLock_notify(alarm->lock);
-	MidiUtilLock_unlock(alarm->lock);
+MidiUtilMessageRing_t MidiUtilMessageRing_new(int number_of_messages, int sysex_buffer_size)
+{
+	MidiUtilMessageRing_t ring;
+
+	if ((number_of_messages < 1) || (sysex_buffer_size < 0)) return NULL;
+	ring = (MidiUtilMessageRing_t)(calloc(1, sizeof (struct MidiUtilMessageRing)));
+
+	/* Powers of two, so that positions can run on freely and just be masked. */
+	ring->number_of_slots = 1;
+	while (ring->number_of_slots < (unsigned long)(number_of_messages)) ring->number_of_slots *= 2;
+	ring->slots = (struct MidiUtilMessageRingSlot *)(malloc(ring->number_of_slots * sizeof (struct MidiUtilMessageRingSlot)));
+	ring->sysex_buffer_size = 1;
+	while (ring->sysex_buffer_size < (unsigned long)(sysex_buffer_size)) ring->sysex_buffer_size *= 2;
+	ring->sysex_buffer = (unsigned char *)(malloc(ring->sysex_buffer_size));
+#ifndef __linux__
+	ring->lock = MidiUtilLock_new();
+#endif
+	return ring;
 }
 
+void MidiUtilMessageRing_free(MidiUtilMessageRing_t ring)
+{
+#ifndef __linux__
+	MidiUtilLock_free(ring->lock);
+#endif
+	free(ring->sysex_buffer);
+	free(ring->slots);
+	free(ring);
+}
+
+int MidiUtilMessageRing_put(MidiUtilMessageRing_t ring, double timestamp, const unsigned char *message, int message_size)
+{
+	unsigned long write_position = ring->write_position;
+	struct MidiUtilMessageRingSlot *slot;
+
+	if (write_position - ring->cached_read_position >= ring->number_of_slots)
+	{
+		ring->cached_read_position = load_ring_position(&(ring->read_position));
+		if (write_position - ring->cached_read_position >= ring->number_of_slots) return -1;
+	}
+
+	slot = &(ring->slots[write_position & (ring->number_of_slots - 1)]);
+
+	if (message_size < 0)
+	{
+		return -1;
+	}
+	else if (message_size <= MIDI_UTIL_MESSAGE_RING_INLINE_SIZE)
+	{
+		memcpy(slot->message, message, message_size);
+	}
+	else
+	{
+		/* Sysex goes in the arena in one piece, skipping whatever is left at the end of the buffer if it would not fit there. */
+		unsigned long sysex_position = ring->sysex_write_position;
+		unsigned long offset = sysex_position & (ring->sysex_buffer_size - 1);
+
+		if ((unsigned long)(message_size) > ring->sysex_buffer_size) return -1;
+		if (offset + message_size > ring->sysex_buffer_size) sysex_position += ring->sysex_buffer_size - offset;
+
+		if (sysex_position + message_size - ring->cached_sysex_read_position > ring->sysex_buffer_size)
+		{
+			ring->cached_sysex_read_position = load_ring_position(&(ring->sysex_read_position));
+			if (sysex_position + message_size - ring->cached_sysex_read_position > ring->sysex_buffer_size) return -1;
+		}
+
+		memcpy(ring->sysex_buffer + (sysex_position & (ring->sysex_buffer_size - 1)), message, message_size);
+		slot->sysex_position = sysex_position;
+		ring->sysex_write_position = sysex_position + message_size;
+	}
+
+	slot->timestamp = timestamp;
+	slot->message_size = message_size;
+	store_ring_position(&(ring->write_position), write_position + 1);
+
+#ifndef _WIN32
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+
+	if (load_ring_flag(&(ring->is_consumer_waiting))) wake_message_ring_consumer(ring);
+	return 0;
+}
+
+int MidiUtilMessageRing_get(MidiUtilMessageRing_t ring, double *timestamp, const unsigned char **message, int *message_size)
+{
+	struct MidiUtilMessageRingSlot *slot;
+
+	/* The previous message stays in place until now, so that a sysex pointer handed out last time was valid in between. */
+	if (ring->has_pending_message)
+	{
+		slot = &(ring->slots[ring->read_position & (ring->number_of_slots - 1)]);
+		if (slot->message_size > MIDI_UTIL_MESSAGE_RING_INLINE_SIZE) store_ring_position(&(ring->sysex_read_position), slot->sysex_position + slot->message_size);
+		store_ring_position(&(ring->read_position), ring->read_position + 1);
+		ring->has_pending_message = 0;
+	}
+
+	if (ring->read_position == ring->cached_write_position)
+	{
+		ring->cached_write_position = load_ring_position(&(ring->write_position));
+		if (ring->read_position == ring->cached_write_position) return 0;
+	}
+
+	slot = &(ring->slots[ring->read_position & (ring->number_of_slots - 1)]);
+	if (timestamp != NULL) *timestamp = slot->timestamp;
+	if (message != NULL) *message = (slot->message_size > MIDI_UTIL_MESSAGE_RING_INLINE_SIZE) ? ring->sysex_buffer + (slot->sysex_position & (ring->sysex_buffer_size - 1)) : slot->message;
+	if (message_size != NULL) *message_size = slot->message_size;
+	ring->has_pending_message = 1;
+	return 1;
+}
+
+int MidiUtilMessageRing_wait(MidiUtilMessageRing_t ring, long long end_time_nsecs)
+{
+	int result;
+
+	if (message_ring_has_messages(ring)) return 1;
+	exchange_ring_flag(&(ring->is_consumer_waiting), 1);
+
+#ifdef __linux__
+	while (load_ring_flag(&(ring->is_consumer_waiting)) && (!load_ring_flag(&(ring->has_wakeup))) && (!message_ring_has_messages(ring)))
+	{
+		struct timespec end_time;
+
+		if (end_time_nsecs >= 0)
+		{
+			if (MidiUtil_getCurrentTimeNsecs() >= end_time_nsecs) break;
+			end_time.tv_sec = (time_t)(end_time_nsecs / 1000000000);
+			end_time.tv_nsec = (long)(end_time_nsecs % 1000000000);
+		}
+
+		/* Sleeps only while the flag is still set, so a producer that clears it first cannot be missed.  The bitset variant takes an absolute CLOCK_MONOTONIC deadline. */
+		syscall(SYS_futex, &(ring->is_consumer_waiting), FUTEX_WAIT_BITSET_PRIVATE, 1, (end_time_nsecs >= 0) ? &end_time : NULL, NULL, FUTEX_BITSET_MATCH_ANY);
+	}
+#else
+	MidiUtilLock_lock(ring->lock);
+
+	while (load_ring_flag(&(ring->is_consumer_waiting)) && (!load_ring_flag(&(ring->has_wakeup))) && (!message_ring_has_messages(ring)))
+	{
+		if (end_time_nsecs < 0)
+		{
+			MidiUtilLock_wait(ring->lock, -1);
+		}
+		else
+		{
+			if (MidiUtil_getCurrentTimeNsecs() >= end_time_nsecs) break;
+			MidiUtilLock_waitUntil(ring->lock, end_time_nsecs);
+		}
+	}
+
+	MidiUtilLock_unlock(ring->lock);
+#endif
+
+	exchange_ring_flag(&(ring->is_consumer_waiting), 0);
+	result = message_ring_has_messages(ring);
+	if (exchange_ring_flag(&(ring->has_wakeup), 0)) result = 1;
+	return result;
+}
+
+void MidiUtilMessageRing_wake(MidiUtilMessageRing_t ring)
+{
+	exchange_ring_flag(&(ring->has_wakeup), 1);
+	wake_message_ring_consumer(ring);
+}
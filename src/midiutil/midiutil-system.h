@@ -10,30 +10,48 @@ extern "C"
 
 typedef struct MidiUtilLock *MidiUtilLock_t;
 typedef struct MidiUtilAlarm *MidiUtilAlarm_t;
+typedef struct MidiUtilMessageRing *MidiUtilMessageRing_t;
 
 void MidiUtil_startThread(void (*callback)(void *user_data), void *user_data);
+int MidiUtil_getNumberOfProcessors(void);
 
 MidiUtilLock_t MidiUtilLock_new(void);
 void MidiUtilLock_free(MidiUtilLock_t lock);
 void MidiUtilLock_lock(MidiUtilLock_t lock);
 void MidiUtilLock_unlock(MidiUtilLock_t lock);
 void MidiUtilLock_wait(MidiUtilLock_t lock, long timeout_msecs);
+void MidiUtilLock_waitUntil(MidiUtilLock_t lock, long long end_time_nsecs); /* against MidiUtil_getCurrentTimeNsecs() */
 void MidiUtilLock_notify(MidiUtilLock_t lock);
 void MidiUtilLock_notifyAll(MidiUtilLock_t lock);
 
+/* Times are from a monotonic clock, which only makes sense relative to other such times, and is not affected by changes to the wall clock. */
 void MidiUtil_sleep(long msecs);
-long MidiUtil_getCurrentTimeMsecs(void);
+void MidiUtil_sleepUntil(long long end_time_nsecs);
+long MidiUtil_getCurrentTimeMsecs(void); /* from the first call in the process, so not on the same scale as the nanosecond times */
+long long MidiUtil_getCurrentTimeNsecs(void);
 void MidiUtil_getCurrentTimeString(char *current_time_string); /* YYYYMMDDhhmmss */
 
 void MidiUtil_setInterruptHandler(void (*callback)(void *user_data), void *user_data);
 void MidiUtil_waitForExit(void (*callback)(void *user_data), void *user_data);
 
+/* Callbacks run on a dispatcher thread, with every alarm that is due at the same time fired as one batch.  With several dispatchers, callbacks from different batches can run concurrently.  The add functions return a handle that can cancel just that alarm, or 0 if the alarm already holds 16777216 pending alarms and cannot take another.  Callbacks, including those for cancellations, are called without the alarm locked, so they can add or cancel alarms themselves.  Freeing an alarm cancels whatever is still pending. */
 MidiUtilAlarm_t MidiUtilAlarm_new(void);
+MidiUtilAlarm_t MidiUtilAlarm_newWithThreads(int number_of_threads);
 void MidiUtilAlarm_free(MidiUtilAlarm_t alarm);
-void MidiUtilAlarm_set(MidiUtilAlarm_t alarm, long msecs, void (*callback)(int cancelled, void *user_data), void *user_data);
-void MidiUtilAlarm_add(MidiUtilAlarm_t alarm, long msecs, void (*callback)(int cancelled, void *user_data), void *user_data);
+long long MidiUtilAlarm_set(MidiUtilAlarm_t alarm, long msecs, void (*callback)(int cancelled, void *user_data), void *user_data);
+long long MidiUtilAlarm_add(MidiUtilAlarm_t alarm, long msecs, void (*callback)(int cancelled, void *user_data), void *user_data);
+long long MidiUtilAlarm_addAt(MidiUtilAlarm_t alarm, long long end_time_nsecs, void (*callback)(int cancelled, void *user_data), void *user_data); /* against MidiUtil_getCurrentTimeNsecs() */
+int MidiUtilAlarm_cancelOne(MidiUtilAlarm_t alarm, long long handle); /* -1 if the alarm has already fired or been cancelled */
 void MidiUtilAlarm_cancel(MidiUtilAlarm_t alarm);
 
+/* Hands timestamped messages from one producer thread, typically a MIDI driver callback, to one consumer thread.  Neither side ever takes a lock or blocks, except the consumer when it chooses to wait. */
+MidiUtilMessageRing_t MidiUtilMessageRing_new(int number_of_messages, int sysex_buffer_size);
+void MidiUtilMessageRing_free(MidiUtilMessageRing_t ring);
+int MidiUtilMessageRing_put(MidiUtilMessageRing_t ring, double timestamp, const unsigned char *message, int message_size); /* -1 if the ring is full, in which case the message is dropped */
+int MidiUtilMessageRing_get(MidiUtilMessageRing_t ring, double *timestamp, const unsigned char **message, int *message_size); /* 0 if empty; the message stays valid until the next call */
+int MidiUtilMessageRing_wait(MidiUtilMessageRing_t ring, long long end_time_nsecs); /* -1 to wait forever; 0 on timeout */
+void MidiUtilMessageRing_wake(MidiUtilMessageRing_t ring); /* makes the consumer's current or next wait return */
+
 #ifdef __cplusplus
 }
 #endif
@@ -3,29 +3,66 @@
 #include <stdlib.h>
 #include <string.h>
 #include <midifile.h>
+#include <midiutil-batch.h>
 
 static void usage(char *program_name)
 {
-	printf("Usage: %s <filename>\n", program_name);
+	fprintf(stderr, "Usage:  %s [ --jobs <n> ] [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "(<filename.mid> can also be a directory, a wildcard pattern, or - for a list of filenames on stdin, with --out naming an output directory)\n");
 	exit(1);
 }
 
-int main(int argc, char **argv)
+static int process_file(char *input_filename, char *output_filename, char *error_message, size_t error_message_size, void *user_data)
 {
-	char *filename;
 	MidiFile_t midi_file;
 
-	if (argc != 2) usage(argv[0]);
-	filename = argv[1];
+	if ((midi_file = MidiFile_load(input_filename)) == NULL)
+	{
+		snprintf(error_message, error_message_size, "Cannot read MIDI file \"%s\".", input_filename);
+		return -1;
+	}
 
-	if ((midi_file = MidiFile_load(filename)) == NULL)
+	if (MidiFile_save(midi_file, output_filename) < 0)
 	{
-		printf("Error: Cannot load MIDI file \"%s\".\n", filename);
-		return 1;
+		snprintf(error_message, error_message_size, "Cannot write MIDI file \"%s\".", output_filename);
+		MidiFile_free(midi_file);
+		return -1;
 	}
 
-	MidiFile_save(midi_file, filename);
 	MidiFile_free(midi_file);
 	return 0;
 }
 
+int main(int argc, char **argv)
+{
+	int number_of_jobs = 0;
+	char *output_filename = NULL;
+	char *input_filename = NULL;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--help") == 0)
+		{
+			usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--jobs") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_jobs = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--out") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			output_filename = argv[i];
+		}
+		else
+		{
+			input_filename = argv[i];
+		}
+	}
+
+	if (input_filename == NULL) usage(argv[0]);
+	return (MidiUtil_processFiles(input_filename, output_filename, number_of_jobs, process_file, NULL) == 0) ? 0 : 1;
+}
+
@@ -5,7 +5,8 @@
  * sequence, each with its own notion of the "current event", are continuously
  * created and destroyed in response to the notes being played interactively.
  * Due to the large number of simultaneous players, it uses a game loop rather
- * than alarms.
+ * than alarms, which sleeps until the next event of any player is due or until
+ * a note comes in.
  */
 
 #include <stdio.h>
@@ -20,8 +21,8 @@
 struct Player
 {
 	MidiFileEvent_t event;
-	long start_time_msecs;
-	long stop_time_msecs;
+	long long start_time_nsecs;
+	long long stop_time_nsecs;
 	int base_channel;
 	int base_note;
 	int base_velocity;
@@ -72,9 +73,9 @@ static void send_note_off(int channel, int note, int velocity)
 	}
 }
 
-static void update_trigger_on_players(void)
+static void update_trigger_on_players(long long *next_time_nsecs)
 {
-	long current_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 	int player_number;
 
 	for (player_number = 0; player_number < MidiUtilPointerArray_getSize(trigger_on_players); player_number++)
@@ -83,9 +84,9 @@ static void update_trigger_on_players(void)
 
 		while (player->event != NULL)
 		{
-			long event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000 / tempo_bpm);
+			long long event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000000000.0 / tempo_bpm);
 
-			if (event_time_msecs <= current_time_msecs)
+			if (event_time_nsecs <= current_time_nsecs)
 			{
 				if (MidiFileEvent_isNoteStartEvent(player->event))
 				{
@@ -98,21 +99,22 @@ static void update_trigger_on_players(void)
 			}
 			else
 			{
+				if (event_time_nsecs < *next_time_nsecs) *next_time_nsecs = event_time_nsecs;
 				break;
 			}
 		}
 
 		if (player->event == NULL)
 		{
-			MidiUtilPointerArray_remove(trigger_on_players, player_number--);
+			MidiUtilPointerArray_swapRemove(trigger_on_players, player_number--);
 			free(player);
 		}
 	}
 }
 
-static void update_trigger_off_players(void)
+static void update_trigger_off_players(long long *next_time_nsecs)
 {
-	long current_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 	int player_number;
 
 	for (player_number = 0; player_number < MidiUtilPointerArray_getSize(trigger_off_players); player_number++)
@@ -121,9 +123,9 @@ static void update_trigger_off_players(void)
 
 		while (player->event != NULL)
 		{
-			long event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000 / tempo_bpm);
+			long long event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000000000.0 / tempo_bpm);
 
-			if (event_time_msecs <= current_time_msecs)
+			if (event_time_nsecs <= current_time_nsecs)
 			{
 				/* for trigger, we only care about note-ons in the sequence, even when deciding which note-offs to send */
 				if (MidiFileEvent_isNoteStartEvent(player->event))
@@ -137,21 +139,22 @@ static void update_trigger_off_players(void)
 			}
 			else
 			{
+				if (event_time_nsecs < *next_time_nsecs) *next_time_nsecs = event_time_nsecs;
 				break;
 			}
 		}
 
 		if (player->event == NULL)
 		{
-			MidiUtilPointerArray_remove(trigger_off_players, player_number--);
+			MidiUtilPointerArray_swapRemove(trigger_off_players, player_number--);
 			free(player);
 		}
 	}
 }
 
-static void update_gate_on_players(void)
+static void update_gate_on_players(long long *next_time_nsecs)
 {
-	long current_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 	int player_number;
 
 	for (player_number = 0; player_number < MidiUtilPointerArray_getSize(gate_on_players); player_number++)
@@ -160,9 +163,9 @@ static void update_gate_on_players(void)
 
 		while (player->event != NULL)
 		{
-			long event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000 / tempo_bpm);
+			long long event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000000000.0 / tempo_bpm);
 
-			if (event_time_msecs <= current_time_msecs)
+			if (event_time_nsecs <= current_time_nsecs)
 			{
 				if (MidiFileEvent_isNoteStartEvent(player->event))
 				{
@@ -210,12 +213,12 @@ static void update_gate_on_players(void)
 					/* looping is like a note-off and immediate note-on */
 					Player_t gate_off_player = (Player_t)(malloc(sizeof(struct Player)));
 					gate_off_player->event = MidiFileEvent_getNextEventInFile(player->event);
-					gate_off_player->start_time_msecs = player->start_time_msecs;
-					gate_off_player->stop_time_msecs = current_time_msecs;
+					gate_off_player->start_time_nsecs = player->start_time_nsecs;
+					gate_off_player->stop_time_nsecs = current_time_nsecs;
 					MidiUtilPointerArray_add(gate_off_players, gate_off_player);
 
 					player->event = MidiFile_getFirstEvent(midi_file);
-					player->start_time_msecs = current_time_msecs;
+					player->start_time_nsecs = current_time_nsecs;
 				}
 				else
 				{
@@ -224,21 +227,22 @@ static void update_gate_on_players(void)
 			}
 			else
 			{
+				if (event_time_nsecs < *next_time_nsecs) *next_time_nsecs = event_time_nsecs;
 				break;
 			}
 		}
 
 		if (player->event == NULL)
 		{
-			MidiUtilPointerArray_remove(gate_on_players, player_number--);
+			MidiUtilPointerArray_swapRemove(gate_on_players, player_number--);
 			free(player);
 		}
 	}
 }
 
-static void update_gate_off_players(void)
+static void update_gate_off_players(long long *next_time_nsecs)
 {
-	long current_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 	int player_number;
 
 	/* play the corresponding note-off for each note that was on already, but no new note-ons nor extra note-offs */
@@ -248,9 +252,9 @@ static void update_gate_off_players(void)
 
 		while (player->event != NULL)
 		{
-			long event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000 / tempo_bpm);
+			long long event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000000000.0 / tempo_bpm);
 
-			if (event_time_msecs <= current_time_msecs)
+			if (event_time_nsecs <= current_time_nsecs)
 			{
 				if (MidiFileEvent_isNoteEndEvent(player->event))
 				{
@@ -258,9 +262,9 @@ static void update_gate_off_players(void)
 
 					if (start_event != NULL)
 					{
-						long start_event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(start_event)) * 60000 / tempo_bpm);
+						long long start_event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(start_event)) * 60000000000.0 / tempo_bpm);
 
-						if (start_event_time_msecs <= player->stop_time_msecs)
+						if (start_event_time_nsecs <= player->stop_time_nsecs)
 						{
 							int channel, base_note;
 
@@ -285,21 +289,22 @@ static void update_gate_off_players(void)
 			}
 			else
 			{
+				if (event_time_nsecs < *next_time_nsecs) *next_time_nsecs = event_time_nsecs;
 				break;
 			}
 		}
 
 		if (player->event == NULL)
 		{
-			MidiUtilPointerArray_remove(gate_off_players, player_number--);
+			MidiUtilPointerArray_swapRemove(gate_off_players, player_number--);
 			free(player);
 		}
 	}
 }
 
-static void update_combo_on_players(void)
+static void update_combo_on_players(long long *next_time_nsecs)
 {
-	long current_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 	int player_number;
 
 	for (player_number = 0; player_number < MidiUtilPointerArray_getSize(combo_on_players); player_number++)
@@ -308,9 +313,9 @@ static void update_combo_on_players(void)
 
 		while (player->event != NULL)
 		{
-			long event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000 / tempo_bpm);
+			long long event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000000000.0 / tempo_bpm);
 
-			if (event_time_msecs <= current_time_msecs)
+			if (event_time_nsecs <= current_time_nsecs)
 			{
 				if (MidiFileEvent_isNoteStartEvent(player->event))
 				{
@@ -331,15 +336,15 @@ static void update_combo_on_players(void)
 					/* looping is like a note-off and immediate note-on */
 					Player_t combo_off_player = (Player_t)(malloc(sizeof(struct Player)));
 					combo_off_player->event = MidiFileEvent_getNextEventInFile(player->event);
-					combo_off_player->start_time_msecs = player->start_time_msecs;
-					combo_off_player->stop_time_msecs = current_time_msecs;
+					combo_off_player->start_time_nsecs = player->start_time_nsecs;
+					combo_off_player->stop_time_nsecs = current_time_nsecs;
 					combo_off_player->base_channel = player->base_channel;
 					combo_off_player->base_note = player->base_note;
 					combo_off_player->base_velocity = player->base_velocity;
 					MidiUtilPointerArray_add(combo_off_players, combo_off_player);
 
 					player->event = MidiFile_getFirstEvent(midi_file);
-					player->start_time_msecs = current_time_msecs;
+					player->start_time_nsecs = current_time_nsecs;
 				}
 				else
 				{
@@ -348,6 +353,7 @@ static void update_combo_on_players(void)
 			}
 			else
 			{
+				if (event_time_nsecs < *next_time_nsecs) *next_time_nsecs = event_time_nsecs;
 				break;
 			}
 		}
@@ -360,9 +366,9 @@ static void update_combo_on_players(void)
 	}
 }
 
-static void update_combo_off_players(void)
+static void update_combo_off_players(long long *next_time_nsecs)
 {
-	long current_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 	int player_number;
 
 	/* play the corresponding note-off for each note that was on already, but no new note-ons nor extra note-offs */
@@ -372,9 +378,9 @@ static void update_combo_off_players(void)
 
 		while (player->event != NULL)
 		{
-			long event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000 / tempo_bpm);
+			long long event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(player->event)) * 60000000000.0 / tempo_bpm);
 
-			if (event_time_msecs <= current_time_msecs)
+			if (event_time_nsecs <= current_time_nsecs)
 			{
 				if (MidiFileEvent_isNoteEndEvent(player->event))
 				{
@@ -382,9 +388,9 @@ static void update_combo_off_players(void)
 
 					if (start_event != NULL)
 					{
-						long start_event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(start_event)) * 60000 / tempo_bpm);
+						long long start_event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(start_event)) * 60000000000.0 / tempo_bpm);
 
-						if (start_event_time_msecs <= player->stop_time_msecs)
+						if (start_event_time_nsecs <= player->stop_time_nsecs)
 						{
 							int note = player->base_note + MidiFileNoteEndEvent_getNote(player->event) - 60;
 							if (note >= 0 && note < 128) send_note_off(player->base_channel, note, 0);
@@ -396,13 +402,14 @@ static void update_combo_off_players(void)
 			}
 			else
 			{
+				if (event_time_nsecs < *next_time_nsecs) *next_time_nsecs = event_time_nsecs;
 				break;
 			}
 		}
 
 		if (player->event == NULL)
 		{
-			MidiUtilPointerArray_remove(combo_off_players, player_number--);
+			MidiUtilPointerArray_swapRemove(combo_off_players, player_number--);
 			free(player);
 		}
 	}
@@ -410,29 +417,31 @@ static void update_combo_off_players(void)
 
 static void player_thread_main(void *user_data)
 {
+	MidiUtilLock_lock(lock);
+
 	while (1)
 	{
-		MidiUtilLock_lock(lock);
-		update_trigger_on_players();
-		update_trigger_off_players();
-		update_gate_on_players();
-		update_gate_off_players();
-		update_combo_on_players();
-		update_combo_off_players();
-		MidiUtilLock_unlock(lock);
-		MidiUtil_sleep(1); /* tune this for CPU busyness vs responsiveness */
+		/* sleep until the next event is due, or until a note played in the meantime starts or stops a player */
+		long long next_time_nsecs = MidiUtil_getCurrentTimeNsecs() + 1000000000;
+		update_trigger_on_players(&next_time_nsecs);
+		update_trigger_off_players(&next_time_nsecs);
+		update_gate_on_players(&next_time_nsecs);
+		update_gate_off_players(&next_time_nsecs);
+		update_combo_on_players(&next_time_nsecs);
+		update_combo_off_players(&next_time_nsecs);
+		MidiUtilLock_waitUntil(lock, next_time_nsecs);
 	}
 }
 
 static void handle_virtual_note_on(int channel, int note, int velocity)
 {
-	long current_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 
 	if (trigger)
 	{
 		Player_t player = (Player_t)(malloc(sizeof(struct Player)));
 		player->event = MidiFile_getFirstEvent(midi_file);
-		player->start_time_msecs = current_time_msecs;
+		player->start_time_nsecs = current_time_nsecs;
 		player->base_channel = channel;
 		player->base_note = note;
 		player->base_velocity = velocity;
@@ -450,14 +459,14 @@ static void handle_virtual_note_on(int channel, int note, int velocity)
 	{
 		Player_t player = (Player_t)(malloc(sizeof(struct Player)));
 		player->event = MidiFile_getFirstEvent(midi_file);
-		player->start_time_msecs = current_time_msecs;
+		player->start_time_nsecs = current_time_nsecs;
 		MidiUtilPointerArray_add(gate_on_players, player);
 	}
 }
 
 static void handle_virtual_note_off(int channel, int note, int velocity)
 {
-	long current_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	long long current_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 
 	if (trigger)
 	{
@@ -473,7 +482,7 @@ static void handle_virtual_note_off(int channel, int note, int velocity)
 				if ((player->base_channel == channel) && (player->base_note == note))
 				{
 					MidiUtilPointerArray_remove(combo_on_players, player_number);
-					player->stop_time_msecs = current_time_msecs;
+					player->stop_time_nsecs = current_time_nsecs;
 					MidiUtilPointerArray_add(combo_off_players, player);
 					break;
 				}
@@ -483,7 +492,7 @@ static void handle_virtual_note_off(int channel, int note, int velocity)
 		{
 			Player_t player = (Player_t)(malloc(sizeof(struct Player)));
 			player->event = MidiFile_getFirstEvent(midi_file);
-			player->start_time_msecs = current_time_msecs;
+			player->start_time_nsecs = current_time_nsecs;
 			player->base_channel = channel;
 			player->base_note = note;
 			player->base_velocity = velocity;
@@ -507,9 +516,9 @@ static void handle_virtual_note_off(int channel, int note, int velocity)
 
 					if (end_event != NULL)
 					{
-						long end_event_time_msecs = player->start_time_msecs + (long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(end_event)) * 60000 / tempo_bpm);
+						long long end_event_time_nsecs = player->start_time_nsecs + (long long)(MidiFile_getBeatFromTick(midi_file, MidiFileEvent_getTick(end_event)) * 60000000000.0 / tempo_bpm);
 
-						if (end_event_time_msecs >= current_time_msecs)
+						if (end_event_time_nsecs >= current_time_nsecs)
 						{
 							int on_note = note + MidiFileNoteStartEvent_getNote(event) - 60;
 							if (on_note >= 0 && on_note < 128) send_note_off(channel, on_note, 0);
@@ -622,6 +631,7 @@ static void handle_midi_message(double timestamp, const unsigned char *message,
 		}
 	}
 
+	MidiUtilLock_notify(lock);
 	MidiUtilLock_unlock(lock);
 }
 
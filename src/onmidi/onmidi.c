@@ -7,13 +7,6 @@
 #include <midiutil-system.h>
 #include <midiutil-rtmidi.h>
 
-struct ControllerHoldId
-{
-	int number;
-};
-
-typedef struct ControllerHoldId *ControllerHoldId_t;
-
 static RtMidiInPtr midi_in = NULL;
 static RtMidiOutPtr midi_out = NULL;
 static int hold_length_msecs = 500;
@@ -24,7 +17,7 @@ static char *pitch_wheel_up_command = NULL;
 static char *pitch_wheel_down_command = NULL;
 static MidiUtilAlarm_t alarm = NULL;
 static int controller_state[128];
-static ControllerHoldId_t controller_hold_ids[128];
+static long long controller_hold_alarms[128];
 static int pitch_wheel_state = 0;
 
 static void usage(char *program_name)
@@ -42,18 +35,8 @@ static void run_command_thread_main(void *user_data)
 
 static void handle_controller_alarm(int cancelled, void *user_data)
 {
-	ControllerHoldId_t controller_hold_id = (ControllerHoldId_t)(user_data);
-
-	if (!cancelled)
-	{
-		if (controller_hold_ids[controller_hold_id->number] == controller_hold_id)
-		{
-			controller_hold_ids[controller_hold_id->number] = NULL;
-			MidiUtil_startThread(run_command_thread_main, controller_hold_commands[controller_hold_id->number]);
-		}
-	}
-
-	free(controller_hold_id);
+	char *controller_hold_command = (char *)(user_data);
+	if (!cancelled) MidiUtil_startThread(run_command_thread_main, controller_hold_command);
 }
 
 static void handle_midi_message(double timestamp, const unsigned char *message, size_t message_size, void *user_data)
@@ -97,11 +80,7 @@ static void handle_midi_message(double timestamp, const unsigned char *message,
 					}
 					else
 					{
-						/* We can't cancel individual alarms, so let the alarm fire but compare with a unique id to see if it's still relevant. */
-						ControllerHoldId_t controller_hold_id = (ControllerHoldId_t)(malloc(sizeof (struct ControllerHoldId)));
-						controller_hold_id->number = number;
-						controller_hold_ids[number] = controller_hold_id;
-						MidiUtilAlarm_add(alarm, hold_length_msecs, handle_controller_alarm, controller_hold_id);
+						controller_hold_alarms[number] = MidiUtilAlarm_add(alarm, hold_length_msecs, handle_controller_alarm, controller_hold_commands[number]);
 					}
 				}
 				else if ((value < 56) && (controller_state[number] != 0))
@@ -110,11 +89,9 @@ static void handle_midi_message(double timestamp, const unsigned char *message,
 
 					if (controller_hold_commands[number] != NULL)
 					{
-						if (controller_hold_ids[number] != NULL)
-						{
-							controller_hold_ids[number] = NULL;
-							MidiUtil_startThread(run_command_thread_main, controller_commands[number]);
-						}
+						/* Released before the hold alarm fired, so it was a short press after all. */
+						if (MidiUtilAlarm_cancelOne(alarm, controller_hold_alarms[number]) == 0) MidiUtil_startThread(run_command_thread_main, controller_commands[number]);
+						controller_hold_alarms[number] = 0;
 					}
 				}
 			}
@@ -181,7 +158,7 @@ int main(int argc, char **argv)
 		controller_commands[i] = NULL;
 		controller_hold_commands[i] = NULL;
 		controller_state[i] = 0;
-		controller_hold_ids[i] = NULL;
+		controller_hold_alarms[i] = 0;
 	}
 
 	for (i = 1; i < argc; i++)
@@ -40,7 +40,8 @@ int main(int argc, char **argv)
 	MidiFile_t midi_file;
 	RtMidiOutPtr midi_out = NULL;
 	RtMidiOutPtr track_midi_outs[1024];
-	unsigned long start_time = 0;
+	long long start_time_nsecs = 0;
+	int has_started = 0;
 	MidiFileEvent_t midi_file_event;
 	long from_tick;
 	long to_tick;
@@ -152,28 +153,17 @@ int main(int argc, char **argv)
 
 			if ((!should_shutdown) && in_range)
 			{
-				unsigned long event_time = (unsigned long)(MidiFile_getTimeFromTick(midi_file, tick) * 1000);
+				long long event_time_nsecs = (long long)(MidiFile_getTimeFromTick(midi_file, tick) * 1000000000.0);
 
-				while (!should_shutdown)
+				if (!has_started)
 				{
-					unsigned long current_time = MidiUtil_getCurrentTimeMsecs();
-
-					if (start_time == 0)
-					{
-						start_time = current_time - event_time; /* fake start time based on range */
-					}
-
-					if (current_time - start_time < event_time)
-					{
-						MidiUtilLock_lock(lock);
-						MidiUtilLock_wait(lock, event_time - (current_time - start_time));
-						MidiUtilLock_unlock(lock);
-					}
-					else
-					{
-						break;
-					}
+					start_time_nsecs = MidiUtil_getCurrentTimeNsecs() - event_time_nsecs; /* fake start time based on range */
+					has_started = 1;
 				}
+
+				MidiUtilLock_lock(lock);
+				while ((!should_shutdown) && (MidiUtil_getCurrentTimeNsecs() < start_time_nsecs + event_time_nsecs)) MidiUtilLock_waitUntil(lock, start_time_nsecs + event_time_nsecs);
+				MidiUtilLock_unlock(lock);
 			}
 
 			if (midi_out != NULL)
@@ -193,8 +183,9 @@ int main(int argc, char **argv)
 
 	if ((extra_time > 0) && !should_shutdown)
 	{
+		long long end_time_nsecs = MidiUtil_getCurrentTimeNsecs() + (long long)(extra_time * 1000000000.0);
 		MidiUtilLock_lock(lock);
-		MidiUtilLock_wait(lock, (long)(extra_time * 1000.0));
+		while ((!should_shutdown) && (MidiUtil_getCurrentTimeNsecs() < end_time_nsecs)) MidiUtilLock_waitUntil(lock, end_time_nsecs);
 		MidiUtilLock_unlock(lock);
 	}
 
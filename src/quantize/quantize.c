@@ -4,10 +4,14 @@
 #include <string.h>
 #include <math.h>
 #include <midifile.h>
+#include <midiutil-batch.h>
+
+static int beat_division = -1;
 
 static void usage(char *program_name)
 {
-	fprintf(stderr, "Usage:  %s --beat-division <division> [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "Usage:  %s --beat-division <division> [ --jobs <n> ] [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "(<filename.mid> can also be a directory, a wildcard pattern, or - for a list of filenames on stdin, with --out naming an output directory)\n");
 	exit(1);
 }
 
@@ -38,14 +42,35 @@ static void quantize_event(MidiFileEvent_t event, void *user_data)
 	}
 }
 
+static int process_file(char *input_filename, char *output_filename, char *error_message, size_t error_message_size, void *user_data)
+{
+	MidiFile_t midi_file;
+
+	if ((midi_file = MidiFile_load(input_filename)) == NULL)
+	{
+		snprintf(error_message, error_message_size, "Cannot read MIDI file \"%s\".", input_filename);
+		return -1;
+	}
+
+	MidiFile_visitEvents(midi_file, quantize_event, &beat_division);
+
+	if (MidiFile_save(midi_file, output_filename) < 0)
+	{
+		snprintf(error_message, error_message_size, "Cannot write MIDI file \"%s\".", output_filename);
+		MidiFile_free(midi_file);
+		return -1;
+	}
+
+	MidiFile_free(midi_file);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
-	int beat_division = -1;
+	int number_of_jobs = 0;
 	char *output_filename = NULL;
 	char *input_filename = NULL;
 	int i;
-	MidiFile_t midi_file;
-	MidiFileEvent_t event;
 
 	for (i = 1; i < argc; i++)
 	{
@@ -58,6 +83,11 @@ int main(int argc, char **argv)
 			if (++i == argc) usage(argv[0]);
 			beat_division = atoi(argv[i]);
 		}
+		else if (strcmp(argv[i], "--jobs") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_jobs = atoi(argv[i]);
+		}
 		else if (strcmp(argv[i], "--out") == 0)
 		{
 			if (++i == argc) usage(argv[0]);
@@ -70,23 +100,6 @@ int main(int argc, char **argv)
 	}
 
 	if ((input_filename == NULL) || (beat_division < 1)) usage(argv[0]);
-	if (output_filename == NULL) output_filename = input_filename;
-
-	if ((midi_file = MidiFile_load(input_filename)) == NULL)
-	{
-		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", input_filename);
-		exit(1);
-	}
-
-	MidiFile_visitEvents(midi_file, quantize_event, &beat_division);
-
-	if (MidiFile_save(midi_file, output_filename) < 0)
-	{
-		fprintf(stderr, "Error:  Cannot write MIDI file \"%s\".\n", output_filename);
-		exit(1);
-	}
-
-	MidiFile_free(midi_file);
-	return 0;
+	return (MidiUtil_processFiles(input_filename, output_filename, number_of_jobs, process_file, NULL) == 0) ? 0 : 1;
 }
 
@@ -12,11 +12,14 @@ static char *midi_in_port = NULL;
 static char *filename = NULL;
 static int save_every_msecs = 0;
 static MidiUtilAlarm_t alarm;
+static MidiUtilLock_t lock;
 static RtMidiInPtr midi_in;
-static MidiFile_t midi_file;
-static MidiFileTrack_t track;
-static long start_time_msecs;
-static int changed = 1;
+static MidiFile_t midi_file; /* just the conductor track */
+static MidiFileWriter_t midi_file_writer;
+static int resolution = 960;
+static double tempo_bpm = 100.0;
+static long long start_time_nsecs;
+static int changed = 0;
 
 static void usage(char *program_name)
 {
@@ -26,49 +29,53 @@ static void usage(char *program_name)
 
 static void handle_midi_message(double timestamp, const unsigned char *message, size_t message_size, void *user_data)
 {
-	long tick = MidiFile_getTickFromTime(midi_file, (float)(MidiUtil_getCurrentTimeMsecs() - start_time_msecs) / 1000.0);
+	long tick;
+
+	MidiUtilLock_lock(lock);
+	/* The tempo never changes, so the tick comes straight from the elapsed nanoseconds in double precision; going through float seconds would lose whole ticks in a long session. */
+	tick = (long)((MidiUtil_getCurrentTimeNsecs() - start_time_nsecs) * (tempo_bpm * resolution / 60.0) / 1000000000.0);
 
 	switch (MidiUtilMessage_getType(message))
 	{
 		case MIDI_UTIL_MESSAGE_TYPE_NOTE_OFF:
 		{
-			MidiFileTrack_createNoteOffEvent(track, tick, MidiUtilNoteOffMessage_getChannel(message), MidiUtilNoteOffMessage_getNote(message), MidiUtilNoteOffMessage_getVelocity(message));
+			MidiFileWriter_writeNoteOffEvent(midi_file_writer, tick, MidiUtilNoteOffMessage_getChannel(message), MidiUtilNoteOffMessage_getNote(message), MidiUtilNoteOffMessage_getVelocity(message));
 			changed = 1;
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_NOTE_ON:
 		{
-			MidiFileTrack_createNoteOnEvent(track, tick, MidiUtilNoteOnMessage_getChannel(message), MidiUtilNoteOnMessage_getNote(message), MidiUtilNoteOnMessage_getVelocity(message));
+			MidiFileWriter_writeNoteOnEvent(midi_file_writer, tick, MidiUtilNoteOnMessage_getChannel(message), MidiUtilNoteOnMessage_getNote(message), MidiUtilNoteOnMessage_getVelocity(message));
 			changed = 1;
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_KEY_PRESSURE:
 		{
-			MidiFileTrack_createKeyPressureEvent(track, tick, MidiUtilKeyPressureMessage_getChannel(message), MidiUtilKeyPressureMessage_getNote(message), MidiUtilKeyPressureMessage_getAmount(message));
+			MidiFileWriter_writeKeyPressureEvent(midi_file_writer, tick, MidiUtilKeyPressureMessage_getChannel(message), MidiUtilKeyPressureMessage_getNote(message), MidiUtilKeyPressureMessage_getAmount(message));
 			changed = 1;
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_CONTROL_CHANGE:
 		{
-			MidiFileTrack_createControlChangeEvent(track, tick, MidiUtilControlChangeMessage_getChannel(message), MidiUtilControlChangeMessage_getNumber(message), MidiUtilControlChangeMessage_getValue(message));
+			MidiFileWriter_writeControlChangeEvent(midi_file_writer, tick, MidiUtilControlChangeMessage_getChannel(message), MidiUtilControlChangeMessage_getNumber(message), MidiUtilControlChangeMessage_getValue(message));
 			changed = 1;
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_PROGRAM_CHANGE:
 		{
-			MidiFileTrack_createProgramChangeEvent(track, tick, MidiUtilProgramChangeMessage_getChannel(message), MidiUtilProgramChangeMessage_getNumber(message));
+			MidiFileWriter_writeProgramChangeEvent(midi_file_writer, tick, MidiUtilProgramChangeMessage_getChannel(message), MidiUtilProgramChangeMessage_getNumber(message));
 			changed = 1;
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_CHANNEL_PRESSURE:
 		{
-			MidiFileTrack_createChannelPressureEvent(track, tick, MidiUtilChannelPressureMessage_getChannel(message), MidiUtilChannelPressureMessage_getAmount(message));
+			MidiFileWriter_writeChannelPressureEvent(midi_file_writer, tick, MidiUtilChannelPressureMessage_getChannel(message), MidiUtilChannelPressureMessage_getAmount(message));
 			changed = 1;
 			break;
 		}
 		case MIDI_UTIL_MESSAGE_TYPE_PITCH_WHEEL:
 		{
-			MidiFileTrack_createPitchWheelEvent(track, tick, MidiUtilPitchWheelMessage_getChannel(message), MidiUtilPitchWheelMessage_getValue(message));
+			MidiFileWriter_writePitchWheelEvent(midi_file_writer, tick, MidiUtilPitchWheelMessage_getChannel(message), MidiUtilPitchWheelMessage_getValue(message));
 			changed = 1;
 			break;
 		}
@@ -78,13 +85,20 @@ static void handle_midi_message(double timestamp, const unsigned char *message,
 			break;
 		}
 	}
+
+	MidiUtilLock_unlock(lock);
 }
 
 static void handle_alarm(int cancelled, void *user_data)
 {
-	if (cancelled || !changed) return;
-	MidiFile_save(midi_file, filename);
+	if (cancelled) return;
+
+	/* only what was recorded since the last checkpoint gets written */
+	MidiUtilLock_lock(lock);
+	if (changed) MidiFileWriter_checkpoint(midi_file_writer);
 	changed = 0;
+	MidiUtilLock_unlock(lock);
+
 	MidiUtilAlarm_set(alarm, save_every_msecs, handle_alarm, NULL);
 }
 
@@ -93,20 +107,23 @@ static void handle_exit(void *user_data)
 	MidiUtilAlarm_free(alarm);
 	rtmidi_close_port(midi_in);
 
-	if (MidiFile_save(midi_file, filename) != 0)
+	if (MidiFileWriter_close(midi_file_writer) != 0)
 	{
 		fprintf(stderr, "Error:  Cannot save \"%s\".\n", filename);
 		exit(1);
 	}
 
 	MidiFile_free(midi_file);
+	MidiUtilLock_free(lock);
 }
 
 int main(int argc, char **argv)
 {
 	int i;
+	MidiFileTrack_t track;
 
 	alarm = MidiUtilAlarm_new();
+	lock = MidiUtilLock_new();
 
 	for (i = 1; i < argc; i++)
 	{
@@ -132,13 +149,21 @@ int main(int argc, char **argv)
 
 	if ((midi_in_port == NULL) || (filename == NULL)) usage(argv[0]);
 
-	midi_file = MidiFile_new(1, MIDI_FILE_DIVISION_TYPE_PPQ, 960);
+	midi_file = MidiFile_new(1, MIDI_FILE_DIVISION_TYPE_PPQ, resolution);
 	track = MidiFile_createTrack(midi_file); /* conductor track */
 	MidiFileTrack_createTimeSignatureEvent(track, 0, 4, 4);
 	MidiFileTrack_createKeySignatureEvent(track, 0, 0, 0);
-	MidiFileTrack_createTempoEvent(track, 0, 100.0);
-	track = MidiFile_createTrack(midi_file); /* main track */
-	start_time_msecs = MidiUtil_getCurrentTimeMsecs();
+	MidiFileTrack_createTempoEvent(track, 0, (float)(tempo_bpm));
+
+	if ((midi_file_writer = MidiFileWriter_open(filename, 1, MIDI_FILE_DIVISION_TYPE_PPQ, resolution)) == NULL)
+	{
+		fprintf(stderr, "Error:  Cannot save \"%s\".\n", filename);
+		exit(1);
+	}
+
+	MidiFileWriter_writeTrack(midi_file_writer, track);
+	MidiFileWriter_startTrack(midi_file_writer); /* main track */
+	start_time_nsecs = MidiUtil_getCurrentTimeNsecs();
 
 	if ((midi_in = rtmidi_open_in_port("recordsmf", midi_in_port, "recordsmf", handle_midi_message, NULL)) == NULL)
 	{
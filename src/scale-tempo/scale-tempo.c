@@ -3,26 +3,68 @@
 #include <stdlib.h>
 #include <string.h>
 #include <midifile.h>
+#include <midiutil-batch.h>
+
+static char *from_string = NULL;
+static char *to_string = NULL;
+static float amount = -1.0;
 
 static void usage(char *program_name)
 {
-	fprintf(stderr, "Usage:  %s [ --from <time> ] [ --to <time> ] --amount <n> [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "Usage:  %s [ --from <time> ] [ --to <time> ] --amount <n> [ --jobs <n> ] [ --out <filename.mid> ] <filename.mid>\n", program_name);
+	fprintf(stderr, "(<filename.mid> can also be a directory, a wildcard pattern, or - for a list of filenames on stdin, with --out naming an output directory)\n");
 	exit(1);
 }
 
-int main(int argc, char **argv)
+static int process_file(char *input_filename, char *output_filename, char *error_message, size_t error_message_size, void *user_data)
 {
-	char *from_string = NULL;
-	char *to_string = NULL;
-	float amount = -1.0;
-	char *output_filename = NULL;
-	char *input_filename = NULL;
-	int i;
 	MidiFile_t midi_file;
 	MidiFileEvent_t event;
 	long from_tick;
 	long to_tick;
 
+	if ((midi_file = MidiFile_load(input_filename)) == NULL)
+	{
+		snprintf(error_message, error_message_size, "Cannot read MIDI file \"%s\".", input_filename);
+		return -1;
+	}
+
+	from_tick = MidiFile_getTickFromTimeString(midi_file, from_string);
+	if (from_tick < 0) from_tick = 0;
+	to_tick = MidiFile_getTickFromTimeString(midi_file, to_string);
+	if (to_tick < 0) to_tick = MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
+
+	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
+	{
+		if (MidiFileEvent_isTempoEvent(event))
+		{
+			long tick = MidiFileEvent_getTick(event);
+
+			if ((tick >= from_tick) && (tick <= to_tick))
+			{
+				MidiFileTempoEvent_setTempo(event, MidiFileTempoEvent_getTempo(event) * amount);
+			}
+		}
+	}
+
+	if (MidiFile_save(midi_file, output_filename) < 0)
+	{
+		snprintf(error_message, error_message_size, "Cannot write MIDI file \"%s\".", output_filename);
+		MidiFile_free(midi_file);
+		return -1;
+	}
+
+	MidiFile_free(midi_file);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int number_of_jobs = 0;
+	char *output_filename = NULL;
+	char *input_filename = NULL;
+	int i;
+
 	for (i = 1; i < argc; i++)
 	{
 		if (strcmp(argv[i], "--help") == 0)
@@ -44,6 +86,11 @@ int main(int argc, char **argv)
 			if (++i == argc) usage(argv[0]);
 			amount = atof(argv[i]);
 		}
+		else if (strcmp(argv[i], "--jobs") == 0)
+		{
+			if (++i == argc) usage(argv[0]);
+			number_of_jobs = atoi(argv[i]);
+		}
 		else if (strcmp(argv[i], "--out") == 0)
 		{
 			if (++i == argc) usage(argv[0]);
@@ -56,39 +103,6 @@ int main(int argc, char **argv)
 	}
 
 	if ((input_filename == NULL) || (amount < 0.0)) usage(argv[0]);
-	if (output_filename == NULL) output_filename = input_filename;
-
-	if ((midi_file = MidiFile_load(input_filename)) == NULL)
-	{
-		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", input_filename);
-		exit(1);
-	}
-
-	from_tick = MidiFile_getTickFromTimeString(midi_file, from_string);
-	if (from_tick < 0) from_tick = 0;
-	to_tick = MidiFile_getTickFromTimeString(midi_file, to_string);
-	if (to_tick < 0) to_tick = MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file));
-
-	for (event = MidiFile_getFirstEvent(midi_file); event != NULL; event = MidiFileEvent_getNextEventInTrack(event))
-	{
-		if (MidiFileEvent_isTempoEvent(event))
-		{
-			long tick = MidiFileEvent_getTick(event);
-
-			if ((tick >= from_tick) && (tick <= to_tick))
-			{
-				MidiFileTempoEvent_setTempo(event, MidiFileTempoEvent_getTempo(event) * amount);
-			}
-		}
-	}
-
-	if (MidiFile_save(midi_file, output_filename) < 0)
-	{
-		fprintf(stderr, "Error:  Cannot write MIDI file \"%s\".\n", output_filename);
-		exit(1);
-	}
-
-	MidiFile_free(midi_file);
-	return 0;
+	return (MidiUtil_processFiles(input_filename, output_filename, number_of_jobs, process_file, NULL) == 0) ? 0 : 1;
 }
 
@@ -14,8 +14,11 @@ int main(int argc, char **argv)
 {
 	char *input_filename = NULL;
 	int i;
-	MidiFile_t midi_file;
-	MidiFileEvent_t event;
+	MidiFileReader_t reader;
+	struct MidiFileReaderEvent event;
+	MidiFile_t conductor_midi_file;
+	MidiFileTrack_t conductor_track;
+	long last_tick = -1;
 
 	for (i = 1; i < argc; i++)
 	{
@@ -31,15 +34,31 @@ int main(int argc, char **argv)
 
 	if (input_filename == NULL) usage(argv[0]);
 
-	if ((midi_file = MidiFile_load(input_filename)) == NULL)
+	if ((reader = MidiFileReader_open(input_filename, MIDI_FILE_READER_MODE_TRACK_BY_TRACK)) == NULL)
 	{
 		fprintf(stderr, "Error:  Cannot read MIDI file \"%s\".\n", input_filename);
 		exit(1);
 	}
 
-	printf("%s\n", MidiFile_getHourMinuteSecondStringFromTick(midi_file, MidiFileEvent_getTick(MidiFile_getLastEvent(midi_file))));
+	/* only the tempo events are kept, to convert the last tick into a time */
 
-	MidiFile_free(midi_file);
+	conductor_midi_file = MidiFile_new(MidiFileReader_getFileFormat(reader), MidiFileReader_getDivisionType(reader), MidiFileReader_getResolution(reader));
+	conductor_track = MidiFile_createTrack(conductor_midi_file);
+
+	while (MidiFileReader_next(reader, &event) == 0)
+	{
+		if (event.type == MIDI_FILE_EVENT_TYPE_META)
+		{
+			if (event.number == 0x2F) continue;
+			if ((event.track_number == 0) && (event.number == 0x51)) MidiFileTrack_createMetaEvent(conductor_track, event.tick, event.number, event.data_length, event.data);
+		}
+
+		if (event.tick > last_tick) last_tick = event.tick;
+	}
+
+	printf("%s\n", MidiFile_getHourMinuteSecondStringFromTick(conductor_midi_file, last_tick));
+
+	MidiFile_free(conductor_midi_file);
+	MidiFileReader_close(reader);
 	return 0;
 }
-